@@ -8,6 +8,7 @@
 #include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/Image.h>
 #include <tfr_msgs/ArucoAction.h>
+#include <tfr_utilities/tracer.h>
 #include <actionlib/server/simple_action_server.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include "generatedMarker.h"
@@ -58,6 +59,8 @@ class TFR_Aruco {
          **/
         void execute(const tfr_msgs::ArucoGoalConstPtr& goal)
         {
+            tfr_utilities::TraceSpan span{"aruco/execute", "camera",
+                tfr_utilities::Tracer::flowFromStamp(goal->image.header.stamp.toNSec())};
             if (server.isPreemptRequested() || !ros::ok())
             {
                 server.setPreempted();
@@ -134,6 +137,7 @@ int main(int argc, char** argv)
 {
     ros::init(argc, argv, "aruco_action_server");
     ros::NodeHandle n{};
+    tfr_utilities::Tracer::configureFromParams("aruco_action_server");
     TFR_Aruco aruco{n};
     ros::Rate rate(16);
     while(ros::ok()){
@@ -0,0 +1,125 @@
+/*
+ * Moves every arm axis at once.
+ *
+ * Publishing a JointState per drive puts each target on the bus at a
+ * different moment, so the joints start at skewed times. Instead each arm
+ * drive's RPDO1 is remapped to controlword + target_position and made
+ * synchronous (transmission type 1). A drive holds a synchronous RPDO until
+ * the next SYNC, so every target is staged first and then released by one
+ * SYNC frame, and all axes start on the same bus cycle.
+ *
+ * Every command takes two SYNCs, the first latches the new set-point (DS402
+ * controlword bit 4 rising with change set immediately), the second drops
+ * bit 4 again so the next command makes a new rising edge. In between every
+ * drive's statusword is read back until it shows set-point acknowledge (bit
+ * 12), a drive which has not taken the target yet would miss the move if bit
+ * 4 dropped first.
+ *
+ * Whether whole arm commands work is published, latched, on
+ * /arm_command/enabled. It stays false when fewer than four arm drives are
+ * found or the remapping fails, and ArmManipulator then falls back to the
+ * per drive set_joint_state topics.
+ *
+ * Radians are converted to drive counts with the same position_0 and
+ * position_2pi as the JointStateSubscriber for that drive, so a target
+ * means the same thing on either path.
+ *
+ * When the command carries per joint profiles they are written to
+ * profile_velocity, profile_acceleration and profile_deceleration over SDO
+ * before the targets are staged, so they are in place when the SYNC lands.
+ * rad/s become counts/s the same way, times a per drive unit scale into the
+ * drive's own units. An axis which isn't moving gets no profile, the one it
+ * had stays in the drive for the per drive set_joint_state moves.
+ *
+ * The EPOS4 takes profile velocity in rpm and acceleration in rpm/s of the
+ * motor shaft, while positions are in increments (4 x encoder counts per
+ * motor turn), so both scales are 60 / increments per motor turn. The servo
+ * cylinders take counts per s and per s^2, a scale of 1. There is no safe
+ * default: if any drive is missing a scale, no drive gets profiles and
+ * /arm_command/profiled stays false, so ArmManipulator doesn't promise a
+ * duration the arm won't keep.
+ *
+ * parameters:
+ *  - ~set_point_timeout: how long to wait for each drive's set-point acknowledge s (double, default: 0.05)
+ *  - ~device<id>/velocity_unit_scale: drive velocity units per count/s (double, required for profiles)
+ *  - ~device<id>/acceleration_unit_scale: drive acceleration units per count/s^2 (double, required for profiles)
+ *
+ * subscribed topics:
+ *  - /arm_command every arm target in one message (tfr_msgs/ArmCommand)
+ *
+ * published topics:
+ *  - /arm_command/enabled whether /arm_command is acted on, latched (std_msgs/Bool)
+ *  - /arm_command/profiled whether its profiles are applied too, latched (std_msgs/Bool)
+ * */
+#ifndef ARM_SYNC_COMMANDER_H
+#define ARM_SYNC_COMMANDER_H
+
+#include <ros/ros.h>
+#include <tfr_msgs/ArmCommand.h>
+#include <std_msgs/Bool.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "master.h"
+
+class ArmSyncCommander
+{
+    public:
+        struct Axis
+        {
+            uint8_t node_id;
+            //drive position at 0 and at 2pi radians
+            int32_t position_0;
+            int32_t position_2pi;
+            //read from the parameters, 0 when they are missing
+            double velocity_unit_scale;
+            double acceleration_unit_scale;
+        };
+
+        /*
+         * axes are in ArmCommand order: turntable, lower arm, upper arm, scoop
+         * */
+        ArmSyncCommander(kaco::Master& master, ros::NodeHandle& n, const std::vector<Axis>& axes);
+        ~ArmSyncCommander() = default;
+        ArmSyncCommander(const ArmSyncCommander&) = delete;
+        ArmSyncCommander& operator=(const ArmSyncCommander&) = delete;
+        ArmSyncCommander(ArmSyncCommander&&) = delete;
+        ArmSyncCommander& operator=(ArmSyncCommander&&) = delete;
+
+        /*
+         * Remaps RPDO1 on every axis, the drives are briefly put into
+         * pre-operational to do it. Returns false if any drive refused.
+         * */
+        bool configure();
+
+    private:
+        //DS402 controlword: enable operation, plus new set-point and change set immediately
+        static const uint16_t CONTROLWORD_ENABLED = 0x000F;
+        static const uint16_t CONTROLWORD_NEW_SET_POINT = 0x0030;
+        static const uint16_t STATUSWORD_SET_POINT_ACKNOWLEDGE = 0x1000;
+        static const uint16_t RPDO1 = 0x200;
+        static const uint16_t SYNC = 0x080;
+
+        kaco::Master& master;
+        std::vector<Axis> axes;
+        ros::Subscriber subscriber;
+        ros::Publisher enabled_publisher;
+        ros::Publisher profiled_publisher;
+        double set_point_timeout;
+        std::mutex bus_mutex;
+        bool configured = false;
+        //every axis has its unit scales
+        bool profiled = true;
+
+        void command(const tfr_msgs::ArmCommand& msg);
+        int32_t toCounts(const Axis& axis, double radians) const;
+        void writeProfile(const Axis& axis, double velocity, double acceleration);
+        void sendTarget(const Axis& axis, uint16_t controlword, int32_t target);
+        void sendSync();
+        //false if the drive didn't acknowledge the set-point in time
+        bool waitForAcknowledge(const Axis& axis);
+        void download(uint8_t node_id, uint16_t index, uint8_t subindex, uint32_t value, uint8_t size);
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * Assembles the transmit PDOs of the LPMS-CU2 into one sensor_msgs/Imu per
+ * sample.
+ *
+ * With the mapping in LPMS-CU2_32BitDataSettings.eds the sensor sends four
+ * PDOs per sample, each carrying two 32 bit floats:
+ *  - TPDO0 (NODEID+0x180): gyroscope x, gyroscope y
+ *  - TPDO1 (NODEID+0x280): gyroscope z, euler x
+ *  - TPDO2 (NODEID+0x380): euler y, euler z
+ *  - TPDO3 (NODEID+0x480): linear acceleration x, linear acceleration y
+ *
+ * The PDOs carry no timestamp, so the sample is stamped with the arrival time
+ * of its first PDO, which is as close to the acquisition time as we can get
+ * from the bus. Linear acceleration z is not mapped, and the four TPDOs are
+ * all used, so it is reported as zero with an unusable covariance. Fusion
+ * turns gravity removal off for this imu (tfr_sensor/launch/fusion.launch).
+ *
+ * parameters:
+ *  - ~imu_frame: frame of the sensor (string, default: imu)
+ *  - ~gyro_scale: raw gyro to rad/s (double, default: pi/180)
+ *  - ~euler_scale: raw euler to rad (double, default: pi/180)
+ *  - ~acceleration_scale: raw acceleration to m/s^2 (double, default: 9.80665)
+ *  - ~orientation_variance: (double, default: 0.001)
+ *  - ~angular_velocity_variance: (double, default: 0.0004)
+ *  - ~linear_acceleration_variance: (double, default: 0.01)
+ *
+ * published topics:
+ *  - /device<id>/imu one message per complete sample (sensor_msgs/Imu),
+ *    can.launch remaps it onto /sensors/imu for the preintegrator
+ * */
+#ifndef LPMS_IMU_ASSEMBLER_H
+#define LPMS_IMU_ASSEMBLER_H
+
+#include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
+#include <cstdint>
+#include <mutex>
+
+#include "message.h"
+
+class LpmsImuAssembler
+{
+    public:
+        LpmsImuAssembler(ros::NodeHandle& n, uint8_t node_id);
+        ~LpmsImuAssembler() = default;
+        LpmsImuAssembler(const LpmsImuAssembler&) = delete;
+        LpmsImuAssembler& operator=(const LpmsImuAssembler&) = delete;
+        LpmsImuAssembler(LpmsImuAssembler&&) = delete;
+        LpmsImuAssembler& operator=(LpmsImuAssembler&&) = delete;
+
+        /*
+         * Feed every message received on the bus, anything that is not one of
+         * our PDOs is ignored. Safe to call from the CAN receive thread.
+         * */
+        void receive(const kaco::Message& message);
+
+        //samples dropped because a PDO went missing
+        uint32_t getDroppedCount();
+
+    private:
+        static const uint16_t TPDO0 = 0x180;
+        static const uint16_t TPDO1 = 0x280;
+        static const uint16_t TPDO2 = 0x380;
+        static const uint16_t TPDO3 = 0x480;
+
+        const uint8_t node_id;
+        ros::Publisher publisher;
+        std::string frame;
+        double gyro_scale;
+        double euler_scale;
+        double acceleration_scale;
+        double orientation_variance;
+        double angular_velocity_variance;
+        double linear_acceleration_variance;
+
+        std::mutex sample_mutex;
+        //bit i is set once TPDOi of the current sample has arrived
+        uint8_t received = 0;
+        ros::Time stamp{};
+        float gyro[3]{};
+        float euler[3]{};
+        float acceleration[2]{};
+        uint32_t dropped = 0;
+
+        static float decodeFloat(const uint8_t* data);
+        void publishSample();
+};
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Stands in for kaco::EntrySubscriber on an int32 entry while tracing, so the
+ * CAN hop is timed where it happens: a span around the write to the device,
+ * in the same callback that does it.
+ *
+ * It subscribes to the same topic as kaco::EntrySubscriber would,
+ * device<id>/set_<entry>, so the nodes publishing to it don't change.
+ *
+ * subscribed topics:
+ *  - device<id>/set_<entry> the value to write (std_msgs/Int32)
+ * */
+#ifndef TRACED_ENTRY_SUBSCRIBER_H
+#define TRACED_ENTRY_SUBSCRIBER_H
+
+#include <ros/ros.h>
+#include <std_msgs/Int32.h>
+#include <string>
+
+#include "device.h"
+#include "subscriber.h"
+
+class TracedEntrySubscriber : public kaco::Subscriber
+{
+    public:
+        /*
+         * span_name must be a string literal, the tracer only keeps the
+         * pointer
+         * */
+        TracedEntrySubscriber(kaco::Device& device, const std::string& entry_name, const char* span_name);
+        ~TracedEntrySubscriber() = default;
+        TracedEntrySubscriber(const TracedEntrySubscriber&) = delete;
+        TracedEntrySubscriber& operator=(const TracedEntrySubscriber&) = delete;
+        TracedEntrySubscriber(TracedEntrySubscriber&&) = delete;
+        TracedEntrySubscriber& operator=(TracedEntrySubscriber&&) = delete;
+
+        void advertise() override;
+
+    private:
+        kaco::Device& device;
+        const std::string entry_name;
+        const char* const span_name;
+        ros::Subscriber subscriber;
+
+        void receive(const std_msgs::Int32& message);
+};
+
+#endif // TRACED_ENTRY_SUBSCRIBER_H
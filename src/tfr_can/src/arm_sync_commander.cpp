@@ -0,0 +1,192 @@
+#include "arm_sync_commander.h"
+
+#include <cmath>
+#include <string>
+#include <exception>
+
+#include "logger.h"
+#include <tfr_utilities/tracer.h>
+
+ArmSyncCommander::ArmSyncCommander(kaco::Master& m, ros::NodeHandle& n, const std::vector<Axis>& a) :
+    master(m),
+    axes{a},
+    subscriber{n.subscribe("/arm_command", 5, &ArmSyncCommander::command, this)},
+    enabled_publisher{n.advertise<std_msgs::Bool>("/arm_command/enabled", 1, true)},
+    profiled_publisher{n.advertise<std_msgs::Bool>("/arm_command/profiled", 1, true)}
+{
+    ros::param::param<double>("~set_point_timeout", set_point_timeout, 0.05);
+    std_msgs::Bool enabled;
+    enabled.data = false;
+    enabled_publisher.publish(enabled);
+    profiled_publisher.publish(enabled);
+    for (Axis& axis : axes)
+    {
+        const std::string prefix = "~device" + std::to_string(axis.node_id);
+        if (!ros::param::get(prefix + "/velocity_unit_scale", axis.velocity_unit_scale) ||
+                !ros::param::get(prefix + "/acceleration_unit_scale", axis.acceleration_unit_scale) ||
+                axis.velocity_unit_scale <= 0 || axis.acceleration_unit_scale <= 0)
+        {
+            ERROR("Arm sync: no unit scales for node " << static_cast<int>(axis.node_id)
+                    << ", every drive keeps its own profile");
+            axis.velocity_unit_scale = 0;
+            axis.acceleration_unit_scale = 0;
+            profiled = false;
+        }
+    }
+}
+
+bool ArmSyncCommander::configure()
+{
+    std::lock_guard<std::mutex> lock(bus_mutex);
+    configured = true;
+    for (const Axis& axis : axes)
+    {
+        const uint32_t cob_id = RPDO1 + axis.node_id;
+        try
+        {
+            //mappings can only change in pre-operational, with the pdo disabled
+            master.core.nmt.send_nmt_message(axis.node_id, kaco::NMT::Command::enter_preoperational);
+            download(axis.node_id, 0x1400, 1, cob_id | 0x80000000, 4);
+            download(axis.node_id, 0x1600, 0, 0, 1);
+            download(axis.node_id, 0x1600, 1, 0x60400010, 4); //controlword
+            download(axis.node_id, 0x1600, 2, 0x607A0020, 4); //target_position
+            download(axis.node_id, 0x1600, 0, 2, 1);
+            download(axis.node_id, 0x1400, 2, 1, 1); //act on every SYNC
+            download(axis.node_id, 0x1400, 1, cob_id, 4);
+            master.core.nmt.send_nmt_message(axis.node_id, kaco::NMT::Command::start_node);
+        }
+        catch (const std::exception& e)
+        {
+            ERROR("Arm sync: could not map RPDO1 on node " << static_cast<int>(axis.node_id) << ": " << e.what());
+            master.core.nmt.send_nmt_message(axis.node_id, kaco::NMT::Command::start_node);
+            configured = false;
+        }
+    }
+    std_msgs::Bool enabled;
+    enabled.data = configured && axes.size() == 4;
+    enabled_publisher.publish(enabled);
+    //a profile on some axes only would stretch their moves and not the rest
+    enabled.data = enabled.data && profiled;
+    profiled_publisher.publish(enabled);
+    return configured;
+}
+
+void ArmSyncCommander::command(const tfr_msgs::ArmCommand& msg)
+{
+    tfr_utilities::TraceSpan span{"can/arm_sync", "can"};
+    std::lock_guard<std::mutex> lock(bus_mutex);
+    if (!configured || axes.size() != 4)
+    {
+        ERROR("Arm sync: not configured, dropping arm command");
+        return;
+    }
+
+    const double targets[4] = {msg.turntable, msg.lower_arm, msg.upper_arm, msg.scoop};
+    int32_t counts[4];
+    for (size_t i = 0; i < axes.size(); i++)
+        counts[i] = toCounts(axes[i], targets[i]);
+
+    //profiles first, over SDO, so every drive has its own before the release
+    if (profiled && msg.profile_velocity.size() == axes.size() &&
+            msg.profile_acceleration.size() == axes.size())
+    {
+        try
+        {
+            for (size_t i = 0; i < axes.size(); i++)
+                writeProfile(axes[i], msg.profile_velocity[i], msg.profile_acceleration[i]);
+        }
+        catch (const std::exception& e)
+        {
+            ERROR("Arm sync: could not write a profile, moving with the previous ones: " << e.what());
+        }
+    }
+
+    //stage every target, then release them all together
+    for (size_t i = 0; i < axes.size(); i++)
+        sendTarget(axes[i], CONTROLWORD_ENABLED | CONTROLWORD_NEW_SET_POINT, counts[i]);
+    sendSync();
+
+    //bit 4 can only drop once every drive has the target
+    for (const Axis& axis : axes)
+        if (!waitForAcknowledge(axis))
+            ERROR("Arm sync: node " << static_cast<int>(axis.node_id) << " did not acknowledge its set-point");
+
+    //finish the set-point handshake so the next command is a fresh edge
+    for (size_t i = 0; i < axes.size(); i++)
+        sendTarget(axes[i], CONTROLWORD_ENABLED, counts[i]);
+    sendSync();
+}
+
+int32_t ArmSyncCommander::toCounts(const Axis& axis, double radians) const
+{
+    const double span = static_cast<double>(axis.position_2pi) - axis.position_0;
+    return static_cast<int32_t>(std::lround(axis.position_0 + radians / (2 * M_PI) * span));
+}
+
+void ArmSyncCommander::writeProfile(const Axis& axis, double velocity, double acceleration)
+{
+    const double counts_per_radian =
+        std::abs(static_cast<double>(axis.position_2pi) - axis.position_0) / (2 * M_PI);
+    const double drive_velocity = std::round(std::abs(velocity) * counts_per_radian * axis.velocity_unit_scale);
+    const double drive_acceleration =
+        std::round(std::abs(acceleration) * counts_per_radian * axis.acceleration_unit_scale);
+    //drives reject a zero profile, and an idle axis would keep a crawl of
+    //1 for every later move, so it keeps the profile it has
+    if (drive_velocity < 1 || drive_acceleration < 1)
+        return;
+    download(axis.node_id, 0x6081, 0, static_cast<uint32_t>(drive_velocity), 4);
+    download(axis.node_id, 0x6083, 0, static_cast<uint32_t>(drive_acceleration), 4);
+    download(axis.node_id, 0x6084, 0, static_cast<uint32_t>(drive_acceleration), 4);
+}
+
+void ArmSyncCommander::sendTarget(const Axis& axis, uint16_t controlword, int32_t target)
+{
+    const uint32_t raw = static_cast<uint32_t>(target);
+    kaco::Message message{};
+    message.cob_id = RPDO1 + axis.node_id;
+    message.rtr = false;
+    message.len = 6;
+    message.data[0] = controlword & 0xFF;
+    message.data[1] = (controlword >> 8) & 0xFF;
+    message.data[2] = raw & 0xFF;
+    message.data[3] = (raw >> 8) & 0xFF;
+    message.data[4] = (raw >> 16) & 0xFF;
+    message.data[5] = (raw >> 24) & 0xFF;
+    master.core.send(message);
+}
+
+void ArmSyncCommander::sendSync()
+{
+    kaco::Message message{};
+    message.cob_id = SYNC;
+    message.rtr = false;
+    message.len = 0;
+    master.core.send(message);
+}
+
+bool ArmSyncCommander::waitForAcknowledge(const Axis& axis)
+{
+    const ros::WallTime end = ros::WallTime::now() + ros::WallDuration(set_point_timeout);
+    do
+    {
+        try
+        {
+            const std::vector<uint8_t> bytes = master.core.sdo.upload(axis.node_id, 0x6041, 0);
+            if (bytes.size() >= 2 && ((bytes[0] | bytes[1] << 8) & STATUSWORD_SET_POINT_ACKNOWLEDGE))
+                return true;
+        }
+        catch (const std::exception&)
+        {
+            //a missed SDO reply is worth another try before the timeout
+        }
+    } while (ros::WallTime::now() < end);
+    return false;
+}
+
+void ArmSyncCommander::download(uint8_t node_id, uint16_t index, uint8_t subindex, uint32_t value, uint8_t size)
+{
+    std::vector<uint8_t> bytes;
+    for (uint8_t i = 0; i < size; i++)
+        bytes.push_back((value >> (8 * i)) & 0xFF);
+    master.core.sdo.download(node_id, index, subindex, size, bytes);
+}
@@ -5,6 +5,11 @@
 #include "joint_state_subscriber.h"
 #include "entry_publisher.h"
 #include "entry_subscriber.h"
+#include "lpms_imu_assembler.h"
+#include "arm_sync_commander.h"
+#include "traced_entry_subscriber.h"
+
+#include <tfr_utilities/tracer.h>
 
 #include <thread>
 #include <chrono>
@@ -33,6 +38,7 @@ const int SERVO_CYLINDER_UPPER_ARM = 45;
 const int SERVO_CYLINDER_SCOOP = 56;
 const int SERVO_CYLINDER_BIN_LEFT = 77; 
 const int SERVO_CYLINDER_BIN_RIGHT = 88; 
+const int LPMS_IMU = 120;
 
 // initialize the topics for any Servo Cylinder actuator 
 void setupServoCylinderDevice(kaco::Device& device, kaco::Bridge& bridge, std::string& eds_files_path)
@@ -115,6 +121,15 @@ void setupServoCylinderDevice(kaco::Device& device, kaco::Bridge& bridge, std::s
     bridge.add_subscriber(iosub_9);
 }
 
+// The dumping server waits on the bin actuators' target reached bit (bit 10)
+// instead of sleeping, see setupMaxonDevice for the statusword. Only the bins
+// need it, so the arm's servo cylinders don't load the bus with it.
+void setupBinStatusword(kaco::Device& device, kaco::Bridge& bridge)
+{
+    auto iopub = std::make_shared<kaco::EntryPublisher>(device, "statusword");
+    bridge.add_publisher(iopub, loop_rate);
+}
+
 void setupMaxonDevice(kaco::Device& device, kaco::Bridge& bridge, std::string& eds_files_path)
 {
     
@@ -236,6 +251,10 @@ int main(int argc, char* argv[]) {
 	// Create bridge
 	ros::init(argc, argv, "canopen_bridge");
 	kaco::Bridge bridge;
+	ros::NodeHandle n;
+	tfr_utilities::Tracer::configureFromParams("canopen_bridge");
+	std::shared_ptr<LpmsImuAssembler> imu_assembler;
+	int arm_devices_found = 0;
 
 	for (size_t i=0; i<master.num_devices(); ++i) {
 
@@ -256,35 +275,51 @@ int main(int argc, char* argv[]) {
         if (deviceId == SERVO_CYLINDER_LOWER_ARM)
         {
             setupServoCylinderDevice(device, bridge, eds_files_path);
+            arm_devices_found++;
         }
 		
 		if (deviceId == SERVO_CYLINDER_UPPER_ARM)
         {
             setupServoCylinderDevice(device, bridge, eds_files_path);
+            arm_devices_found++;
         }
 		
 		if (deviceId == SERVO_CYLINDER_SCOOP)
         {
             setupServoCylinderDevice(device, bridge, eds_files_path);
+            arm_devices_found++;
         }
 		
 		if (deviceId == SERVO_CYLINDER_BIN_LEFT)
        {
             setupServoCylinderDevice(device, bridge, eds_files_path);
+            setupBinStatusword(device, bridge);
        }
 
 		if (deviceId == SERVO_CYLINDER_BIN_RIGHT)
         {
             setupServoCylinderDevice(device, bridge, eds_files_path);
+            setupBinStatusword(device, bridge);
         }
 		
 		if (deviceId == TURNTABLE) //THIS IS WHERE WE LOAD THE EDS LIBRARY
 	{
 	    setupMaxonDevice(device, bridge, eds_files_path);
+	    arm_devices_found++;
 	}
 		
 		
 		
+		else if (deviceId == LPMS_IMU)
+		{
+			// The imu streams its samples as PDOs, rather than publishing each
+			// entry on its own topic we put every sample into one Imu message.
+			imu_assembler = std::make_shared<LpmsImuAssembler>(n, deviceId);
+			master.core.register_receive_callback([imu_assembler](const kaco::Message& message) {
+				imu_assembler->receive(message);
+			});
+		}
+
 		else if (deviceId == DRIVETRAIN) //Drivetrain Motor controller
 		{
 			device.load_dictionary_from_eds(eds_files_path + "roboteq_motor_controllers_v60.eds");
@@ -293,7 +328,12 @@ int main(int argc, char* argv[]) {
 			
 			// Roboteq SBL2360.
 
-			auto iosub_8_1_1 = std::make_shared<kaco::EntrySubscriber>(device, "cmd_cango/cmd_cango_1");
+			// while tracing the treads' commands are timed at the write to the drive
+			std::shared_ptr<kaco::Subscriber> iosub_8_1_1;
+			if (tfr_utilities::Tracer::enabled())
+				iosub_8_1_1 = std::make_shared<TracedEntrySubscriber>(device, "cmd_cango/cmd_cango_1", "can/cmd_cango");
+			else
+				iosub_8_1_1 = std::make_shared<kaco::EntrySubscriber>(device, "cmd_cango/cmd_cango_1");
     		bridge.add_subscriber(iosub_8_1_1);
 
 			auto iopub_8_1_2 = std::make_shared<kaco::EntryPublisher>(device, "qry_motcmd/channel_1");
@@ -310,8 +350,16 @@ int main(int argc, char* argv[]) {
 			
             auto iopub_8_1_6 = std::make_shared<kaco::EntryPublisher>(device, "qry_abcntr/channel_1");
     		bridge.add_publisher(iopub_8_1_6, loop_rate);
+
+			// Closed loop error, only meaningful when the channel is in closed loop speed mode
+			auto iopub_8_1_7 = std::make_shared<kaco::EntryPublisher>(device, "qry_lperr/qry_lperr_1");
+    		bridge.add_publisher(iopub_8_1_7, loop_rate);
 			
-			auto iosub_8_2_1 = std::make_shared<kaco::EntrySubscriber>(device, "cmd_cango/cmd_cango_2");
+			std::shared_ptr<kaco::Subscriber> iosub_8_2_1;
+			if (tfr_utilities::Tracer::enabled())
+				iosub_8_2_1 = std::make_shared<TracedEntrySubscriber>(device, "cmd_cango/cmd_cango_2", "can/cmd_cango");
+			else
+				iosub_8_2_1 = std::make_shared<kaco::EntrySubscriber>(device, "cmd_cango/cmd_cango_2");
     		bridge.add_subscriber(iosub_8_2_1);
 
 			auto iopub_8_2_2 = std::make_shared<kaco::EntryPublisher>(device, "qry_motcmd/channel_2");
@@ -328,6 +376,9 @@ int main(int argc, char* argv[]) {
 
             auto iopub_8_2_6 = std::make_shared<kaco::EntryPublisher>(device, "qry_abcntr/channel_2");
     		bridge.add_publisher(iopub_8_2_6, loop_rate);
+
+			auto iopub_8_2_7 = std::make_shared<kaco::EntryPublisher>(device, "qry_lperr/qry_lperr_2");
+    		bridge.add_publisher(iopub_8_2_7, loop_rate);
 		
 		//Reads battery voltage	
 		auto iopub_8 = std::make_shared<kaco::EntryPublisher>(device, "qry_volts/v_bat");
@@ -338,6 +389,24 @@ int main(int argc, char* argv[]) {
 		
 
 	}
+	// Whole arm commands, released on one SYNC so every axis starts together.
+	// Uses the same position_0 and position_2pi as each drive's JointStateSubscriber.
+	std::shared_ptr<ArmSyncCommander> arm_sync_commander;
+	if (arm_devices_found == 4)
+	{
+		arm_sync_commander = std::make_shared<ArmSyncCommander>(master, n, std::vector<ArmSyncCommander::Axis>{
+				{TURNTABLE, -6321, 6321, 0, 0},
+				{SERVO_CYLINDER_LOWER_ARM, 0, 47104, 0, 0},
+				{SERVO_CYLINDER_UPPER_ARM, 0, 47104, 0, 0},
+				{SERVO_CYLINDER_SCOOP, 0, 47104, 0, 0}});
+		if (!arm_sync_commander->configure())
+			ERROR("Arm sync commands are disabled, use /device<id>/set_joint_state instead.");
+	}
+	else
+	{
+		ERROR("Only found " << arm_devices_found << " of 4 arm drives, arm sync commands are disabled.");
+	}
+
 	PRINT("About to call bridge.run()");
 	bridge.run();
 	
@@ -0,0 +1,116 @@
+#include "lpms_imu_assembler.h"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+LpmsImuAssembler::LpmsImuAssembler(ros::NodeHandle& n, uint8_t id) :
+    node_id{id},
+    publisher{n.advertise<sensor_msgs::Imu>("device" + std::to_string(id) + "/imu", 50)}
+{
+    ros::param::param<std::string>("~imu_frame", frame, "imu");
+    ros::param::param<double>("~gyro_scale", gyro_scale, M_PI / 180.0);
+    ros::param::param<double>("~euler_scale", euler_scale, M_PI / 180.0);
+    ros::param::param<double>("~acceleration_scale", acceleration_scale, 9.80665);
+    ros::param::param<double>("~orientation_variance", orientation_variance, 0.001);
+    ros::param::param<double>("~angular_velocity_variance", angular_velocity_variance, 0.0004);
+    ros::param::param<double>("~linear_acceleration_variance", linear_acceleration_variance, 0.01);
+}
+
+void LpmsImuAssembler::receive(const kaco::Message& message)
+{
+    if (message.rtr || message.len < 8 || (message.cob_id & 0x7F) != node_id)
+        return;
+
+    const uint16_t function = message.cob_id & 0x780;
+    std::lock_guard<std::mutex> lock(sample_mutex);
+    switch (function)
+    {
+        case TPDO0:
+            //a new sample starts, whatever was pending is incomplete
+            if (received != 0)
+                dropped++;
+            received = 1;
+            stamp = ros::Time::now();
+            gyro[0] = decodeFloat(message.data);
+            gyro[1] = decodeFloat(message.data + 4);
+            break;
+        case TPDO1:
+            received |= 1 << 1;
+            gyro[2] = decodeFloat(message.data);
+            euler[0] = decodeFloat(message.data + 4);
+            break;
+        case TPDO2:
+            received |= 1 << 2;
+            euler[1] = decodeFloat(message.data);
+            euler[2] = decodeFloat(message.data + 4);
+            break;
+        case TPDO3:
+            received |= 1 << 3;
+            acceleration[0] = decodeFloat(message.data);
+            acceleration[1] = decodeFloat(message.data + 4);
+            if (received == 0x0F)
+                publishSample();
+            else
+                dropped++;
+            received = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+uint32_t LpmsImuAssembler::getDroppedCount()
+{
+    std::lock_guard<std::mutex> lock(sample_mutex);
+    return dropped;
+}
+
+/*
+ * The sensor sends IEEE 754 floats least significant byte first.
+ * */
+float LpmsImuAssembler::decodeFloat(const uint8_t* data)
+{
+    uint32_t raw = static_cast<uint32_t>(data[0]) |
+        static_cast<uint32_t>(data[1]) << 8 |
+        static_cast<uint32_t>(data[2]) << 16 |
+        static_cast<uint32_t>(data[3]) << 24;
+    float value;
+    std::memcpy(&value, &raw, sizeof(value));
+    return value;
+}
+
+void LpmsImuAssembler::publishSample()
+{
+    sensor_msgs::Imu imu;
+    imu.header.stamp = stamp;
+    imu.header.frame_id = frame;
+
+    //fixed axis roll, pitch, yaw to quaternion
+    double cr = std::cos(euler[0] * euler_scale / 2), sr = std::sin(euler[0] * euler_scale / 2);
+    double cp = std::cos(euler[1] * euler_scale / 2), sp = std::sin(euler[1] * euler_scale / 2);
+    double cy = std::cos(euler[2] * euler_scale / 2), sy = std::sin(euler[2] * euler_scale / 2);
+    imu.orientation.w = cr * cp * cy + sr * sp * sy;
+    imu.orientation.x = sr * cp * cy - cr * sp * sy;
+    imu.orientation.y = cr * sp * cy + sr * cp * sy;
+    imu.orientation.z = cr * cp * sy - sr * sp * cy;
+
+    imu.angular_velocity.x = gyro[0] * gyro_scale;
+    imu.angular_velocity.y = gyro[1] * gyro_scale;
+    imu.angular_velocity.z = gyro[2] * gyro_scale;
+
+    imu.linear_acceleration.x = acceleration[0] * acceleration_scale;
+    imu.linear_acceleration.y = acceleration[1] * acceleration_scale;
+    imu.linear_acceleration.z = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        imu.orientation_covariance[i * 4] = orientation_variance;
+        imu.angular_velocity_covariance[i * 4] = angular_velocity_variance;
+        imu.linear_acceleration_covariance[i * 4] = linear_acceleration_variance;
+    }
+    //z is not in the pdo mapping
+    imu.linear_acceleration_covariance[8] = 1e6;
+
+    publisher.publish(imu);
+}
@@ -0,0 +1,34 @@
+#include "traced_entry_subscriber.h"
+
+#include <exception>
+
+#include "logger.h"
+#include "utils.h"
+#include <tfr_utilities/tracer.h>
+
+TracedEntrySubscriber::TracedEntrySubscriber(kaco::Device& d, const std::string& entry, const char* span) :
+    device(d),
+    entry_name{entry},
+    span_name{span}
+{}
+
+void TracedEntrySubscriber::advertise()
+{
+    ros::NodeHandle n;
+    const std::string topic = "device" + std::to_string(device.get_node_id()) +
+        "/set_" + kaco::Utils::escape(entry_name);
+    subscriber = n.subscribe(topic, 1, &TracedEntrySubscriber::receive, this);
+}
+
+void TracedEntrySubscriber::receive(const std_msgs::Int32& message)
+{
+    tfr_utilities::TraceSpan span{span_name, "can"};
+    try
+    {
+        device.set_entry(entry_name, kaco::Value{static_cast<int32_t>(message.data)});
+    }
+    catch (const std::exception& e)
+    {
+        ERROR("Traced entry subscriber: writing " << entry_name << " failed: " << e.what());
+    }
+}
@@ -1,17 +1,23 @@
 #include <Encoder.h>
 #include <Wire.h>
 #include <Adafruit_ADS1015.h>
-#include <ros.h>
-#include <tfr_msgs/ArduinoAReading.h>
 #include <quadrature.h>
+#include <serial_protocol.h>
 
-ros::NodeHandle nh;
+/*
+  Streams raw encoder counts and potentiometer positions to the host using the
+  framing in serial_protocol.h. The host side is the arduino_bridge node, which
+  turns these into tfr_msgs/ArduinoAReading.
+
+  Counts go out at a fixed 250hz with their micros() timestamp, potentiometers
+  go out whenever a full round of adc conversions finishes, the adc is never
+  waited on so it does not hold up the counts.
+*/
 
-//encoder level constants
-const double GEARBOX_CPR = 4096;
-const double TURNTABLE_CPR = 28; 
-const double GEARBOX_MPR = 2*3.14*0.15; 
-const double TURNTABLE_RPR = (1/188.0)*(15.0/72.0)*2.0*3.15159; 
+const long BAUD_RATE = 115200;
+const unsigned long COUNT_PERIOD_US = 4000;
+//the ads1115 needs this long to finish a single ended conversion
+const unsigned long ADC_CONVERSION_US = 8000;
 
 //pin constants
 const int GEARBOX_LEFT_A = 2;
@@ -61,13 +67,9 @@ Potentiometer pots []
   Potentiometer{0.00348, -23.882}             //BIN_RIGHT TODO
 };
 
-
-PositionQuadrature turntable(TURNTABLE_CPR, TURNTABLE_A, TURNTABLE_B); 
-
-//encoders
-VelocityQuadrature gearbox_left(GEARBOX_CPR, GEARBOX_LEFT_A, GEARBOX_LEFT_B);
-tfr_msgs::ArduinoAReading arduinoReading;
-ros::Publisher arduino("arduino_a", &arduinoReading);
+//encoders, counts[0] is the left gearbox, counts[1] the turntable
+CountQuadrature gearbox_left(GEARBOX_LEFT_A, GEARBOX_LEFT_B);
+CountQuadrature turntable(TURNTABLE_A, TURNTABLE_B);
 
 //potentiometers
 /*
@@ -88,36 +90,88 @@ ads1115_b =>
 Adafruit_ADS1115 ads1115_a;
 
 Adafruit_ADS1115 ads1115_b(0x49);
+
+//the three rounds of adc conversions, one pair of channels at a time
+int adc_step = 0;
+unsigned long adc_started = 0;
+unsigned long next_count = 0;
+serial_protocol::PositionsPayload positions{};
+
+uint8_t frame[serial_protocol::HEADER_SIZE + serial_protocol::MAX_PAYLOAD + 1];
+
+void startConversion()
+{
+    switch (adc_step)
+    {
+        case 0:
+            ads1115_a.startADC_SingleEnded(2);
+            ads1115_b.startADC_SingleEnded(0);
+            break;
+        case 1:
+            ads1115_a.startADC_SingleEnded(1);
+            ads1115_b.startADC_SingleEnded(1);
+            break;
+        case 2:
+            ads1115_a.startADC_SingleEnded(3);
+            break;
+    }
+    adc_started = micros();
+}
+
+int16_t toMilliradians(float radians)
+{
+    return static_cast<int16_t>(radians * 1000.0);
+}
+
+void collectConversion()
+{
+    switch (adc_step)
+    {
+        case 0:
+            positions.milliradians[ARM_UPPER] = toMilliradians(pots[ARM_UPPER].getPosition(ads1115_a.collectADC_SingleEnded()));
+            positions.milliradians[BIN_LEFT] = toMilliradians(pots[BIN_LEFT].getPosition(ads1115_b.collectADC_SingleEnded()));
+            break;
+        case 1:
+            positions.milliradians[ARM_SCOOP] = toMilliradians(pots[ARM_SCOOP].getPosition(ads1115_a.collectADC_SingleEnded()));
+            positions.milliradians[BIN_RIGHT] = toMilliradians(pots[BIN_RIGHT].getPosition(ads1115_b.collectADC_SingleEnded()));
+            break;
+        case 2:
+            positions.milliradians[ARM_LOWER] = toMilliradians(pots[ARM_LOWER].getPosition(ads1115_a.collectADC_SingleEnded()));
+            positions.micros = micros();
+            Serial.write(frame, serial_protocol::encode(serial_protocol::POSITIONS,
+                        &positions, sizeof(positions), frame));
+            break;
+    }
+    adc_step = (adc_step + 1) % 3;
+}
+
 void setup()
 {
-    nh.initNode();
-    nh.advertise(arduino);
+    Serial.begin(BAUD_RATE);
     ads1115_a.begin();
+    ads1115_b.begin();
+    startConversion();
+    next_count = micros();
 }
 
 void loop()
 {
-    arduinoReading.tread_left_vel = gearbox_left.getVelocity() * GEARBOX_MPR;
-    arduinoReading.arm_turntable_pos = turntable.getPosition()  * TURNTABLE_RPR;
-
-    ads1115_a.startADC_SingleEnded(2);
-    ads1115_b.startADC_SingleEnded(0);
-    delay(8);
-    arduinoReading.arm_upper_pos = pots[ARM_UPPER].getPosition(ads1115_a.collectADC_SingleEnded());
-    arduinoReading.bin_left_pos = pots[BIN_LEFT].getPosition(ads1115_b.collectADC_SingleEnded());
-    nh.spinOnce(); 
-
-    ads1115_a.startADC_SingleEnded(1);
-    ads1115_b.startADC_SingleEnded(1);
-    delay(8);
-    arduinoReading.arm_scoop_pos = pots[ARM_SCOOP].getPosition(ads1115_a.collectADC_SingleEnded());
-    arduinoReading.bin_right_pos = pots[BIN_RIGHT].getPosition(ads1115_b.collectADC_SingleEnded());
-    nh.spinOnce();
-
-    ads1115_a.startADC_SingleEnded(3);
-    delay(8);
-    arduinoReading.arm_lower_pos = pots[ARM_LOWER].getPosition(ads1115_a.collectADC_SingleEnded());
-    nh.spinOnce();
-
-    arduino.publish(&arduinoReading);
+    unsigned long now = micros();
+    //signed difference so this survives the micros() rollover
+    if (static_cast<long>(now - next_count) >= 0)
+    {
+        serial_protocol::CountsPayload counts;
+        counts.micros = micros();
+        counts.counts[0] = gearbox_left.getCount();
+        counts.counts[1] = turntable.getCount();
+        Serial.write(frame, serial_protocol::encode(serial_protocol::COUNTS,
+                    &counts, sizeof(counts), frame));
+        next_count += COUNT_PERIOD_US;
+    }
+
+    if (micros() - adc_started >= ADC_CONVERSION_US)
+    {
+        collectConversion();
+        startConversion();
+    }
 }
@@ -1,17 +1,19 @@
 #include <Adafruit_PWMServoDriver.h>
 #include <Encoder.h>
 #include <Wire.h>
-#include <ros.h>
-#include <tfr_msgs/ArduinoBReading.h>
 #include <quadrature.h>
-#include <std_msgs/Int32.h>
-#include <tfr_msgs/PwmCommand.h>
+#include <serial_protocol.h>
 
-ros::NodeHandle nh;
+/*
+  Streams the raw right gearbox count to the host, and drives the pwm outputs
+  from the commands it receives, both using the framing in serial_protocol.h.
+  The host side is the arduino_bridge node, which turns the counts into
+  tfr_msgs/ArduinoBReading and forwards /motor_output.
+*/
+
+const long BAUD_RATE = 115200;
+const unsigned long COUNT_PERIOD_US = 4000;
 
-//encoder level constants
-const double CPR = 4096; //pulse per revolution
-const double GEARBOX_MPR = 2*3.1415*0.15; 
 const float MAX_DRIVEBASE_DELTA = 8.0;
 const float MAX_ARM_DELTA = 15.0;
 
@@ -37,20 +39,34 @@ enum class Address : int16_t
     BIN_RIGHT = 3
 };
 
+//in the order of tfr_msgs/PwmCommand, which is the order of the payload
+const Address COMMAND_ORDER[8] 
+{
+    Address::TREAD_LEFT,
+    Address::TREAD_RIGHT,
+    Address::ARM_TURNTABLE,
+    Address::ARM_LOWER,
+    Address::ARM_UPPER,
+    Address::ARM_SCOOP,
+    Address::BIN_LEFT,
+    Address::BIN_RIGHT
+};
+
 
 Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
 
 //encoders
-VelocityQuadrature gearbox_right(CPR, GEARBOX_RIGHT_A, GEARBOX_RIGHT_B);
-
-//TODO Quadrature turntable(CPR, GEARBOX_LEFT_A, GEARBOX_LEFT_B);
-tfr_msgs::ArduinoBReading arduino_reading;
-ros::Publisher arduino("arduino_b", &arduino_reading);
-void motorOutput(const tfr_msgs::PwmCommand& command);
-ros::Subscriber<tfr_msgs::PwmCommand> motor_subscriber("/motor_output", &motorOutput );
+CountQuadrature gearbox_right(GEARBOX_RIGHT_A, GEARBOX_RIGHT_B);
 
 uint16_t pwm_values[9] {};
 
+unsigned long next_count = 0;
+uint8_t frame[serial_protocol::HEADER_SIZE + serial_protocol::MAX_PAYLOAD + 1];
+
+//incoming frame state
+uint8_t rx[serial_protocol::HEADER_SIZE + serial_protocol::MAX_PAYLOAD + 1];
+uint8_t rx_size = 0;
+
 
 void setup()
 {
@@ -63,57 +79,86 @@ void setup()
     for (auto& val : pwm_values)
       val = NEUTRAL;
 
-    nh.initNode();
-    nh.advertise(arduino);
-    nh.subscribe(motor_subscriber);
+    Serial.begin(BAUD_RATE);
     pwm.begin();
     pwm.setPWMFreq(80);  // This is the maximum PWM frequency
-    setAddress(Address::TREAD_LEFT, 0, FULL_DELTA);
-    setAddress(Address::TREAD_RIGHT, 0, FULL_DELTA);
-    setAddress(Address::ARM_TURNTABLE, 0, FULL_DELTA);
-    setAddress(Address::ARM_LOWER, 0, FULL_DELTA);
-    setAddress(Address::ARM_UPPER, 0, FULL_DELTA);
-    setAddress(Address::ARM_SCOOP, 0, FULL_DELTA);
-    setAddress(Address::BIN_LEFT, 0, FULL_DELTA);
-    setAddress(Address::BIN_RIGHT, 0, FULL_DELTA);
+    for (const auto& address : COMMAND_ORDER)
+        setAddress(address, 0, FULL_DELTA);
+    next_count = micros();
 }
 
 void loop()
 {
-    arduino_reading.tread_right_vel = gearbox_right.getVelocity()/GEARBOX_MPR;
-    delay(8);
-    nh.spinOnce(); //I know we don't have any callbacks, but the libary needs this call
-    delay(8);
-    arduino.publish(&arduino_reading);
-    nh.spinOnce(); //I know we don't have any callbacks, but the libary needs this call
+    unsigned long now = micros();
+    //signed difference so this survives the micros() rollover
+    if (static_cast<long>(now - next_count) >= 0)
+    {
+        serial_protocol::CountsPayload counts;
+        counts.micros = micros();
+        counts.counts[0] = gearbox_right.getCount();
+        counts.counts[1] = 0;
+        Serial.write(frame, serial_protocol::encode(serial_protocol::COUNTS,
+                    &counts, sizeof(counts), frame));
+        next_count += COUNT_PERIOD_US;
+    }
+
+    while (Serial.available() > 0)
+        receiveByte(Serial.read());
+}
+
+/*
+ * Collects bytes into rx until a whole frame is in, resynchronizing on the
+ * sync bytes whenever something does not add up.
+ */
+void receiveByte(uint8_t byte)
+{
+    if ((rx_size == 0 && byte != serial_protocol::SYNC_0) ||
+        (rx_size == 1 && byte != serial_protocol::SYNC_1) ||
+        (rx_size == 3 && byte > serial_protocol::MAX_PAYLOAD))
+    {
+        rx_size = (byte == serial_protocol::SYNC_0) ? 1 : 0;
+        rx[0] = byte;
+        return;
+    }
+    rx[rx_size++] = byte;
+    if (rx_size < serial_protocol::HEADER_SIZE ||
+            rx_size < serial_protocol::HEADER_SIZE + rx[3] + 1)
+        return;
+
+    uint8_t length = rx[3];
+    uint8_t crc = serial_protocol::crc8(serial_protocol::crc8(0, rx[2]), length);
+    for (uint8_t i = 0; i < length; i++)
+        crc = serial_protocol::crc8(crc, rx[serial_protocol::HEADER_SIZE + i]);
+
+    if (crc == rx[serial_protocol::HEADER_SIZE + length] &&
+            rx[2] == serial_protocol::PWM_COMMAND &&
+            length == sizeof(serial_protocol::PwmCommandPayload))
+    {
+        serial_protocol::PwmCommandPayload command;
+        memcpy(&command, rx + serial_protocol::HEADER_SIZE, sizeof(command));
+        motorOutput(command);
+    }
+    rx_size = 0;
 }
 
-void motorOutput(const tfr_msgs::PwmCommand& command)
+void motorOutput(const serial_protocol::PwmCommandPayload& command)
 {
 
     if(command.enabled)
     {
       	digitalWrite(OUTPUT_ENABLE, LOW);
-        setAddress(Address::TREAD_LEFT, command.tread_left, MAX_DRIVEBASE_DELTA);
-        setAddress(Address::TREAD_RIGHT, command.tread_right, MAX_DRIVEBASE_DELTA);
-        setAddress(Address::ARM_TURNTABLE, command.arm_turntable, MAX_ARM_DELTA);
-        setAddress(Address::ARM_LOWER, command.arm_lower, MAX_ARM_DELTA);
-        setAddress(Address::ARM_UPPER, command.arm_upper, MAX_ARM_DELTA);
-        setAddress(Address::ARM_SCOOP, command.arm_scoop, MAX_ARM_DELTA);
-        setAddress(Address::BIN_LEFT, command.bin_left, MAX_ARM_DELTA);
-        setAddress(Address::BIN_RIGHT, command.bin_right, MAX_ARM_DELTA);
+        for (int i = 0; i < 8; i++)
+        {
+            //the treads ramp slower than everything else
+            float max_delta = (i < 2) ? MAX_DRIVEBASE_DELTA : MAX_ARM_DELTA;
+            setAddress(COMMAND_ORDER[i], command.outputs[i] / 100.0, max_delta);
+        }
     }
     else
     {
       	digitalWrite(OUTPUT_ENABLE, HIGH);
-        setAddress(Address::TREAD_LEFT, 0, FULL_DELTA);
-        setAddress(Address::TREAD_RIGHT, 0, FULL_DELTA);
-        setAddress(Address::ARM_TURNTABLE, 0, FULL_DELTA);
-        setAddress(Address::ARM_LOWER, 0, FULL_DELTA);
-        setAddress(Address::ARM_UPPER, 0, FULL_DELTA);
-        setAddress(Address::ARM_SCOOP, 0, FULL_DELTA);
-        setAddress(Address::BIN_LEFT, 0, FULL_DELTA);
-        setAddress(Address::BIN_RIGHT, 0, FULL_DELTA);
+        for (const auto& address : COMMAND_ORDER)
+            setAddress(address, 0, FULL_DELTA);
     }
 }
 
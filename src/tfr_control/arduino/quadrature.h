@@ -86,4 +86,27 @@ class PositionQuadrature
     
 };
 
+/*
+  Reads the raw count of a quadrature encoder. Unlike the classes above it does
+  no math on the avr, the count is sent with a micros() timestamp and the host
+  derives velocity and position.
+  */
+class CountQuadrature
+{
+  public:
+    CountQuadrature(int a_pin, int b_pin):
+    encoder{a_pin,b_pin} {}
+
+  //interrupt safety is handled by lower level library
+  int32_t getCount()
+  {
+    return encoder.read();
+  }
+
+  private:
+
+    Encoder encoder;
+    
+};
+
 #endif
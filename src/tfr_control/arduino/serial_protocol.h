@@ -0,0 +1,92 @@
+#ifndef SERIAL_PROTOCOL_H
+#define SERIAL_PROTOCOL_H
+#include <stdint.h>
+
+/*
+  Binary framing shared by the arduino sketches and the host side decoder
+  (tfr_control/src/arduino_bridge.cpp). Keep this file free of arduino
+  specific includes, it is compiled for both.
+
+  Every frame is:
+    [0xAA] [0x55] [type] [payload length] [payload ...] [crc8]
+  The crc covers type, length and payload. Multi byte fields are little endian,
+  which is the native order of both the avr and the host, so payloads are
+  copied straight out of the packed structs below.
+*/
+namespace serial_protocol
+{
+  const uint8_t SYNC_0 = 0xAA;
+  const uint8_t SYNC_1 = 0x55;
+  const uint8_t HEADER_SIZE = 4;
+  const uint8_t MAX_PAYLOAD = 32;
+
+  enum FrameType : uint8_t
+  {
+    COUNTS = 0x01,      // arduino -> host, raw encoder counts
+    POSITIONS = 0x02,   // arduino -> host, potentiometer positions
+    PWM_COMMAND = 0x10  // host -> arduino b, motor outputs
+  };
+
+  /*
+    Raw quadrature counts latched at one micros() timestamp. Counts are left
+    to wrap, the host takes differences in 32 bit arithmetic so neither the
+    counts nor the 71 minute micros() rollover need special handling.
+  */
+  struct __attribute__((packed)) CountsPayload
+  {
+    uint32_t micros;
+    int32_t counts[2];
+  };
+
+  /*
+    Potentiometer positions in milliradians, in the order of the Potentiometers
+    enum in arduino_a.
+  */
+  struct __attribute__((packed)) PositionsPayload
+  {
+    uint32_t micros;
+    int16_t milliradians[5];
+  };
+
+  /*
+    Motor outputs scaled from [-1, 1] to [-100, 100], in the order of
+    tfr_msgs/PwmCommand.
+  */
+  struct __attribute__((packed)) PwmCommandPayload
+  {
+    uint8_t enabled;
+    int8_t outputs[8];
+  };
+
+  // crc-8, polynomial 0x07
+  inline uint8_t crc8(uint8_t crc, uint8_t byte)
+  {
+    crc ^= byte;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    return crc;
+  }
+
+  /*
+    Writes a complete frame into out, which must hold HEADER_SIZE + length + 1
+    bytes, and returns the number of bytes written.
+  */
+  inline uint8_t encode(uint8_t type, const void* payload, uint8_t length, uint8_t* out)
+  {
+    const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+    out[0] = SYNC_0;
+    out[1] = SYNC_1;
+    out[2] = type;
+    out[3] = length;
+    uint8_t crc = crc8(crc8(0, type), length);
+    for (uint8_t i = 0; i < length; i++)
+    {
+      out[HEADER_SIZE + i] = bytes[i];
+      crc = crc8(crc, bytes[i]);
+    }
+    out[HEADER_SIZE + length] = crc;
+    return HEADER_SIZE + length + 1;
+  }
+}
+
+#endif
@@ -0,0 +1,77 @@
+/****************************************************************************************
+ * File:            arduino_decoder.h
+ * 
+ * Purpose:         Host side of the framed serial protocol the arduinos speak, see
+ *                  tfr_control/arduino/serial_protocol.h for the frame layout.
+ * 
+ *                  ArduinoFrameDecoder pulls frames out of a raw byte stream, and
+ *                  CountVelocityEstimator turns timestamped raw encoder counts into
+ *                  a velocity.
+ ***************************************************************************************/
+#ifndef ARDUINO_DECODER_H
+#define ARDUINO_DECODER_H
+
+#include <serial_protocol.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace tfr_control
+{
+    class ArduinoFrameDecoder
+    {
+    public:
+        ArduinoFrameDecoder();
+
+        /*
+         * Feeds one byte, returns true once it completes a frame with a valid
+         * checksum, the frame stays available until the next call.
+         * */
+        bool push(uint8_t byte);
+
+        uint8_t getType() const { return buffer[2]; }
+        uint8_t getLength() const { return buffer[3]; }
+        const uint8_t* getPayload() const { return buffer + serial_protocol::HEADER_SIZE; }
+
+        uint32_t getFrameCount() const { return frames; }
+        uint32_t getErrorCount() const { return errors; }
+
+    private:
+        uint8_t buffer[serial_protocol::HEADER_SIZE + serial_protocol::MAX_PAYLOAD + 1];
+        size_t size;
+        uint32_t frames;
+        uint32_t errors;
+    };
+
+    class CountVelocityEstimator
+    {
+    public:
+        /*
+         * window: the span of samples velocity is measured over [s], longer is
+         * smoother, shorter is more responsive
+         * */
+        explicit CountVelocityEstimator(double window);
+
+        /*
+         * Adds a sample and returns the velocity over the window [counts/s].
+         * Counts and the timestamp may wrap.
+         * */
+        double update(int32_t count, uint32_t micros);
+
+        double getVelocity() const { return velocity; }
+        int32_t getCount() const { return samples.empty() ? 0 : samples.back().count; }
+
+    private:
+        struct Sample
+        {
+            int32_t count;
+            uint32_t micros;
+        };
+
+        const uint32_t window_us;
+        std::deque<Sample> samples;
+        double velocity;
+    };
+}
+
+#endif // ARDUINO_DECODER_H
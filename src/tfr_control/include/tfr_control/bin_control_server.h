@@ -1,24 +1,47 @@
 /****************************************************************************************
  * File:            bin_control_server.h
- * 
+ *
  * Purpose:         This class implements an action server that provides an interface
  *                  between primary systems and the hardware layer of the robot.
  *                  It allows systems to raise or lower the bin and communicates when
  *                  that task has been completed.
- * 
- *                  This class is not a node, and lives in the controller_launcher node.
- * 
- * Actions Implemented (Server):    Bin.action
- * Publishes To:                    /bin_position_controller/command
+ *
+ *                  The bin is lifted by two servo cylinders, left (device77) and
+ *                  right (device88). They are moved as a pair by a BinSynchronizer,
+ *                  streaming one shared profile to both at ~bin/rate and trimming
+ *                  whichever side gets ahead, so the bin doesn't rack (see
+ *                  bin_synchronizer.h). A move that skews past ~bin/fault_skew is
+ *                  stopped and aborted.
+ *
+ *                  This class is not a node, and lives in the control node.
+ *
+ * Actions Implemented (Server):    bin (Bin.action)
+ * Publishes To:                    /device77/set_joint_state, /device88/set_joint_state
+ *                                  (sensor_msgs/JointState)
+ *                                  /bin_skew left - right in drive radians (std_msgs/Float64)
+ * Subscribes To:                   /device77/get_joint_state, /device88/get_joint_state
+ *                                  (sensor_msgs/JointState)
+ * Parameters:                      /bin/raised, lowered: targets in drive radians, shared
+ *                                      with the dumping server (double, default 5.0, 1.0)
+ *                                  ~bin/max_velocity, max_acceleration: the shared profile
+ *                                      (double, default 0.5, 1.0)
+ *                                  ~bin/trim_gain, skew_deadband, max_trim, hold_skew,
+ *                                      fault_skew, position_tolerance: see bin_synchronizer.h
+ *                                      (double, default 4.0, 0.02, 0.3, 0.15, 0.4, 0.05)
+ *                                  ~bin/rate: hz the set-points are streamed at (double, default 50)
+ *                                  ~bin/timeout: added to the profile time before giving up
+ *                                      (double, default 5)
  ***************************************************************************************/
 #ifndef BIN_CONTROL_SERVER_H
 #define BIN_CONTROL_SERVER_H
 
 #include <ros/ros.h>
 #include <actionlib/server/simple_action_server.h>
+#include <sensor_msgs/JointState.h>
 #include <tfr_msgs/BinAction.h>
 #include <mutex>
-#include <condition_variable>
+#include <vector>
+#include "bin_synchronizer.h"
 
 using Server = actionlib::SimpleActionServer<tfr_msgs::BinAction>;
 
@@ -26,7 +49,7 @@ class BinControlServer
 {
 public:
     BinControlServer() = delete;
-    explicit BinControlServer(ros::NodeHandle& n, float target_bin_angle);
+    explicit BinControlServer(ros::NodeHandle& n);
     BinControlServer(const BinControlServer& other) = delete;
     BinControlServer(BinControlServer&&) = delete;
 
@@ -36,19 +59,31 @@ public:
     BinControlServer& operator=(BinControlServer&&) = delete;
 
     void ControlBin(const tfr_msgs::BinGoalConstPtr& goal);
-    void SignalBinController();
 
 private:
-    void wait_for_bin();
-    
+    enum Side
+    {
+        LEFT,
+        RIGHT,
+        SIDES,
+    };
+
+    void updatePosition(const sensor_msgs::JointState::ConstPtr& state, size_t side);
+    void command(double left, double right);
+    static tfr_control::BinSynchronizer::Limits loadLimits();
+
     ros::NodeHandle& node;
     Server server;
-    ros::Publisher bin_command_publisher;
-    const float TARGET_BIN_ANGLE;
-    std::mutex signal_mutex;
-    bool bin_task_completed;
-    std::condition_variable signal;
+    ros::Publisher left_publisher;
+    ros::Publisher right_publisher;
+    ros::Publisher skew_publisher;
+    std::vector<ros::Subscriber> position_subscribers;
+    tfr_control::BinSynchronizer synchronizer;
+    double raised, lowered, rate, timeout;
 
+    std::mutex position_mutex;
+    double positions[SIDES];
+    bool position_known[SIDES];
 };
 
 #endif // BIN_CONTROL_SERVER_H
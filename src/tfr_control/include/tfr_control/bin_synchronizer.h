@@ -0,0 +1,106 @@
+/****************************************************************************************
+ * File:            bin_synchronizer.h
+ *
+ * Purpose:         Drives the bin's two servo cylinders (device77 and device88)
+ *                  as one axis, so the bin can be moved at full speed without
+ *                  racking it.
+ *
+ *                  Both cylinders follow the same trapezoidal profile, from
+ *                  where they are on average to the target, sampled into a
+ *                  set-point every update. The skew between them (left - right)
+ *                  is checked on every update against the measured positions:
+ *
+ *                  - beyond skew_deadband the side that is ahead in the
+ *                    direction of motion has its set-point held back by
+ *                    trim_gain per radian of skew, at most max_trim, so the
+ *                    slower side catches up
+ *                  - beyond hold_skew the profile stops advancing until the
+ *                    skew is back under it, the set-points wait for the
+ *                    slower side
+ *                  - beyond fault_skew the move is given up and both sides
+ *                    are held where they are
+ *
+ *                  Positions are in drive radians, the same as
+ *                  /device<id>/set_joint_state.
+ ***************************************************************************************/
+#ifndef BIN_SYNCHRONIZER_H
+#define BIN_SYNCHRONIZER_H
+
+#include <profile_synchronizer.h>
+
+namespace tfr_control
+{
+    class BinSynchronizer
+    {
+    public:
+        struct Limits
+        {
+            //the shared profile [rad/s, rad/s^2]
+            double max_velocity;
+            double max_acceleration;
+            //skew correction [rad], trim_gain is unitless
+            double trim_gain;
+            double skew_deadband;
+            double max_trim;
+            double hold_skew;
+            double fault_skew;
+            //how close both sides have to be to the target to finish [rad]
+            double position_tolerance;
+        };
+
+        struct Command
+        {
+            double left;
+            double right;
+        };
+
+        enum Status
+        {
+            MOVING,
+            FINISHED,
+            FAULT,
+        };
+
+        explicit BinSynchronizer(const Limits& limits);
+        ~BinSynchronizer() = default;
+        BinSynchronizer(const BinSynchronizer&) = delete;
+        BinSynchronizer& operator=(const BinSynchronizer&) = delete;
+        BinSynchronizer(BinSynchronizer&&) = delete;
+        BinSynchronizer& operator=(BinSynchronizer&&) = delete;
+
+        /*
+         * Starts a move of both sides to target from the measured left and
+         * right positions, returns how long the profile takes [s]
+         * */
+        double start(double left, double right, double target);
+
+        /*
+         * Advances the profile by dt seconds given the measured positions, and
+         * fills the set-point for each side
+         * */
+        Status update(double left, double right, double dt, Command& command);
+
+        //the last measured left - right skew, and the largest since start [rad]
+        double getSkew() const;
+        double getMaxSkew() const;
+
+    private:
+        const Limits limits;
+        const ProfileSynchronizer profile;
+        double origin;
+        double target;
+        //+1 extending, -1 retracting
+        double direction;
+        double velocity;
+        double acceleration_time;
+        double total_time;
+        double time;
+        double skew;
+        double max_skew;
+
+        //the shared set-point time seconds into the move
+        double sample(double t) const;
+    };
+}
+
+#endif // BIN_SYNCHRONIZER_H
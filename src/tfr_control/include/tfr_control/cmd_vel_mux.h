@@ -0,0 +1,108 @@
+/****************************************************************************************
+ * File:            cmd_vel_mux.h
+ * 
+ * Purpose:         Arbitrates between every node that wants to drive the robot, and
+ *                  shapes the winning command before it reaches the drivebase.
+ * 
+ *                  Each source publishes to its own input topic and has a priority
+ *                  and a timeout. The highest priority source which has published
+ *                  within its timeout owns the drivebase, zero commands included,
+ *                  so a source which stops the robot holds it stopped until its
+ *                  timeout runs out. Sources have to keep publishing to keep
+ *                  control. When nobody owns the drivebase the target is zero, so a
+ *                  source which goes quiet always brings the robot to a stop.
+ *
+ *                  The output ramps toward the target with limited acceleration and
+ *                  jerk on linear x and angular z. linear y (the creep command used by
+ *                  the drivebase) passes through unshaped. A source with ramp false
+ *                  passes through unshaped on every axis, for the timed open loop
+ *                  moves whose distance depends on getting the full velocity for
+ *                  the whole duration. The ramp picks up from wherever it left off.
+ * 
+ * Parameters:      ~rate: how fast to publish hz (double, default: 32)
+ *                  ~acc_lim_x: linear acceleration limit m/s^2 (double, default: 0.3)
+ *                  ~acc_lim_theta: angular acceleration limit rad/s^2 (double, default: 0.4)
+ *                  ~jerk_lim_x: linear jerk limit m/s^3 (double, default: 1.0)
+ *                  ~jerk_lim_theta: angular jerk limit rad/s^3 (double, default: 2.0)
+ *                  ~sources: list of {name, priority, timeout, ramp}, each source
+ *                  listens on cmd_vel_mux/<name>, ramp defaults to true
+ * 
+ * Subscribed To:   /cmd_vel_mux/<name>
+ * Publishes To:    /cmd_vel
+ *                  /cmd_vel_mux/active (latched name of the owning source, "" for none)
+ ***************************************************************************************/
+#ifndef CMD_VEL_MUX_H
+#define CMD_VEL_MUX_H
+
+#include "ros/ros.h"
+#include "geometry_msgs/Twist.h"
+#include "std_msgs/String.h"
+#include <string>
+#include <vector>
+
+namespace tfr_control
+{
+    /*
+     * Ramps one axis toward a target with bounded acceleration and jerk, and
+     * never overshoots the target.
+     * */
+    class JerkLimitedRamp
+    {
+    public:
+        JerkLimitedRamp(double acceleration_limit, double jerk_limit);
+
+        double step(double target, double dt);
+        //jump straight to velocity, at rest
+        void reset(double velocity);
+
+        double getVelocity() const { return velocity; }
+
+    private:
+        double acceleration_limit;
+        double jerk_limit;
+        double velocity;
+        double acceleration;
+    };
+
+    class CmdVelMux
+    {
+    public:
+        CmdVelMux() = delete;
+        explicit CmdVelMux(ros::NodeHandle& n, double rate);
+        CmdVelMux(const CmdVelMux& other) = delete;
+        CmdVelMux(CmdVelMux&&) = delete;
+
+        ~CmdVelMux() = default;
+
+        CmdVelMux& operator=(const CmdVelMux&) = delete;
+        CmdVelMux& operator=(CmdVelMux&&) = delete;
+
+    private:
+        struct Source
+        {
+            std::string name;
+            int priority;
+            ros::Duration timeout;
+            bool ramp;
+            ros::Time last_command;
+            geometry_msgs::Twist command;
+            ros::Subscriber subscriber;
+        };
+
+        void commandCallback(const geometry_msgs::Twist::ConstPtr& msg, size_t source);
+        void update(const ros::TimerEvent& event);
+        int selectSource(const ros::Time& now) const;
+
+        std::vector<Source> sources;
+        int active;
+
+        JerkLimitedRamp linear;
+        JerkLimitedRamp angular;
+
+        ros::Publisher cmd_publisher;
+        ros::Publisher active_publisher;
+        ros::Timer timer;
+    };
+}
+
+#endif // CMD_VEL_MUX_H
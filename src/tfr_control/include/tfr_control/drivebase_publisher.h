@@ -9,9 +9,15 @@
  *                  one to each motor controller. This class will only publish after
  *                  reading a message on /cmd_vel.
  * 
+ *                  The setpoints are also republished on latched topics, so
+ *                  diagnostics can read the last commanded value without
+ *                  touching the parameter server.
+ * 
  * Subscribed To:   /cmd_vel
  * Publishes To:    /left_tread_velocity_controller/command
  *                  /right_tread_velocity_controller/command
+ *                  /left_tread_velocity_controller/setpoint (latched)
+ *                  /right_tread_velocity_controller/setpoint (latched)
  ***************************************************************************************/
 #ifndef DRIVEBASE_PUBLISHER_H
 #define DRIVEBASE_PUBLISHER_H
@@ -44,6 +50,8 @@ namespace tfr_control
 
         ros::Publisher left_tread_publisher;
         ros::Publisher right_tread_publisher;
+        ros::Publisher left_setpoint_publisher;
+        ros::Publisher right_setpoint_publisher;
         ros::Subscriber subscriber;
     };
 }
@@ -0,0 +1,164 @@
+/****************************************************************************************
+ * File:            flight_recorder.h
+ *
+ * Purpose:         Keeps the last few seconds of the control loop in memory, every
+ *                  input and output of every cycle, so there is something to look at
+ *                  after a fault besides the log.
+ *
+ *                  The control loop calls record() once a cycle, which copies one
+ *                  fixed size FlightFrame into a ring and never locks, allocates or
+ *                  waits. Each slot carries a sequence number, odd while it is being
+ *                  written and 2 * (frame index + 1) once it holds that frame, so a
+ *                  reader can copy the ring while the loop keeps going and drop any
+ *                  slot that changed under it.
+ *
+ *                  Dumps are written by a thread of their own. fault() only flags one,
+ *                  which that thread picks up within 0.1 s, and is safe from the
+ *                  control loop. requestDump() is for everything else. Faults closer
+ *                  together than min_fault_interval share a dump.
+ *
+ *                  A dump is a FlightRecorderHeader followed by frames FlightFrames,
+ *                  oldest first, all in host byte order. flight_recorder_to_csv.py
+ *                  reads them.
+ ***************************************************************************************/
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <tfr_utilities/joints.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tfr_control
+{
+    // turntable, lower arm, upper arm, scoop
+    constexpr size_t RECORDED_ARM_JOINTS = 4;
+
+    /*
+     * One control cycle. Floats keep it small, doubles are only used where
+     * the precision matters.
+     * */
+    struct FlightFrame
+    {
+        //ros time the cycle started at [s]
+        double time;
+        //since the previous cycle started, and how long each step took [s]
+        float period;
+        float read_time;
+        float update_time;
+        float write_time;
+        //per tfr_utilities::Joint, what the controllers saw and what they commanded
+        float position[tfr_utilities::Joint::JOINT_COUNT];
+        float velocity[tfr_utilities::Joint::JOINT_COUNT];
+        float command[tfr_utilities::Joint::JOINT_COUNT];
+        //arm encoders before calibration, and the drives' torques
+        float raw_encoder[RECORDED_ARM_JOINTS];
+        float torque[RECORDED_ARM_JOINTS];
+        //left, right: the counter, its observer's variance, the cmd_cango sent
+        //and the roboteq's loop error
+        int32_t tread_count[2];
+        float tread_variance[2];
+        int32_t tread_command[2];
+        int32_t tread_loop_error[2];
+        uint8_t enabled;
+        uint8_t padding[3];
+    };
+
+    struct FlightRecorderHeader
+    {
+        char magic[4];          // "TFRF"
+        uint32_t version;
+        uint32_t frame_size;    // sizeof(FlightFrame)
+        uint32_t frames;
+        double dump_time;       // wall time the dump was asked for [s]
+        char reason[32];        // nul terminated
+    };
+
+    class FlightRecorder
+    {
+    public:
+        static const uint32_t VERSION = 1;
+
+        /*
+         * capacity: frames kept, directory: where dumps go,
+         * min_fault_interval: seconds between dumps caused by faults
+         * */
+        FlightRecorder(size_t capacity, const std::string& directory, double min_fault_interval);
+        ~FlightRecorder();
+        FlightRecorder(const FlightRecorder&) = delete;
+        FlightRecorder& operator=(const FlightRecorder&) = delete;
+        FlightRecorder(FlightRecorder&&) = delete;
+        FlightRecorder& operator=(FlightRecorder&&) = delete;
+
+        /*
+         * Adds a frame, overwriting the oldest one. Only ever call this from
+         * one thread.
+         * */
+        void record(const FlightFrame& frame);
+
+        /*
+         * Flags a fault for the dump thread, safe to call from the control
+         * loop. reason must be a string literal.
+         * */
+        void fault(const char* reason);
+
+        /*
+         * Asks the dump thread for a dump, returns the file it will be written
+         * to. Takes a lock, so not from the control loop.
+         * */
+        std::string requestDump(const std::string& reason);
+
+        /*
+         * Copies the frames still in the ring, oldest first.
+         * */
+        void snapshot(std::vector<FlightFrame>& frames) const;
+
+        /*
+         * Writes frames to path as a dump.
+         * */
+        static bool write(const std::string& path, const std::string& reason, double dump_time,
+                const std::vector<FlightFrame>& frames, std::string& message);
+
+    private:
+        struct Slot
+        {
+            std::atomic<uint64_t> sequence;
+            FlightFrame frame;
+        };
+
+        struct Request
+        {
+            std::string path;
+            std::string reason;
+            double time;
+        };
+
+        const size_t capacity;
+        const std::string directory;
+        const double min_fault_interval;
+        std::unique_ptr<Slot[]> slots;
+        //frames recorded so far
+        std::atomic<uint64_t> written;
+        std::atomic<const char*> fault_reason;
+
+        //guard the requests below, the dump thread waits on signal
+        std::mutex request_mutex;
+        std::condition_variable signal;
+        bool stopping;
+        std::vector<Request> requests;
+        double last_fault_dump;
+
+        std::thread dumper;
+
+        void run();
+        void dump(const Request& request);
+        std::string pathFor(const std::string& reason, double dump_time) const;
+    };
+}
+
+#endif // FLIGHT_RECORDER_H
@@ -0,0 +1,79 @@
+/****************************************************************************************
+ * File:            joint_calibration.h
+ *
+ * Purpose:         Maps raw absolute encoder readings to joint positions.
+ *
+ *                  Every joint has a straight line mapping defined by two points, an
+ *                  encoder reading and the joint angle it corresponds to. The points are
+ *                  turned into a scale and offset when the table is loaded, so the control
+ *                  loop only does a multiply and an add per joint. Reversed joints just
+ *                  end up with a negative scale.
+ *
+ *                  The table is immutable once built. Reloading builds a new table off
+ *                  to the side and swaps the pointer, so the control loop always sees
+ *                  either the old table or the new one, never half of each.
+ *
+ * Parameters:      /absolute_position_encoder_limits/<joint_name>:
+ *                      encoder: [a, b] two raw encoder readings
+ *                      joint:   [a, b] the joint positions at those readings (radians)
+ *                      clamp:   optional, clamp the output to the joint range (bool)
+ *                  Joints missing from the parameter server keep the built in
+ *                  defaults.
+ ***************************************************************************************/
+#ifndef JOINT_CALIBRATION_H
+#define JOINT_CALIBRATION_H
+
+#include <ros/ros.h>
+#include <tfr_utilities/joints.h>
+#include <array>
+#include <memory>
+#include <string>
+
+namespace tfr_control
+{
+    class JointCalibration
+    {
+    public:
+        struct Entry
+        {
+            bool enabled;
+            double scale;
+            double offset;
+            bool clamp;
+            double joint_min;
+            double joint_max;
+        };
+
+        using Table = std::array<Entry, tfr_utilities::Joint::JOINT_COUNT>;
+
+        JointCalibration();
+        JointCalibration(const JointCalibration&) = delete;
+        JointCalibration& operator=(const JointCalibration&) = delete;
+        JointCalibration(JointCalibration&&) = delete;
+        JointCalibration& operator=(JointCalibration&&) = delete;
+
+        /*
+         * Builds a new table from the parameter server and swaps it in. If any
+         * configured joint is malformed nothing is swapped and the reason is
+         * written to message.
+         * */
+        bool load(std::string& message);
+
+        /*
+         * Converts every calibrated joint in one pass, joints without an entry
+         * are left alone in positions.
+         * */
+        void apply(const double raw[tfr_utilities::Joint::JOINT_COUNT],
+                double positions[tfr_utilities::Joint::JOINT_COUNT]) const;
+
+        static Entry fromPoints(double encoder_a, double joint_a,
+                double encoder_b, double joint_b);
+
+    private:
+        static Table defaults();
+
+        std::shared_ptr<const Table> table;
+    };
+}
+
+#endif
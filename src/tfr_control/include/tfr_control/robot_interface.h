@@ -29,6 +29,10 @@
 #include <tfr_msgs/PwmCommand.h>
 #include <tfr_utilities/control_code.h>
 #include <tfr_utilities/joints.h>
+#include "joint_calibration.h"
+#include "tread_velocity_observer.h"
+#include "flight_recorder.h"
+#include <tfr_msgs/TreadVelocity.h>
 #include <vector>
 #include <mutex>
 #include <limits>
@@ -38,6 +42,7 @@
 #include <iomanip>
 #include <iostream>
 #include <cstdio>
+#include <cmath>
 
 namespace tfr_control {
 
@@ -85,6 +90,18 @@ namespace tfr_control {
     
         void zeroTurntable();
 
+        /*
+         * Rebuilds the encoder calibration from the parameter server, the
+         * running table is kept if the new one is malformed
+         * */
+        bool reloadCalibration(std::string& message);
+
+        /*
+         * Fills in what the hardware layer last read and wrote, for the
+         * flight recorder. Call it after write().
+         * */
+        void recordState(FlightFrame& frame);
+
     private:
         //joint states for Joint state publisher package
         hardware_interface::JointStateInterface joint_state_interface;
@@ -92,6 +109,8 @@ namespace tfr_control {
         hardware_interface::PositionJointInterface joint_position_interface;
         //cmd states for velocity driven joints
         hardware_interface::EffortJointInterface joint_effort_interface;
+        //cmd states for the treads when the roboteq closes the speed loop
+        hardware_interface::VelocityJointInterface joint_velocity_interface;
         
         bool enabled;
 
@@ -155,17 +174,47 @@ namespace tfr_control {
         
         void setBrushlessLeftEncoder(const std_msgs::Int32 &msg);
         void setBrushlessRightEncoder(const std_msgs::Int32 &msg);
+
+        // the last counter values, guarded by the tread mutexes
+        int32_t left_tread_count = 0;
+        int32_t right_tread_count = 0;
         
-        int32_t left_tread_absolute_encoder_previous = 0;
-        int32_t left_tread_absolute_encoder_current = 0;
-        ros::Time left_tread_time_previous;
-        ros::Time left_tread_time_current;
-        
-        int32_t right_tread_absolute_encoder_previous = 0;
-        int32_t right_tread_absolute_encoder_current = 0;
-        ros::Time right_tread_time_previous;
-        ros::Time right_tread_time_current;
-        
+        // puts the bridge's counter samples back on its poll grid
+        SampleClock left_tread_clock;
+        SampleClock right_tread_clock;
+
+        // fed by the counter callbacks, guarded by the tread mutexes
+        TreadVelocityObserver left_tread_observer;
+        TreadVelocityObserver right_tread_observer;
+
+        // the cmd_cango values last sent, the observer's model input
+        int32_t left_tread_last_command = 0;
+        int32_t right_tread_last_command = 0;
+
+        ros::Publisher tread_velocity_publisher;
+
+        /*
+         * Closed loop speed mode, the roboteq runs the tread speed loop itself
+         * and cmd_cango becomes a speed setpoint, where +-1000 is its
+         * configured max rpm. The tread controllers then command m/s through
+         * the velocity interface and we add acceleration feedforward.
+         * */
+        bool tread_speed_mode = false;
+        // tread speed at a cmd_cango of 1000 [m/s]
+        double tread_max_speed = 0.5;
+        // extra cmd_cango per m/s^2 of commanded acceleration
+        double tread_acceleration_feedforward = 0.0;
+        std::pair<double, double> tread_setpoint_previous;
+        int32_t speedModeCommand(double setpoint, double previous, double dt);
+
+        // the roboteq's own closed loop error, guarded by the tread mutexes
+        ros::Subscriber left_tread_loop_error_subscriber;
+        ros::Subscriber right_tread_loop_error_subscriber;
+        int32_t left_tread_loop_error = 0;
+        int32_t right_tread_loop_error = 0;
+        void readLeftTreadLoopError(const std_msgs::Int32 &msg);
+        void readRightTreadLoopError(const std_msgs::Int32 &msg);
+
         const double pi = 3.14159265358979;
         
         std::mutex brushless_left_tread_mutex;
@@ -179,8 +228,8 @@ namespace tfr_control {
         void accumulateBrushlessLeftVel(const std_msgs::Int32 &msg);
         
         
-        double readBrushlessRightVel();
-        double readBrushlessLeftVel();
+        double readBrushlessRightVel(double& variance, int32_t& loop_error);
+        double readBrushlessLeftVel(double& variance, int32_t& loop_error);
         
         //const bool enable_left_tread_pid_debug_output = true;
         
@@ -192,39 +241,11 @@ namespace tfr_control {
         const int32_t brushless_encoder_count_per_revolution = 12800;
         double brushlessEncoderCountToRadians(int32_t encoder_count);
         double brushlessEncoderCountToRevolutions(int32_t encoder_count);
-        double encoderDeltaToLinearSpeed(int32_t encoder_delta, ros::Duration time_delta);
-        
-        int32_t bin_encoder_min = 0;
-        int32_t bin_encoder_max = 0;
-        double bin_joint_min = 0.0;
-        double bin_joint_max = 0.0;
-
-        int32_t turntable_encoder_min = -308224;
-        int32_t turntable_encoder_max = 308224;
-        double turntable_joint_min = -2 * 3.14159265358979;
-        double turntable_joint_max = 2 * 3.14159265358979;
-
-        
-        /* 
-            TODO: Update this entire section for ultramotion
-        */
-         double arm_lower_encoder_min = 5.2;
-         double arm_lower_encoder_max = 1.2;
-         double arm_lower_joint_min = 0.104; // lower arm UP
-         double arm_lower_joint_max = 1.55;
-        
-         double arm_upper_encoder_min = 5.2; // arm UP
-         double arm_upper_encoder_max = 1.2;
-         double arm_upper_joint_min = 0.98; // arm UP
-         double arm_upper_joint_max = 2.4; // arm DOWN, actuator EXTENDED
-        
-         double arm_end_encoder_min = 3.72;
-         double arm_end_encoder_max = 1.2;
-         double arm_end_joint_min = -1.16614; // scoop OPEN
-         double arm_end_joint_max = 1.62; // actuator EXTENDED, scoop CLOSED
         
-        const int32_t get_arm_lower_min_int();
-        const int32_t get_arm_lower_max_int();
+        // raw encoder readings to joint positions, reloadable at runtime
+        JointCalibration calibration;
+        // the last raw encoder readings, kept for the flight recorder
+        double raw_values[tfr_utilities::Joint::JOINT_COUNT]{};
 
         // Populated by controller layer for us to use
         double command_values[tfr_utilities::Joint::JOINT_COUNT]{};
@@ -247,6 +268,7 @@ namespace tfr_control {
         
         void registerJointEffortInterface(std::string name, tfr_utilities::Joint joint);
         void registerJointPositionInterface(std::string name, tfr_utilities::Joint joint);
+        void registerJointVelocityInterface(std::string name, tfr_utilities::Joint joint);
         //void registerBinJoint(std::string name, Joint joint);
 
         void adjustFakeJoint(const tfr_utilities::Joint &joint);
@@ -0,0 +1,109 @@
+/****************************************************************************************
+ * File:            tread_velocity_observer.h
+ *
+ * Purpose:         Estimates tread velocity from the Roboteq's absolute counter.
+ *
+ *                  The bridge polls the counter on a fixed cadence, but the samples
+ *                  reach us bunched up and spread out by the bus and the topic
+ *                  pipeline. Dividing each count delta by the receive time delta makes
+ *                  the speed explode whenever two samples land together.
+ *
+ *                  SampleClock puts the receive times back on the poll grid. It is a
+ *                  first order phase locked loop, each sample is expected one period
+ *                  after the last and only a fraction of the arrival jitter is let
+ *                  through.
+ *
+ *                  TreadVelocityObserver is a two state (position, velocity) kalman
+ *                  filter. The motor is modelled as a first order lag toward a speed
+ *                  proportional to the commanded cmd_cango, and corrected with the
+ *                  counter position. Nothing is ever divided by a sample interval, so
+ *                  bunched samples only make the estimate a little less certain.
+ ***************************************************************************************/
+#ifndef TREAD_VELOCITY_OBSERVER_H
+#define TREAD_VELOCITY_OBSERVER_H
+
+#include <cstdint>
+
+namespace tfr_control
+{
+    class SampleClock
+    {
+    public:
+        /*
+         * period: the nominal time between samples [s]
+         * gain: how much of the arrival jitter to follow, 0 to 1
+         * */
+        SampleClock(double period, double gain);
+
+        /*
+         * Takes the time a sample arrived and returns the time it was most
+         * likely taken [s]
+         * */
+        double stamp(double arrival);
+
+    private:
+        const double period;
+        const double gain;
+        bool locked;
+        double last;
+    };
+
+    class TreadVelocityObserver
+    {
+    public:
+        struct Parameters
+        {
+            //tread travel per counter tick [m]
+            double meters_per_count;
+            //steady state speed per unit of cmd_cango [m/s]
+            double velocity_per_command;
+            //how quickly the tread reaches the commanded speed [s]
+            double time_constant;
+            //spectral density of unmodelled acceleration [(m/s^2)^2 s]
+            double acceleration_noise;
+            //variance of a single position reading [m^2]
+            double measurement_noise;
+        };
+
+        explicit TreadVelocityObserver(const Parameters& parameters);
+
+        /*
+         * Runs the model forward to time [s] with the command that has been
+         * applied since the last call. Going backwards in time is ignored, so
+         * only advance the filter to sample times.
+         * */
+        void predict(double time, double command);
+
+        /*
+         * Corrects the estimate with a counter reading taken at time [s], the
+         * counter may wrap.
+         * */
+        void correct(int32_t count, double time, double command);
+
+        /*
+         * The velocity the model expects at time [s] under command, without
+         * moving the filter forward. Lets the control loop read a current
+         * estimate between counter samples.
+         * */
+        double velocityAt(double time, double command) const;
+
+        bool isInitialized() const { return initialized; }
+        //[m/s]
+        double getVelocity() const { return velocity; }
+        //[(m/s)^2]
+        double getVariance() const { return covariance[1][1]; }
+
+    private:
+        const Parameters parameters;
+        bool initialized;
+        double time;
+        int32_t last_count;
+        //counter position relative to the first sample [m]
+        double measured;
+        double position;
+        double velocity;
+        double covariance[2][2];
+    };
+}
+
+#endif // TREAD_VELOCITY_OBSERVER_H
@@ -0,0 +1,285 @@
+/****************************************************************************************
+ * File:            arduino_bridge.cpp
+ * 
+ * Purpose:         Talks to one of the arduinos over the framed serial protocol
+ *                  (tfr_control/arduino/serial_protocol.h) in place of rosserial.
+ *
+ *                  The arduinos only stream raw encoder counts with micros() stamps,
+ *                  velocity and position are derived here where there is floating
+ *                  point hardware and a proper clock. Readings are published on the
+ *                  same topics and messages rosserial used, so nothing downstream
+ *                  has to change. For arduino b /motor_output is forwarded to the
+ *                  board as well.
+ *
+ *                  If no counts arrive for ~stale_timeout the tread velocity is
+ *                  published as zero rather than the last one measured, so a
+ *                  stalled board reads as stopped. Read errors back off from
+ *                  10ms up to a second instead of spinning on the port.
+ *
+ *                  Both treads are scaled by ~meters_per_count. The old sketch for
+ *                  arduino b divided the right tread's rev/s by the meters per
+ *                  revolution (2*pi*0.15) where arduino a multiplied the left, so
+ *                  /arduino_b tread_right_vel is now m/s like the left, where it
+ *                  used to read 1/(2*pi*0.15)^2, about 1.13, times too fast.
+ *
+ * Parameters:      ~board: which sketch is on the other end, "a" or "b" (string, default: a)
+ *                  ~port: serial device (string, default: /dev/ttyACM0)
+ *                  ~rate: how fast to publish readings hz (double, default: 50)
+ *                  ~velocity_window: span velocity is measured over s (double, default: 0.02)
+ *                  ~meters_per_count: tread travel per gearbox count (double, default: 2*pi*0.15/4096)
+ *                  ~turntable_radians_per_count: (double, default: (1/188)*(15/72)*2*pi/28)
+ *                  ~stale_timeout: counts older than this read as stopped s (double, default: 0.1)
+ *
+ * Subscribed To:   /motor_output (board b only)
+ * Publishes To:    /arduino_a (tfr_msgs/ArduinoAReading) or /arduino_b (tfr_msgs/ArduinoBReading)
+ ***************************************************************************************/
+#include <ros/ros.h>
+#include <tfr_msgs/ArduinoAReading.h>
+#include <tfr_msgs/ArduinoBReading.h>
+#include <tfr_msgs/PwmCommand.h>
+#include "arduino_decoder.h"
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+namespace tfr_control
+{
+    class ArduinoBridge
+    {
+    public:
+        ArduinoBridge(ros::NodeHandle& n, const std::string& board, int fd,
+                double rate, double window) :
+            board_a{board == "a"},
+            fd{fd},
+            left{window},
+            right{window},
+            turntable_count{0},
+            positions{},
+            counts_seen{false},
+            last_counts{},
+            running{true}
+        {
+            ros::param::param<double>("~meters_per_count", meters_per_count, 2 * M_PI * 0.15 / 4096);
+            ros::param::param<double>("~turntable_radians_per_count", turntable_radians_per_count,
+                    (1 / 188.0) * (15.0 / 72.0) * 2.0 * M_PI / 28);
+            ros::param::param<double>("~stale_timeout", stale_timeout, 0.1);
+
+            if (board_a)
+                reading_publisher = n.advertise<tfr_msgs::ArduinoAReading>("/arduino_a", 5);
+            else
+            {
+                reading_publisher = n.advertise<tfr_msgs::ArduinoBReading>("/arduino_b", 5);
+                command_subscriber = n.subscribe("/motor_output", 1, &ArduinoBridge::sendCommand, this);
+            }
+            timer = n.createTimer(ros::Duration(1 / rate), &ArduinoBridge::publishReading, this);
+            reader = std::thread(&ArduinoBridge::readLoop, this);
+        }
+
+        ~ArduinoBridge()
+        {
+            running = false;
+            reader.join();
+        }
+        ArduinoBridge(const ArduinoBridge&) = delete;
+        ArduinoBridge& operator=(const ArduinoBridge&) = delete;
+        ArduinoBridge(ArduinoBridge&&) = delete;
+        ArduinoBridge& operator=(ArduinoBridge&&) = delete;
+
+    private:
+        const bool board_a;
+        const int fd;
+        double meters_per_count;
+        double turntable_radians_per_count;
+        double stale_timeout;
+
+        std::mutex state_mutex;
+        ArduinoFrameDecoder decoder;
+        CountVelocityEstimator left;
+        CountVelocityEstimator right;
+        int32_t turntable_count;
+        serial_protocol::PositionsPayload positions;
+        //when the last counts arrived, by the host's clock
+        bool counts_seen;
+        std::chrono::steady_clock::time_point last_counts;
+
+        ros::Publisher reading_publisher;
+        ros::Subscriber command_subscriber;
+        ros::Timer timer;
+        std::atomic<bool> running;
+        std::thread reader;
+
+        void readLoop()
+        {
+            uint8_t bytes[64];
+            const std::chrono::milliseconds min_backoff{10}, max_backoff{1000};
+            std::chrono::milliseconds backoff = min_backoff;
+            while (running && ros::ok())
+            {
+                ssize_t count = read(fd, bytes, sizeof(bytes));
+                if (count < 0 && errno != EINTR && errno != EAGAIN)
+                {
+                    //an unplugged board fails every read straight away
+                    ROS_WARN_THROTTLE(5, "Arduino Bridge: serial read failed: %s", std::strerror(errno));
+                    std::this_thread::sleep_for(backoff);
+                    backoff = std::min(backoff * 2, max_backoff);
+                    continue;
+                }
+                if (count <= 0)
+                    continue;
+                backoff = min_backoff;
+                std::lock_guard<std::mutex> lock(state_mutex);
+                for (ssize_t i = 0; i < count; i++)
+                    if (decoder.push(bytes[i]))
+                        handleFrame();
+            }
+        }
+
+        //called with state_mutex held
+        void handleFrame()
+        {
+            if (decoder.getType() == serial_protocol::COUNTS &&
+                    decoder.getLength() == sizeof(serial_protocol::CountsPayload))
+            {
+                serial_protocol::CountsPayload counts;
+                std::memcpy(&counts, decoder.getPayload(), sizeof(counts));
+                counts_seen = true;
+                last_counts = std::chrono::steady_clock::now();
+                if (board_a)
+                {
+                    left.update(counts.counts[0], counts.micros);
+                    turntable_count = counts.counts[1];
+                }
+                else
+                    right.update(counts.counts[0], counts.micros);
+            }
+            else if (decoder.getType() == serial_protocol::POSITIONS &&
+                    decoder.getLength() == sizeof(serial_protocol::PositionsPayload))
+                std::memcpy(&positions, decoder.getPayload(), sizeof(positions));
+        }
+
+        void publishReading(const ros::TimerEvent&)
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            const bool stale = !counts_seen || std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - last_counts).count() > stale_timeout;
+            if (stale && counts_seen)
+                ROS_WARN_THROTTLE(5, "Arduino Bridge: no counts from arduino %s, reading as stopped",
+                        board_a ? "a" : "b");
+            if (board_a)
+            {
+                tfr_msgs::ArduinoAReading reading;
+                reading.tread_left_vel = stale ? 0 : left.getVelocity() * meters_per_count;
+                reading.arm_turntable_pos = turntable_count * turntable_radians_per_count;
+                //same order as the Potentiometers enum in arduino_a
+                reading.arm_lower_pos = positions.milliradians[0] * 1e-3;
+                reading.arm_upper_pos = positions.milliradians[1] * 1e-3;
+                reading.arm_scoop_pos = positions.milliradians[2] * 1e-3;
+                reading.bin_left_pos = positions.milliradians[3] * 1e-3;
+                reading.bin_right_pos = positions.milliradians[4] * 1e-3;
+                reading_publisher.publish(reading);
+            }
+            else
+            {
+                tfr_msgs::ArduinoBReading reading;
+                reading.tread_right_vel = stale ? 0 : right.getVelocity() * meters_per_count;
+                reading_publisher.publish(reading);
+            }
+            ROS_DEBUG("Arduino Bridge: %u frames, %u errors",
+                    decoder.getFrameCount(), decoder.getErrorCount());
+        }
+
+        static int8_t toPercent(float value)
+        {
+            return static_cast<int8_t>(std::round(std::max(-1.0f, std::min(1.0f, value)) * 100));
+        }
+
+        void sendCommand(const tfr_msgs::PwmCommand& command)
+        {
+            serial_protocol::PwmCommandPayload payload;
+            payload.enabled = command.enabled;
+            payload.outputs[0] = toPercent(command.tread_left);
+            payload.outputs[1] = toPercent(command.tread_right);
+            payload.outputs[2] = toPercent(command.arm_turntable);
+            payload.outputs[3] = toPercent(command.arm_lower);
+            payload.outputs[4] = toPercent(command.arm_upper);
+            payload.outputs[5] = toPercent(command.arm_scoop);
+            payload.outputs[6] = toPercent(command.bin_left);
+            payload.outputs[7] = toPercent(command.bin_right);
+
+            uint8_t frame[serial_protocol::HEADER_SIZE + sizeof(payload) + 1];
+            size_t size = serial_protocol::encode(serial_protocol::PWM_COMMAND,
+                    &payload, sizeof(payload), frame);
+            if (write(fd, frame, size) != static_cast<ssize_t>(size))
+                ROS_WARN("Arduino Bridge: failed to write motor command");
+        }
+    };
+}
+
+/*
+ * Opens the port raw at 115200 baud, with reads that give up after 100ms so
+ * the reader thread can notice shutdown.
+ * */
+int openSerial(const std::string& port)
+{
+    int fd = open(port.c_str(), O_RDWR | O_NOCTTY);
+    if (fd < 0)
+        return fd;
+    termios tty{};
+    if (tcgetattr(fd, &tty) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B115200);
+    cfsetospeed(&tty, B115200);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 1;
+    if (tcsetattr(fd, TCSANOW, &tty) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "arduino_bridge");
+    ros::NodeHandle n;
+
+    std::string board, port;
+    double rate, window;
+    ros::param::param<std::string>("~board", board, "a");
+    ros::param::param<std::string>("~port", port, "/dev/ttyACM0");
+    ros::param::param<double>("~rate", rate, 50);
+    ros::param::param<double>("~velocity_window", window, 0.02);
+    if (board != "a" && board != "b")
+    {
+        ROS_ERROR("Parameter 'board' must be \"a\" or \"b\".");
+        return 1;
+    }
+
+    int fd = openSerial(port);
+    if (fd < 0)
+    {
+        ROS_ERROR("Arduino Bridge: failed to open serial device %s.", port.c_str());
+        return 1;
+    }
+    ROS_INFO("Arduino Bridge: opened %s for arduino %s", port.c_str(), board.c_str());
+
+    {
+        tfr_control::ArduinoBridge bridge(n, board, fd, rate, window);
+        ros::spin();
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,70 @@
+/****************************************************************************************
+ * File:            arduino_decoder.cpp
+ * 
+ * Purpose:         This is the implementation file for the arduino protocol decoders.
+ *                  See tfr_control/include/tfr_control/arduino_decoder.h for details.
+ ***************************************************************************************/
+#include "arduino_decoder.h"
+
+namespace tfr_control
+{
+    ArduinoFrameDecoder::ArduinoFrameDecoder() :
+        buffer{}, size{0}, frames{0}, errors{0}
+    {}
+
+    bool ArduinoFrameDecoder::push(uint8_t byte)
+    {
+        if ((size == 0 && byte != serial_protocol::SYNC_0) ||
+            (size == 1 && byte != serial_protocol::SYNC_1) ||
+            (size == 3 && byte > serial_protocol::MAX_PAYLOAD))
+        {
+            //out of sync, start over, this byte may begin the next frame
+            if (size > 0)
+                errors++;
+            size = (byte == serial_protocol::SYNC_0) ? 1 : 0;
+            buffer[0] = byte;
+            return false;
+        }
+
+        buffer[size++] = byte;
+        if (size < serial_protocol::HEADER_SIZE ||
+                size < serial_protocol::HEADER_SIZE + buffer[3] + 1u)
+            return false;
+
+        size = 0;
+        uint8_t length = buffer[3];
+        uint8_t crc = serial_protocol::crc8(serial_protocol::crc8(0, buffer[2]), length);
+        for (uint8_t i = 0; i < length; i++)
+            crc = serial_protocol::crc8(crc, buffer[serial_protocol::HEADER_SIZE + i]);
+        if (crc != buffer[serial_protocol::HEADER_SIZE + length])
+        {
+            errors++;
+            return false;
+        }
+        frames++;
+        return true;
+    }
+
+    CountVelocityEstimator::CountVelocityEstimator(double window) :
+        window_us{static_cast<uint32_t>(window * 1e6)}, samples{}, velocity{0}
+    {}
+
+    double CountVelocityEstimator::update(int32_t count, uint32_t micros)
+    {
+        samples.push_back({count, micros});
+        //keep the newest sample at least a window older than the current one
+        while (samples.size() > 2 &&
+                static_cast<uint32_t>(micros - samples[1].micros) >= window_us)
+            samples.pop_front();
+
+        const Sample& oldest = samples.front();
+        //unsigned differences take care of rollover
+        uint32_t elapsed = micros - oldest.micros;
+        if (elapsed == 0)
+            return velocity;
+        int32_t moved = static_cast<int32_t>(static_cast<uint32_t>(count) -
+                static_cast<uint32_t>(oldest.count));
+        velocity = moved / (elapsed * 1e-6);
+        return velocity;
+    }
+}
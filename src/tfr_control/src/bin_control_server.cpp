@@ -0,0 +1,167 @@
+#include "bin_control_server.h"
+#include <boost/bind.hpp>
+#include <std_msgs/Float64.h>
+#include <string>
+
+BinControlServer::BinControlServer(ros::NodeHandle& n) :
+    node{n},
+    server{n, "bin", boost::bind(&BinControlServer::ControlBin, this, _1), false},
+    left_publisher{n.advertise<sensor_msgs::JointState>("/device77/set_joint_state", 5)},
+    right_publisher{n.advertise<sensor_msgs::JointState>("/device88/set_joint_state", 5)},
+    skew_publisher{n.advertise<std_msgs::Float64>("/bin_skew", 5)},
+    synchronizer{loadLimits()},
+    positions{0, 0},
+    position_known{false, false}
+{
+    ros::param::param<double>("/bin/raised", raised, 5.0);
+    ros::param::param<double>("/bin/lowered", lowered, 1.0);
+    ros::param::param<double>("~bin/rate", rate, 50.0);
+    ros::param::param<double>("~bin/timeout", timeout, 5.0);
+
+    const char* const devices[] = {"/device77", "/device88"};
+    for (size_t side = 0; side < SIDES; side++)
+    {
+        position_subscribers.push_back(n.subscribe<sensor_msgs::JointState>(
+            std::string{devices[side]} + "/get_joint_state", 5,
+            boost::bind(&BinControlServer::updatePosition, this, _1, side)));
+    }
+
+    server.start();
+    ROS_INFO("Bin Control Server: Started");
+}
+
+tfr_control::BinSynchronizer::Limits BinControlServer::loadLimits()
+{
+    tfr_control::BinSynchronizer::Limits limits;
+    ros::param::param<double>("~bin/max_velocity", limits.max_velocity, 0.5);
+    ros::param::param<double>("~bin/max_acceleration", limits.max_acceleration, 1.0);
+    ros::param::param<double>("~bin/trim_gain", limits.trim_gain, 4.0);
+    ros::param::param<double>("~bin/skew_deadband", limits.skew_deadband, 0.02);
+    ros::param::param<double>("~bin/max_trim", limits.max_trim, 0.3);
+    ros::param::param<double>("~bin/hold_skew", limits.hold_skew, 0.15);
+    ros::param::param<double>("~bin/fault_skew", limits.fault_skew, 0.4);
+    ros::param::param<double>("~bin/position_tolerance", limits.position_tolerance, 0.05);
+    return limits;
+}
+
+void BinControlServer::updatePosition(const sensor_msgs::JointState::ConstPtr& state, size_t side)
+{
+    if (state->position.empty())
+        return;
+    std::lock_guard<std::mutex> lock{position_mutex};
+    positions[side] = state->position[0];
+    position_known[side] = true;
+}
+
+void BinControlServer::command(double left, double right)
+{
+    sensor_msgs::JointState left_state, right_state;
+    left_state.header.stamp = right_state.header.stamp = ros::Time::now();
+    left_state.position.push_back(left);
+    right_state.position.push_back(right);
+    left_publisher.publish(left_state);
+    right_publisher.publish(right_state);
+}
+
+/*
+ * Moves both bin actuators to the raised or lowered position together.
+ *
+ * Succeeds once both sides are at the target, aborts if either side's
+ * position is unknown, the sides skew past ~bin/fault_skew or the move takes
+ * ~bin/timeout longer than its profile. Preempting or aborting holds both
+ * sides where they are.
+ * */
+void BinControlServer::ControlBin(const tfr_msgs::BinGoalConstPtr& goal)
+{
+    tfr_msgs::BinResult result;
+    result.return_code = tfr_msgs::BinResult::ERROR_ENCOUNTERED;
+
+    double target;
+    uint8_t done_code;
+    if (goal->command_code == tfr_msgs::BinGoal::RAISE_BIN)
+    {
+        target = raised;
+        done_code = tfr_msgs::BinResult::BIN_RAISED;
+    }
+    else if (goal->command_code == tfr_msgs::BinGoal::LOWER_BIN)
+    {
+        target = lowered;
+        done_code = tfr_msgs::BinResult::BIN_LOWERED;
+    }
+    else
+    {
+        ROS_WARN("Bin Control Server: unknown command %d", goal->command_code);
+        server.setAborted(result);
+        return;
+    }
+
+    double left, right;
+    {
+        std::lock_guard<std::mutex> lock{position_mutex};
+        if (!position_known[LEFT] || !position_known[RIGHT])
+        {
+            ROS_WARN("Bin Control Server: bin actuator positions unknown, not moving");
+            server.setAborted(result);
+            return;
+        }
+        left = positions[LEFT];
+        right = positions[RIGHT];
+    }
+
+    const double duration = synchronizer.start(left, right, target);
+    ROS_INFO("Bin Control Server: moving the bin to %f, %.2f seconds", target, duration);
+
+    ros::Rate loop_rate(rate);
+    const ros::Time start = ros::Time::now();
+    ros::Time last = start;
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock{position_mutex};
+            left = positions[LEFT];
+            right = positions[RIGHT];
+        }
+
+        if (server.isPreemptRequested() || !ros::ok())
+        {
+            command(left, right);
+            ROS_INFO("Bin Control Server: preempted");
+            server.setPreempted(result);
+            return;
+        }
+
+        const ros::Time now = ros::Time::now();
+        tfr_control::BinSynchronizer::Command set_point;
+        const tfr_control::BinSynchronizer::Status status =
+            synchronizer.update(left, right, (now - last).toSec(), set_point);
+        last = now;
+        command(set_point.left, set_point.right);
+
+        std_msgs::Float64 skew;
+        skew.data = synchronizer.getSkew();
+        skew_publisher.publish(skew);
+
+        if (status == tfr_control::BinSynchronizer::FINISHED)
+        {
+            ROS_INFO("Bin Control Server: bin at %f after %.2f seconds, largest skew %f", target,
+                    (now - start).toSec(), synchronizer.getMaxSkew());
+            result.return_code = done_code;
+            server.setSucceeded(result);
+            return;
+        }
+        if (status == tfr_control::BinSynchronizer::FAULT)
+        {
+            ROS_ERROR("Bin Control Server: bin skewed %f, stopping it", synchronizer.getSkew());
+            server.setAborted(result);
+            return;
+        }
+        if ((now - start).toSec() > duration + timeout)
+        {
+            command(left, right);
+            ROS_WARN("Bin Control Server: bin didn't reach %f, stopped at %f, %f", target, left, right);
+            server.setAborted(result);
+            return;
+        }
+        loop_rate.sleep();
+    }
+}
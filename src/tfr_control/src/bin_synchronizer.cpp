@@ -0,0 +1,95 @@
+#include "bin_synchronizer.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace tfr_control
+{
+    BinSynchronizer::BinSynchronizer(const Limits& limits) :
+        limits(limits),
+        profile{std::vector<ProfileSynchronizer::Limits>{{limits.max_velocity, limits.max_acceleration}}},
+        origin{0}, target{0}, direction{1}, velocity{0}, acceleration_time{0}, total_time{0},
+        time{0}, skew{0}, max_skew{0}
+    {}
+
+    double BinSynchronizer::start(double left, double right, double to)
+    {
+        //the sides start from their average, whichever is ahead gets trimmed
+        origin = (left + right) / 2;
+        target = to;
+        direction = target >= origin ? 1 : -1;
+
+        std::vector<ProfileSynchronizer::Profile> profiles;
+        total_time = profile.synchronize({origin}, {target}, profiles);
+        velocity = profiles[0].velocity;
+        acceleration_time = velocity / profiles[0].acceleration;
+
+        time = 0;
+        skew = left - right;
+        max_skew = std::abs(skew);
+        return total_time;
+    }
+
+    BinSynchronizer::Status BinSynchronizer::update(double left, double right, double dt, Command& command)
+    {
+        skew = left - right;
+        const double magnitude = std::abs(skew);
+        max_skew = std::max(max_skew, magnitude);
+
+        if (magnitude > limits.fault_skew)
+        {
+            command.left = left;
+            command.right = right;
+            return FAULT;
+        }
+
+        //the set-points wait while the slower side is too far behind
+        if (magnitude <= limits.hold_skew)
+            time = std::min(time + dt, total_time);
+
+        const double set_point = sample(time);
+        const double trim = std::min(std::max(limits.trim_gain * (magnitude - limits.skew_deadband), 0.0),
+                limits.max_trim);
+        command.left = set_point;
+        command.right = set_point;
+        if (direction * skew > 0)
+            command.left -= direction * trim;
+        else
+            command.right -= direction * trim;
+
+        if (time >= total_time &&
+                std::abs(left - target) <= limits.position_tolerance &&
+                std::abs(right - target) <= limits.position_tolerance)
+            return FINISHED;
+        return MOVING;
+    }
+
+    double BinSynchronizer::getSkew() const
+    {
+        return skew;
+    }
+
+    double BinSynchronizer::getMaxSkew() const
+    {
+        return max_skew;
+    }
+
+    double BinSynchronizer::sample(double t) const
+    {
+        if (t >= total_time)
+            return target;
+
+        const double acceleration = velocity / acceleration_time;
+        double distance;
+        if (t < acceleration_time)
+            distance = acceleration * t * t / 2;
+        else if (t < total_time - acceleration_time)
+            distance = velocity * acceleration_time / 2 + velocity * (t - acceleration_time);
+        else
+        {
+            const double remaining = total_time - t;
+            distance = std::abs(target - origin) - acceleration * remaining * remaining / 2;
+        }
+        return origin + direction * distance;
+    }
+}
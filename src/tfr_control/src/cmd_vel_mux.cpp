@@ -0,0 +1,171 @@
+/****************************************************************************************
+ * File:            cmd_vel_mux.cpp
+ * 
+ * Purpose:         This is the implementation file for the CmdVelMux class.
+ *                  See tfr_control/include/tfr_control/cmd_vel_mux.h for details.
+ ***************************************************************************************/
+#include "cmd_vel_mux.h"
+#include <algorithm>
+#include <cmath>
+
+namespace tfr_control
+{
+    JerkLimitedRamp::JerkLimitedRamp(double acceleration_limit, double jerk_limit) :
+        acceleration_limit{acceleration_limit}, jerk_limit{jerk_limit},
+        velocity{0}, acceleration{0}
+    {}
+
+    double JerkLimitedRamp::step(double target, double dt)
+    {
+        double error = target - velocity;
+        //the largest acceleration we can still wind back down to zero, with
+        //the jerk limit, before reaching the target
+        double desired = std::copysign(
+                std::min(acceleration_limit, std::sqrt(2 * jerk_limit * std::abs(error))),
+                error);
+        double max_change = jerk_limit * dt;
+        acceleration += std::max(-max_change, std::min(max_change, desired - acceleration));
+
+        double next = velocity + acceleration * dt;
+        if ((target - next) * error <= 0)
+        {
+            //reached or passed the target this step
+            velocity = target;
+            acceleration = 0;
+        }
+        else
+            velocity = next;
+        return velocity;
+    }
+
+    void JerkLimitedRamp::reset(double velocity)
+    {
+        this->velocity = velocity;
+        acceleration = 0;
+    }
+
+    CmdVelMux::CmdVelMux(ros::NodeHandle& n, double rate) :
+        sources{}, active{-1},
+        linear{0.3, 1.0}, angular{0.4, 2.0}
+    {
+        double acc_lim_x, acc_lim_theta, jerk_lim_x, jerk_lim_theta;
+        ros::param::param<double>("~acc_lim_x", acc_lim_x, 0.3);
+        ros::param::param<double>("~acc_lim_theta", acc_lim_theta, 0.4);
+        ros::param::param<double>("~jerk_lim_x", jerk_lim_x, 1.0);
+        ros::param::param<double>("~jerk_lim_theta", jerk_lim_theta, 2.0);
+        linear = JerkLimitedRamp{acc_lim_x, jerk_lim_x};
+        angular = JerkLimitedRamp{acc_lim_theta, jerk_lim_theta};
+
+        XmlRpc::XmlRpcValue source_list;
+        if (!ros::param::get("~sources", source_list) ||
+                source_list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+        {
+            ROS_WARN("Cmd Vel Mux: no sources configured, only zeros will be sent");
+        }
+        else
+        {
+            //the subscriber callbacks keep an index, so size the vector up front
+            sources.resize(source_list.size());
+            for (int i = 0; i < source_list.size(); i++)
+            {
+                Source& source = sources[i];
+                source.name = static_cast<std::string>(source_list[i]["name"]);
+                source.priority = static_cast<int>(source_list[i]["priority"]);
+                source.timeout = ros::Duration(static_cast<double>(source_list[i]["timeout"]));
+                source.ramp = !source_list[i].hasMember("ramp") || static_cast<bool>(source_list[i]["ramp"]);
+                source.subscriber = n.subscribe<geometry_msgs::Twist>("cmd_vel_mux/" + source.name, 1,
+                        boost::bind(&CmdVelMux::commandCallback, this, _1, i));
+                ROS_INFO("Cmd Vel Mux: source %s priority %d timeout %f%s",
+                        source.name.c_str(), source.priority, source.timeout.toSec(),
+                        source.ramp ? "" : " unramped");
+            }
+        }
+
+        cmd_publisher = n.advertise<geometry_msgs::Twist>("cmd_vel", 5);
+        active_publisher = n.advertise<std_msgs::String>("cmd_vel_mux/active", 1, true);
+        std_msgs::String none;
+        active_publisher.publish(none);
+        timer = n.createTimer(ros::Duration(1 / rate), &CmdVelMux::update, this);
+    }
+
+    void CmdVelMux::commandCallback(const geometry_msgs::Twist::ConstPtr& msg, size_t source)
+    {
+        //a zero command keeps ownership too, a stop must not hand the drivebase
+        //to whoever is next in line
+        sources[source].last_command = ros::Time::now();
+        sources[source].command = *msg;
+    }
+
+    int CmdVelMux::selectSource(const ros::Time& now) const
+    {
+        int best = -1;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            const Source& source = sources[i];
+            if (source.last_command.isZero() || now - source.last_command > source.timeout)
+                continue;
+            if (best == -1 || source.priority > sources[best].priority)
+                best = i;
+        }
+        return best;
+    }
+
+    void CmdVelMux::update(const ros::TimerEvent& event)
+    {
+        ros::Time now = ros::Time::now();
+        int selected = selectSource(now);
+        if (selected != active)
+        {
+            active = selected;
+            std_msgs::String name;
+            if (active != -1)
+                name.data = sources[active].name;
+            ROS_INFO("Cmd Vel Mux: active source \"%s\"", name.data.c_str());
+            active_publisher.publish(name);
+        }
+
+        //with no active source the target is zero, which stops the robot
+        geometry_msgs::Twist target;
+        if (active != -1)
+            target = sources[active].command;
+
+        double dt = (event.current_real - event.last_real).toSec();
+        if (event.last_real.isZero() || dt <= 0 || dt > 1.0)
+            dt = (event.current_expected - event.last_expected).toSec();
+        if (dt <= 0 || dt > 1.0)
+            return;
+
+        geometry_msgs::Twist cmd;
+        if (active != -1 && !sources[active].ramp)
+        {
+            linear.reset(target.linear.x);
+            angular.reset(target.angular.z);
+        }
+        cmd.linear.x = linear.step(target.linear.x, dt);
+        cmd.angular.z = angular.step(target.angular.z, dt);
+        cmd.linear.y = target.linear.y;
+        cmd_publisher.publish(cmd);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "cmd_vel_mux");
+
+    ros::NodeHandle n;
+
+    double rate;
+    ros::param::param<double>("~rate", rate, 32);
+    if (rate <= 0)
+    {
+        ROS_ERROR("Parameter 'rate' must be a positive value.");
+        return 1;
+    }
+
+    tfr_control::CmdVelMux mux(n, rate);
+
+    ROS_INFO("cmd_vel_mux started");
+
+    ros::spin();
+    return 0;
+}
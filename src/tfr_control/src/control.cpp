@@ -9,27 +9,55 @@
  *
  * PARAMETERS:
  *  ~rate: in hz how fast we want to run the control loop (double, default:10)
+ *  ~tread_observer/sample_rate: hz the bridge polls the tread counters at (double, default: 32)
+ *  ~tread_observer/velocity_per_command: tread m/s per unit of cmd_cango (double, default: 0.0005)
+ *  ~tread_observer/time_constant: tread speed lag in s (double, default: 0.3)
+ *  ~tread_observer/acceleration_noise: observer process noise (double, default: 1.0)
+ *  ~tread_observer/measurement_noise: counter position variance m^2 (double, default: 1e-6)
+ *  ~tread_speed_mode/enabled: treads run in the roboteq's closed loop speed mode (bool, default: false)
+ *  ~tread_speed_mode/max_speed: tread m/s at a cmd_cango of 1000 (double, default: 0.5)
+ *  ~tread_speed_mode/acceleration_feedforward: cmd_cango per m/s^2 (double, default: 0)
+ *  ~bin/*: the bin actuators, see bin_control_server.h
+ *  ~flight_recorder/seconds: how much of the control loop is kept in memory (double, default: 30)
+ *  ~flight_recorder/directory: where dumps are written (string, default: the ros log directory)
+ *  ~flight_recorder/fault_interval: least seconds between dumps caused by faults (double, default: 10)
+ *  ~flight_recorder/overrun_factor: a cycle this many times longer than ~rate is a fault (double, default: 3)
+ * ACTIONS:
+ *  bin - raises or lowers the bin, both actuators together (tfr_msgs/Bin)
+ * PUBLISHED TOPICS:
+ *  /tread_velocity - observed tread speeds and their variance (tfr_msgs/TreadVelocity)
  * SERVICES:
  *  /toggle_control - uses the empty service, needs to be explicitly turned on to work
  *  /toggle_motors - uses the empty service, needs to be explicitly turned on to work
  *  /bin_state - gives the position of the bin
  *  /arm_state - gives the 4d position of the arm
  *  /zero_turntable - zeros the position of the turntable
+ *  /reload_calibration - reloads the encoder calibration from the parameter
+ *  server, after a new one is put there with rosparam load
+ *  /flight_recorder/dump - dumps the flight recorder, replies with the file
+ *
+ * The flight recorder (see flight_recorder.h) keeps every cycle of the control
+ * loop. It is dumped on request, when control is toggled off, and on a fault:
+ * an overrun cycle or a controller commanding something that isn't a number.
  */
 #include <ros/ros.h>
+#include <ros/file_log.h>
 #include <std_srvs/SetBool.h>
 #include <std_srvs/Empty.h>
+#include <std_srvs/Trigger.h>
 #include <tfr_msgs/QuerySrv.h>
 #include <tfr_msgs/BinStateSrv.h>
 #include <tfr_msgs/ArmStateSrv.h>
 #include <urdf/model.h>
 #include <sstream>
+#include <cmath>
+#include <memory>
 #include <controller_manager/controller_manager.h>
 #include <tfr_utilities/joints.h>
+#include <tfr_utilities/tracer.h>
 #include "robot_interface.h"
 #include "bin_control_server.h"
-#include <sensor_msgs/Imu.h>
-#include <geometry_msgs/Vector3.h>
+#include "flight_recorder.h"
 
 
 
@@ -85,6 +113,23 @@ void initializeTestCode(ros::NodeHandle& n)
 }
 //END TEST CODE
 
+/*
+ * Sizes the flight recorder to ~flight_recorder/seconds of the control loop
+ * */
+std::unique_ptr<tfr_control::FlightRecorder> makeFlightRecorder(double rate)
+{
+    double seconds, fault_interval;
+    std::string directory;
+    ros::param::param<double>("~flight_recorder/seconds", seconds, 30.0);
+    ros::param::param<double>("~flight_recorder/fault_interval", fault_interval, 10.0);
+    ros::param::param<std::string>("~flight_recorder/directory", directory,
+            ros::file_log::getLogDirectory());
+    const size_t frames = static_cast<size_t>(std::ceil(seconds * rate));
+    ROS_INFO("Control: flight recorder keeping %lu frames, dumping to %s", frames, directory.c_str());
+    return std::unique_ptr<tfr_control::FlightRecorder>{
+        new tfr_control::FlightRecorder{frames, directory, fault_interval}};
+}
+
 
 class Control
 {
@@ -97,30 +142,36 @@ class Control
             binService{n.advertiseService("bin_state", &Control::getBinState,this)},
             armService{n.advertiseService("arm_state", &Control::getArmState,this)},
             zeroService{n.advertiseService("zero_turntable", &Control::zeroTurntable,this)},
+            calibrationService{n.advertiseService("reload_calibration", &Control::reloadCalibration,this)},
+            bin_server{n},
+            recorder{makeFlightRecorder(rate)},
+            recorderService{n.advertiseService("flight_recorder/dump", &Control::dumpFlightRecorder, this)},
             cycle{1/rate},
-            enabled{false},
-			quat_x_sub{n.subscribe("/device120/quaternion_x", 5, &Control::updatePrivateLocalVariable1,this)},
-			quat_y_sub{n.subscribe("/device120/quaternion_y", 5, &Control::updatePrivateLocalVariable2,this)},
-			quat_z_sub{n.subscribe("/device120/quaternion_z", 5, &Control::updatePrivateLocalVariable3,this)},
-			quat_w_sub{n.subscribe("/device120/quaternion_w", 5, &Control::updatePrivateLocalVariable4,this)},
-			lin_vel_x_sub{n.subscribe("linear_acceleration_x", 5, &Control::accumulateX,this)},
-			lin_vel_y_sub{n.subscribe("linear_acceleration_y", 5, &Control::accumulateY,this)},
-			lin_vel_z_sub{n.subscribe("linear_acceleration_z", 5, &Control::accumulateZ,this)}
-		{}
+            enabled{false}
+		{
+            ros::param::param<double>("~flight_recorder/overrun_factor", overrun_factor, 3.0);
+        }
         
         /*
          * performs one iteration of the control loop
          * */
         void execute()
         {
+            const ros::Time start = ros::Time::now();
+            const ros::WallTime wall_start = ros::WallTime::now();
             //update from hardware
             robot_interface.read();
+            const ros::WallTime read_end = ros::WallTime::now();
             //update controllers
             controller_interface.update(ros::Time::now(), cycle);
+            const ros::WallTime update_end = ros::WallTime::now();
             //if (!enabled)
             //    robot_interface.clearCommands();
             //update hardware from controllers
             robot_interface.write();
+            const ros::WallTime write_end = ros::WallTime::now();
+
+            record(start, wall_start, read_end, update_end, write_end);
 			
             cycle.sleep();
         }
@@ -143,71 +194,21 @@ class Control
         //reset service
         ros::ServiceServer zeroService;
 
+        //calibration service
+        ros::ServiceServer calibrationService;
+
+        //moves the two bin actuators together
+        BinControlServer bin_server;
+
+        //the last few seconds of the control loop
+        std::unique_ptr<tfr_control::FlightRecorder> recorder;
+        ros::ServiceServer recorderService;
+        ros::WallTime last_start;
+        double overrun_factor;
+
         //how fast to spin
         ros::Duration cycle;
 
-		double quat_x = 0;
-		double quat_y = 0;
-		double quat_z = 0;
-		double quat_w = 0;
-		
-		double lin_acc_x = 0;
-		double lin_acc_y = 0;
-		double lin_acc_z = 0;
-		
-		double lin_vel_x = 0;
-		double lin_vel_y = 0;
-		double lin_vel_z = 0;
-		
-		ros::Subscriber quat_x_sub;
-		ros::Subscriber quat_y_sub;
-		ros::Subscriber quat_z_sub;
-		ros::Subscriber quat_w_sub;
-		
-		ros::Subscriber lin_vel_x_sub;
-		ros::Subscriber lin_vel_y_sub;
-		ros::Subscriber lin_vel_z_sub;
-		
-		void updatePrivateLocalVariable1(const std_msgs::Float64 &value)
-		{
-			quat_x = value.data;
-		}
-		
-		void updatePrivateLocalVariable2(const std_msgs::Float64 &value)
-		{
-			quat_y = value.data;
-		}
-		
-		void updatePrivateLocalVariable3(const std_msgs::Float64 &value)
-		{
-			quat_z = value.data;
-		}
-		
-		void updatePrivateLocalVariable4(const std_msgs::Float64 &value)
-		{
-			quat_w = value.data;
-		}
-		
-		
-		void accumulateX(const std_msgs::Float64 &value)
-		{
-			lin_acc_x = value.data;
-			lin_vel_x += value.data;
-		}
-		
-		void accumulateY(const std_msgs::Float64 &value)
-		{
-			lin_acc_y = value.data;
-			lin_vel_y += value.data;
-		}
-		
-		void accumulateZ(const std_msgs::Float64 &value)
-		{
-			lin_acc_z = value.data;
-			lin_vel_z += value.data;
-		}
-		
-		
         //if our motors are enabled
         bool enabled;
 
@@ -219,6 +220,8 @@ class Control
         {
             enabled = request.data;
             robot_interface.setEnabled(request.data);
+            if (!request.data)
+                recorder->requestDump("estop");
             return true;
         }
 
@@ -266,6 +269,56 @@ class Control
             return true;
         }
 
+        /*
+         * Swaps in a new encoder calibration without restarting the node
+         * */
+        bool reloadCalibration(std_srvs::Trigger::Request& request,
+                std_srvs::Trigger::Response& response)
+        {
+            response.success = robot_interface.reloadCalibration(response.message);
+            ROS_INFO("Control: reload calibration, %s", response.message.c_str());
+            return true;
+        }
+
+        /*
+         * Dumps the flight recorder, the reply is the file it goes to
+         * */
+        bool dumpFlightRecorder(std_srvs::Trigger::Request& request,
+                std_srvs::Trigger::Response& response)
+        {
+            response.message = recorder->requestDump("request");
+            response.success = true;
+            return true;
+        }
+
+        /*
+         * Puts one cycle in the flight recorder, and flags a fault on an
+         * overrun or a command that isn't a number. Runs every cycle, so it
+         * only copies.
+         * */
+        void record(const ros::Time& start, const ros::WallTime& wall_start,
+                const ros::WallTime& read_end, const ros::WallTime& update_end,
+                const ros::WallTime& write_end)
+        {
+            tfr_control::FlightFrame frame{};
+            frame.time = start.toSec();
+            frame.period = last_start.isZero() ? 0.0f : static_cast<float>((wall_start - last_start).toSec());
+            frame.read_time = static_cast<float>((read_end - wall_start).toSec());
+            frame.update_time = static_cast<float>((update_end - read_end).toSec());
+            frame.write_time = static_cast<float>((write_end - update_end).toSec());
+            robot_interface.recordState(frame);
+            recorder->record(frame);
+            last_start = wall_start;
+
+            if (frame.period > overrun_factor * cycle.toSec())
+                recorder->fault("overrun");
+            for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+            {
+                if (!std::isfinite(frame.command[joint]))
+                    recorder->fault("command");
+            }
+        }
+
 
 };
 
@@ -273,6 +326,7 @@ int main(int argc, char **argv)
 {
     ros::init(argc, argv, "control");
     ros::NodeHandle n;
+    tfr_utilities::Tracer::configureFromParams("control");
 
     double rate;
     ros::param::param<double>("~rate", rate, 10.0);
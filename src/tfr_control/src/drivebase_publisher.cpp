@@ -5,11 +5,12 @@
  *                  See tfr_control/include/tfr_control/drivebase_publisher.h for details.
  ***************************************************************************************/
 #include "drivebase_publisher.h"
+#include <tfr_utilities/tracer.h>
 
 namespace tfr_control
 {
     DrivebasePublisher::DrivebasePublisher(
-        ros::NodeHandle& n, double wheel_radius, double wheel_span) : 
+        ros::NodeHandle& n, double wheel_span, double wheel_radius) : 
         n{n}, wheel_radius{wheel_radius}, wheel_span{wheel_span}, 
         left_tread_publisher{}, right_tread_publisher{}
     {
@@ -17,17 +18,19 @@ namespace tfr_control
             "left_tread_velocity_controller/command", 5);
         right_tread_publisher = n.advertise<std_msgs::Float64>(
             "right_tread_velocity_controller/command", 5);
+        left_setpoint_publisher = n.advertise<std_msgs::Float64>(
+            "left_tread_velocity_controller/setpoint", 1, true);
+        right_setpoint_publisher = n.advertise<std_msgs::Float64>(
+            "right_tread_velocity_controller/setpoint", 1, true);
 
-
-        subscriber = n.subscribe("cmd_vel", 100, &DrivebasePublisher::subscriptionCallback, this);
+        //only the newest command matters, anything older is stale
+        subscriber = n.subscribe("cmd_vel", 1, &DrivebasePublisher::subscriptionCallback, this);
     }
 
     void DrivebasePublisher::subscriptionCallback(const geometry_msgs::Twist::ConstPtr& msg)
     {
-        ros::param::getCached("~wheel_span", wheel_span);
-        //ROS_INFO("Wheel Span: %f", wheel_span);
-
-         double left_velocity = msg->linear.x - (wheel_span * msg->angular.z) / 2;
+        tfr_utilities::TraceSpan span{"drivebase/cmd_vel", "teleop"};
+        double left_velocity = msg->linear.x - (wheel_span * msg->angular.z) / 2;
         double right_velocity = msg->linear.x + (wheel_span * msg->angular.z) / 2;
         
    if (msg->linear.x == 0 && msg->angular.z == 0 && msg->linear.y){
@@ -46,10 +49,8 @@ namespace tfr_control
         right_cmd.data = right_velocity;
         left_tread_publisher.publish(left_cmd);
         right_tread_publisher.publish(right_cmd);
-        
-        // Debug. Write the setpoints to the parameter server so that other nodes can see them.
-        n.setParam("/left_tread_velocity_controller/setpoint", left_cmd.data);
-        n.setParam("/right_tread_velocity_controller/setpoint", right_cmd.data);
+        left_setpoint_publisher.publish(left_cmd);
+        right_setpoint_publisher.publish(right_cmd);
     }
 
 }
@@ -59,6 +60,7 @@ int main(int argc, char **argv)
     ros::init(argc, argv, "drivebase");
 
     ros::NodeHandle n;
+    tfr_utilities::Tracer::configureFromParams("drivebase");
     
     double wheel_span, wheel_radius;
 
@@ -0,0 +1,179 @@
+#include "flight_recorder.h"
+#include <ros/ros.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+
+namespace tfr_control
+{
+    const uint32_t FlightRecorder::VERSION;
+
+    namespace
+    {
+        double wallTime()
+        {
+            return std::chrono::duration<double>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        //how often the dump thread looks for a fault
+        const std::chrono::milliseconds FAULT_POLL{100};
+    }
+
+    FlightRecorder::FlightRecorder(size_t frames, const std::string& d, double interval) :
+        capacity{std::max<size_t>(frames, 1)}, directory{d}, min_fault_interval{interval},
+        slots{new Slot[capacity]}, written{0}, fault_reason{nullptr}, stopping{false},
+        last_fault_dump{-interval}
+    {
+        for (size_t i = 0; i < capacity; i++)
+            slots[i].sequence.store(0, std::memory_order_relaxed);
+        dumper = std::thread{&FlightRecorder::run, this};
+    }
+
+    FlightRecorder::~FlightRecorder()
+    {
+        {
+            std::lock_guard<std::mutex> lock{request_mutex};
+            stopping = true;
+        }
+        signal.notify_one();
+        dumper.join();
+    }
+
+    void FlightRecorder::record(const FlightFrame& frame)
+    {
+        const uint64_t index = written.load(std::memory_order_relaxed);
+        Slot& slot = slots[index % capacity];
+        //odd while the frame is half written
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.frame = frame;
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        written.store(index + 1, std::memory_order_release);
+    }
+
+    void FlightRecorder::fault(const char* reason)
+    {
+        //no lock and no wakeup, the dump thread polls for it
+        fault_reason.store(reason, std::memory_order_release);
+    }
+
+    std::string FlightRecorder::requestDump(const std::string& reason)
+    {
+        const double time = wallTime();
+        std::string path = pathFor(reason, time);
+        {
+            std::lock_guard<std::mutex> lock{request_mutex};
+            requests.push_back(Request{path, reason, time});
+        }
+        signal.notify_one();
+        return path;
+    }
+
+    void FlightRecorder::snapshot(std::vector<FlightFrame>& frames) const
+    {
+        const uint64_t end = written.load(std::memory_order_acquire);
+        const uint64_t begin = end > capacity ? end - capacity : 0;
+        frames.clear();
+        frames.reserve(end - begin);
+        for (uint64_t index = begin; index < end; index++)
+        {
+            const Slot& slot = slots[index % capacity];
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            //being written, or already lapped by a newer frame
+            if (sequence != 2 * index + 2)
+                continue;
+            FlightFrame frame = slot.frame;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+                continue;
+            frames.push_back(frame);
+        }
+    }
+
+    bool FlightRecorder::write(const std::string& path, const std::string& reason, double dump_time,
+            const std::vector<FlightFrame>& frames, std::string& message)
+    {
+        FlightRecorderHeader header{};
+        std::memcpy(header.magic, "TFRF", 4);
+        header.version = VERSION;
+        header.frame_size = sizeof(FlightFrame);
+        header.frames = static_cast<uint32_t>(frames.size());
+        header.dump_time = dump_time;
+        std::strncpy(header.reason, reason.c_str(), sizeof(header.reason) - 1);
+
+        std::ofstream out{path, std::ios::binary | std::ios::trunc};
+        if (!out)
+        {
+            message = "could not open " + path;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(frames.data()), frames.size() * sizeof(FlightFrame));
+        if (!out)
+        {
+            message = "could not write " + path;
+            return false;
+        }
+        message = "wrote " + std::to_string(frames.size()) + " frames to " + path;
+        return true;
+    }
+
+    void FlightRecorder::run()
+    {
+        std::unique_lock<std::mutex> lock{request_mutex};
+        while (true)
+        {
+            signal.wait_for(lock, FAULT_POLL, [this]{ return stopping || !requests.empty(); });
+            std::vector<Request> pending;
+            pending.swap(requests);
+            const bool stop = stopping;
+            lock.unlock();
+
+            for (const Request& request : pending)
+                dump(request);
+
+            const char* reason = fault_reason.exchange(nullptr, std::memory_order_acquire);
+            if (reason != nullptr)
+            {
+                const double time = wallTime();
+                if (time - last_fault_dump >= min_fault_interval)
+                {
+                    last_fault_dump = time;
+                    dump(Request{pathFor(reason, time), reason, time});
+                }
+            }
+
+            if (stop)
+                return;
+            lock.lock();
+        }
+    }
+
+    void FlightRecorder::dump(const Request& request)
+    {
+        std::vector<FlightFrame> frames;
+        snapshot(frames);
+        std::string message;
+        if (write(request.path, request.reason, request.time, frames, message))
+            ROS_INFO("Flight Recorder: %s, %s", request.reason.c_str(), message.c_str());
+        else
+            ROS_WARN("Flight Recorder: %s, %s", request.reason.c_str(), message.c_str());
+    }
+
+    std::string FlightRecorder::pathFor(const std::string& reason, double dump_time) const
+    {
+        const std::time_t seconds = static_cast<std::time_t>(dump_time);
+        const int milliseconds = static_cast<int>((dump_time - seconds) * 1000);
+        std::tm local{};
+        localtime_r(&seconds, &local);
+        char stamp[32];
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+        char fraction[8];
+        std::snprintf(fraction, sizeof(fraction), "_%03d", milliseconds);
+        return directory + "/flight_" + stamp + fraction + "_" + reason + ".tfrf";
+    }
+}
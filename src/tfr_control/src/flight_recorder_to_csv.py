@@ -0,0 +1,58 @@
+#! /usr/bin/env python
+"""
+Turns a flight recorder dump (see include/tfr_control/flight_recorder.h) into a
+csv, one row per control cycle.
+
+usage: rosrun tfr_control flight_recorder_to_csv.py flight_<stamp>_<reason>.tfrf [out.csv]
+"""
+import csv
+import struct
+import sys
+
+JOINTS = ["left_tread", "right_tread", "bin", "turntable", "lower_arm", "upper_arm", "scoop"]
+ARM = ["turntable", "lower_arm", "upper_arm", "scoop"]
+TREADS = ["left", "right"]
+
+# must match FlightRecorderHeader and FlightFrame
+HEADER = struct.Struct("<4sIIId32s")
+FRAME = struct.Struct("<d4f7f7f7f4f4f2i2f2i2iB3x")
+VERSION = 1
+
+COLUMNS = (["time", "period", "read_time", "update_time", "write_time"]
+           + [joint + "_position" for joint in JOINTS]
+           + [joint + "_velocity" for joint in JOINTS]
+           + [joint + "_command" for joint in JOINTS]
+           + [joint + "_raw_encoder" for joint in ARM]
+           + [joint + "_torque" for joint in ARM]
+           + [tread + "_tread_count" for tread in TREADS]
+           + [tread + "_tread_variance" for tread in TREADS]
+           + [tread + "_tread_command" for tread in TREADS]
+           + [tread + "_tread_loop_error" for tread in TREADS]
+           + ["enabled"])
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1], "rb") as dump:
+        data = dump.read()
+
+    magic, version, frame_size, frames, dump_time, reason = HEADER.unpack_from(data, 0)
+    if magic != b"TFRF" or version != VERSION or frame_size != FRAME.size:
+        sys.exit("%s is not a version %d flight recorder dump" % (sys.argv[1], VERSION))
+    if HEADER.size + frames * FRAME.size > len(data):
+        sys.exit("%s is cut short" % sys.argv[1])
+    sys.stderr.write("%d frames, dumped at %f for %s\n"
+                     % (frames, dump_time, reason.split(b"\0")[0].decode()))
+
+    out = open(sys.argv[2], "w") if len(sys.argv) > 2 else sys.stdout
+    writer = csv.writer(out)
+    writer.writerow(COLUMNS)
+    for i in range(frames):
+        writer.writerow(FRAME.unpack_from(data, HEADER.size + i * FRAME.size))
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
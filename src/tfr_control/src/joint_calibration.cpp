@@ -0,0 +1,134 @@
+#include "joint_calibration.h"
+#include <algorithm>
+#include <cmath>
+
+namespace tfr_control
+{
+    namespace
+    {
+        //must match the joint names in the URDF and the yaml
+        const char* const joint_names[tfr_utilities::Joint::JOINT_COUNT] =
+        {
+            "left_tread_joint",
+            "right_tread_joint",
+            "bin_joint",
+            "turntable_joint",
+            "lower_arm_joint",
+            "upper_arm_joint",
+            "scoop_joint",
+        };
+
+        //yaml numbers come through as ints when written without a decimal point
+        bool toDouble(XmlRpc::XmlRpcValue& value, double& out)
+        {
+            if (value.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+                out = static_cast<double>(value);
+            else if (value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+                out = static_cast<int>(value);
+            else
+                return false;
+            return true;
+        }
+
+        bool toPair(XmlRpc::XmlRpcValue& value, double& a, double& b)
+        {
+            return value.getType() == XmlRpc::XmlRpcValue::TypeArray &&
+                value.size() == 2 && toDouble(value[0], a) && toDouble(value[1], b);
+        }
+    }
+
+    JointCalibration::JointCalibration() :
+        table{std::make_shared<const Table>(defaults())}
+    {}
+
+    JointCalibration::Entry JointCalibration::fromPoints(double encoder_a, double joint_a,
+            double encoder_b, double joint_b)
+    {
+        Entry entry{};
+        entry.enabled = true;
+        entry.scale = (joint_b - joint_a) / (encoder_b - encoder_a);
+        entry.offset = joint_a - entry.scale * encoder_a;
+        entry.joint_min = std::min(joint_a, joint_b);
+        entry.joint_max = std::max(joint_a, joint_b);
+        return entry;
+    }
+
+    /*
+     * The values the robot was tuned with before the table was configurable
+     * */
+    JointCalibration::Table JointCalibration::defaults()
+    {
+        const double pi = 3.14159265358979;
+        Table t{};
+        t[tfr_utilities::Joint::TURNTABLE] = fromPoints(-308224, -2 * pi, 308224, 2 * pi);
+        t[tfr_utilities::Joint::LOWER_ARM] = fromPoints(5.2, 0.104, 1.2, 1.55);
+        t[tfr_utilities::Joint::UPPER_ARM] = fromPoints(5.2, 2.4, 1.2, 0.98);
+        t[tfr_utilities::Joint::SCOOP] = fromPoints(3.72, 1.62, 1.2, -1.16614);
+        return t;
+    }
+
+    bool JointCalibration::load(std::string& message)
+    {
+        XmlRpc::XmlRpcValue config;
+        if (!ros::param::get("/absolute_position_encoder_limits", config) ||
+                config.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+        {
+            message = "no calibration on the parameter server, keeping current table";
+            return false;
+        }
+
+        Table next = defaults();
+        int loaded = 0;
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            const std::string name{joint_names[joint]};
+            if (!config.hasMember(name))
+                continue;
+
+            XmlRpc::XmlRpcValue& entry = config[name];
+            double encoder_a, encoder_b, joint_a, joint_b;
+            if (entry.getType() != XmlRpc::XmlRpcValue::TypeStruct ||
+                    !entry.hasMember("encoder") || !entry.hasMember("joint") ||
+                    !toPair(entry["encoder"], encoder_a, encoder_b) ||
+                    !toPair(entry["joint"], joint_a, joint_b))
+            {
+                message = name + " needs encoder: [a, b] and joint: [a, b]";
+                return false;
+            }
+            if (std::abs(encoder_b - encoder_a) < 1e-9)
+            {
+                message = name + " has the same encoder value at both points";
+                return false;
+            }
+
+            next[joint] = fromPoints(encoder_a, joint_a, encoder_b, joint_b);
+            if (entry.hasMember("clamp") &&
+                    entry["clamp"].getType() == XmlRpc::XmlRpcValue::TypeBoolean)
+            {
+                next[joint].clamp = static_cast<bool>(entry["clamp"]);
+            }
+            loaded++;
+        }
+
+        std::atomic_store(&table, std::shared_ptr<const Table>{std::make_shared<const Table>(next)});
+        message = "loaded calibration for " + std::to_string(loaded) + " joints";
+        return true;
+    }
+
+    void JointCalibration::apply(const double raw[tfr_utilities::Joint::JOINT_COUNT],
+            double positions[tfr_utilities::Joint::JOINT_COUNT]) const
+    {
+        //hold our own reference so a reload mid pass can't free the table
+        const std::shared_ptr<const Table> current = std::atomic_load(&table);
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            const Entry& entry = (*current)[joint];
+            if (!entry.enabled)
+                continue;
+            double position = entry.scale * raw[joint] + entry.offset;
+            if (entry.clamp)
+                position = std::max(std::min(position, entry.joint_max), entry.joint_min);
+            positions[joint] = position;
+        }
+    }
+}
@@ -5,12 +5,43 @@
  */
 #include "robot_interface.h"
 #include <tfr_utilities/joints.h>
+#include <tfr_utilities/tracer.h>
 
 using hardware_interface::JointStateHandle;
 using hardware_interface::JointHandle;
 
 namespace tfr_control
 {
+    namespace
+    {
+        /*
+         * Tread observer tuning, see tread_velocity_observer.h
+         * */
+        TreadVelocityObserver::Parameters treadObserverParameters()
+        {
+            //12800 counts per revolution of a 0.15m wheel
+            TreadVelocityObserver::Parameters parameters{};
+            ros::param::param<double>("~tread_observer/meters_per_count",
+                    parameters.meters_per_count, 2 * 3.14159265358979 * 0.15 / 12800);
+            ros::param::param<double>("~tread_observer/velocity_per_command",
+                    parameters.velocity_per_command, 0.0005);
+            ros::param::param<double>("~tread_observer/time_constant",
+                    parameters.time_constant, 0.3);
+            ros::param::param<double>("~tread_observer/acceleration_noise",
+                    parameters.acceleration_noise, 1.0);
+            ros::param::param<double>("~tread_observer/measurement_noise",
+                    parameters.measurement_noise, 1e-6);
+            return parameters;
+        }
+
+        double treadSamplePeriod()
+        {
+            double rate;
+            ros::param::param<double>("~tread_observer/sample_rate", rate, 32.0);
+            return 1 / rate;
+        }
+    }
+
     /*
      * Creates the robot interfaces spins up all the joints and registers them
      * with their relevant interfaces
@@ -60,6 +91,17 @@ namespace tfr_control
         //left_tread_publisher_pid_debug_state{n.advertise<std_msgs::Float64>("/left_tread_velocity_controller/pid_debug/state", 1)}, Not sure if this does anything so disabling for debug purposes
        // left_tread_publisher_pid_debug_command{n.advertise<std_msgs::Int32>("/left_tread_velocity_controller/pid_debug/command", 1)}, Not sure if this does anything so disabling for debug purposes
         
+        left_tread_clock{treadSamplePeriod(), 0.1},
+        right_tread_clock{treadSamplePeriod(), 0.1},
+        left_tread_observer{treadObserverParameters()},
+        right_tread_observer{treadObserverParameters()},
+        tread_velocity_publisher{n.advertise<tfr_msgs::TreadVelocity>("tread_velocity", 5)},
+        tread_setpoint_previous{std::make_pair(0,0)},
+        left_tread_loop_error_subscriber{n.subscribe("/device8/get_qry_lperr/qry_lperr_1", 5,
+                &RobotInterface::readLeftTreadLoopError, this)},
+        right_tread_loop_error_subscriber{n.subscribe("/device8/get_qry_lperr/qry_lperr_2", 5,
+                &RobotInterface::readRightTreadLoopError, this)},
+
         use_fake_values{fakes}, lower_limits{lower_lim},
         upper_limits{upper_lim}, drivebase_v0{std::make_pair(0,0)},
         last_update{ros::Time::now()},
@@ -78,16 +120,35 @@ namespace tfr_control
         registerJointPositionInterface("lower_arm_joint", tfr_utilities::Joint::LOWER_ARM);
         registerJointPositionInterface("upper_arm_joint", tfr_utilities::Joint::UPPER_ARM);
         registerJointPositionInterface("scoop_joint", tfr_utilities::Joint::SCOOP);
+        // the treads can also be driven by speed, which interface is in use is
+        // decided by the controllers in the yaml
+        registerJointVelocityInterface("left_tread_joint", tfr_utilities::Joint::LEFT_TREAD);
+        registerJointVelocityInterface("right_tread_joint", tfr_utilities::Joint::RIGHT_TREAD);
         //register the interfaces with the controller layer
         registerInterface(&joint_state_interface);
         registerInterface(&joint_effort_interface);
         registerInterface(&joint_position_interface);
+        registerInterface(&joint_velocity_interface);
+
+        ros::param::param<bool>("~tread_speed_mode/enabled", tread_speed_mode, false);
+        ros::param::param<double>("~tread_speed_mode/max_speed", tread_max_speed, 0.5);
+        ros::param::param<double>("~tread_speed_mode/acceleration_feedforward",
+                tread_acceleration_feedforward, 0.0);
+        if (tread_speed_mode)
+            ROS_INFO("Robot Interface: treads in closed loop speed mode, max speed %f m/s",
+                    tread_max_speed);
         
         for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
         {
             velocity_values[joint] = 0;
             effort_values[joint] = 0;
         }
+
+        std::string message;
+        if (!calibration.load(message))
+            ROS_WARN("Robot Interface: %s", message.c_str());
+        else
+            ROS_INFO("Robot Interface: %s", message.c_str());
     }
 
 
@@ -100,72 +161,58 @@ namespace tfr_control
      * */
  void RobotInterface::read() 
     {
+        tfr_msgs::TreadVelocity tread_velocity;
+        tread_velocity.stamp = ros::Time::now();
+
         //LEFT_TREAD
         position_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] = 0;
-        velocity_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] = readBrushlessLeftVel();
+        velocity_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] = 
+            readBrushlessLeftVel(tread_velocity.left_variance, tread_velocity.left_loop_error);
         effort_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] = 0;
 
         //RIGHT_TREAD
         position_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)] = 0;
-        velocity_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)] = readBrushlessRightVel();
+        velocity_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)] = 
+            readBrushlessRightVel(tread_velocity.right_variance, tread_velocity.right_loop_error);
         effort_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)] = 0;
 
+        tread_velocity.left_velocity = velocity_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)];
+        tread_velocity.right_velocity = velocity_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)];
+        tread_velocity_publisher.publish(tread_velocity);
+
         if (!use_fake_values)
         {
-            //TURNTABLE
-            double turntable_position_double = 
-                linear_interp<double>(static_cast<double>(turntable_encoder), static_cast<double>(turntable_encoder_min),
-                    turntable_joint_min,
-                    static_cast<double>(turntable_encoder_max),
-                    turntable_joint_max
-                    );
-            
-            position_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] = turntable_position_double;
+            double raw[tfr_utilities::Joint::JOINT_COUNT]{};
+
+            turntable_mutex.lock();
+            raw[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] = turntable_encoder;
+            turntable_mutex.unlock();
+
+            lower_arm_mutex.lock();
+            raw[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = lower_arm_encoder;
+            lower_arm_mutex.unlock();
+
+            upper_arm_mutex.lock();
+            raw[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = upper_arm_encoder;
+            upper_arm_mutex.unlock();
+
+            scoop_mutex.lock();
+            raw[static_cast<int>(tfr_utilities::Joint::SCOOP)] = scoop_encoder;
+            scoop_mutex.unlock();
+
+            //TURNTABLE, LOWER_ARM, UPPER_ARM, SCOOP
+            calibration.apply(raw, position_values);
+            for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+                raw_values[joint] = raw[joint];
+
             velocity_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] = 0; 
             effort_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] = 0;
-
-            //LOWER_ARM
-            double lower_arm_position_double = 
-                linear_interp<double>(
-                    static_cast<double>(lower_arm_encoder),
-                    static_cast<double>(arm_lower_encoder_min),
-                    arm_lower_joint_min,
-                    static_cast<double>(arm_lower_encoder_max),
-                    arm_lower_joint_max
-                    );
-        
-            double upper_arm_position_double = 
-                linear_interp<double>(
-                    static_cast<double>(upper_arm_encoder),
-                    static_cast<double>(arm_upper_encoder_min),
-                    arm_upper_joint_max,
-                    static_cast<double>(arm_upper_encoder_max),
-                    arm_upper_joint_min
-                    );
-
-            double scoop_position_double = 
-                linear_interp<double>(
-                    static_cast<double>(scoop_encoder),
-                    static_cast<double>(arm_end_encoder_min),
-                    arm_end_joint_max,
-                    static_cast<double>(arm_end_encoder_max),
-                    arm_end_joint_min
-                    );
-
-            position_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = lower_arm_position_double;
             velocity_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = 0;
             effort_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = 0;
-
-            //UPPER_ARM
-            position_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = upper_arm_position_double;
             velocity_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = 0;
             effort_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = 0;
-
-            //SCOOP
-            position_values[static_cast<int>(tfr_utilities::Joint::SCOOP)] = scoop_position_double; 
             velocity_values[static_cast<int>(tfr_utilities::Joint::SCOOP)] = 0;
             effort_values[static_cast<int>(tfr_utilities::Joint::SCOOP)] = 0;
-            
         }
  
         //BIN
@@ -184,6 +231,7 @@ namespace tfr_control
      */
     void RobotInterface::write() 
     {
+        tfr_utilities::TraceSpan span{"control/write", "control"};
 
         double signal;
         if (use_fake_values) //test code for working with rviz simulator
@@ -194,17 +242,38 @@ namespace tfr_control
             adjustFakeJoint(tfr_utilities::Joint::SCOOP);
         }
         
+        //in speed mode the tread commands are m/s rather than effort
+        const double dt = (ros::Time::now() - last_update).toSec();
+
         //LEFT_TREAD
         double left_tread_command = command_values[static_cast<int32_t>(tfr_utilities::Joint::LEFT_TREAD)];
+        if (tread_speed_mode)
+        {
+            const double setpoint = left_tread_command;
+            left_tread_command = speedModeCommand(setpoint, tread_setpoint_previous.first, dt);
+            tread_setpoint_previous.first = setpoint;
+        }
         std_msgs::Int32 left_tread_msg;
         left_tread_msg.data = 1 * clamp(static_cast<int32_t>(left_tread_command), -1000, 1000); //changed -1 to 1 for debugging hall direction
+        brushless_left_tread_mutex.lock();
+        left_tread_last_command = left_tread_msg.data;
+        brushless_left_tread_mutex.unlock();
        // left_tread_msg.data += 1; // for debugging only
         brushless_left_tread_vel_publisher.publish(left_tread_msg);
 
         //RIGHT_TREAD
         double right_tread_command = command_values[static_cast<int32_t>(tfr_utilities::Joint::RIGHT_TREAD)];
+        if (tread_speed_mode)
+        {
+            const double setpoint = right_tread_command;
+            right_tread_command = speedModeCommand(setpoint, tread_setpoint_previous.second, dt);
+            tread_setpoint_previous.second = setpoint;
+        }
         std_msgs::Int32 right_tread_msg;
         right_tread_msg.data = 1 * clamp(static_cast<int32_t>(right_tread_command), -1000, 1000); //changed -1 to 1 for debugging hall direction
+        brushless_right_tread_mutex.lock();
+        right_tread_last_command = right_tread_msg.data;
+        brushless_right_tread_mutex.unlock();
         //right_tread_msg.data += 1; // for debugging only
         brushless_right_tread_vel_publisher.publish(right_tread_msg);
         
@@ -214,6 +283,19 @@ namespace tfr_control
         drivebase_v0.second = velocity_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)];
     }
     
+    /*
+     * Turns a tread speed setpoint [m/s] into a closed loop cmd_cango, with
+     * feedforward on the change in setpoint so the roboteq's loop doesn't
+     * have to wind up to follow an acceleration.
+     * */
+    int32_t RobotInterface::speedModeCommand(double setpoint, double previous, double dt)
+    {
+        double command = setpoint / tread_max_speed * 1000;
+        if (dt > 0)
+            command += tread_acceleration_feedforward * (setpoint - previous) / dt;
+        return static_cast<int32_t>(std::round(command));
+    }
+
     template <typename T>
     T RobotInterface::linear_interp(T x, T x1, T y1, T x2, T y2)
     {
@@ -239,33 +321,6 @@ namespace tfr_control
         return std::max(std::min(input, upper_bound), lower_bound);
     }
 
-    // TODO: Horrible duplication of code should be removed.
-    // has hardcoded min joint position in header file
-    const int32_t RobotInterface::get_arm_lower_min_int()
-    {
-        double arm_lower_joint_min_mapped = linear_interp<double>(arm_lower_joint_min * -10,
-                arm_lower_joint_min,
-                std::numeric_limits<int32_t>::min(),
-                arm_lower_joint_max, 
-                std::numeric_limits<int32_t>::max());
-        int32_t arm_lower_joint_min_mapped_int = static_cast<int32_t>(arm_lower_joint_min_mapped);
-        
-        return arm_lower_joint_min_mapped_int;
-    }
-        
-    // has hardcoded max joint position in header file
-    const int32_t RobotInterface::get_arm_lower_max_int()
-    {
-        double arm_lower_joint_max_mapped = linear_interp<double>(arm_lower_joint_max * 10,
-                arm_lower_joint_min,
-                std::numeric_limits<int32_t>::min(),
-                arm_lower_joint_max, 
-                std::numeric_limits<int32_t>::max());
-        int32_t arm_lower_joint_max_mapped_int = static_cast<int32_t>(arm_lower_joint_max_mapped);
-        
-        return arm_lower_joint_max_mapped_int;
-    }
-    
     void RobotInterface::setEnabled(bool val)
     {
         enabled = val;
@@ -416,14 +471,24 @@ namespace tfr_control
 
     void RobotInterface::setBrushlessLeftEncoder(const std_msgs::Int32 &msg)
     {
-        left_tread_absolute_encoder_current = msg.data;
-        left_tread_time_current = ros::Time::now();
+        brushless_left_tread_mutex.lock();
+
+        left_tread_count = msg.data;
+        left_tread_observer.correct(msg.data, left_tread_clock.stamp(ros::Time::now().toSec()),
+                left_tread_last_command);
+
+        brushless_left_tread_mutex.unlock();
     }
     
     void RobotInterface::setBrushlessRightEncoder(const std_msgs::Int32 &msg)
     {
-        right_tread_absolute_encoder_current = msg.data;
-        right_tread_time_current = ros::Time::now();
+        brushless_right_tread_mutex.lock();
+
+        right_tread_count = msg.data;
+        right_tread_observer.correct(msg.data, right_tread_clock.stamp(ros::Time::now().toSec()),
+                right_tread_last_command);
+
+        brushless_right_tread_mutex.unlock();
     }
 
     /*
@@ -442,6 +507,31 @@ namespace tfr_control
         joint_position_interface.registerHandle(handle);
     }
 
+    /*
+     * Register a tread with the velocity interface, sharing the state handle
+     * it already has from the effort interface
+     * */
+    void RobotInterface::registerJointVelocityInterface(std::string name, tfr_utilities::Joint joint) 
+    {
+        auto idx = static_cast<int>(joint);
+        JointHandle handle(joint_state_interface.getHandle(name), &command_values[idx]);
+        joint_velocity_interface.registerHandle(handle);
+    }
+
+    void RobotInterface::readLeftTreadLoopError(const std_msgs::Int32 &msg)
+    {
+        brushless_left_tread_mutex.lock();
+        left_tread_loop_error = msg.data;
+        brushless_left_tread_mutex.unlock();
+    }
+
+    void RobotInterface::readRightTreadLoopError(const std_msgs::Int32 &msg)
+    {
+        brushless_right_tread_mutex.lock();
+        right_tread_loop_error = msg.data;
+        brushless_right_tread_mutex.unlock();
+    }
+
     // get the ratio of the encoder count to the max encoder count for a revolution
     double RobotInterface::brushlessEncoderCountToRadians(int32_t encoder_count)
     {
@@ -453,19 +543,6 @@ namespace tfr_control
         return (static_cast<double>(encoder_count) / static_cast<double>(brushless_encoder_count_per_revolution));
     }
    
-    // returns the linear speed of the robot (how fast it is moving forwards) in meters / second.
-    double RobotInterface::encoderDeltaToLinearSpeed(int32_t encoder_delta, ros::Duration time_delta)
-    {
-        const double wheel_radius_meters = 0.15; 
-        const double wheel_circumference = 2* 3.1415927 * wheel_radius_meters;
-        
-        const double revolutions = brushlessEncoderCountToRevolutions(encoder_delta);
-        
-        const double linear_speed_meters_per_sec = (wheel_circumference * revolutions) / time_delta.toSec();
-        
-        return linear_speed_meters_per_sec;
-    }
-    
     void RobotInterface::accumulateBrushlessRightVel(const std_msgs::Int32 &msg)
     {
         brushless_right_tread_mutex.lock();
@@ -489,46 +566,82 @@ namespace tfr_control
         brushless_left_tread_mutex.unlock();
     }
     
-    double RobotInterface::readBrushlessRightVel()
+    /*
+     * The observed tread speed in meters / second, extrapolated from the last
+     * counter sample to now
+     * */
+    double RobotInterface::readBrushlessRightVel(double& variance, int32_t& loop_error)
     {
         brushless_right_tread_mutex.lock();
 
-        int32_t encoder_delta = right_tread_absolute_encoder_current - right_tread_absolute_encoder_previous;
-        
-        ros::Duration time_delta = right_tread_time_current - right_tread_time_previous;
-        
-        right_tread_absolute_encoder_previous = right_tread_absolute_encoder_current;
-        right_tread_time_previous = right_tread_time_current;
-        
+        const double velocity = right_tread_observer.velocityAt(ros::Time::now().toSec(),
+                right_tread_last_command);
+        variance = right_tread_observer.getVariance();
+        loop_error = right_tread_loop_error;
+
         brushless_right_tread_mutex.unlock();
-        
-        const double linear_speed_meters_per_sec = encoderDeltaToLinearSpeed(encoder_delta, time_delta);
-        
-        return linear_speed_meters_per_sec;
+
+        return velocity;
     }
     
-    double RobotInterface::readBrushlessLeftVel()
+    double RobotInterface::readBrushlessLeftVel(double& variance, int32_t& loop_error)
     {
         brushless_left_tread_mutex.lock();
 
-        int32_t encoder_delta = left_tread_absolute_encoder_current - left_tread_absolute_encoder_previous;
-        
-        ros::Duration time_delta = left_tread_time_current - left_tread_time_previous;
-        
-        left_tread_absolute_encoder_previous = left_tread_absolute_encoder_current;
-        left_tread_time_previous = left_tread_time_current;
-        
+        const double velocity = left_tread_observer.velocityAt(ros::Time::now().toSec(),
+                left_tread_last_command);
+        variance = left_tread_observer.getVariance();
+        loop_error = left_tread_loop_error;
+
         brushless_left_tread_mutex.unlock();
-        
-        const double linear_speed_meters_per_sec = encoderDeltaToLinearSpeed(encoder_delta, time_delta);
-        
-        return linear_speed_meters_per_sec;
+
+        return velocity;
     }
     
     void RobotInterface::zeroTurntable()
     {
         //TODO
     }
+
+    bool RobotInterface::reloadCalibration(std::string& message)
+    {
+        return calibration.load(message);
+    }
+
+    void RobotInterface::recordState(FlightFrame& frame)
+    {
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            frame.position[joint] = static_cast<float>(position_values[joint]);
+            frame.velocity[joint] = static_cast<float>(velocity_values[joint]);
+            frame.command[joint] = static_cast<float>(command_values[joint]);
+        }
+
+        //TURNTABLE, LOWER_ARM, UPPER_ARM, SCOOP
+        const int arm = static_cast<int>(tfr_utilities::Joint::TURNTABLE);
+        for (size_t joint = 0; joint < RECORDED_ARM_JOINTS; joint++)
+            frame.raw_encoder[joint] = static_cast<float>(raw_values[arm + joint]);
+        frame.torque[0] = static_cast<float>(turntable_torque);
+        frame.torque[1] = static_cast<float>(lower_arm_torque);
+        frame.torque[2] = static_cast<float>(upper_arm_torque);
+        frame.torque[3] = static_cast<float>(scoop_torque);
+
+        brushless_left_tread_mutex.lock();
+        frame.tread_count[0] = left_tread_count;
+        frame.tread_variance[0] = static_cast<float>(left_tread_observer.getVariance());
+        frame.tread_command[0] = left_tread_last_command;
+        frame.tread_loop_error[0] = left_tread_loop_error;
+        brushless_left_tread_mutex.unlock();
+
+        brushless_right_tread_mutex.lock();
+        frame.tread_count[1] = right_tread_count;
+        frame.tread_variance[1] = static_cast<float>(right_tread_observer.getVariance());
+        frame.tread_command[1] = right_tread_last_command;
+        frame.tread_loop_error[1] = right_tread_loop_error;
+        brushless_right_tread_mutex.unlock();
+
+        frame.enabled = enabled;
+    }
     
 
 }
@@ -1,9 +1,39 @@
 // C++11
+/*
+ * Forwards the tread commands from /motor_output to the motor controller over
+ * the raspberry pi's UART.
+ *
+ * The subscriber callback only stores the newest command, a separate writer
+ * thread sends whatever is newest at a fixed cadence. A slow UART therefore
+ * never backs up the subscriber queue, and stale commands are dropped instead
+ * of being sent in order.
+ *
+ * Every command is sent as a 5 byte frame:
+ *  [0xA5] [sequence] [right power] [left power] [checksum]
+ * where the powers are signed bytes, the sequence number increments with each
+ * frame, and the checksum is the 8 bit sum of the sequence and power bytes.
+ * Nothing on the receiving end understands frames yet, so ~framed defaults to
+ * false, which sends the old unframed [right power] [left power]. Only turn it
+ * on together with a receiver that expects frames.
+ *
+ * If no command arrives for ~command_timeout the writer sends zeros rather
+ * than repeating the last command, so the treads stop when control dies.
+ *
+ * parameters:
+ *  - ~right_power_scale: scales the right tread command (int, default: 100)
+ *  - ~left_power_scale: scales the left tread command (int, default: 100)
+ *  - ~send_rate: how often to send the newest command [hz] (double, default: 20)
+ *  - ~report_period: how often to log throughput and drops [s] (double, default: 5)
+ *  - ~framed: whether to frame commands (bool, default: false)
+ *  - ~command_timeout: how long the last command is repeated [s] (double, default: 0.5)
+ */
 
 #include <iostream>
 #include <unistd.h>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <atomic>
 #include <ros/ros.h>
 #include <tfr_msgs/PwmCommand.h>
 
@@ -20,36 +50,137 @@ namespace wiringpi
 const std::string UART_DEVICE_NAME = "/dev/ttyS0";
 const int UART_BAUD_RATE = 9600;
 const int COMMAND_SIZE_BYTES = 2;
+const int FRAME_SIZE_BYTES = 5;
+const uint8_t FRAME_START = 0xA5;
 const int MOTOR_RIGHT = 0;
 const int MOTOR_LEFT  = 1;
 int fd;
 int right_power_scale = 100;
 int left_power_scale = 100;
+bool framed = false;
 
+// The newest command, shared between the callback and the writer thread.
+std::mutex command_mutex;
+int8_t latest_power[COMMAND_SIZE_BYTES] = {0, 0};
+bool command_pending = false;
+bool command_received = false;
+std::chrono::steady_clock::time_point last_command;
+
+// Statistics, reset every report period.
+std::atomic<uint32_t> commands_dropped{0};
+std::atomic<uint32_t> commands_received{0};
 
-void serialWriteCallback(const tfr_msgs::PwmCommand & command) {
-    //ROS_INFO("In callback");
 
+void serialWriteCallback(const tfr_msgs::PwmCommand & command) {
     int8_t motorPower[COMMAND_SIZE_BYTES] = {0, 0};
-    uint8_t * unsignedPower = (uint8_t *)motorPower;
-    
-    if(command.enabled) {
-        ros::param::getCached("~right_power_scale", right_power_scale);
-        ros::param::getCached("~left_power_scale", left_power_scale);
-        
 
+    if(command.enabled) {
         motorPower[MOTOR_RIGHT] = command.tread_right * right_power_scale;
         motorPower[MOTOR_LEFT] = command.tread_left * left_power_scale; // Jon changed this from negative to try and debug the right tread not spinning due to being sent -1 commands randomly
-        
-        if (command.tread_right != 0 || command.tread_left != 0) {
-            ROS_INFO("writing power: %d, %d", motorPower[MOTOR_RIGHT], motorPower[MOTOR_LEFT]);
-        }
+    }
 
-        write(fd, motorPower, COMMAND_SIZE_BYTES);	
+    std::lock_guard<std::mutex> lock(command_mutex);
+    if (command_pending) {
+        // the writer never got to send the previous command
+        commands_dropped++;
     }
-    else {
-        ROS_INFO("command not enabled");
-        write(fd, motorPower, COMMAND_SIZE_BYTES);
+    latest_power[MOTOR_RIGHT] = motorPower[MOTOR_RIGHT];
+    latest_power[MOTOR_LEFT] = motorPower[MOTOR_LEFT];
+    command_pending = true;
+    command_received = true;
+    last_command = std::chrono::steady_clock::now();
+    commands_received++;
+}
+
+// write() may return early, keep going until the whole buffer is out.
+bool writeAll(const uint8_t* buffer, int size) {
+    int written = 0;
+    while (written < size) {
+        ssize_t result = write(fd, buffer + written, size - written);
+        if (result <= 0) {
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+void serialWriterLoop(double send_rate, double report_period, double command_timeout) {
+    const auto timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(command_timeout));
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / send_rate));
+    auto next_send = std::chrono::steady_clock::now();
+    auto last_report = next_send;
+
+    uint8_t sequence = 0;
+    uint32_t bytes_written = 0;
+    uint32_t frames_written = 0;
+    uint32_t write_errors = 0;
+    uint32_t overruns = 0;
+    bool timed_out = false;
+
+    while (ros::ok()) {
+        int8_t power[COMMAND_SIZE_BYTES] = {0, 0};
+        bool fresh;
+        {
+            std::lock_guard<std::mutex> lock(command_mutex);
+            fresh = command_received && std::chrono::steady_clock::now() - last_command <= timeout;
+            if (fresh) {
+                power[MOTOR_RIGHT] = latest_power[MOTOR_RIGHT];
+                power[MOTOR_LEFT] = latest_power[MOTOR_LEFT];
+            }
+            command_pending = false;
+        }
+        if (fresh == timed_out) {
+            timed_out = !fresh;
+            if (timed_out && command_received) {
+                ROS_WARN("rp_control: no command for %.2f s, stopping the treads", command_timeout);
+            }
+        }
+
+        // The newest command is resent every period, even if it has not
+        // changed, so the motors always hold the freshest value until it
+        // times out.
+        uint8_t frame[FRAME_SIZE_BYTES];
+        int frame_size;
+        if (framed) {
+            frame[0] = FRAME_START;
+            frame[1] = sequence++;
+            frame[2] = static_cast<uint8_t>(power[MOTOR_RIGHT]);
+            frame[3] = static_cast<uint8_t>(power[MOTOR_LEFT]);
+            frame[4] = static_cast<uint8_t>(frame[1] + frame[2] + frame[3]);
+            frame_size = FRAME_SIZE_BYTES;
+        } else {
+            frame[0] = static_cast<uint8_t>(power[MOTOR_RIGHT]);
+            frame[1] = static_cast<uint8_t>(power[MOTOR_LEFT]);
+            frame_size = COMMAND_SIZE_BYTES;
+        }
+
+        if (writeAll(frame, frame_size)) {
+            bytes_written += frame_size;
+            frames_written++;
+        } else {
+            write_errors++;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_report).count();
+        if (elapsed >= report_period) {
+            ROS_INFO("rp_control: %.1f bytes/s, %u frames, %u commands received, %u dropped, %u write errors, %u overruns",
+                    bytes_written / elapsed, frames_written, commands_received.exchange(0),
+                    commands_dropped.exchange(0), write_errors, overruns);
+            bytes_written = frames_written = write_errors = overruns = 0;
+            last_report = now;
+        }
+
+        next_send += period;
+        if (next_send < now) {
+            // the UART could not keep up with the cadence, don't try to catch up
+            overruns++;
+            next_send = now;
+        }
+        std::this_thread::sleep_until(next_send);
     }
 }
 
@@ -58,6 +189,24 @@ int main (int argc, char** argv)
 {
     ROS_INFO("starting raspberry pi node");
     ros::init(argc, argv, "rp_control");
+
+    double send_rate, report_period, command_timeout;
+    ros::param::param<int>("~right_power_scale", right_power_scale, 100);
+    ros::param::param<int>("~left_power_scale", left_power_scale, 100);
+    ros::param::param<double>("~send_rate", send_rate, 20);
+    ros::param::param<double>("~report_period", report_period, 5);
+    ros::param::param<bool>("~framed", framed, false);
+    ros::param::param<double>("~command_timeout", command_timeout, 0.5);
+    if (send_rate <= 0)
+    {
+        ROS_ERROR("Parameter 'send_rate' must be a positive value.");
+        return 1;
+    }
+    if (command_timeout <= 0)
+    {
+        ROS_ERROR("Parameter 'command_timeout' must be a positive value.");
+        return 1;
+    }
     
     //setup serial connection
     if ( wiringpi::wiringPiSetup() == -1 )
@@ -75,12 +224,13 @@ int main (int argc, char** argv)
     }
     
     ros::NodeHandle n;
-    ros::Subscriber sub_obj = n.subscribe("/motor_output", 4, serialWriteCallback);
+    ros::Subscriber sub_obj = n.subscribe("/motor_output", 1, serialWriteCallback);
+    std::thread writer(serialWriterLoop, send_rate, report_period, command_timeout);
     ROS_INFO("About to spin raspberry pi node");
     ros::spin();
     ROS_INFO("Have returned from spin");
+    writer.join();
 
 
     return 0;
 }
-
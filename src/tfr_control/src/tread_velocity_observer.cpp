@@ -0,0 +1,106 @@
+#include "tread_velocity_observer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace tfr_control
+{
+    SampleClock::SampleClock(double period, double gain) :
+        period{period}, gain{gain}, locked{false}, last{0}
+    {}
+
+    double SampleClock::stamp(double arrival)
+    {
+        //first sample, or the source went quiet for a while, start over
+        if (!locked || arrival - last > 4 * period || arrival < last - period)
+        {
+            locked = true;
+            last = arrival;
+            return last;
+        }
+
+        //a dropped poll shows up as a gap of a whole number of periods, samples
+        //are far more often late than early so the rounding leans late
+        const double periods = std::max(1.0, std::floor((arrival - last) / period + 0.25));
+        const double expected = last + periods * period;
+        const double error = std::max(std::min(arrival - expected, period / 2), -period / 2);
+        last = expected + gain * error;
+        return last;
+    }
+
+    TreadVelocityObserver::TreadVelocityObserver(const Parameters& parameters) :
+        parameters(parameters), initialized{false}, time{0}, last_count{0},
+        measured{0}, position{0}, velocity{0}, covariance{{0, 0}, {0, 0}}
+    {}
+
+    void TreadVelocityObserver::predict(double to, double command)
+    {
+        const double dt = to - time;
+        if (!initialized || dt <= 0)
+            return;
+        time = to;
+
+        //exact discretization of a first order lag toward the commanded speed
+        const double tau = parameters.time_constant;
+        const double decay = std::exp(-dt / tau);
+        const double lag = tau * (1 - decay);
+        const double target = parameters.velocity_per_command * command;
+
+        position += lag * velocity + (dt - lag) * target;
+        velocity = decay * velocity + (1 - decay) * target;
+
+        // P = F P F' + Q, with F = [1 lag; 0 decay]
+        const double p00 = covariance[0][0], p01 = covariance[0][1];
+        const double p10 = covariance[1][0], p11 = covariance[1][1];
+        const double q = parameters.acceleration_noise;
+        covariance[0][0] = p00 + lag * (p01 + p10) + lag * lag * p11 + q * dt * dt * dt / 3;
+        covariance[0][1] = decay * (p01 + lag * p11) + q * dt * dt / 2;
+        covariance[1][0] = decay * (p10 + lag * p11) + q * dt * dt / 2;
+        covariance[1][1] = decay * decay * p11 + q * dt;
+    }
+
+    double TreadVelocityObserver::velocityAt(double at, double command) const
+    {
+        if (!initialized || at <= time)
+            return velocity;
+        const double decay = std::exp(-(at - time) / parameters.time_constant);
+        return decay * velocity + (1 - decay) * parameters.velocity_per_command * command;
+    }
+
+    void TreadVelocityObserver::correct(int32_t count, double at, double command)
+    {
+        if (!initialized)
+        {
+            initialized = true;
+            time = at;
+            last_count = count;
+            measured = 0;
+            position = 0;
+            velocity = parameters.velocity_per_command * command;
+            covariance[0][0] = parameters.measurement_noise;
+            covariance[0][1] = covariance[1][0] = 0;
+            covariance[1][1] = 1;
+            return;
+        }
+
+        predict(at, command);
+
+        //wrap safe difference, positions stay relative to the first sample
+        const int32_t delta = static_cast<int32_t>(
+                static_cast<uint32_t>(count) - static_cast<uint32_t>(last_count));
+        last_count = count;
+        measured += delta * parameters.meters_per_count;
+        const double innovation = measured - position;
+
+        const double s = covariance[0][0] + parameters.measurement_noise;
+        const double k0 = covariance[0][0] / s;
+        const double k1 = covariance[1][0] / s;
+        position += k0 * innovation;
+        velocity += k1 * innovation;
+
+        const double p00 = covariance[0][0], p01 = covariance[0][1];
+        covariance[0][0] = (1 - k0) * p00;
+        covariance[0][1] = (1 - k0) * p01;
+        covariance[1][0] -= k1 * p00;
+        covariance[1][1] -= k1 * p01;
+    }
+}
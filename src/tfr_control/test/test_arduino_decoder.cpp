@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+#include "arduino_decoder.h"
+
+using tfr_control::ArduinoFrameDecoder;
+using tfr_control::CountVelocityEstimator;
+
+namespace
+{
+    std::vector<uint8_t> countsFrame(uint32_t micros, int32_t first, int32_t second)
+    {
+        serial_protocol::CountsPayload counts;
+        counts.micros = micros;
+        counts.counts[0] = first;
+        counts.counts[1] = second;
+        std::vector<uint8_t> frame(serial_protocol::HEADER_SIZE + sizeof(counts) + 1);
+        frame.resize(serial_protocol::encode(serial_protocol::COUNTS, &counts, sizeof(counts), frame.data()));
+        return frame;
+    }
+
+    /*
+     * Feeds every byte, returns how many frames completed.
+     * */
+    int feed(ArduinoFrameDecoder& decoder, const std::vector<uint8_t>& bytes)
+    {
+        int completed = 0;
+        for (uint8_t byte : bytes)
+            if (decoder.push(byte))
+                completed++;
+        return completed;
+    }
+}
+
+TEST(ArduinoFrameDecoder, DecodesAFrame)
+{
+    ArduinoFrameDecoder decoder;
+    EXPECT_EQ(feed(decoder, countsFrame(1234, -5, 70000)), 1);
+    EXPECT_EQ(decoder.getType(), serial_protocol::COUNTS);
+    ASSERT_EQ(decoder.getLength(), sizeof(serial_protocol::CountsPayload));
+    serial_protocol::CountsPayload counts;
+    std::memcpy(&counts, decoder.getPayload(), sizeof(counts));
+    EXPECT_EQ(counts.micros, 1234u);
+    EXPECT_EQ(counts.counts[0], -5);
+    EXPECT_EQ(counts.counts[1], 70000);
+    EXPECT_EQ(decoder.getFrameCount(), 1u);
+    EXPECT_EQ(decoder.getErrorCount(), 0u);
+}
+
+TEST(ArduinoFrameDecoder, ResyncsAfterGarbage)
+{
+    ArduinoFrameDecoder decoder;
+    //noise, then a sync byte which goes nowhere, then a real frame
+    std::vector<uint8_t> bytes{0x00, 0x13, serial_protocol::SYNC_0, 0x42};
+    std::vector<uint8_t> frame = countsFrame(1, 2, 3);
+    bytes.insert(bytes.end(), frame.begin(), frame.end());
+    EXPECT_EQ(feed(decoder, bytes), 1);
+    EXPECT_EQ(decoder.getErrorCount(), 1u);
+}
+
+TEST(ArduinoFrameDecoder, RejectsABadChecksum)
+{
+    ArduinoFrameDecoder decoder;
+    std::vector<uint8_t> frame = countsFrame(1, 2, 3);
+    frame[serial_protocol::HEADER_SIZE] ^= 0x01;
+    EXPECT_EQ(feed(decoder, frame), 0);
+    EXPECT_EQ(decoder.getErrorCount(), 1u);
+    //and carries on with the next one
+    EXPECT_EQ(feed(decoder, countsFrame(1, 2, 3)), 1);
+}
+
+TEST(ArduinoFrameDecoder, RejectsAnOversizedLength)
+{
+    ArduinoFrameDecoder decoder;
+    std::vector<uint8_t> bytes{serial_protocol::SYNC_0, serial_protocol::SYNC_1,
+        serial_protocol::COUNTS, serial_protocol::MAX_PAYLOAD + 1};
+    EXPECT_EQ(feed(decoder, bytes), 0);
+    EXPECT_EQ(decoder.getErrorCount(), 1u);
+    EXPECT_EQ(feed(decoder, countsFrame(1, 2, 3)), 1);
+}
+
+TEST(CountVelocityEstimator, MeasuresOverTheWindow)
+{
+    CountVelocityEstimator estimator{0.02};
+    //1000 counts/s, a sample every 4ms
+    for (uint32_t i = 0; i <= 20; i++)
+        estimator.update(static_cast<int32_t>(i * 4), i * 4000);
+    EXPECT_NEAR(estimator.getVelocity(), 1000, 1e-6);
+    EXPECT_EQ(estimator.getCount(), 80);
+}
+
+TEST(CountVelocityEstimator, SurvivesRollover)
+{
+    CountVelocityEstimator estimator{0.02};
+    //both the counts and micros() wrap mid stream
+    const int32_t start_count = 2147483647 - 20;
+    const uint32_t start_micros = 4294967295u - 10000;
+    for (uint32_t i = 0; i <= 10; i++)
+        estimator.update(static_cast<int32_t>(static_cast<uint32_t>(start_count) + i * 8),
+                start_micros + i * 4000);
+    EXPECT_NEAR(estimator.getVelocity(), 2000, 1e-6);
+}
+
+TEST(CountVelocityEstimator, NeedsTimeToPass)
+{
+    CountVelocityEstimator estimator{0.02};
+    //a single sample spans no time
+    EXPECT_DOUBLE_EQ(estimator.update(0, 0), 0);
+    estimator.update(-10, 10000);
+    EXPECT_NEAR(estimator.getVelocity(), -1000, 1e-6);
+    //a repeated stamp still measures from the oldest sample
+    EXPECT_NEAR(estimator.update(-10, 10000), -1000, 1e-6);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
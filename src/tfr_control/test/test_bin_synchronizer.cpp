@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include "bin_synchronizer.h"
+
+using tfr_control::BinSynchronizer;
+
+namespace
+{
+    const BinSynchronizer::Limits limits{0.5, 1.0, 4.0, 0.02, 0.3, 0.15, 0.4, 0.05};
+    const double dt = 0.02;
+
+    /*
+     * One servo cylinder, following its set-point at up to max_velocity.
+     * */
+    struct Cylinder
+    {
+        double position;
+        double max_velocity;
+
+        void follow(double set_point)
+        {
+            const double step = max_velocity * dt;
+            position += std::min(std::max(set_point - position, -step), step);
+        }
+    };
+
+    /*
+     * Runs a move until it ends or timeout, returns how it ended.
+     * */
+    BinSynchronizer::Status run(BinSynchronizer& synchronizer, Cylinder& left, Cylinder& right,
+            double timeout)
+    {
+        BinSynchronizer::Command command;
+        for (double t = 0; t < timeout; t += dt)
+        {
+            const BinSynchronizer::Status status =
+                synchronizer.update(left.position, right.position, dt, command);
+            if (status != BinSynchronizer::MOVING)
+                return status;
+            left.follow(command.left);
+            right.follow(command.right);
+        }
+        return BinSynchronizer::MOVING;
+    }
+}
+
+TEST(BinSynchronizer, MovesBothSidesTogether)
+{
+    BinSynchronizer synchronizer{limits};
+    //from 1 to 5, 0.5 s at 1 rad/s^2 up to 0.5 rad/s, 7.5 s cruising, 0.5 s down
+    const double time = synchronizer.start(1.0, 1.0, 5.0);
+    EXPECT_NEAR(time, 8.5, 1e-9);
+
+    BinSynchronizer::Command command;
+    double last = 1.0;
+    for (double t = dt; t < time - dt / 2; t += dt)
+    {
+        ASSERT_EQ(synchronizer.update(last, last, dt, command), BinSynchronizer::MOVING);
+        EXPECT_DOUBLE_EQ(command.left, command.right);
+        EXPECT_GE(command.left, last);
+        EXPECT_LE(command.left - last, limits.max_velocity * dt + 1e-9);
+        last = command.left;
+    }
+    EXPECT_EQ(synchronizer.update(last, last, dt, command), BinSynchronizer::MOVING);
+    EXPECT_DOUBLE_EQ(command.left, 5.0);
+    EXPECT_EQ(synchronizer.update(5.0, 5.0, dt, command), BinSynchronizer::FINISHED);
+    EXPECT_DOUBLE_EQ(synchronizer.getMaxSkew(), 0);
+}
+
+TEST(BinSynchronizer, StartsFromTheAverage)
+{
+    BinSynchronizer synchronizer{limits};
+    synchronizer.start(1.1, 0.9, 5.0);
+    EXPECT_NEAR(synchronizer.getSkew(), 0.2, 1e-12);
+
+    //the first set-point is a step from 1.0, the left side gets held back
+    BinSynchronizer::Command command;
+    synchronizer.update(1.1, 0.9, dt, command);
+    EXPECT_NEAR(command.right, 1.0, 1e-3);
+    EXPECT_NEAR(command.left, command.right - limits.max_trim, 1e-12);
+}
+
+TEST(BinSynchronizer, InsideTheDeadbandNothingIsTrimmed)
+{
+    BinSynchronizer synchronizer{limits};
+    synchronizer.start(1.0, 1.0, 5.0);
+    BinSynchronizer::Command command;
+    synchronizer.update(1.01, 1.0, 1.0, command);
+    EXPECT_DOUBLE_EQ(command.left, command.right);
+}
+
+TEST(BinSynchronizer, TrimsTheSideAheadWhileExtending)
+{
+    BinSynchronizer synchronizer{limits};
+    synchronizer.start(1.0, 1.0, 5.0);
+    BinSynchronizer::Command command;
+
+    //0.05 of skew is 0.03 over the deadband, 0.12 of trim
+    synchronizer.update(2.05, 2.0, 2.0, command);
+    EXPECT_NEAR(command.right - command.left, 0.12, 1e-9);
+
+    synchronizer.update(2.5, 2.55, dt, command);
+    EXPECT_NEAR(command.left - command.right, 0.12, 1e-9);
+}
+
+TEST(BinSynchronizer, TrimsTheSideAheadWhileRetracting)
+{
+    BinSynchronizer synchronizer{limits};
+    synchronizer.start(5.0, 5.0, 1.0);
+    BinSynchronizer::Command command;
+
+    //going down the lower side is ahead, and its set-point is raised
+    synchronizer.update(3.95, 4.0, 2.0, command);
+    EXPECT_NEAR(command.left - command.right, 0.12, 1e-9);
+
+    synchronizer.update(3.5, 3.45, dt, command);
+    EXPECT_NEAR(command.right - command.left, 0.12, 1e-9);
+}
+
+TEST(BinSynchronizer, SlowSideIsWaitedFor)
+{
+    BinSynchronizer synchronizer{limits};
+    synchronizer.start(1.0, 1.0, 5.0);
+    BinSynchronizer::Command command;
+    synchronizer.update(1.0, 1.0, 2.0, command);
+    const double set_point = command.right;
+
+    //past hold_skew the profile stops where it is
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(synchronizer.update(2.0, 1.8, dt, command), BinSynchronizer::MOVING);
+        EXPECT_DOUBLE_EQ(command.right, set_point);
+    }
+
+    //and carries on once the skew is back under it
+    synchronizer.update(2.0, 1.9, dt, command);
+    EXPECT_GT(command.right, set_point);
+}
+
+TEST(BinSynchronizer, CorrectsALaggingSide)
+{
+    //the right cylinder is a quarter slower than the profile wants
+    BinSynchronizer synchronizer{limits};
+    Cylinder left{1.0, 1.0}, right{1.0, limits.max_velocity * 0.75};
+    synchronizer.start(left.position, right.position, 5.0);
+
+    EXPECT_EQ(run(synchronizer, left, right, 30), BinSynchronizer::FINISHED);
+    EXPECT_LE(synchronizer.getMaxSkew(), limits.hold_skew + limits.max_velocity * dt);
+    EXPECT_NEAR(left.position, 5.0, limits.position_tolerance);
+    EXPECT_NEAR(right.position, 5.0, limits.position_tolerance);
+}
+
+TEST(BinSynchronizer, FinishesOnlyOnceBothSidesSettle)
+{
+    BinSynchronizer synchronizer{limits};
+    const double time = synchronizer.start(1.0, 1.0, 2.0);
+    BinSynchronizer::Command command;
+
+    //the profile is over, but the right side is still short of the target
+    EXPECT_EQ(synchronizer.update(2.0, 1.9, time + 1, command), BinSynchronizer::MOVING);
+    EXPECT_EQ(synchronizer.update(2.0, 1.96, dt, command), BinSynchronizer::FINISHED);
+
+    //and not before the profile is over, wherever the sides are
+    BinSynchronizer early{limits};
+    early.start(1.0, 1.0, 2.0);
+    EXPECT_EQ(early.update(2.0, 2.0, dt, command), BinSynchronizer::MOVING);
+}
+
+TEST(BinSynchronizer, FaultHoldsBothSidesWhereTheyAre)
+{
+    BinSynchronizer synchronizer{limits};
+    synchronizer.start(1.0, 1.0, 5.0);
+    BinSynchronizer::Command command;
+    synchronizer.update(1.0, 1.0, 1.0, command);
+
+    EXPECT_EQ(synchronizer.update(2.0, 1.5, dt, command), BinSynchronizer::FAULT);
+    EXPECT_DOUBLE_EQ(command.left, 2.0);
+    EXPECT_DOUBLE_EQ(command.right, 1.5);
+    EXPECT_DOUBLE_EQ(synchronizer.getSkew(), 0.5);
+    EXPECT_DOUBLE_EQ(synchronizer.getMaxSkew(), 0.5);
+}
+
+TEST(BinSynchronizer, StalledSideHoldsTheMove)
+{
+    //the right cylinder doesn't move at all, the left one waits for it
+    //rather than racking the bin, until the control server times out
+    BinSynchronizer synchronizer{limits};
+    Cylinder left{1.0, 1.0}, right{1.0, 0.0};
+    synchronizer.start(left.position, right.position, 5.0);
+
+    EXPECT_EQ(run(synchronizer, left, right, 30), BinSynchronizer::MOVING);
+    EXPECT_LE(synchronizer.getMaxSkew(), limits.hold_skew + limits.max_velocity * dt);
+    EXPECT_LT(left.position, 1.0 + limits.fault_skew);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
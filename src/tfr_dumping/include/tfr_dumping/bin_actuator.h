@@ -0,0 +1,79 @@
+/****************************************************************************************
+ * File:            bin_actuator.h
+ *
+ * Purpose:         Follows one of the bin's servo cylinders (device77 and
+ *                  device88) after it is commanded, and says when it is done
+ *                  moving, so dumping can go on as soon as the hardware is
+ *                  instead of after a fixed sleep.
+ *
+ *                  An actuator has reached its target once the statusword's
+ *                  target reached bit (bit 10) is set, its position is within
+ *                  position_tolerance of the target and it has stood still for
+ *                  settle_time. One that stands still short of its target while
+ *                  pushing with at least stall_torque has stalled, the bin is
+ *                  against something. Either way it is done. For the first
+ *                  min_time after a command the status is ignored, the drive
+ *                  still reports on the last target then.
+ *
+ *                  Velocity is in the drive's own units, torque in per mille
+ *                  of its rated torque, position in drive radians.
+ ***************************************************************************************/
+#ifndef BIN_ACTUATOR_H
+#define BIN_ACTUATOR_H
+
+#include <cstdint>
+
+class BinActuator
+{
+public:
+    struct Settle
+    {
+        double position_tolerance;
+        double velocity_tolerance;
+        double settle_time;
+        double stall_torque;
+        double min_time;
+    };
+
+    enum Status
+    {
+        IDLE,
+        MOVING,
+        REACHED,
+        STALLED,
+    };
+
+    explicit BinActuator(const Settle& settle);
+    ~BinActuator() = default;
+    BinActuator(const BinActuator&) = delete;
+    BinActuator& operator=(const BinActuator&) = delete;
+    BinActuator(BinActuator&&) = delete;
+    BinActuator& operator=(BinActuator&&) = delete;
+
+    void command(double target, double time);
+
+    void updateStatusword(uint16_t statusword);
+    void updatePosition(double position);
+    void updateVelocity(double velocity, double time);
+    void updateTorque(double torque);
+
+    Status getStatus(double time) const;
+
+    double getPosition() const;
+
+private:
+    Settle settle;
+    bool commanded;
+    double target;
+    double command_time;
+
+    // feedback that hasn't been heard from isn't waited on, except velocity
+    bool have_statusword, have_position, have_velocity;
+    bool target_reached;
+    double position;
+    double torque;
+    bool still;
+    double still_since;
+};
+
+#endif // BIN_ACTUATOR_H
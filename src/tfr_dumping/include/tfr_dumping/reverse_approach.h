@@ -0,0 +1,65 @@
+/****************************************************************************************
+ * File:            reverse_approach.h
+ *
+ * Purpose:         Backs the robot up to the bin as a closed loop controller,
+ *                  run at a fixed rate.
+ *
+ *                  The distance left is the fiducial distance to the bin less
+ *                  standoff (half the robot plus an adjustment). While the
+ *                  fiducial is fresh it is used as is. Once it goes stale, for
+ *                  example when the marker leaves the camera's view close in,
+ *                  the distance driven on the fused odometry since the last
+ *                  fiducial is taken off instead. The speed is proportional to
+ *                  the distance left, between min_speed and max_speed, and the
+ *                  approach is done once it is within tolerance.
+ ***************************************************************************************/
+#ifndef REVERSE_APPROACH_H
+#define REVERSE_APPROACH_H
+
+class ReverseApproach
+{
+public:
+    struct Gains
+    {
+        double kp;              // 1/s
+        double max_speed;       // m/s
+        double min_speed;       // m/s
+        double tolerance;       // m
+        double fiducial_timeout;// s
+        double standoff;        // m
+    };
+
+    explicit ReverseApproach(const Gains& gains);
+    ~ReverseApproach() = default;
+    ReverseApproach(const ReverseApproach&) = delete;
+    ReverseApproach& operator=(const ReverseApproach&) = delete;
+    ReverseApproach(ReverseApproach&&) = delete;
+    ReverseApproach& operator=(ReverseApproach&&) = delete;
+
+    /*
+     * Starts from odometry position x, y with the bin fiducial_distance away.
+     * */
+    void start(double x, double y, double fiducial_distance, double time);
+
+    void updateFiducial(double fiducial_distance, double time);
+
+    /*
+     * Takes the odometry position, returns the forward velocity to command,
+     * negative to back up and zero once done.
+     * */
+    double update(double x, double y, double time);
+
+    bool isDone() const;
+    double getRemaining() const;
+
+private:
+    Gains gains;
+    // where the last fiducial was seen, and what was left to go from there
+    double anchor_x, anchor_y, anchor_remaining;
+    double fiducial_distance, fiducial_time;
+    bool fiducial_fresh;
+    double remaining;
+    bool done;
+};
+
+#endif // REVERSE_APPROACH_H
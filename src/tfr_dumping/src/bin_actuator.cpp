@@ -0,0 +1,71 @@
+#include "bin_actuator.h"
+
+#include <algorithm>
+#include <cmath>
+
+BinActuator::BinActuator(const Settle& s) :
+    settle{s}, commanded{false}, target{0}, command_time{0},
+    have_statusword{false}, have_position{false}, have_velocity{false},
+    target_reached{false}, position{0}, torque{0}, still{false}, still_since{0}
+{
+}
+
+void BinActuator::command(double t, double time)
+{
+    commanded = true;
+    target = t;
+    command_time = time;
+}
+
+void BinActuator::updateStatusword(uint16_t statusword)
+{
+    const uint16_t TARGET_REACHED = 1 << 10;
+    have_statusword = true;
+    target_reached = (statusword & TARGET_REACHED) != 0;
+}
+
+void BinActuator::updatePosition(double p)
+{
+    have_position = true;
+    position = p;
+}
+
+void BinActuator::updateVelocity(double velocity, double time)
+{
+    have_velocity = true;
+    const bool now_still = std::abs(velocity) <= settle.velocity_tolerance;
+    if (now_still && !still)
+        still_since = time;
+    still = now_still;
+}
+
+void BinActuator::updateTorque(double t)
+{
+    torque = t;
+}
+
+BinActuator::Status BinActuator::getStatus(double time) const
+{
+    if (!commanded)
+        return IDLE;
+    //without a velocity there is no telling it stopped
+    if (time - command_time < settle.min_time || !have_velocity || !still)
+        return MOVING;
+    //it has to have stopped since the command, not before it
+    const double still_for = time - std::max(still_since, command_time + settle.min_time);
+    if (still_for < settle.settle_time)
+        return MOVING;
+
+    const bool at_target = (!have_statusword || target_reached) &&
+        (!have_position || std::abs(position - target) <= settle.position_tolerance);
+    if (at_target)
+        return REACHED;
+    if (std::abs(torque) >= settle.stall_torque)
+        return STALLED;
+    return MOVING;
+}
+
+double BinActuator::getPosition() const
+{
+    return position;
+}
@@ -1,36 +1,81 @@
 /*
- * First checks fiducual odometry for distance from dumping location
+ * Dumps the bin as a state machine that goes on as soon as the hardware is
+ * done, rather than after fixed sleeps.
  *
- * Next, checks drivebase odometry distance
+ * First waits for the robot to stand still, so the fiducial distance to the
+ * dumping location is as accurate as possible.
  *
- * Then, moves backwards until the displacement of the drivebase odometry
- * is greater than or equal to the original distance from the dumping
- * location according to fiducial odometry.
+ * Then backs up to the dumping location, as a closed loop controller on the
+ * fused odometry and fiducial distance (see reverse_approach.h).
  *
- * Next, Raises bin.
+ * Next, raises the bin through the bin action of the control node, which moves
+ * both actuators together (see tfr_control/bin_control_server.h). Once that
+ * is done and both actuators have settled (see bin_actuator.h), or either of
+ * them stalls, holds it up for ~bin/dump_dwell so the regolith slides out, and
+ * lowers it again.
  *
- * FInally, lowers bin
+ * Every step has a timeout. A bin that doesn't finish raising is lowered
+ * anyway, one that doesn't finish lowering aborts the dump.
+ *
+ * PARAMETERS
+ * - ~half_robot_length: (float, default 0)
+ * - ~adjust_distance: added to half_robot_length as the stand off from the
+ *                     dumping location (float, default 0)
+ * - ~odometry: the fused odometry topic (string, default /odometry/filtered)
+ * - ~rate: how fast the state machine and approach controller run in hz (double, default 20)
+ * - ~still_time: how long the robot has to stand still before the fiducial
+ *                distance is taken (double, default 0.5)
+ * - ~still_timeout: most time spent waiting for that (double, default 4)
+ * - ~approach/kp, max_speed, min_speed, tolerance, fiducial_timeout:
+ *                     see reverse_approach.h (double, default 0.5, 0.1, 0.03, 0.02, 0.5)
+ * - ~approach/timeout: (double, default 30)
+ * - /bin/raised, lowered: bin actuator positions in drive radians, shared with
+ *                     the control node (double, default 5.0, 1.0)
+ * - ~bin/dump_dwell: how long the bin is held up in seconds (double, default 10)
+ * - ~bin/position_tolerance, velocity_tolerance, settle_time, stall_torque, min_time:
+ *                     see bin_actuator.h (double, default 0.05, 100, 0.3, 500, 0.3)
+ * - ~bin/timeout: most time a raise or lower can take (double, default 15)
+ *
+ * SUBSCRIBED TOPICS
+ * - /fiducial_odom (nav_msgs/Odometry) distance to the dumping location
+ * - ~odometry (nav_msgs/Odometry) fused odometry
+ * - /device77/..., /device88/...: get_statusword (std_msgs/UInt16),
+ *   get_joint_state (sensor_msgs/JointState), get_velocity_actual_value
+ *   (std_msgs/Int32), get_torque_actual_value (std_msgs/Int16) of the bin
+ *   actuators
  *
  * published topic: -/cmd_vel geometry_msgs/Twist the drivebase velocity
+ *
+ * action client: - bin (tfr_msgs/Bin) moves the bin
  * */
 
 #include <actionlib/client/simple_action_client.h>
 #include <actionlib/server/simple_action_server.h>
+#include <boost/bind.hpp>
 #include <geometry_msgs/Twist.h>
 #include <image_transport/image_transport.h>
 #include <math.h>
 #include <nav_msgs/Odometry.h>
 #include <ros/ros.h>
 #include <sensor_msgs/Image.h>
+#include <sensor_msgs/JointState.h>
 #include <std_msgs/Float64.h>
+#include <std_msgs/Int16.h>
 #include <std_msgs/Int32.h>
+#include <std_msgs/UInt16.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <tfr_msgs/ArucoAction.h>
+#include <tfr_msgs/BinAction.h>
 #include <tfr_msgs/BinStateSrv.h>
 #include <tfr_msgs/EmptyAction.h>
 #include <tfr_msgs/WrappedImage.h>
-#include <tfr_utilities/arm_manipulator.h>
 #include <tfr_utilities/control_code.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "bin_actuator.h"
+#include "reverse_approach.h"
 
 
 
@@ -38,12 +83,37 @@ class Dumper {
 public:
 
   Dumper(ros::NodeHandle &node, const std::string &service_name, const float half_robot_length, const float adjust_distance, const std::string odometry):
-         arm_manipulator{node},
          server{node, "dump", boost::bind(&Dumper::dumpBinContents, this, _1), false},
-         half_robot_length{half_robot_length}, adjust_distance{adjust_distance},
          drivebase_publisher{node.advertise<geometry_msgs::Twist>("cmd_vel", 5)},
          fiducialOdomSubscriber{node.subscribe("/fiducial_odom", 5, &Dumper::fiducialOdomCallback, this)},
-         odomSubscriber{node.subscribe("/odometry/filtered", 5, &Dumper::odomCallback, this)} {
+         odomSubscriber{node.subscribe(odometry.empty() ? "/odometry/filtered" : odometry, 5, &Dumper::odomCallback, this)},
+         bin_client{node, "bin", true},
+         gains{loadGains(half_robot_length + adjust_distance)},
+         settle{loadSettle()} {
+            ros::param::param<double>("~rate", rate, 20.0);
+            ros::param::param<double>("~still_time", still_time, 0.5);
+            ros::param::param<double>("~still_timeout", still_timeout, 4.0);
+            ros::param::param<double>("~approach/timeout", approach_timeout, 30.0);
+            ros::param::param<double>("/bin/raised", bin_raised, 5.0);
+            ros::param::param<double>("/bin/lowered", bin_lowered, 1.0);
+            ros::param::param<double>("~bin/dump_dwell", dump_dwell, 10.0);
+            ros::param::param<double>("~bin/timeout", bin_timeout, 15.0);
+
+            // the bin actuators, left then right
+            const char* const devices[] = {"/device77", "/device88"};
+            for (size_t bin = 0; bin < BINS; bin++) {
+              bins.emplace_back(new BinActuator{settle});
+              const std::string device{devices[bin]};
+              bin_subscribers.push_back(node.subscribe<std_msgs::UInt16>(device + "/get_statusword", 5,
+                  boost::bind(&Dumper::statuswordCallback, this, _1, bin)));
+              bin_subscribers.push_back(node.subscribe<sensor_msgs::JointState>(device + "/get_joint_state", 5,
+                  boost::bind(&Dumper::binPositionCallback, this, _1, bin)));
+              bin_subscribers.push_back(node.subscribe<std_msgs::Int32>(device + "/get_velocity_actual_value", 5,
+                  boost::bind(&Dumper::binVelocityCallback, this, _1, bin)));
+              bin_subscribers.push_back(node.subscribe<std_msgs::Int16>(device + "/get_torque_actual_value", 5,
+                  boost::bind(&Dumper::binTorqueCallback, this, _1, bin)));
+            }
+
             ROS_INFO("dumping action server initializing");
             server.start();
             ROS_INFO("dumping action server initialized");
@@ -57,104 +127,314 @@ public:
 
 
 private:
+  enum class DumpState {
+    SETTLING,
+    APPROACHING,
+    STOPPING,
+    RAISING,
+    DUMPING,
+    LOWERING,
+    DONE,
+  };
+
+  static const size_t BINS = 2;
+
   actionlib::SimpleActionServer<tfr_msgs::EmptyAction> server;
 
   ros::Publisher drivebase_publisher;
 
   ros::Subscriber fiducialOdomSubscriber;
   ros::Subscriber odomSubscriber;
+  std::vector<ros::Subscriber> bin_subscribers;
 
-  float half_robot_length, adjust_distance;
-  float currentFiducialDistance, originalFiducialDistance;
-  float currDistanceX, currDistanceY, actualCurrDistance, actualOriginalDistance;
-  float movedDistance = 0;
+  actionlib::SimpleActionClient<tfr_msgs::BinAction> bin_client;
 
-  geometry_msgs::Twist move_cmd{};
+  const ReverseApproach::Gains gains;
+  const BinActuator::Settle settle;
+  double rate, still_time, still_timeout, approach_timeout;
+  double bin_raised, bin_lowered, bin_timeout, dump_dwell;
 
-  ArmManipulator arm_manipulator;
+  // written by the callbacks, read by the state machine
+  std::mutex feedback_mutex;
+  bool have_fiducial = false;
+  double fiducial_distance = 0, fiducial_time = 0;
+  bool have_odometry = false;
+  double odom_x = 0, odom_y = 0;
+  bool robot_still = false;
+  double still_since = 0;
+  std::vector<std::unique_ptr<BinActuator>> bins;
 
+  geometry_msgs::Twist move_cmd{};
 
 
-  // continually upddating but only needed to set original fiducial distance
-  void fiducialOdomCallback(const nav_msgs::Odometry &dumpDistance) {
-    this->currentFiducialDistance = dumpDistance.pose.pose.position.x;
+  static ReverseApproach::Gains loadGains(double standoff) {
+    ReverseApproach::Gains gains;
+    ros::param::param<double>("~approach/kp", gains.kp, 0.5);
+    ros::param::param<double>("~approach/max_speed", gains.max_speed, 0.1);
+    ros::param::param<double>("~approach/min_speed", gains.min_speed, 0.03);
+    ros::param::param<double>("~approach/tolerance", gains.tolerance, 0.02);
+    ros::param::param<double>("~approach/fiducial_timeout", gains.fiducial_timeout, 0.5);
+    gains.standoff = standoff;
+    return gains;
   }
 
-  // continually updating actualCurrentTreadDistance so we can know how far the robot has moved
-  void odomCallback(const nav_msgs::Odometry &distance) {
-    this->currDistanceX = distance.pose.pose.position.x;
-    this->currDistanceY = distance.pose.pose.position.y;
-    // distance formula
-    this->actualCurrDistance = sqrt((this->currDistanceX * this->currDistanceX) +
-                              (this->currDistanceY * this->currDistanceY));
-    // this was done because I think the distance formula was resulting in the wrong sign,
-    // so I just flipped it
-    this->actualCurrDistance = -this->actualCurrDistance;
+  static BinActuator::Settle loadSettle() {
+    BinActuator::Settle settle;
+    ros::param::param<double>("~bin/position_tolerance", settle.position_tolerance, 0.05);
+    ros::param::param<double>("~bin/velocity_tolerance", settle.velocity_tolerance, 100);
+    ros::param::param<double>("~bin/settle_time", settle.settle_time, 0.3);
+    ros::param::param<double>("~bin/stall_torque", settle.stall_torque, 500);
+    ros::param::param<double>("~bin/min_time", settle.min_time, 0.3);
+    return settle;
   }
 
+  // the distance to the dumping location, while the marker is in view
+  void fiducialOdomCallback(const nav_msgs::Odometry &dumpDistance) {
+    std::lock_guard<std::mutex> lock{feedback_mutex};
+    have_fiducial = true;
+    fiducial_distance = dumpDistance.pose.pose.position.x;
+    fiducial_time = ros::Time::now().toSec();
+  }
 
+  // where the robot is, and whether it is standing still
+  void odomCallback(const nav_msgs::Odometry &odometry) {
+    const double now = ros::Time::now().toSec();
+    const bool still = std::abs(odometry.twist.twist.linear.x) < 0.02 &&
+                       std::abs(odometry.twist.twist.angular.z) < 0.05;
+    std::lock_guard<std::mutex> lock{feedback_mutex};
+    have_odometry = true;
+    odom_x = odometry.pose.pose.position.x;
+    odom_y = odometry.pose.pose.position.y;
+    if (still && !robot_still) {
+      still_since = now;
+    }
+    robot_still = still;
+  }
 
-  // moves backwards until the moved distance is equal to or greater than the original fiducial odometry distance
-  void moveNotBlind() {
-    ROS_INFO("Dumping Action Server: Command Recieved, BACKWARD");
-    move_cmd.linear.x = -.1;
-    drivebase_publisher.publish(move_cmd);
-
-    ROS_INFO("Original Odometry Distance starting at %f", this->actualOriginalDistance);
-    ROS_INFO("Original Fiducial Distance starting at %f", this->originalFiducialDistance);
-    ROS_INFO("Original Current Odometry Distance Starting at %f", this->actualCurrDistance);
+  void statuswordCallback(const std_msgs::UInt16::ConstPtr &statusword, size_t bin) {
+    std::lock_guard<std::mutex> lock{feedback_mutex};
+    bins[bin]->updateStatusword(statusword->data);
+  }
 
-    while (this->movedDistance < this->originalFiducialDistance) {
-      this->movedDistance = (this->actualOriginalDistance - this->actualCurrDistance) +
-                       this->half_robot_length + this->adjust_distance;
+  void binPositionCallback(const sensor_msgs::JointState::ConstPtr &state, size_t bin) {
+    if (state->position.empty()) {
+      return;
     }
+    std::lock_guard<std::mutex> lock{feedback_mutex};
+    bins[bin]->updatePosition(state->position[0]);
+  }
+
+  void binVelocityCallback(const std_msgs::Int32::ConstPtr &velocity, size_t bin) {
+    std::lock_guard<std::mutex> lock{feedback_mutex};
+    bins[bin]->updateVelocity(velocity->data, ros::Time::now().toSec());
+  }
 
-    ROS_INFO("Original Tread Distance Finished at %f", this->actualOriginalDistance);
-    ROS_INFO("Original Fiducial Distance Finished at %f", this->originalFiducialDistance);
-    ROS_INFO("Original Current Tread Distance Finished at %f", this->actualCurrDistance);
-    ROS_INFO("Dumping Action Server: BACKWARD finsihed");
+  void binTorqueCallback(const std_msgs::Int16::ConstPtr &torque, size_t bin) {
+    std::lock_guard<std::mutex> lock{feedback_mutex};
+    bins[bin]->updateTorque(torque->data);
   }
 
-  void stopMoving() {
-    ROS_INFO("Dumping Action Server: Command Recieved, STOP");
-    move_cmd.linear.x = 0;
+  void drive(double velocity) {
+    move_cmd.linear.x = velocity;
     drivebase_publisher.publish(move_cmd);
-    ROS_INFO("Dumping Action Server: STOP finshed");
   }
 
-  void extendBin() {
-    ROS_INFO("Dumping Action Server: Command Recieved, DUMP");
-    arm_manipulator.moveLeftBinPosition(5.0);  // Extend left bin actuator
-    arm_manipulator.moveRightBinPosition(5.0); // Extend right bin actuator
-    ROS_INFO("Dumping Action Server: DUMP finished");
+  // command is tfr_msgs::BinGoal::RAISE_BIN or LOWER_BIN, position where it ends up
+  void moveBin(uint8_t command, double position) {
+    {
+      std::lock_guard<std::mutex> lock{feedback_mutex};
+      const double now = ros::Time::now().toSec();
+      for (auto &bin : bins) {
+        bin->command(position, now);
+      }
+    }
+    tfr_msgs::BinGoal goal;
+    goal.command_code = command;
+    bin_client.sendGoal(goal);
+  }
+
+  // true once the bin move is over, failed if the bin control server gave up
+  // on it. A stalled actuator ends the move early.
+  bool binMoveDone(double now, bool &failed) {
+    const actionlib::SimpleClientGoalState goal_state = bin_client.getState();
+    failed = goal_state.isDone() && goal_state != actionlib::SimpleClientGoalState::SUCCEEDED;
+    if (failed) {
+      return true;
+    }
+    if (!binsSettled(now)) {
+      return false;
+    }
+    if (!goal_state.isDone()) {
+      bin_client.cancelGoal();
+    }
+    return true;
   }
 
-  void retractBin() {
-    ROS_INFO("Dumping Action Server: Command Recieved, RESET_DUMPING");
-    arm_manipulator.moveLeftBinPosition(1.0);  // Retract left bin actuator
-    arm_manipulator.moveRightBinPosition(1.0); // Retract right bin actuator
-    ROS_INFO("Dumping Action Server: DUMPING_RESET finished");
+  // true once both bin actuators reached their target or stalled
+  bool binsSettled(double now) {
+    std::lock_guard<std::mutex> lock{feedback_mutex};
+    for (size_t bin = 0; bin < BINS; bin++) {
+      const BinActuator::Status status = bins[bin]->getStatus(now);
+      if (status == BinActuator::MOVING || status == BinActuator::IDLE) {
+        return false;
+      }
+      if (status == BinActuator::STALLED) {
+        ROS_WARN("Dumping Action Server: bin actuator %lu stalled at %f", bin, bins[bin]->getPosition());
+      }
+    }
+    return true;
   }
 
   // where the actions of dumping are called
   void dumpBinContents(const tfr_msgs::EmptyGoalConstPtr &goal) {
-    // sleep makes sure robot is not moving so fiducial odom is accurate as possible
-    // when original fiducial distance is set
-    ros::Duration(4.0).sleep();
-
-    this->originalFiducialDistance = this->currentFiducialDistance;
-    this->actualOriginalDistance = this->actualCurrDistance;
-
-    moveNotBlind();
-
-    stopMoving();
-    ros::Duration(2.0).sleep();
+    ReverseApproach approach{gains};
+    double fed_fiducial_time = 0;
+    DumpState state = DumpState::SETTLING;
+    ros::Time state_start = ros::Time::now();
+    const ros::Time dump_start = state_start;
+    ros::Rate loop_rate(rate);
+
+    auto enter = [&](DumpState next) {
+      ROS_INFO("Dumping Action Server: %s finished after %.2f seconds", name(state),
+               (ros::Time::now() - state_start).toSec());
+      state = next;
+      state_start = ros::Time::now();
+    };
+
+    while (state != DumpState::DONE) {
+      if (server.isPreemptRequested() || !ros::ok()) {
+        drive(0);
+        if (state == DumpState::RAISING || state == DumpState::LOWERING) {
+          bin_client.cancelGoal();
+        }
+        ROS_INFO("Dumping Action Server: preempted while %s", name(state));
+        server.setPreempted();
+        return;
+      }
+
+      const double now = ros::Time::now().toSec();
+      const double in_state = (ros::Time::now() - state_start).toSec();
+
+      switch (state) {
+        case DumpState::SETTLING: {
+          // the fiducial distance is taken with the robot standing still
+          std::lock_guard<std::mutex> lock{feedback_mutex};
+          const bool settled = robot_still && now - still_since >= still_time;
+          if (settled || in_state >= still_timeout) {
+            if (!have_fiducial || !have_odometry) {
+              ROS_WARN("Dumping Action Server: no %s, can't find the dumping location",
+                       have_fiducial ? "odometry" : "fiducial");
+              server.setAborted();
+              return;
+            }
+            ROS_INFO("Dumping Action Server: fiducial distance %f", fiducial_distance);
+            approach.start(odom_x, odom_y, fiducial_distance, now);
+            fed_fiducial_time = fiducial_time;
+            enter(DumpState::APPROACHING);
+          }
+          break;
+        }
+        case DumpState::APPROACHING: {
+          double velocity;
+          {
+            std::lock_guard<std::mutex> lock{feedback_mutex};
+            // only new fixes, an old one would forget the driving since
+            if (fiducial_time > fed_fiducial_time) {
+              approach.updateFiducial(fiducial_distance, fiducial_time);
+              fed_fiducial_time = fiducial_time;
+            }
+            velocity = approach.update(odom_x, odom_y, now);
+          }
+          drive(velocity);
+          if (approach.isDone()) {
+            enter(DumpState::STOPPING);
+          } else if (in_state >= approach_timeout) {
+            drive(0);
+            ROS_WARN("Dumping Action Server: approach timed out %f m short", approach.getRemaining());
+            server.setAborted();
+            return;
+          }
+          break;
+        }
+        case DumpState::STOPPING: {
+          // the bin only goes up once the robot has stopped
+          drive(0);
+          bool stopped;
+          {
+            std::lock_guard<std::mutex> lock{feedback_mutex};
+            stopped = robot_still && now - still_since >= still_time;
+          }
+          if (stopped || in_state >= still_timeout) {
+            if (!bin_client.waitForServer(ros::Duration(1.0))) {
+              ROS_WARN("Dumping Action Server: no bin action server, can't dump");
+              server.setAborted();
+              return;
+            }
+            enter(DumpState::RAISING);
+            moveBin(tfr_msgs::BinGoal::RAISE_BIN, bin_raised);
+          }
+          break;
+        }
+        case DumpState::RAISING: {
+          // keeps hold of the drivebase, stopped, while the bin is up
+          drive(0);
+          bool failed;
+          const bool done = binMoveDone(now, failed);
+          if (done || in_state >= bin_timeout) {
+            if (failed || !done) {
+              ROS_WARN("Dumping Action Server: bin didn't finish raising, lowering it");
+              enter(DumpState::LOWERING);
+              moveBin(tfr_msgs::BinGoal::LOWER_BIN, bin_lowered);
+            } else {
+              enter(DumpState::DUMPING);
+            }
+          }
+          break;
+        }
+        case DumpState::DUMPING: {
+          // the bin stays up while the regolith slides out
+          drive(0);
+          if (in_state >= dump_dwell) {
+            enter(DumpState::LOWERING);
+            moveBin(tfr_msgs::BinGoal::LOWER_BIN, bin_lowered);
+          }
+          break;
+        }
+        case DumpState::LOWERING: {
+          drive(0);
+          bool failed;
+          if (binMoveDone(now, failed) && !failed) {
+            enter(DumpState::DONE);
+          } else if (failed || in_state >= bin_timeout) {
+            bin_client.cancelGoal();
+            ROS_WARN("Dumping Action Server: bin didn't finish lowering");
+            server.setAborted();
+            return;
+          }
+          break;
+        }
+        case DumpState::DONE:
+          break;
+      }
+
+      loop_rate.sleep();
+    }
 
-    extendBin();
-    ros::Duration(10.0).sleep();
+    ROS_INFO("Dumping Action Server: dumped in %.2f seconds", (ros::Time::now() - dump_start).toSec());
+    server.setSucceeded();
+  }
 
-    retractBin();
-    ros::Duration(10.0).sleep();
+  static const char *name(DumpState state) {
+    switch (state) {
+      case DumpState::SETTLING: return "SETTLING";
+      case DumpState::APPROACHING: return "APPROACHING";
+      case DumpState::STOPPING: return "STOPPING";
+      case DumpState::RAISING: return "RAISING";
+      case DumpState::DUMPING: return "DUMPING";
+      case DumpState::LOWERING: return "LOWERING";
+      case DumpState::DONE: return "DONE";
+    }
+    return "";
   }
 };
 
@@ -176,7 +456,8 @@ int main(int argc, char **argv) {
 
   Dumper dumper(n, service_name, half_robot_length, adjust_distance, odometry);
 
-  ros::Rate rate(10);
+  // the state machine runs in the action server's thread, and needs the
+  // feedback callbacks served while it does
   ros::spin();
   return 0;
 }
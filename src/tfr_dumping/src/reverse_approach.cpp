@@ -0,0 +1,61 @@
+#include "reverse_approach.h"
+
+#include <algorithm>
+#include <cmath>
+
+ReverseApproach::ReverseApproach(const Gains& g) :
+    gains{g}, anchor_x{0}, anchor_y{0}, anchor_remaining{0}, fiducial_distance{0},
+    fiducial_time{0}, fiducial_fresh{false}, remaining{0}, done{false}
+{
+}
+
+void ReverseApproach::start(double x, double y, double distance, double time)
+{
+    done = false;
+    fiducial_distance = distance;
+    fiducial_time = time;
+    fiducial_fresh = true;
+    anchor_x = x;
+    anchor_y = y;
+    anchor_remaining = remaining = distance - gains.standoff;
+}
+
+void ReverseApproach::updateFiducial(double distance, double time)
+{
+    fiducial_distance = distance;
+    fiducial_time = time;
+    fiducial_fresh = true;
+}
+
+double ReverseApproach::update(double x, double y, double time)
+{
+    if (done)
+        return 0;
+
+    if (fiducial_fresh && time - fiducial_time <= gains.fiducial_timeout)
+    {
+        //start over from the new fix
+        anchor_x = x;
+        anchor_y = y;
+        anchor_remaining = fiducial_distance - gains.standoff;
+    }
+    fiducial_fresh = false;
+    remaining = anchor_remaining - std::hypot(x - anchor_x, y - anchor_y);
+
+    if (remaining <= gains.tolerance)
+    {
+        done = true;
+        return 0;
+    }
+    return -std::max(gains.min_speed, std::min(gains.max_speed, gains.kp * remaining));
+}
+
+bool ReverseApproach::isDone() const
+{
+    return done;
+}
+
+double ReverseApproach::getRemaining() const
+{
+    return remaining;
+}
@@ -32,10 +32,16 @@
  * - ~hole: whether to place the hole or not (bool, default: true);
  * - ~navigation_from: whether to run from or not (bool, default: true);
  * - ~dumping: whether to run dumping or not (bool, default: true);
+ * - ~dump_at_mass: stop digging and go dump once the digging server's bin_fill
+ *                  estimate reaches this many kg, 0 digs for the whole digging
+ *                  time (double, default: 0);
  * 
  * PUBLISHED TOPICS
  * - /com 
  *   - the communication topic
+ *
+ * SUBSCRIBED TOPICS
+ * - bin_fill: the regolith dug since the last dump in kg (std_msgs/Float64)
  * */
 #include <ros/ros.h>
 #include <ros/console.h>
@@ -47,12 +53,14 @@
 #include <tfr_msgs/SetOdometry.h>
 #include <move_base_msgs/MoveBaseAction.h>
 #include <std_srvs/Empty.h>
+#include <std_msgs/Float64.h>
 #include <geometry_msgs/Twist.h>
 #include <tfr_utilities/location_codes.h>
 #include <tfr_utilities/status_code.h>
 #include <tfr_utilities/status_publisher.h>
 #include <actionlib/server/simple_action_server.h>
 #include <actionlib/client/simple_action_client.h>
+#include <atomic>
 
 class AutonomousExecutive
 {
@@ -69,7 +77,9 @@ class AutonomousExecutive
             frequency{f},
             status_publisher{n},
             drivebase_publisher{n.advertise<geometry_msgs::Twist>("cmd_vel", 5)},
-            moveClient{n, "move_base", true}
+            moveClient{n, "move_base", true},
+            binFillSubscriber{n.subscribe("bin_fill", 5, &AutonomousExecutive::binFillCallback, this)},
+            bin_fill{0}
             
         {
             ros::param::param<bool>("~localization_to", LOCALIZATION_TO, true);
@@ -97,6 +107,7 @@ class AutonomousExecutive
                 }
             }
             ros::param::param<bool>("~digging", DIGGING, true);
+            ros::param::param<double>("~dump_at_mass", DUMP_AT_MASS, 0.0);
             if (DIGGING)
             {
                 ROS_INFO("Autonomous Action Server: Connecting to digging server");
@@ -213,13 +224,19 @@ class AutonomousExecutive
                 tfr_msgs::DiggingGoal goal{};
                 ROS_INFO("Autonomous Action Server: retrieving digging time");
                 tfr_msgs::DurationSrv digging_time;
-                ros::service::call("digging_time", digging_time);
+                if (!ros::service::call("digging_time", digging_time))
+                {
+                    ROS_ERROR("Autonomous Action Server: could not get the digging time");
+                    server.setAborted();
+                    return;
+                }
                 ROS_INFO("Autonomous Action Server: digging time retreived %f",
                         digging_time.response.duration.toSec());
                 goal.diggingTime = digging_time.response.duration;
                 diggingClient.sendGoal(goal);
 
-                //handle preemption
+                //handle preemption, and stop early once the bin is full
+                bool bin_full = false;
                 while (!diggingClient.getState().isDone())
                 {
                     if (server.isPreemptRequested()  || !server.isActive() || ! ros::ok())
@@ -229,21 +246,24 @@ class AutonomousExecutive
                         ROS_INFO("Autonomous Action Server: digging preempted");
                         return;
                     }
+                    if (!bin_full && DUMP_AT_MASS > 0 && bin_fill >= DUMP_AT_MASS)
+                    {
+                        ROS_INFO("Autonomous Action Server: bin holds %.1f kg, going to dump",
+                                bin_fill.load());
+                        diggingClient.cancelGoal();
+                        bin_full = true;
+                    }
                     frequency.sleep();
                 }
-                if (diggingClient.getState()!=actionlib::SimpleClientGoalState::SUCCEEDED)
+                if (diggingClient.getState()!=actionlib::SimpleClientGoalState::SUCCEEDED &&
+                        !(bin_full && diggingClient.getState()==actionlib::SimpleClientGoalState::PREEMPTED))
                 {
                     ROS_INFO("Autonomous Action Server: digging failed");
                     server.setAborted();
                     return;
                 }
                 ROS_INFO("Autonomous Action Server: backing up");
-                geometry_msgs::Twist vel;
-                vel.linear.x = -.25;
-                drivebase_publisher.publish(vel);
-                ros::Duration(5.0).sleep();
-                vel.linear.x = 0;
-                drivebase_publisher.publish(vel);
+                driveFor(-.25, 5.0);
                 ROS_INFO("Autonomous Action Server: digging finished");
             }
             if (LOCALIZATION_FROM)
@@ -323,6 +343,8 @@ class AutonomousExecutive
                     return;
                 }
                 ROS_INFO("Autonomous Action Server: dumping finished");
+                std_srvs::Empty reset;
+                ros::service::call("reset_bin_fill", reset);
 
             }
             ROS_INFO("Autonomous Action Server: AUTONOMOUS MISSION SUCCESS");
@@ -394,17 +416,31 @@ class AutonomousExecutive
                 ros::service::call("/reset_fusion", empty);
            }
             ROS_INFO("Autonomous Action Server: forward localization");
-            geometry_msgs::Twist vel;
-            vel.linear.x = 0.25;
-            drivebase_publisher.publish(vel);
-            ros::Duration(1.15).sleep();
-            vel.linear.x = 0;
-            drivebase_publisher.publish(vel);
+            driveFor(0.25, 1.15);
             std_srvs::Empty req;
             ros::service::call("/move_base/clear_costmaps", req);
             ROS_INFO("Autonomous Action Server: localization finished");
         }
 
+        /*
+         * Drives straight at velocity for duration seconds, then stops. The
+         * command is repeated every preemption check, cmd_vel_mux stops the
+         * robot if it goes quiet for longer than its timeout.
+         * */
+        void driveFor(double velocity, double duration)
+        {
+            geometry_msgs::Twist vel;
+            vel.linear.x = velocity;
+            const ros::Time end = ros::Time::now() + ros::Duration(duration);
+            while (ros::ok() && ros::Time::now() < end)
+            {
+                drivebase_publisher.publish(vel);
+                frequency.sleep();
+            }
+            vel.linear.x = 0;
+            drivebase_publisher.publish(vel);
+        }
+
         actionlib::SimpleActionServer<tfr_msgs::EmptyAction> server;
         actionlib::SimpleActionClient<tfr_msgs::LocalizationAction> localizationClient;
         actionlib::SimpleActionClient<tfr_msgs::NavigationAction> navigationClient;
@@ -412,6 +448,15 @@ class AutonomousExecutive
         actionlib::SimpleActionClient<tfr_msgs::EmptyAction> dumpingClient;
         actionlib::SimpleActionClient<move_base_msgs::MoveBaseAction> moveClient;
 
+        ros::Subscriber binFillSubscriber;
+        //written by the subscriber, read by the mission
+        std::atomic<double> bin_fill;
+
+        void binFillCallback(const std_msgs::Float64 &msg)
+        {
+            bin_fill = msg.data;
+        }
+
        StatusPublisher status_publisher;
 
         bool LOCALIZATION_TO;
@@ -421,6 +466,7 @@ class AutonomousExecutive
         bool NAVIGATION_FROM;
         bool DIGGING;
         bool DUMPING;
+        double DUMP_AT_MASS;
         //how often to check for preemption
         ros::Duration frequency;
         ros::Publisher drivebase_publisher;
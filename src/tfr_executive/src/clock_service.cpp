@@ -6,6 +6,8 @@
  * - ~driving_time: The amount oftime we anticipate localization to take in seconds. (`float`, default 45)
  * - ~driving_time: The amount of time we anticipate driving to take seconds. (`float`, default 37)
  * - ~dumping_time: The amount of time we anticipate dumping to take in seconds.  (`float`, default 45)
+ * - ~digging_margin: Slack added to the digging queue's own estimate, in
+ *                    seconds. (`float`, default 30)
  * - ~mission_time: The amount of time we allocate for the mission in total 
  *                  seconds. (`float`, default: 600)
  * SERVICES  
@@ -13,9 +15,13 @@
  * 2. time_remaining: returns the amount of time remaining in the mission
  * 3. digging_time: Gives the digging time which is equal to  
  *                  (duration - start - driving_time - dumping_time) or 0 
- *                  if negative duration. 
+ *                  if negative duration, which tells the digging server to dig
+ *                  nothing. When the digging server has published
+ *                  /digging_queue_time and the queue needs less than that, the
+ *                  queue's own estimate plus digging_margin is given instead.
  * */
 #include <ros/ros.h>
+#include <algorithm>
 #include <cmath>
 #include <std_srvs/Empty.h>
 #include <tfr_msgs/DurationSrv.h>
@@ -24,7 +30,8 @@ class ClockService
 {
     public:
         ClockService(ros::NodeHandle &n, ros::Duration& mission, 
-                ros::Duration& localization, ros::Duration& driving, ros::Duration& dumping):
+                ros::Duration& localization, ros::Duration& driving, ros::Duration& dumping,
+                ros::Duration& margin):
             start_mission{n.advertiseService("start_mission", &ClockService::startMission, this)},
             time_remaining{n.advertiseService("time_remaining", &ClockService::timeRemaining, this)},
             digging_time{n.advertiseService("digging_time", &ClockService::diggingTime , this)},
@@ -32,7 +39,8 @@ class ClockService
             mission_duration{mission},
             localization_duration{localization},
             driving_duration{driving},
-            dumping_duration{dumping}
+            dumping_duration{dumping},
+            digging_margin{margin}
         { }
 
         ~ClockService() = default;
@@ -82,6 +90,12 @@ class ClockService
                 - driving_duration 
                 - localization_duration
                 - dumping_duration;
+            res.duration = std::max(res.duration, ros::Duration{0});
+
+            double queue_time;
+            if (ros::param::getCached("/digging_queue_time", queue_time) &&
+                    queue_time > 0 && ros::Duration{queue_time} + digging_margin < res.duration)
+                res.duration = ros::Duration{queue_time} + digging_margin;
             return true;
         }
 
@@ -94,24 +108,27 @@ class ClockService
         ros::Duration localization_duration;
         ros::Duration driving_duration;
         ros::Duration dumping_duration;
+        ros::Duration digging_margin;
 };
 
 int main(int argc, char** argv)
 {
     ros::init(argc, argv, "clock_service");
     ros::NodeHandle n{};
-    double mission_time, driving_time, dumping_time, localization_time;
+    double mission_time, driving_time, dumping_time, localization_time, margin_time;
     ros::param::param<double>("~mission_time", mission_time, 600);
     ros::param::param<double>("~driving_time", driving_time, 35);
     ros::param::param<double>("~dumping_time", dumping_time, 45);
     ros::param::param<double>("~localization_time", localization_time, 45);
+    ros::param::param<double>("~digging_margin", margin_time, 30);
 
     ros::Duration 
         mission{mission_time}, 
         driving{driving_time},
         dumping{dumping_time}, 
-        localization{localization_time};
-    ClockService clock{n, mission, localization,  driving, dumping};
+        localization{localization_time},
+        margin{margin_time};
+    ClockService clock{n, mission, localization,  driving, dumping, margin};
     ros::spin();
     return 0;
 }
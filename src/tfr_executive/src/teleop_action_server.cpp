@@ -34,8 +34,10 @@
 #include <rosbag/bag.h>
 #include <tfr_utilities/teleop_code.h>
 #include <tfr_utilities/control_code.h>
+#include <tfr_utilities/tracer.h>
 #include <tfr_msgs/TeleopAction.h>
 #include <tfr_msgs/DiggingAction.h>
+#include <tfr_msgs/BinAction.h>
 #include <tfr_msgs/EmptySrv.h>
 #include <tfr_msgs/BinStateSrv.h>
 #include <tfr_msgs/ArmStateSrv.h>
@@ -82,6 +84,7 @@ class TeleopExecutive
             bin_publisher{n.advertise<std_msgs::Float64>("/bin_position_controller/command", 5)},
             digging_client{n, "dig"},
             arm_client{n, "move_arm", true},
+            bin_client{n, "bin", true},
             right_bin_pub{n.advertise<std_msgs::Int32>("/device12/set_cmd_cango/cmd_cango_3", 1)},
             left_bin_pub{n.advertise<std_msgs::Int32>("/device12/set_cmd_cango/cmd_cango_2", 1)},
             turntable_pub{n.advertise<std_msgs::Int32>("/device4/set_cmd_cango/cmd_cango_1", 1)},
@@ -152,12 +155,13 @@ class TeleopExecutive
          * This approach avoids additional threading beyond the action server, and should meet our response requirements.
          * 
          * ACTION MESSAGE
-         * - Goal: uint8 command
+         * - Goal: uint8 command, uint64 trace_flow
          * - Feedback: none
          * - Result: none
          * */
         void processCommand(const tfr_msgs::TeleopGoalConstPtr& goal)
         {
+            tfr_utilities::TraceSpan span{"teleop/process_command", "teleop", goal->trace_flow};
             geometry_msgs::Twist move_cmd{};
             auto code = static_cast<tfr_utilities::TeleopCode>(goal->code);
             switch(code)
@@ -269,7 +273,11 @@ class TeleopExecutive
                         tfr_msgs::DiggingGoal goal{};
                         ROS_INFO("Teleop Action Server: retrieving digging time");
                         tfr_msgs::DurationSrv digging_time;
-                        ros::service::call("digging_time", digging_time);
+                        if (!ros::service::call("digging_time", digging_time))
+                        {
+                            ROS_ERROR("Teleop Action Server: could not get the digging time, not digging");
+                            break;
+                        }
                         ROS_INFO("Teleop Action Server: digging time retreived %f",
                                 digging_time.response.duration.toSec());
                         goal.diggingTime = digging_time.response.duration;
@@ -294,20 +302,16 @@ class TeleopExecutive
                 case (tfr_utilities::TeleopCode::DUMP):
                     {
                         
-                        //TODO: Match the rate to avoid torquing the bin. 
                         ROS_INFO("Teleop Action Server: Command Recieved, DUMP");
-			            arm_manipulator.moveLeftBinPosition(5.0); // Extend left bin actuator
-			            arm_manipulator.moveRightBinPosition(5.0); // Extend right bin actuator
+                        moveBin(tfr_msgs::BinGoal::RAISE_BIN); // Extend both bin actuators together
                         ROS_INFO("Teleop Action Server: DUMP finished");
                         break;
                     }
 
                 case (tfr_utilities::TeleopCode::RESET_DUMPING):
                     {
-                        //TODO: Match the rate to avoid torquing the bin. 
                         ROS_INFO("Teleop Action Server: Command Recieved, RESET_DUMPING");
-                        arm_manipulator.moveLeftBinPosition(1.0); // Retract left bin actuator
-			            arm_manipulator.moveRightBinPosition(1.0); // Retract right bin actuator
+                        moveBin(tfr_msgs::BinGoal::LOWER_BIN); // Retract both bin actuators together
                         ROS_INFO("Teleop Action Server: DUMPING_RESET finished");
                         break;
                     }
@@ -382,9 +386,26 @@ class TeleopExecutive
             bag.write("motorAmpCh2", ros::Time::now(), msg);
         }
 
+        /*
+         * Starts raising or lowering the bin through the control node, which
+         * keeps both actuators level. Doesn't wait for it to finish.
+         * */
+        void moveBin(uint8_t command)
+        {
+            if (!bin_client.isServerConnected())
+            {
+                ROS_WARN("Teleop Action Server: bin action server not connected");
+                return;
+            }
+            tfr_msgs::BinGoal goal;
+            goal.command_code = command;
+            bin_client.sendGoal(goal);
+        }
+
         actionlib::SimpleActionServer<tfr_msgs::TeleopAction> server;
         actionlib::SimpleActionClient<tfr_msgs::DiggingAction> digging_client;
         actionlib::SimpleActionClient<tfr_msgs::ArmMoveAction> arm_client;
+        actionlib::SimpleActionClient<tfr_msgs::BinAction> bin_client;
         rosbag::Bag bag;
         ros::Subscriber lower_arm_torque_sub;
         int16_t lower_arm_torque;
@@ -421,6 +442,7 @@ int main(int argc, char** argv)
 {
     ros::init(argc, argv, "teleop_action_server");
     ros::NodeHandle n{};
+    tfr_utilities::Tracer::configureFromParams("teleop_action_server");
     double linear_velocity, angular_velocity, rate;
     bool use_digging; 
     ros::param::param<double>("~linear_velocity", linear_velocity, 0.25);
@@ -0,0 +1,141 @@
+/****************************************************************************************
+ * File:            gateway.h
+ *
+ * Purpose:         One end of the link between the robot and the operator station,
+ *                  without any ros or sockets so it can be driven by a test.
+ *
+ *                  Outgoing, it owns a TopicScheduler and paces it with a token
+ *                  bucket filled at the LinkMonitor's budget. Pings go out every
+ *                  ping_interval, and pongs and requests go out as soon as they
+ *                  are made, ahead of any topic, but still spend the budget.
+ *
+ *                  Incoming, it reassembles fragments, keeping only the newest
+ *                  message per topic (a fragment of a newer message abandons an
+ *                  older one), and undoes delta encoding. Every keyframe is
+ *                  acknowledged as it arrives. A message on a topic with no
+ *                  description yet, or a delta against a keyframe it no longer
+ *                  has, is dropped and the far end is asked for what was
+ *                  missing, at most every request_interval per topic.
+ *                  A reliable message is acknowledged once it is published, and
+ *                  again whenever it turns up after that, since the far end
+ *                  sends it until it hears so. One that could not be published
+ *                  yet is forgotten so its next copy gets another try.
+ *
+ *                  The far end sends a new session id when it restarts, which
+ *                  throws away everything learned about it.
+ *
+ *                  Not thread safe, the gateway node guards it.
+ ***************************************************************************************/
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "gateway_codec.h"
+#include "topic_scheduler.h"
+#include "link_monitor.h"
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace tfr_gateway
+{
+    struct GatewayOptions
+    {
+        //largest datagram, keep it under the radio's mtu
+        size_t mtu;
+        double ping_interval;
+        double request_interval;
+        //how long a reliable message waits for its acknowledgement
+        double retransmit_interval;
+        size_t keyframe_interval;
+        //seconds of budget the token bucket can save up
+        double burst;
+        uint32_t session;
+        LinkOptions link;
+    };
+
+    //a complete message or description from the far end
+    struct Incoming
+    {
+        PacketKind kind;
+        uint16_t topic;
+        std::vector<uint8_t> body;
+    };
+
+    class Gateway
+    {
+    public:
+        Gateway(const GatewayOptions& options, const std::vector<TopicConfig>& topics);
+        ~Gateway() = default;
+        Gateway(const Gateway&) = delete;
+        Gateway& operator=(const Gateway&) = delete;
+        Gateway(Gateway&&) = delete;
+        Gateway& operator=(Gateway&&) = delete;
+
+        void describe(uint16_t topic, const TopicDescription& description);
+        //returns false if it pushed an older message out of the queue
+        bool offer(uint16_t topic, std::vector<uint8_t> message);
+
+        //appends whatever the budget allows to go now
+        void poll(double now, std::vector<std::vector<uint8_t>>& packets);
+        //appends whatever the datagram completed
+        void receive(const uint8_t* data, size_t size, double now, std::vector<Incoming>& incoming);
+
+        LinkStats link(double now) const { return monitor.stats(now); }
+        const TopicScheduler& topics() const { return scheduler; }
+        //messages dropped on the way in, missing fragments or bases
+        uint64_t incomplete() const { return abandoned; }
+
+    private:
+        struct Assembly
+        {
+            uint32_t message;
+            uint16_t count;
+            uint16_t received;
+            std::vector<std::vector<uint8_t>> fragments;
+        };
+
+        struct Remote
+        {
+            bool described;
+            //newest last
+            std::deque<std::pair<uint32_t, std::vector<uint8_t>>> keyframes;
+            bool requested;
+            double last_request;
+            //the newest reliable message published
+            bool confirmed;
+            uint32_t last_confirmed;
+            Assembly message;
+            Assembly description;
+        };
+
+        const GatewayOptions options;
+        TopicScheduler scheduler;
+        LinkMonitor monitor;
+
+        uint32_t sequence;
+        double tokens;
+        double last_poll;
+        double last_ping;
+        bool polled;
+        std::vector<std::vector<uint8_t>> control;
+
+        bool peer_known;
+        uint32_t peer_session;
+        std::map<uint16_t, Remote> remotes;
+        uint64_t abandoned;
+
+        void probe(PacketKind kind, uint64_t time_us);
+        void request(uint16_t topic, uint8_t flags, Remote& remote, double now);
+        void acknowledge(uint16_t topic, uint8_t flag, uint32_t message);
+        void checkSession(uint32_t session);
+        bool assemble(Assembly& assembly, const FragmentHeader& fragment,
+                const uint8_t* data, size_t size, std::vector<uint8_t>& body);
+        //false if it had to drop the message
+        bool deliver(uint16_t topic, Remote& remote, std::vector<uint8_t> body, double now,
+                std::vector<Incoming>& incoming);
+    };
+}
+
+#endif
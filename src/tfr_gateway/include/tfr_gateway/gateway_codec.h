@@ -0,0 +1,193 @@
+/****************************************************************************************
+ * File:            gateway_codec.h
+ *
+ * Purpose:         The wire format spoken between the robot and station gateways.
+ *
+ *                  Every datagram starts with the same eight byte header:
+ *                      magic u16, kind u8, flags u8, sequence u32
+ *                  The sequence counts every datagram a gateway sends, so the
+ *                  other end can tell how many went missing.
+ *
+ *                  MESSAGE and DESCRIPTION datagrams carry one fragment of a
+ *                  larger body:
+ *                      topic u16, message u32, index u16, count u16, bytes
+ *                  A MESSAGE body is an Encoding byte, the id of the keyframe a
+ *                  delta was taken against, then the serialized ros message or
+ *                  the delta. A DESCRIPTION body names the topic and its type so
+ *                  the far end can advertise it. A MESSAGE fragment with
+ *                  MESSAGE_RELIABLE in its flags wants its message acknowledged.
+ *
+ *                  REQUEST datagrams carry a topic, with flags saying whether
+ *                  the description or a fresh keyframe is wanted, or that a
+ *                  keyframe or reliable message arrived, each followed by its
+ *                  message id in the order of the flags.
+ *                  PING and PONG carry a Probe.
+ *
+ *                  Everything is little endian.
+ ***************************************************************************************/
+#ifndef GATEWAY_CODEC_H
+#define GATEWAY_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tfr_gateway
+{
+    //first two bytes of every datagram, anything else on the port is ignored
+    constexpr uint16_t MAGIC = 0x5447;
+    constexpr size_t HEADER_SIZE = 8;
+    constexpr size_t FRAGMENT_HEADER_SIZE = 10;
+
+    enum class PacketKind : uint8_t
+    {
+        MESSAGE = 1,
+        DESCRIPTION = 2,
+        REQUEST = 3,
+        PING = 4,
+        PONG = 5,
+    };
+
+    enum RequestFlags : uint8_t
+    {
+        REQUEST_DESCRIPTION = 1,
+        REQUEST_KEYFRAME = 2,
+        KEYFRAME_RECEIVED = 4,
+        MESSAGE_RECEIVED = 8,
+    };
+
+    enum MessageFlags : uint8_t
+    {
+        //sent again until the far end says it arrived
+        MESSAGE_RELIABLE = 1,
+    };
+
+    //both ends remember this many of the latest keyframes per topic
+    constexpr size_t KEPT_KEYFRAMES = 4;
+
+    enum class Encoding : uint8_t
+    {
+        //the far end does not keep it
+        PLAIN = 0,
+        //kept by the far end as the base for the deltas after it
+        KEYFRAME = 1,
+        DELTA = 2,
+    };
+
+    struct PacketHeader
+    {
+        PacketKind kind;
+        uint8_t flags;
+        uint32_t sequence;
+    };
+
+    struct FragmentHeader
+    {
+        uint16_t topic;
+        uint32_t message;
+        uint16_t index;
+        uint16_t count;
+    };
+
+    /*
+     * Pings and pongs both carry what the sender has received so far, so
+     * each end learns how its own datagrams are faring from either one.
+     * A pong echoes the time from the ping it answers.
+     * */
+    struct Probe
+    {
+        //changes every time a gateway starts
+        uint32_t session;
+        uint64_t time_us;
+        uint64_t received_bytes;
+        uint32_t received_packets;
+        uint32_t highest_sequence;
+    };
+
+    //what the far end needs to advertise a topic it has never seen
+    struct TopicDescription
+    {
+        std::string name;
+        std::string datatype;
+        std::string md5sum;
+        std::string definition;
+        bool latching;
+    };
+
+    class ByteWriter
+    {
+    public:
+        explicit ByteWriter(std::vector<uint8_t>& out) : out(out) {}
+
+        void u8(uint8_t value) { out.push_back(value); }
+        void u16(uint16_t value);
+        void u32(uint32_t value);
+        void u64(uint64_t value);
+        void bytes(const uint8_t* data, size_t size);
+        void string(const std::string& value);
+
+    private:
+        std::vector<uint8_t>& out;
+    };
+
+    /*
+     * Reads past the end return zeros and clear ok(), so a parser can read a
+     * whole structure and check once at the end.
+     * */
+    class ByteReader
+    {
+    public:
+        ByteReader(const uint8_t* data, size_t size) :
+            data{data}, size{size}, offset{0}, good{true} {}
+
+        uint8_t u8();
+        uint16_t u16();
+        uint32_t u32();
+        uint64_t u64();
+        std::string string();
+
+        bool ok() const { return good; }
+        size_t remaining() const { return size - offset; }
+        const uint8_t* position() const { return data + offset; }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t offset;
+        bool good;
+
+        bool take(size_t count);
+    };
+
+    void writeHeader(ByteWriter& writer, const PacketHeader& header);
+    bool readHeader(ByteReader& reader, PacketHeader& header);
+
+    void writeFragment(ByteWriter& writer, const FragmentHeader& fragment);
+    bool readFragment(ByteReader& reader, FragmentHeader& fragment);
+
+    void writeProbe(ByteWriter& writer, const Probe& probe);
+    bool readProbe(ByteReader& reader, Probe& probe);
+
+    void encodeDescription(const TopicDescription& description, std::vector<uint8_t>& out);
+    bool decodeDescription(const std::vector<uint8_t>& body, TopicDescription& description);
+
+    /*
+     * Delta encoding works on the serialized message, so it needs no
+     * knowledge of the type. The message is xored against a keyframe of the
+     * same length, which leaves zeros wherever a field did not change, then
+     * each block of eight bytes is written as a mask of its nonzero bytes
+     * followed by just those bytes. Fixed layout numeric messages (odometry,
+     * joint states, costmaps) shrink to the fields that moved, an unchanged
+     * block costs one byte.
+     *
+     * The message and base must be the same length.
+     * */
+    void deltaEncode(const std::vector<uint8_t>& base, const std::vector<uint8_t>& message,
+            std::vector<uint8_t>& out);
+    //false if the delta does not fit the base
+    bool deltaDecode(const std::vector<uint8_t>& base, const uint8_t* delta, size_t size,
+            std::vector<uint8_t>& out);
+}
+
+#endif
@@ -0,0 +1,69 @@
+/****************************************************************************************
+ * File:            link_emulator.h
+ *
+ * Purpose:         A one way radio link in memory, for testing the gateways on one
+ *                  machine.
+ *
+ *                  Datagrams leave through a bottleneck of the given bandwidth
+ *                  with a buffer of queue_bytes in front of it, anything that
+ *                  does not fit in the buffer is dropped, the way a saturated
+ *                  radio behaves. Each one then takes latency plus up to jitter
+ *                  seconds to arrive, and a fraction loss of them never do.
+ *                  Jitter can reorder datagrams, like the real link.
+ *
+ *                  The link_emulator node runs two of these between a pair of
+ *                  udp sockets, the tests use them directly.
+ ***************************************************************************************/
+#ifndef LINK_EMULATOR_H
+#define LINK_EMULATOR_H
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace tfr_gateway
+{
+    struct EmulatorOptions
+    {
+        //seconds
+        double latency;
+        double jitter;
+        //bytes per second, 0 for no limit
+        double bandwidth;
+        double loss;
+        size_t queue_bytes;
+        uint32_t seed;
+    };
+
+    class LinkEmulator
+    {
+    public:
+        explicit LinkEmulator(const EmulatorOptions& options);
+        ~LinkEmulator() = default;
+        LinkEmulator(const LinkEmulator&) = delete;
+        LinkEmulator& operator=(const LinkEmulator&) = delete;
+        LinkEmulator(LinkEmulator&&) = delete;
+        LinkEmulator& operator=(LinkEmulator&&) = delete;
+
+        //false if the datagram was lost or did not fit in the buffer
+        bool send(std::vector<uint8_t> packet, double now);
+        //appends every datagram which has arrived by now
+        void deliver(double now, std::vector<std::vector<uint8_t>>& packets);
+
+        //bytes waiting for the bottleneck
+        double backlog(double now) const;
+        uint64_t dropped() const { return lost; }
+
+    private:
+        EmulatorOptions options;
+        std::mt19937 random;
+        std::uniform_real_distribution<double> uniform;
+        //when the bottleneck is free again
+        double free_at;
+        std::multimap<double, std::vector<uint8_t>> in_flight;
+        uint64_t lost;
+    };
+}
+
+#endif
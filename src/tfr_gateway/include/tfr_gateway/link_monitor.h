@@ -0,0 +1,117 @@
+/****************************************************************************************
+ * File:            link_monitor.h
+ *
+ * Purpose:         Measures the radio link and sets how fast the gateway may send.
+ *
+ *                  Round trip time comes from pings, smoothed, along with the
+ *                  lowest recent sample as the time an empty link takes. Every
+ *                  probe from the far end says how many of our datagrams it has
+ *                  seen and the highest sequence among them, which gives the
+ *                  loss and delivered throughput since the last one.
+ *
+ *                  The send budget (bytes per second) backs off to 80% when a
+ *                  round trip comes back congestion_delay over the lowest one,
+ *                  meaning datagrams are waiting in a queue somewhere, or
+ *                  when more than loss_threshold of them go missing, at most
+ *                  once every two round trips (half a second at least) so the
+ *                  queue can drain first. It grows by 1% (at least 500B/s) per
+ *                  probe while the link is clear and at least half the budget
+ *                  is being used, an idle gateway holds its budget where it is.
+ *
+ *                  Not thread safe, the gateway node guards it.
+ ***************************************************************************************/
+#ifndef LINK_MONITOR_H
+#define LINK_MONITOR_H
+
+#include "gateway_codec.h"
+#include <cstdint>
+
+namespace tfr_gateway
+{
+    struct LinkOptions
+    {
+        //bytes per second
+        double initial_rate;
+        double min_rate;
+        double max_rate;
+        //seconds of queueing on top of the lowest round trip before backing off
+        double congestion_delay;
+        double loss_threshold;
+        //seconds without a probe before the link counts as down
+        double timeout;
+    };
+
+    struct LinkStats
+    {
+        bool connected;
+        //seconds
+        double rtt;
+        double min_rtt;
+        double loss;
+        //bytes per second
+        double budget;
+        double send_rate;
+        double delivered_rate;
+        double receive_rate;
+    };
+
+    class LinkMonitor
+    {
+    public:
+        explicit LinkMonitor(const LinkOptions& options);
+        ~LinkMonitor() = default;
+        LinkMonitor(const LinkMonitor&) = delete;
+        LinkMonitor& operator=(const LinkMonitor&) = delete;
+        LinkMonitor(LinkMonitor&&) = delete;
+        LinkMonitor& operator=(LinkMonitor&&) = delete;
+
+        void sent(size_t bytes);
+        void received(uint32_t sequence, size_t bytes);
+
+        //what goes in our next ping or pong
+        Probe probe(uint32_t session, uint64_t time_us) const;
+
+        //a probe from the far end, ping or pong
+        void report(const Probe& probe, double now);
+        void roundTrip(double rtt, double now);
+
+        //the far end restarted, its counters start over
+        void restart();
+
+        double budget() const { return rate; }
+        LinkStats stats(double now) const;
+
+    private:
+        const LinkOptions options;
+        double rate;
+
+        double srtt;
+        double latest_rtt;
+        //lowest over the last ten to twenty seconds
+        double min_rtt;
+        double next_min_rtt;
+        double min_rtt_time;
+        double last_cut;
+        bool measured;
+
+        uint64_t sent_bytes;
+        uint64_t received_bytes;
+        uint32_t received_packets;
+        uint32_t highest_sequence;
+
+        //the last probe from the far end, and ours when it came
+        bool reported;
+        double heard;
+        double report_time;
+        Probe last_probe;
+        uint64_t sent_at_report;
+        uint64_t received_at_report;
+
+        double loss;
+        double send_rate;
+        double delivered_rate;
+        double receive_rate;
+    };
+}
+
+#endif
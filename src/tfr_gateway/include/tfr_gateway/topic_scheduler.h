@@ -0,0 +1,165 @@
+/****************************************************************************************
+ * File:            topic_scheduler.h
+ *
+ * Purpose:         Decides which topic gets the next datagram on the link.
+ *
+ *                  Each topic has a queue of serialized messages which drops its
+ *                  oldest message when full, so a topic which outruns the link
+ *                  only ever sends its freshest data. A topic can only start a
+ *                  new message once 1/rate seconds have passed since it started
+ *                  the last one, with a queue of one that caps it at rate and
+ *                  always sends the latest message.
+ *
+ *                  Messages go out one fragment at a time. Every fragment goes
+ *                  to the highest priority topic with something to send, so a
+ *                  teleop goal goes out between two fragments of a camera frame
+ *                  rather than after the whole frame. Topics of equal priority
+ *                  take turns by how long they have waited. Descriptions go
+ *                  ahead of everything.
+ *
+ *                  Topics with delta set only send deltas against a keyframe the
+ *                  far end has said it received, so a lost keyframe costs
+ *                  nothing but the bytes. Messages go whole while a keyframe is
+ *                  on its way, and a keyframe goes out when there is no base of
+ *                  the right length, the far end asks, or every
+ *                  keyframe_interval messages, with deltas against the old base
+ *                  until the new one is acknowledged. A delta which would not
+ *                  save at least a quarter is sent as a keyframe.
+ *
+ *                  Topics with reliable set send one message at a time and send
+ *                  it again every retransmit_interval until the far end says it
+ *                  arrived, ignoring the rate cap, before starting the next. The
+ *                  rest wait in the queue as usual. They are never delta
+ *                  encoded. This is for action goals, cancels and results, where
+ *                  one lost datagram leaves a client waiting forever.
+ *
+ *                  Not thread safe, the gateway node guards it.
+ ***************************************************************************************/
+#ifndef TOPIC_SCHEDULER_H
+#define TOPIC_SCHEDULER_H
+
+#include "gateway_codec.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tfr_gateway
+{
+    struct TopicConfig
+    {
+        std::string name;
+        //higher goes first
+        int priority;
+        //messages started per second at most, 0 for no cap
+        double rate;
+        size_t queue_size;
+        bool delta;
+        bool reliable;
+    };
+
+    struct TopicStats
+    {
+        uint64_t offered;
+        //pushed out of a full queue before they were sent
+        uint64_t dropped;
+        uint64_t sent;
+        uint64_t keyframes;
+        uint64_t bytes;
+        //reliable messages sent again for want of an acknowledgement
+        uint64_t retransmitted;
+    };
+
+    class TopicScheduler
+    {
+    public:
+        TopicScheduler(const std::vector<TopicConfig>& topics, size_t mtu, size_t keyframe_interval,
+                double retransmit_interval);
+        ~TopicScheduler() = default;
+        TopicScheduler(const TopicScheduler&) = delete;
+        TopicScheduler& operator=(const TopicScheduler&) = delete;
+        TopicScheduler(TopicScheduler&&) = delete;
+        TopicScheduler& operator=(TopicScheduler&&) = delete;
+
+        //queues a serialized message, returns false if it pushed out an older one
+        bool offer(uint16_t topic, std::vector<uint8_t> message);
+
+        //sets the description and sends it
+        void describe(uint16_t topic, std::vector<uint8_t> description);
+        //sends the description again, if there is one yet
+        void resendDescription(uint16_t topic);
+        //the far end lost its keyframes, start over
+        void requestKeyframe(uint16_t topic);
+        //the far end has a keyframe, deltas can use it
+        void keyframeReceived(uint16_t topic, uint32_t message);
+        //the far end has a reliable message, the next one can go
+        void messageReceived(uint16_t topic, uint32_t message);
+
+        /*
+         * Appends the next datagram to packet, with the given sequence.
+         * Returns false, and leaves packet alone, if nothing can go yet.
+         * */
+        bool next(double now, uint32_t sequence, std::vector<uint8_t>& packet);
+
+        size_t size() const { return topics.size(); }
+        const TopicConfig& config(uint16_t topic) const { return topics[topic].config; }
+        const TopicStats& stats(uint16_t topic) const { return topics[topic].stats; }
+
+    private:
+        //a body on its way out a fragment at a time
+        struct Outgoing
+        {
+            std::vector<uint8_t> body;
+            uint32_t message;
+            uint16_t count;
+            uint16_t next;
+            bool active;
+        };
+
+        struct Topic
+        {
+            TopicConfig config;
+            std::deque<std::vector<uint8_t>> queue;
+            //when it last started a message, for the rate cap
+            double last_start;
+            bool started;
+            uint32_t next_message;
+
+            //the acknowledged keyframe deltas are taken against
+            bool has_base;
+            uint32_t base_id;
+            std::vector<uint8_t> base;
+            //keyframes sent but not acknowledged yet, oldest first
+            std::deque<std::pair<uint32_t, std::vector<uint8_t>>> unacknowledged;
+            size_t since_keyframe;
+
+            //the reliable message on its way, sent again until acknowledged
+            bool waiting;
+            uint32_t pending_id;
+            std::vector<uint8_t> pending;
+            double last_sent;
+
+            std::vector<uint8_t> description;
+            bool describe;
+            uint32_t next_description;
+
+            Outgoing data;
+            Outgoing describing;
+            TopicStats stats;
+        };
+
+        std::vector<Topic> topics;
+        const size_t payload;
+        const size_t keyframe_interval;
+        const double retransmit_interval;
+
+        bool eligible(const Topic& topic, double now) const;
+        void start(Topic& topic, double now);
+        void begin(Outgoing& outgoing, std::vector<uint8_t> body, uint32_t message);
+        void fragment(uint16_t id, PacketKind kind, Outgoing& outgoing, uint32_t sequence,
+                std::vector<uint8_t>& packet);
+    };
+}
+
+#endif
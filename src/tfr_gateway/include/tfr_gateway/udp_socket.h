@@ -0,0 +1,29 @@
+/****************************************************************************************
+ * File:            udp_socket.h
+ *
+ * Purpose:         The little bit of posix socket setup the gateway and link
+ *                  emulator nodes share.
+ ***************************************************************************************/
+#ifndef UDP_SOCKET_H
+#define UDP_SOCKET_H
+
+#include <netinet/in.h>
+#include <cstdint>
+#include <string>
+
+namespace tfr_gateway
+{
+    /*
+     * Opens a udp socket bound to port on every interface, 0 for any port.
+     * Reads give up after timeout seconds so the threads reading them can
+     * notice shutdown. Returns -1 on failure.
+     * */
+    int openUdpSocket(uint16_t port, double timeout);
+
+    //looks up an ipv4 address, returns false if there is none
+    bool resolveAddress(const std::string& host, uint16_t port, sockaddr_in& address);
+
+    bool sameAddress(const sockaddr_in& a, const sockaddr_in& b);
+}
+
+#endif
@@ -0,0 +1,283 @@
+/****************************************************************************************
+ * File:            gateway.cpp
+ *
+ * Purpose:         This is the implementation file for the Gateway class.
+ *                  See tfr_gateway/include/tfr_gateway/gateway.h for details.
+ ***************************************************************************************/
+#include "gateway.h"
+#include <algorithm>
+
+namespace tfr_gateway
+{
+    Gateway::Gateway(const GatewayOptions& options, const std::vector<TopicConfig>& topics) :
+        options(options),
+        scheduler{topics, options.mtu, options.keyframe_interval, options.retransmit_interval},
+        monitor{options.link},
+        sequence{1}, tokens{0}, last_poll{0}, last_ping{0}, polled{false}, control{},
+        peer_known{false}, peer_session{0}, remotes{}, abandoned{0}
+    {}
+
+    void Gateway::describe(uint16_t topic, const TopicDescription& description)
+    {
+        std::vector<uint8_t> body;
+        encodeDescription(description, body);
+        scheduler.describe(topic, std::move(body));
+    }
+
+    bool Gateway::offer(uint16_t topic, std::vector<uint8_t> message)
+    {
+        return scheduler.offer(topic, std::move(message));
+    }
+
+    void Gateway::poll(double now, std::vector<std::vector<uint8_t>>& packets)
+    {
+        const double budget = monitor.budget();
+        const bool first = !polled;
+        if (first)
+        {
+            polled = true;
+            last_poll = now;
+            tokens = budget * options.burst;
+        }
+        const double depth = std::max(budget * options.burst, 2.0 * options.mtu);
+        tokens = std::min(tokens + budget * std::max(now - last_poll, 0.0), depth);
+        last_poll = now;
+
+        if (first || now - last_ping >= options.ping_interval)
+        {
+            last_ping = now;
+            probe(PacketKind::PING, static_cast<uint64_t>(now * 1e6));
+        }
+
+        //control traffic jumps the queue, it is small and the link depends on it
+        for (std::vector<uint8_t>& packet : control)
+        {
+            tokens -= packet.size();
+            monitor.sent(packet.size());
+            packets.push_back(std::move(packet));
+        }
+        control.clear();
+
+        while (tokens > 0)
+        {
+            std::vector<uint8_t> packet;
+            if (!scheduler.next(now, sequence, packet))
+                break;
+            sequence++;
+            tokens -= packet.size();
+            monitor.sent(packet.size());
+            packets.push_back(std::move(packet));
+        }
+    }
+
+    void Gateway::receive(const uint8_t* data, size_t size, double now,
+            std::vector<Incoming>& incoming)
+    {
+        ByteReader reader{data, size};
+        PacketHeader header;
+        if (!readHeader(reader, header))
+            return;
+
+        if (header.kind == PacketKind::PING || header.kind == PacketKind::PONG)
+        {
+            Probe probe;
+            if (!readProbe(reader, probe))
+                return;
+            checkSession(probe.session);
+            monitor.received(header.sequence, size);
+            monitor.report(probe, now);
+            if (header.kind == PacketKind::PING)
+                this->probe(PacketKind::PONG, probe.time_us);
+            else
+                monitor.roundTrip(now - probe.time_us / 1e6, now);
+            return;
+        }
+        monitor.received(header.sequence, size);
+
+        if (header.kind == PacketKind::REQUEST)
+        {
+            const uint16_t topic = reader.u16();
+            if (!reader.ok() || topic >= scheduler.size())
+                return;
+            if (header.flags & REQUEST_DESCRIPTION)
+                scheduler.resendDescription(topic);
+            if (header.flags & REQUEST_KEYFRAME)
+                scheduler.requestKeyframe(topic);
+            if (header.flags & KEYFRAME_RECEIVED)
+            {
+                const uint32_t message = reader.u32();
+                if (reader.ok())
+                    scheduler.keyframeReceived(topic, message);
+            }
+            if (header.flags & MESSAGE_RECEIVED)
+            {
+                const uint32_t message = reader.u32();
+                if (reader.ok())
+                    scheduler.messageReceived(topic, message);
+            }
+            return;
+        }
+        if (header.kind != PacketKind::MESSAGE && header.kind != PacketKind::DESCRIPTION)
+            return;
+
+        FragmentHeader fragment;
+        if (!readFragment(reader, fragment))
+            return;
+        Remote& remote = remotes[fragment.topic];
+        std::vector<uint8_t> body;
+        if (header.kind == PacketKind::DESCRIPTION)
+        {
+            if (!assemble(remote.description, fragment, reader.position(), reader.remaining(), body))
+                return;
+            remote.described = true;
+            incoming.push_back(Incoming{PacketKind::DESCRIPTION, fragment.topic, std::move(body)});
+        }
+        else if (header.flags & MESSAGE_RELIABLE)
+        {
+            //already published, the acknowledgement must have been lost
+            if (remote.confirmed && static_cast<int32_t>(fragment.message - remote.last_confirmed) <= 0)
+            {
+                acknowledge(fragment.topic, MESSAGE_RECEIVED, fragment.message);
+                return;
+            }
+            if (!assemble(remote.message, fragment, reader.position(), reader.remaining(), body))
+                return;
+            if (!deliver(fragment.topic, remote, std::move(body), now, incoming))
+            {
+                remote.message = Assembly{};
+                return;
+            }
+            remote.confirmed = true;
+            remote.last_confirmed = fragment.message;
+            acknowledge(fragment.topic, MESSAGE_RECEIVED, fragment.message);
+        }
+        else if (assemble(remote.message, fragment, reader.position(), reader.remaining(), body))
+            deliver(fragment.topic, remote, std::move(body), now, incoming);
+    }
+
+    void Gateway::probe(PacketKind kind, uint64_t time_us)
+    {
+        std::vector<uint8_t> packet;
+        ByteWriter writer{packet};
+        writeHeader(writer, PacketHeader{kind, 0, sequence++});
+        writeProbe(writer, monitor.probe(options.session, time_us));
+        control.push_back(std::move(packet));
+    }
+
+    void Gateway::request(uint16_t topic, uint8_t flags, Remote& remote, double now)
+    {
+        if (remote.requested && now - remote.last_request < options.request_interval)
+            return;
+        remote.requested = true;
+        remote.last_request = now;
+        std::vector<uint8_t> packet;
+        ByteWriter writer{packet};
+        writeHeader(writer, PacketHeader{PacketKind::REQUEST, flags, sequence++});
+        writer.u16(topic);
+        control.push_back(std::move(packet));
+    }
+
+    void Gateway::acknowledge(uint16_t topic, uint8_t flag, uint32_t message)
+    {
+        std::vector<uint8_t> packet;
+        ByteWriter writer{packet};
+        writeHeader(writer, PacketHeader{PacketKind::REQUEST, flag, sequence++});
+        writer.u16(topic);
+        writer.u32(message);
+        control.push_back(std::move(packet));
+    }
+
+    void Gateway::checkSession(uint32_t session)
+    {
+        if (peer_known && session == peer_session)
+            return;
+        //a new far end knows nothing, start it over from descriptions and keyframes
+        peer_known = true;
+        peer_session = session;
+        remotes.clear();
+        monitor.restart();
+        for (size_t i = 0; i < scheduler.size(); i++)
+        {
+            scheduler.resendDescription(i);
+            scheduler.requestKeyframe(i);
+        }
+    }
+
+    bool Gateway::assemble(Assembly& assembly, const FragmentHeader& fragment,
+            const uint8_t* data, size_t size, std::vector<uint8_t>& body)
+    {
+        if (assembly.count == 0 || fragment.message != assembly.message)
+        {
+            //ids wrap, anything up to half way round counts as newer
+            const bool newer = static_cast<int32_t>(fragment.message - assembly.message) > 0;
+            if (assembly.count != 0 && !newer)
+                return false;
+            if (assembly.count != 0 && assembly.received < assembly.count)
+                abandoned++;
+            assembly.message = fragment.message;
+            assembly.count = fragment.count;
+            assembly.received = 0;
+            assembly.fragments.assign(fragment.count, {});
+        }
+        if (assembly.received == assembly.count || fragment.count != assembly.count)
+            return false;
+        std::vector<uint8_t>& slot = assembly.fragments[fragment.index];
+        //a duplicate, or an empty fragment we already counted
+        if (!slot.empty() || (size == 0 && assembly.count > 1))
+            return false;
+        slot.assign(data, data + size);
+        if (++assembly.received < assembly.count)
+            return false;
+
+        body.clear();
+        for (std::vector<uint8_t>& part : assembly.fragments)
+            body.insert(body.end(), part.begin(), part.end());
+        assembly.fragments.clear();
+        return true;
+    }
+
+    bool Gateway::deliver(uint16_t topic, Remote& remote, std::vector<uint8_t> body, double now,
+            std::vector<Incoming>& incoming)
+    {
+        ByteReader reader{body.data(), body.size()};
+        const Encoding encoding = static_cast<Encoding>(reader.u8());
+        const uint32_t base = reader.u32();
+        if (!reader.ok())
+            return false;
+
+        std::vector<uint8_t> message;
+        if (encoding == Encoding::DELTA)
+        {
+            auto keyframe = std::find_if(remote.keyframes.begin(), remote.keyframes.end(),
+                    [base](const std::pair<uint32_t, std::vector<uint8_t>>& kept)
+                    { return kept.first == base; });
+            if (keyframe == remote.keyframes.end() ||
+                    !deltaDecode(keyframe->second, reader.position(), reader.remaining(), message))
+            {
+                abandoned++;
+                request(topic, REQUEST_KEYFRAME, remote, now);
+                return false;
+            }
+        }
+        else
+        {
+            message.assign(reader.position(), reader.position() + reader.remaining());
+            if (encoding == Encoding::KEYFRAME)
+            {
+                if (remote.keyframes.size() >= KEPT_KEYFRAMES)
+                    remote.keyframes.pop_front();
+                remote.keyframes.emplace_back(base, message);
+                acknowledge(topic, KEYFRAME_RECEIVED, base);
+            }
+        }
+
+        if (!remote.described)
+        {
+            abandoned++;
+            request(topic, REQUEST_DESCRIPTION, remote, now);
+            return false;
+        }
+        incoming.push_back(Incoming{PacketKind::MESSAGE, topic, std::move(message)});
+        return true;
+    }
+}
@@ -0,0 +1,206 @@
+/****************************************************************************************
+ * File:            gateway_codec.cpp
+ *
+ * Purpose:         This is the implementation file for the gateway wire format.
+ *                  See tfr_gateway/include/tfr_gateway/gateway_codec.h for details.
+ ***************************************************************************************/
+#include "gateway_codec.h"
+#include <algorithm>
+
+namespace tfr_gateway
+{
+    void ByteWriter::u16(uint16_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    void ByteWriter::u32(uint32_t value)
+    {
+        u16(static_cast<uint16_t>(value));
+        u16(static_cast<uint16_t>(value >> 16));
+    }
+
+    void ByteWriter::u64(uint64_t value)
+    {
+        u32(static_cast<uint32_t>(value));
+        u32(static_cast<uint32_t>(value >> 32));
+    }
+
+    void ByteWriter::bytes(const uint8_t* data, size_t size)
+    {
+        out.insert(out.end(), data, data + size);
+    }
+
+    void ByteWriter::string(const std::string& value)
+    {
+        u32(static_cast<uint32_t>(value.size()));
+        bytes(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    }
+
+    bool ByteReader::take(size_t count)
+    {
+        if (!good || count > size - offset)
+        {
+            good = false;
+            return false;
+        }
+        return true;
+    }
+
+    uint8_t ByteReader::u8()
+    {
+        if (!take(1))
+            return 0;
+        return data[offset++];
+    }
+
+    uint16_t ByteReader::u16()
+    {
+        uint16_t low = u8();
+        uint16_t high = u8();
+        return static_cast<uint16_t>(low | (high << 8));
+    }
+
+    uint32_t ByteReader::u32()
+    {
+        uint32_t low = u16();
+        uint32_t high = u16();
+        return low | (high << 16);
+    }
+
+    uint64_t ByteReader::u64()
+    {
+        uint64_t low = u32();
+        uint64_t high = u32();
+        return low | (high << 32);
+    }
+
+    std::string ByteReader::string()
+    {
+        uint32_t length = u32();
+        if (!take(length))
+            return {};
+        std::string value{reinterpret_cast<const char*>(data + offset), length};
+        offset += length;
+        return value;
+    }
+
+    void writeHeader(ByteWriter& writer, const PacketHeader& header)
+    {
+        writer.u16(MAGIC);
+        writer.u8(static_cast<uint8_t>(header.kind));
+        writer.u8(header.flags);
+        writer.u32(header.sequence);
+    }
+
+    bool readHeader(ByteReader& reader, PacketHeader& header)
+    {
+        if (reader.u16() != MAGIC)
+            return false;
+        header.kind = static_cast<PacketKind>(reader.u8());
+        header.flags = reader.u8();
+        header.sequence = reader.u32();
+        return reader.ok();
+    }
+
+    void writeFragment(ByteWriter& writer, const FragmentHeader& fragment)
+    {
+        writer.u16(fragment.topic);
+        writer.u32(fragment.message);
+        writer.u16(fragment.index);
+        writer.u16(fragment.count);
+    }
+
+    bool readFragment(ByteReader& reader, FragmentHeader& fragment)
+    {
+        fragment.topic = reader.u16();
+        fragment.message = reader.u32();
+        fragment.index = reader.u16();
+        fragment.count = reader.u16();
+        return reader.ok() && fragment.index < fragment.count;
+    }
+
+    void writeProbe(ByteWriter& writer, const Probe& probe)
+    {
+        writer.u32(probe.session);
+        writer.u64(probe.time_us);
+        writer.u64(probe.received_bytes);
+        writer.u32(probe.received_packets);
+        writer.u32(probe.highest_sequence);
+    }
+
+    bool readProbe(ByteReader& reader, Probe& probe)
+    {
+        probe.session = reader.u32();
+        probe.time_us = reader.u64();
+        probe.received_bytes = reader.u64();
+        probe.received_packets = reader.u32();
+        probe.highest_sequence = reader.u32();
+        return reader.ok();
+    }
+
+    void encodeDescription(const TopicDescription& description, std::vector<uint8_t>& out)
+    {
+        ByteWriter writer{out};
+        writer.string(description.name);
+        writer.string(description.datatype);
+        writer.string(description.md5sum);
+        writer.string(description.definition);
+        writer.u8(description.latching ? 1 : 0);
+    }
+
+    bool decodeDescription(const std::vector<uint8_t>& body, TopicDescription& description)
+    {
+        ByteReader reader{body.data(), body.size()};
+        description.name = reader.string();
+        description.datatype = reader.string();
+        description.md5sum = reader.string();
+        description.definition = reader.string();
+        description.latching = reader.u8() != 0;
+        return reader.ok() && !description.name.empty();
+    }
+
+    void deltaEncode(const std::vector<uint8_t>& base, const std::vector<uint8_t>& message,
+            std::vector<uint8_t>& out)
+    {
+        for (size_t block = 0; block < message.size(); block += 8)
+        {
+            const size_t end = std::min(block + 8, message.size());
+            const size_t mask_at = out.size();
+            uint8_t mask = 0;
+            out.push_back(0);
+            for (size_t i = block; i < end; i++)
+            {
+                const uint8_t difference = message[i] ^ base[i];
+                if (difference == 0)
+                    continue;
+                mask |= 1 << (i - block);
+                out.push_back(difference);
+            }
+            out[mask_at] = mask;
+        }
+    }
+
+    bool deltaDecode(const std::vector<uint8_t>& base, const uint8_t* delta, size_t size,
+            std::vector<uint8_t>& out)
+    {
+        out = base;
+        size_t read = 0;
+        for (size_t block = 0; block < base.size(); block += 8)
+        {
+            if (read >= size)
+                return false;
+            const uint8_t mask = delta[read++];
+            for (size_t bit = 0; bit < 8; bit++)
+            {
+                if ((mask & (1 << bit)) == 0)
+                    continue;
+                if (block + bit >= base.size() || read >= size)
+                    return false;
+                out[block + bit] ^= delta[read++];
+            }
+        }
+        return read == size;
+    }
+}
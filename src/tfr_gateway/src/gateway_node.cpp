@@ -0,0 +1,377 @@
+/****************************************************************************************
+ * File:            gateway_node.cpp
+ *
+ * Purpose:         One end of the link between the robot and mission control. It
+ *                  subscribes to the topics in ~topics, whatever their type, sends
+ *                  them over a single udp socket through a Gateway
+ *                  (tfr_gateway/include/tfr_gateway/gateway.h), and publishes
+ *                  whatever the far end sends it. Run one on the robot and one on
+ *                  the operator station, each listing the topics it sends.
+ *
+ *                  Every local topic lives under ~prefix, the names on the link
+ *                  do not. The station gateway runs with a prefix, so mission
+ *                  control is remapped onto the gateway's copies of the robot's
+ *                  topics rather than reaching across the radio for them.
+ *
+ * Parameters:      ~port: udp port to listen on (int, default: 47400)
+ *                  ~peer_host: where the other gateway is, leave it empty to wait
+ *                      for the other gateway to ping first (string, default: "")
+ *                  ~peer_port: (int, default: 47400)
+ *                  ~prefix: namespace for every local topic (string, default: "")
+ *                  ~topics: list of {name, priority, rate, queue, delta, reliable}
+ *                      to send, higher priority goes first, rate caps messages per
+ *                      second (0 for none), queue is how many to hold before
+ *                      dropping the oldest, delta sends numeric streams as
+ *                      differences and reliable sends each message until the far
+ *                      end acknowledges it
+ *                  ~mtu: largest datagram bytes (int, default: 1200)
+ *                  ~ping_rate: hz (double, default: 10)
+ *                  ~initial_rate: starting send budget B/s (double, default: 200000)
+ *                  ~min_rate: (double, default: 20000)
+ *                  ~max_rate: (double, default: 4000000)
+ *                  ~congestion_delay: queueing over the lowest round trip before
+ *                      backing off s (double, default: 0.1)
+ *                  ~loss_threshold: loss before backing off (double, default: 0.1)
+ *                  ~keyframe_interval: messages between keyframes (int, default: 50)
+ *                  ~retransmit_interval: wait for an acknowledgement before sending
+ *                      a reliable message again s (double, default: 0.3)
+ *
+ * Subscribed To:   ~prefix + each name in ~topics
+ * Publishes To:    ~prefix + each topic the far end sends, as its own type
+ *                  ~link (tfr_msgs/GatewayLink) at 1hz
+ ***************************************************************************************/
+#include <ros/ros.h>
+#include <topic_tools/shape_shifter.h>
+#include <tfr_msgs/GatewayLink.h>
+#include "gateway.h"
+#include "udp_socket.h"
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace tfr_gateway
+{
+    class GatewayNode
+    {
+    public:
+        GatewayNode(ros::NodeHandle& n, const GatewayOptions& options,
+                const std::vector<TopicConfig>& topics, const std::string& prefix,
+                int fd, bool peer_known, const sockaddr_in& peer) :
+            n(n), prefix{prefix}, fd{fd},
+            start{std::chrono::steady_clock::now()},
+            gateway{options, topics}, described(topics.size(), false),
+            peer_known{peer_known}, peer(peer), connected{false},
+            remote_topics{}, running{true}
+        {
+            for (size_t i = 0; i < topics.size(); i++)
+            {
+                //the event carries the connection header, which says if it is latched
+                boost::function<void(const ros::MessageEvent<topic_tools::ShapeShifter const>&)> callback =
+                    boost::bind(&GatewayNode::offer, this, _1, i);
+                subscribers.push_back(n.subscribe(prefix + topics[i].name, topics[i].queue_size, callback));
+                ROS_INFO("Gateway: sending %s priority %d rate %f queue %zu%s%s",
+                        topics[i].name.c_str(), topics[i].priority, topics[i].rate,
+                        topics[i].queue_size, topics[i].delta ? " delta" : "",
+                        topics[i].reliable ? " reliable" : "");
+            }
+            link_publisher = ros::NodeHandle{"~"}.advertise<tfr_msgs::GatewayLink>("link", 5);
+            timer = n.createTimer(ros::Duration(1.0), &GatewayNode::publishLink, this);
+            sender = std::thread(&GatewayNode::sendLoop, this);
+            receiver = std::thread(&GatewayNode::receiveLoop, this);
+        }
+
+        ~GatewayNode()
+        {
+            running = false;
+            sender.join();
+            receiver.join();
+        }
+        GatewayNode(const GatewayNode&) = delete;
+        GatewayNode& operator=(const GatewayNode&) = delete;
+        GatewayNode(GatewayNode&&) = delete;
+        GatewayNode& operator=(GatewayNode&&) = delete;
+
+    private:
+        //what the far end told us about one of its topics
+        struct RemoteTopic
+        {
+            TopicDescription description;
+            ros::Publisher publisher;
+        };
+
+        ros::NodeHandle& n;
+        const std::string prefix;
+        const int fd;
+        const std::chrono::steady_clock::time_point start;
+
+        std::mutex gateway_mutex;
+        Gateway gateway;
+        std::vector<bool> described;
+        bool peer_known;
+        sockaddr_in peer;
+        bool connected;
+
+        //only touched by the receive thread
+        std::map<uint16_t, RemoteTopic> remote_topics;
+
+        std::vector<ros::Subscriber> subscribers;
+        ros::Publisher link_publisher;
+        ros::Timer timer;
+        std::atomic<bool> running;
+        std::thread sender;
+        std::thread receiver;
+
+        //seconds on a clock which never jumps, the link measurements depend on it
+        double now() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        void offer(const ros::MessageEvent<topic_tools::ShapeShifter const>& event, size_t topic)
+        {
+            const topic_tools::ShapeShifter::ConstPtr& msg = event.getConstMessage();
+            std::vector<uint8_t> message(msg->size());
+            ros::serialization::OStream stream(message.data(), message.size());
+            msg->write(stream);
+
+            std::lock_guard<std::mutex> lock(gateway_mutex);
+            if (!described[topic])
+            {
+                //the far end needs the type to advertise, which we only learn now
+                described[topic] = true;
+                const ros::M_string& header = event.getConnectionHeader();
+                ros::M_string::const_iterator latching = header.find("latching");
+                gateway.describe(topic, TopicDescription{gateway.topics().config(topic).name,
+                        msg->getDataType(), msg->getMD5Sum(), msg->getMessageDefinition(),
+                        latching != header.end() && latching->second == "1"});
+            }
+            gateway.offer(topic, std::move(message));
+        }
+
+        void sendLoop()
+        {
+            std::vector<std::vector<uint8_t>> packets;
+            while (running && ros::ok())
+            {
+                sockaddr_in to;
+                {
+                    std::lock_guard<std::mutex> lock(gateway_mutex);
+                    //nothing goes until we know where, so nothing counts as lost
+                    if (peer_known)
+                        gateway.poll(now(), packets);
+                    to = peer;
+                }
+                for (const std::vector<uint8_t>& packet : packets)
+                    sendto(fd, packet.data(), packet.size(), 0,
+                            reinterpret_cast<const sockaddr*>(&to), sizeof(to));
+                packets.clear();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        void receiveLoop()
+        {
+            std::vector<uint8_t> buffer(65536);
+            std::vector<Incoming> incoming;
+            while (running && ros::ok())
+            {
+                sockaddr_in from{};
+                socklen_t length = sizeof(from);
+                ssize_t count = recvfrom(fd, buffer.data(), buffer.size(), 0,
+                        reinterpret_cast<sockaddr*>(&from), &length);
+                if (count <= 0)
+                    continue;
+                {
+                    std::lock_guard<std::mutex> lock(gateway_mutex);
+                    ByteReader reader{buffer.data(), static_cast<size_t>(count)};
+                    PacketHeader header;
+                    if (!readHeader(reader, header))
+                        continue;
+                    //answer wherever the other gateway is now, its address can change,
+                    //but only a ping says it is the gateway and not a stray datagram
+                    Probe probe;
+                    if (header.kind == PacketKind::PING && readProbe(reader, probe) &&
+                            (!peer_known || !sameAddress(peer, from)))
+                    {
+                        ROS_INFO("Gateway: peer at %s:%d", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+                        peer = from;
+                        peer_known = true;
+                    }
+                    gateway.receive(buffer.data(), count, now(), incoming);
+                }
+                for (Incoming& item : incoming)
+                    publish(item);
+                incoming.clear();
+            }
+        }
+
+        void publish(Incoming& incoming)
+        {
+            if (incoming.kind == PacketKind::DESCRIPTION)
+            {
+                TopicDescription description;
+                if (!decodeDescription(incoming.body, description))
+                    return;
+                RemoteTopic& remote = remote_topics[incoming.topic];
+                if (remote.publisher && remote.description.name == description.name &&
+                        remote.description.md5sum == description.md5sum)
+                    return;
+                remote.description = description;
+                topic_tools::ShapeShifter shifter;
+                shifter.morph(description.md5sum, description.datatype, description.definition, "");
+                remote.publisher = shifter.advertise(n, prefix + description.name, 5, description.latching);
+                ROS_INFO("Gateway: receiving %s (%s)", description.name.c_str(), description.datatype.c_str());
+                return;
+            }
+
+            std::map<uint16_t, RemoteTopic>::iterator remote = remote_topics.find(incoming.topic);
+            if (remote == remote_topics.end() || !remote->second.publisher)
+                return;
+            const TopicDescription& description = remote->second.description;
+            topic_tools::ShapeShifter shifter;
+            shifter.morph(description.md5sum, description.datatype, description.definition, "");
+            ros::serialization::IStream stream(incoming.body.data(), incoming.body.size());
+            shifter.read(stream);
+            remote->second.publisher.publish(shifter);
+        }
+
+        void publishLink(const ros::TimerEvent&)
+        {
+            tfr_msgs::GatewayLink link;
+            link.stamp = ros::Time::now();
+            {
+                std::lock_guard<std::mutex> lock(gateway_mutex);
+                const LinkStats stats = gateway.link(now());
+                link.connected = stats.connected;
+                link.rtt = stats.rtt;
+                link.min_rtt = stats.min_rtt;
+                link.loss = stats.loss;
+                link.budget = stats.budget;
+                link.send_rate = stats.send_rate;
+                link.delivered_rate = stats.delivered_rate;
+                link.receive_rate = stats.receive_rate;
+                const TopicScheduler& topics = gateway.topics();
+                for (uint16_t i = 0; i < topics.size(); i++)
+                {
+                    link.topics.push_back(topics.config(i).name);
+                    link.sent.push_back(topics.stats(i).sent);
+                    link.dropped.push_back(topics.stats(i).dropped);
+                    link.bytes.push_back(topics.stats(i).bytes);
+                }
+                link.incomplete = gateway.incomplete();
+            }
+
+            if (link.connected != connected)
+            {
+                connected = link.connected;
+                if (connected)
+                    ROS_WARN("Gateway: link up, round trip %.0fms", link.rtt * 1000);
+                else
+                    ROS_WARN("Gateway: link down");
+            }
+            link_publisher.publish(link);
+        }
+    };
+
+    std::vector<TopicConfig> loadTopics()
+    {
+        std::vector<TopicConfig> topics;
+        XmlRpc::XmlRpcValue topic_list;
+        if (!ros::param::get("~topics", topic_list) ||
+                topic_list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+        {
+            ROS_WARN("Gateway: no topics configured, only receiving");
+            return topics;
+        }
+        for (int i = 0; i < topic_list.size(); i++)
+        {
+            XmlRpc::XmlRpcValue& entry = topic_list[i];
+            TopicConfig topic{static_cast<std::string>(entry["name"]), 0, 0, 1, false, false};
+            if (entry.hasMember("priority"))
+                topic.priority = static_cast<int>(entry["priority"]);
+            if (entry.hasMember("rate"))
+                topic.rate = static_cast<double>(entry["rate"]);
+            if (entry.hasMember("queue"))
+                topic.queue_size = std::max(static_cast<int>(entry["queue"]), 1);
+            if (entry.hasMember("delta"))
+                topic.delta = static_cast<bool>(entry["delta"]);
+            if (entry.hasMember("reliable"))
+                topic.reliable = static_cast<bool>(entry["reliable"]);
+            topics.push_back(topic);
+        }
+        return topics;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "gateway");
+    ros::NodeHandle n;
+
+    int port, peer_port, mtu, keyframe_interval;
+    std::string peer_host, prefix;
+    double ping_rate, initial_rate, min_rate, max_rate, congestion_delay, loss_threshold,
+           retransmit_interval;
+    ros::param::param<int>("~port", port, 47400);
+    ros::param::param<std::string>("~peer_host", peer_host, "");
+    ros::param::param<int>("~peer_port", peer_port, 47400);
+    ros::param::param<std::string>("~prefix", prefix, "");
+    ros::param::param<int>("~mtu", mtu, 1200);
+    ros::param::param<double>("~ping_rate", ping_rate, 10);
+    ros::param::param<double>("~initial_rate", initial_rate, 200000);
+    ros::param::param<double>("~min_rate", min_rate, 20000);
+    ros::param::param<double>("~max_rate", max_rate, 4000000);
+    ros::param::param<double>("~congestion_delay", congestion_delay, 0.1);
+    ros::param::param<double>("~loss_threshold", loss_threshold, 0.1);
+    ros::param::param<int>("~keyframe_interval", keyframe_interval, 50);
+    ros::param::param<double>("~retransmit_interval", retransmit_interval, 0.3);
+    if (mtu < 200 || mtu > 65000)
+    {
+        ROS_ERROR("Parameter 'mtu' must be between 200 and 65000.");
+        return 1;
+    }
+    if (ping_rate <= 0 || min_rate <= 0 || max_rate < min_rate || keyframe_interval < 1 ||
+            retransmit_interval <= 0)
+    {
+        ROS_ERROR("Parameters 'ping_rate', 'min_rate', 'max_rate', 'keyframe_interval' and 'retransmit_interval' must be positive, with max_rate above min_rate.");
+        return 1;
+    }
+
+    sockaddr_in peer{};
+    bool peer_known = !peer_host.empty();
+    if (peer_known && !tfr_gateway::resolveAddress(peer_host, peer_port, peer))
+    {
+        ROS_ERROR("Gateway: could not resolve peer %s.", peer_host.c_str());
+        return 1;
+    }
+    int fd = tfr_gateway::openUdpSocket(port, 0.1);
+    if (fd < 0)
+    {
+        ROS_ERROR("Gateway: failed to open udp port %d.", port);
+        return 1;
+    }
+
+    //a fresh session tells the far end we restarted and lost everything
+    std::random_device random;
+    tfr_gateway::GatewayOptions options{static_cast<size_t>(mtu), 1 / ping_rate, 0.5,
+        retransmit_interval, static_cast<size_t>(keyframe_interval), 0.05, random(),
+        tfr_gateway::LinkOptions{std::min(std::max(initial_rate, min_rate), max_rate),
+            min_rate, max_rate, congestion_delay, loss_threshold, 2.0}};
+    ROS_INFO("Gateway: listening on %d%s%s", port,
+            peer_known ? ", sending to " : ", waiting for the peer",
+            peer_known ? peer_host.c_str() : "");
+
+    {
+        tfr_gateway::GatewayNode gateway(n, options, tfr_gateway::loadTopics(), prefix, fd, peer_known, peer);
+        ros::spin();
+    }
+    close(fd);
+    return 0;
+}
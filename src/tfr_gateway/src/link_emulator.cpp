@@ -0,0 +1,55 @@
+/****************************************************************************************
+ * File:            link_emulator.cpp
+ *
+ * Purpose:         This is the implementation file for the LinkEmulator class.
+ *                  See tfr_gateway/include/tfr_gateway/link_emulator.h for details.
+ ***************************************************************************************/
+#include "link_emulator.h"
+#include <algorithm>
+
+namespace tfr_gateway
+{
+    LinkEmulator::LinkEmulator(const EmulatorOptions& options) :
+        options(options), random{options.seed}, uniform{0.0, 1.0},
+        free_at{0}, in_flight{}, lost{0}
+    {}
+
+    double LinkEmulator::backlog(double now) const
+    {
+        if (options.bandwidth <= 0)
+            return 0;
+        return std::max(free_at - now, 0.0) * options.bandwidth;
+    }
+
+    bool LinkEmulator::send(std::vector<uint8_t> packet, double now)
+    {
+        double departure = now;
+        if (options.bandwidth > 0)
+        {
+            if (backlog(now) + packet.size() > options.queue_bytes)
+            {
+                lost++;
+                return false;
+            }
+            free_at = std::max(free_at, now) + packet.size() / options.bandwidth;
+            departure = free_at;
+        }
+        //lost on the air after it took its turn at the bottleneck
+        if (uniform(random) < options.loss)
+        {
+            lost++;
+            return false;
+        }
+        const double arrival = departure + options.latency + options.jitter * uniform(random);
+        in_flight.emplace(arrival, std::move(packet));
+        return true;
+    }
+
+    void LinkEmulator::deliver(double now, std::vector<std::vector<uint8_t>>& packets)
+    {
+        auto end = in_flight.upper_bound(now);
+        for (auto it = in_flight.begin(); it != end; ++it)
+            packets.push_back(std::move(it->second));
+        in_flight.erase(in_flight.begin(), end);
+    }
+}
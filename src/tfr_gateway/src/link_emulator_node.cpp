@@ -0,0 +1,196 @@
+/****************************************************************************************
+ * File:            link_emulator_node.cpp
+ *
+ * Purpose:         Stands in for the radio so the gateways can be tried on one
+ *                  machine. It is a udp proxy: the station gateway sends to ~port,
+ *                  which forwards to the robot gateway at ~target_host:~target_port,
+ *                  and the replies go back to wherever the station last sent from.
+ *                  Each direction goes through its own LinkEmulator
+ *                  (tfr_gateway/include/tfr_gateway/link_emulator.h) with the same
+ *                  settings.
+ *
+ *                  The settings are read once at startup, restart the node to
+ *                  change them.
+ *
+ * Parameters:      ~port: where the station gateway sends (int, default: 47401)
+ *                  ~target_host: the robot gateway (string, default: localhost)
+ *                  ~target_port: (int, default: 47400)
+ *                  ~latency: one way s (double, default: 0.03)
+ *                  ~jitter: up to this much extra latency s (double, default: 0.005)
+ *                  ~bandwidth: B/s each way, 0 for no limit (double, default: 100000)
+ *                  ~loss: fraction of datagrams lost (double, default: 0.01)
+ *                  ~queue_bytes: buffer in front of the bandwidth limit (int, default: 25000)
+ ***************************************************************************************/
+#include <ros/ros.h>
+#include "link_emulator.h"
+#include "udp_socket.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+namespace tfr_gateway
+{
+    class LinkEmulatorNode
+    {
+    public:
+        LinkEmulatorNode(const EmulatorOptions& options, int station_fd, int robot_fd,
+                const sockaddr_in& robot) :
+            station_fd{station_fd}, robot_fd{robot_fd}, robot(robot),
+            start{std::chrono::steady_clock::now()},
+            up{options},
+            down{EmulatorOptions{options.latency, options.jitter, options.bandwidth,
+                options.loss, options.queue_bytes, options.seed + 1}},
+            station_known{false}, station{}, running{true}
+        {
+            delivery = std::thread(&LinkEmulatorNode::deliverLoop, this);
+            from_station = std::thread(&LinkEmulatorNode::receiveLoop, this, station_fd, true);
+            from_robot = std::thread(&LinkEmulatorNode::receiveLoop, this, robot_fd, false);
+        }
+
+        ~LinkEmulatorNode()
+        {
+            running = false;
+            delivery.join();
+            from_station.join();
+            from_robot.join();
+        }
+        LinkEmulatorNode(const LinkEmulatorNode&) = delete;
+        LinkEmulatorNode& operator=(const LinkEmulatorNode&) = delete;
+        LinkEmulatorNode(LinkEmulatorNode&&) = delete;
+        LinkEmulatorNode& operator=(LinkEmulatorNode&&) = delete;
+
+    private:
+        const int station_fd;
+        const int robot_fd;
+        const sockaddr_in robot;
+        const std::chrono::steady_clock::time_point start;
+
+        std::mutex link_mutex;
+        //station to robot
+        LinkEmulator up;
+        LinkEmulator down;
+        bool station_known;
+        sockaddr_in station;
+
+        std::atomic<bool> running;
+        std::thread delivery;
+        std::thread from_station;
+        std::thread from_robot;
+
+        double now() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        void receiveLoop(int fd, bool uplink)
+        {
+            std::vector<uint8_t> buffer(65536);
+            while (running && ros::ok())
+            {
+                sockaddr_in from{};
+                socklen_t length = sizeof(from);
+                ssize_t count = recvfrom(fd, buffer.data(), buffer.size(), 0,
+                        reinterpret_cast<sockaddr*>(&from), &length);
+                if (count <= 0)
+                    continue;
+                std::lock_guard<std::mutex> lock(link_mutex);
+                if (uplink)
+                {
+                    station = from;
+                    station_known = true;
+                }
+                (uplink ? up : down).send(std::vector<uint8_t>(buffer.begin(), buffer.begin() + count), now());
+            }
+        }
+
+        void deliverLoop()
+        {
+            std::vector<std::vector<uint8_t>> to_robot, to_station;
+            uint64_t reported = 0;
+            while (running && ros::ok())
+            {
+                sockaddr_in station_address;
+                bool station_ready;
+                uint64_t dropped;
+                {
+                    std::lock_guard<std::mutex> lock(link_mutex);
+                    const double time = now();
+                    up.deliver(time, to_robot);
+                    down.deliver(time, to_station);
+                    station_address = station;
+                    station_ready = station_known;
+                    dropped = up.dropped() + down.dropped();
+                }
+                for (const std::vector<uint8_t>& packet : to_robot)
+                    sendto(robot_fd, packet.data(), packet.size(), 0,
+                            reinterpret_cast<const sockaddr*>(&robot), sizeof(robot));
+                if (station_ready)
+                    for (const std::vector<uint8_t>& packet : to_station)
+                        sendto(station_fd, packet.data(), packet.size(), 0,
+                                reinterpret_cast<const sockaddr*>(&station_address), sizeof(station_address));
+                to_robot.clear();
+                to_station.clear();
+
+                if (dropped >= reported + 1000)
+                {
+                    reported = dropped;
+                    ROS_INFO("Link Emulator: %lu datagrams dropped", static_cast<unsigned long>(dropped));
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    };
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "link_emulator");
+    ros::NodeHandle n;
+
+    int port, target_port, queue_bytes;
+    std::string target_host;
+    double latency, jitter, bandwidth, loss;
+    ros::param::param<int>("~port", port, 47401);
+    ros::param::param<std::string>("~target_host", target_host, "localhost");
+    ros::param::param<int>("~target_port", target_port, 47400);
+    ros::param::param<double>("~latency", latency, 0.03);
+    ros::param::param<double>("~jitter", jitter, 0.005);
+    ros::param::param<double>("~bandwidth", bandwidth, 100000);
+    ros::param::param<double>("~loss", loss, 0.01);
+    ros::param::param<int>("~queue_bytes", queue_bytes, 25000);
+    if (latency < 0 || jitter < 0 || bandwidth < 0 || loss < 0 || loss > 1 || queue_bytes < 0)
+    {
+        ROS_ERROR("Link Emulator: parameters must be positive, with loss at most 1.");
+        return 1;
+    }
+
+    sockaddr_in robot{};
+    if (!tfr_gateway::resolveAddress(target_host, target_port, robot))
+    {
+        ROS_ERROR("Link Emulator: could not resolve target %s.", target_host.c_str());
+        return 1;
+    }
+    int station_fd = tfr_gateway::openUdpSocket(port, 0.1);
+    int robot_fd = tfr_gateway::openUdpSocket(0, 0.1);
+    if (station_fd < 0 || robot_fd < 0)
+    {
+        ROS_ERROR("Link Emulator: failed to open udp port %d.", port);
+        return 1;
+    }
+    ROS_INFO("Link Emulator: %d to %s:%d, %.0fms latency, %.0fB/s, %.1f%% loss",
+            port, target_host.c_str(), target_port, latency * 1000, bandwidth, loss * 100);
+
+    {
+        tfr_gateway::LinkEmulatorNode emulator(tfr_gateway::EmulatorOptions{latency, jitter, bandwidth,
+                loss, static_cast<size_t>(queue_bytes), static_cast<uint32_t>(time(nullptr))},
+                station_fd, robot_fd, robot);
+        ros::spin();
+    }
+    close(station_fd);
+    close(robot_fd);
+    return 0;
+}
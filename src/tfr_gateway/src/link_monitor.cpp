@@ -0,0 +1,133 @@
+/****************************************************************************************
+ * File:            link_monitor.cpp
+ *
+ * Purpose:         This is the implementation file for the LinkMonitor class.
+ *                  See tfr_gateway/include/tfr_gateway/link_monitor.h for details.
+ ***************************************************************************************/
+#include "link_monitor.h"
+#include <algorithm>
+
+namespace tfr_gateway
+{
+    namespace
+    {
+        //probes closer together than this are too noisy for a rate
+        constexpr double MIN_INTERVAL = 0.05;
+        constexpr double MIN_RTT_WINDOW = 10.0;
+        constexpr double SMOOTHING = 0.25;
+    }
+
+    LinkMonitor::LinkMonitor(const LinkOptions& options) :
+        options(options),
+        rate{std::min(std::max(options.initial_rate, options.min_rate), options.max_rate)},
+        srtt{0}, latest_rtt{0}, min_rtt{0}, next_min_rtt{0}, min_rtt_time{0}, last_cut{0}, measured{false},
+        sent_bytes{0}, received_bytes{0}, received_packets{0}, highest_sequence{0},
+        reported{false}, heard{0}, report_time{0}, last_probe{0, 0, 0, 0, 0},
+        sent_at_report{0}, received_at_report{0},
+        loss{0}, send_rate{0}, delivered_rate{0}, receive_rate{0}
+    {}
+
+    void LinkMonitor::sent(size_t bytes)
+    {
+        sent_bytes += bytes;
+    }
+
+    void LinkMonitor::received(uint32_t sequence, size_t bytes)
+    {
+        received_bytes += bytes;
+        received_packets++;
+        highest_sequence = std::max(highest_sequence, sequence);
+    }
+
+    Probe LinkMonitor::probe(uint32_t session, uint64_t time_us) const
+    {
+        return Probe{session, time_us, received_bytes, received_packets, highest_sequence};
+    }
+
+    void LinkMonitor::report(const Probe& probe, double now)
+    {
+        //pings and pongs can pass each other, only go forward
+        if (reported && probe.highest_sequence < last_probe.highest_sequence)
+            return;
+        heard = now;
+        if (!reported)
+        {
+            reported = true;
+            report_time = now;
+            last_probe = probe;
+            sent_at_report = sent_bytes;
+            received_at_report = received_bytes;
+            return;
+        }
+        const double dt = now - report_time;
+        if (dt < MIN_INTERVAL)
+            return;
+
+        const uint32_t expected = probe.highest_sequence - last_probe.highest_sequence;
+        const uint32_t arrived = probe.received_packets - last_probe.received_packets;
+        if (expected > 0)
+        {
+            const double lost = 1.0 - std::min(arrived, expected) / static_cast<double>(expected);
+            loss += SMOOTHING * (lost - loss);
+        }
+        delivered_rate += SMOOTHING * ((probe.received_bytes - last_probe.received_bytes) / dt - delivered_rate);
+        send_rate += SMOOTHING * ((sent_bytes - sent_at_report) / dt - send_rate);
+        receive_rate += SMOOTHING * ((received_bytes - received_at_report) / dt - receive_rate);
+
+        //the latest sample, the smoothed one lags too far behind a filling queue
+        const bool queueing = measured && latest_rtt - min_rtt > options.congestion_delay;
+        if (queueing || loss > options.loss_threshold)
+        {
+            if (now - last_cut > std::max(2 * srtt, 0.5))
+            {
+                rate = std::max(options.min_rate, rate * 0.8);
+                last_cut = now;
+            }
+        }
+        else if ((sent_bytes - sent_at_report) / dt >= rate * 0.5)
+            rate = std::min(options.max_rate, rate + std::max(rate * 0.01, 500.0));
+
+        report_time = now;
+        last_probe = probe;
+        sent_at_report = sent_bytes;
+        received_at_report = received_bytes;
+    }
+
+    void LinkMonitor::roundTrip(double rtt, double now)
+    {
+        if (rtt < 0)
+            return;
+        latest_rtt = rtt;
+        if (!measured)
+        {
+            measured = true;
+            srtt = rtt;
+            min_rtt = next_min_rtt = rtt;
+            min_rtt_time = now;
+            return;
+        }
+        srtt += (rtt - srtt) / 8;
+        min_rtt = std::min(min_rtt, rtt);
+        next_min_rtt = std::min(next_min_rtt, rtt);
+        if (now - min_rtt_time > MIN_RTT_WINDOW)
+        {
+            min_rtt = next_min_rtt;
+            next_min_rtt = rtt;
+            min_rtt_time = now;
+        }
+    }
+
+    void LinkMonitor::restart()
+    {
+        reported = false;
+        received_bytes = 0;
+        received_packets = 0;
+        highest_sequence = 0;
+    }
+
+    LinkStats LinkMonitor::stats(double now) const
+    {
+        return LinkStats{reported && now - heard < options.timeout,
+            srtt, min_rtt, loss, rate, send_rate, delivered_rate, receive_rate};
+    }
+}
@@ -0,0 +1,267 @@
+/****************************************************************************************
+ * File:            topic_scheduler.cpp
+ *
+ * Purpose:         This is the implementation file for the TopicScheduler class.
+ *                  See tfr_gateway/include/tfr_gateway/topic_scheduler.h for details.
+ ***************************************************************************************/
+#include "topic_scheduler.h"
+#include <algorithm>
+#include <limits>
+
+namespace tfr_gateway
+{
+    TopicScheduler::TopicScheduler(const std::vector<TopicConfig>& configs, size_t mtu,
+            size_t keyframe_interval, double retransmit_interval) :
+        topics{},
+        payload{std::max<size_t>(mtu, 64) - HEADER_SIZE - FRAGMENT_HEADER_SIZE},
+        keyframe_interval{std::max<size_t>(keyframe_interval, 1)},
+        retransmit_interval{retransmit_interval}
+    {
+        topics.resize(configs.size());
+        for (size_t i = 0; i < configs.size(); i++)
+        {
+            Topic& topic = topics[i];
+            topic.config = configs[i];
+            topic.config.queue_size = std::max<size_t>(topic.config.queue_size, 1);
+            //a delta resent after its base moved on would be garbage
+            if (topic.config.reliable)
+                topic.config.delta = false;
+            topic.last_start = 0;
+            topic.started = false;
+            topic.next_message = 0;
+            topic.has_base = false;
+            topic.base_id = 0;
+            topic.since_keyframe = 0;
+            topic.waiting = false;
+            topic.pending_id = 0;
+            topic.last_sent = 0;
+            topic.describe = false;
+            topic.next_description = 0;
+            topic.data = Outgoing{{}, 0, 0, 0, false};
+            topic.describing = Outgoing{{}, 0, 0, 0, false};
+            topic.stats = TopicStats{0, 0, 0, 0, 0, 0};
+        }
+    }
+
+    bool TopicScheduler::offer(uint16_t id, std::vector<uint8_t> message)
+    {
+        Topic& topic = topics[id];
+        topic.stats.offered++;
+        bool kept = true;
+        while (topic.queue.size() >= topic.config.queue_size)
+        {
+            topic.queue.pop_front();
+            topic.stats.dropped++;
+            kept = false;
+        }
+        topic.queue.push_back(std::move(message));
+        return kept;
+    }
+
+    void TopicScheduler::describe(uint16_t id, std::vector<uint8_t> description)
+    {
+        topics[id].description = std::move(description);
+        topics[id].describe = true;
+    }
+
+    void TopicScheduler::resendDescription(uint16_t id)
+    {
+        topics[id].describe = !topics[id].description.empty();
+    }
+
+    void TopicScheduler::requestKeyframe(uint16_t id)
+    {
+        topics[id].has_base = false;
+        topics[id].base.clear();
+        topics[id].unacknowledged.clear();
+    }
+
+    void TopicScheduler::keyframeReceived(uint16_t id, uint32_t message)
+    {
+        Topic& topic = topics[id];
+        auto& waiting = topic.unacknowledged;
+        for (auto it = waiting.begin(); it != waiting.end(); ++it)
+        {
+            if (it->first != message)
+                continue;
+            topic.has_base = true;
+            topic.base_id = message;
+            topic.base = std::move(it->second);
+            //anything older can never become the base now
+            waiting.erase(waiting.begin(), it + 1);
+            return;
+        }
+    }
+
+    void TopicScheduler::messageReceived(uint16_t id, uint32_t message)
+    {
+        Topic& topic = topics[id];
+        if (!topic.waiting || topic.pending_id != message)
+            return;
+        topic.waiting = false;
+        topic.pending.clear();
+    }
+
+    bool TopicScheduler::eligible(const Topic& topic, double now) const
+    {
+        if (topic.waiting)
+            return now - topic.last_sent >= retransmit_interval;
+        if (topic.queue.empty())
+            return false;
+        return !topic.started || topic.config.rate <= 0 ||
+            now - topic.last_start >= 1.0 / topic.config.rate;
+    }
+
+    bool TopicScheduler::next(double now, uint32_t sequence, std::vector<uint8_t>& packet)
+    {
+        //descriptions first, nothing on a topic can be published without one
+        for (size_t i = 0; i < topics.size(); i++)
+        {
+            Topic& topic = topics[i];
+            if (!topic.describing.active && topic.describe)
+            {
+                topic.describe = false;
+                begin(topic.describing, topic.description, topic.next_description++);
+            }
+            if (topic.describing.active)
+            {
+                fragment(i, PacketKind::DESCRIPTION, topic.describing, sequence, packet);
+                return true;
+            }
+        }
+
+        int best = -1;
+        for (size_t i = 0; i < topics.size(); i++)
+        {
+            const Topic& topic = topics[i];
+            if (!topic.data.active && !eligible(topic, now))
+                continue;
+            if (best == -1)
+            {
+                best = i;
+                continue;
+            }
+            const Topic& other = topics[best];
+            if (topic.config.priority > other.config.priority ||
+                    (topic.config.priority == other.config.priority &&
+                     (!topic.started || (other.started && topic.last_start < other.last_start))))
+                best = i;
+        }
+        if (best == -1)
+            return false;
+
+        Topic& topic = topics[best];
+        if (!topic.data.active)
+        {
+            start(topic, now);
+            //too big to fragment, start dropped it
+            if (!topic.data.active)
+                return next(now, sequence, packet);
+        }
+        fragment(best, PacketKind::MESSAGE, topic.data, sequence, packet);
+        return true;
+    }
+
+    void TopicScheduler::start(Topic& topic, double now)
+    {
+        if (topic.waiting)
+        {
+            topic.last_start = now;
+            topic.last_sent = now;
+            topic.stats.retransmitted++;
+            begin(topic.data, topic.pending, topic.pending_id);
+            return;
+        }
+
+        std::vector<uint8_t> message = std::move(topic.queue.front());
+        topic.queue.pop_front();
+        topic.last_start = now;
+        topic.started = true;
+        const uint32_t id = topic.next_message++;
+
+        std::vector<uint8_t> body;
+        body.reserve(message.size() + 5);
+        ByteWriter writer{body};
+        Encoding encoding = Encoding::PLAIN;
+        if (topic.config.delta)
+        {
+            const bool due = topic.since_keyframe >= keyframe_interval;
+            const bool waiting = !topic.unacknowledged.empty() &&
+                topic.unacknowledged.back().second.size() == message.size();
+            encoding = waiting && !due ? Encoding::PLAIN : Encoding::KEYFRAME;
+            if (topic.has_base && !due && topic.base.size() == message.size())
+            {
+                writer.u8(static_cast<uint8_t>(Encoding::DELTA));
+                writer.u32(topic.base_id);
+                deltaEncode(topic.base, message, body);
+                if ((body.size() - 5) * 4 <= message.size() * 3)
+                    encoding = Encoding::DELTA;
+                else
+                {
+                    encoding = Encoding::KEYFRAME;
+                    body.clear();
+                }
+            }
+            topic.since_keyframe++;
+        }
+        if (encoding != Encoding::DELTA)
+        {
+            writer.u8(static_cast<uint8_t>(encoding));
+            writer.u32(id);
+            writer.bytes(message.data(), message.size());
+        }
+
+        if ((body.size() + payload - 1) / payload > std::numeric_limits<uint16_t>::max())
+        {
+            topic.stats.dropped++;
+            return;
+        }
+        if (encoding == Encoding::KEYFRAME)
+        {
+            if (topic.unacknowledged.size() >= KEPT_KEYFRAMES)
+                topic.unacknowledged.pop_front();
+            topic.unacknowledged.emplace_back(id, std::move(message));
+            topic.since_keyframe = 0;
+            topic.stats.keyframes++;
+        }
+        topic.stats.sent++;
+        if (topic.config.reliable)
+        {
+            topic.waiting = true;
+            topic.pending_id = id;
+            topic.pending = body;
+            topic.last_sent = now;
+        }
+        begin(topic.data, std::move(body), id);
+    }
+
+    void TopicScheduler::begin(Outgoing& outgoing, std::vector<uint8_t> body, uint32_t message)
+    {
+        outgoing.count = static_cast<uint16_t>(std::max<size_t>((body.size() + payload - 1) / payload, 1));
+        outgoing.body = std::move(body);
+        outgoing.message = message;
+        outgoing.next = 0;
+        outgoing.active = true;
+    }
+
+    void TopicScheduler::fragment(uint16_t id, PacketKind kind, Outgoing& outgoing,
+            uint32_t sequence, std::vector<uint8_t>& packet)
+    {
+        const size_t start = packet.size();
+        ByteWriter writer{packet};
+        const uint8_t flags = kind == PacketKind::MESSAGE && topics[id].config.reliable ?
+            MESSAGE_RELIABLE : 0;
+        writeHeader(writer, PacketHeader{kind, flags, sequence});
+        writeFragment(writer, FragmentHeader{id, outgoing.message, outgoing.next, outgoing.count});
+        const size_t offset = outgoing.next * payload;
+        const size_t length = std::min(payload, outgoing.body.size() - offset);
+        writer.bytes(outgoing.body.data() + offset, length);
+        topics[id].stats.bytes += packet.size() - start;
+
+        if (++outgoing.next == outgoing.count)
+        {
+            outgoing.active = false;
+            outgoing.body.clear();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+/****************************************************************************************
+ * File:            udp_socket.cpp
+ *
+ * Purpose:         This is the implementation file for the udp socket helpers.
+ *                  See tfr_gateway/include/tfr_gateway/udp_socket.h for details.
+ ***************************************************************************************/
+#include "udp_socket.h"
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstring>
+
+namespace tfr_gateway
+{
+    int openUdpSocket(uint16_t port, double timeout)
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0)
+            return -1;
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        timeval wait{};
+        wait.tv_sec = static_cast<time_t>(timeout);
+        wait.tv_usec = static_cast<suseconds_t>(std::fmod(timeout, 1.0) * 1e6);
+        //a camera frame arrives as a burst of datagrams, give them room
+        int buffer = 1 << 20;
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait)) < 0 ||
+                setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool resolveAddress(const std::string& host, uint16_t port, sockaddr_in& address)
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* found = nullptr;
+        if (getaddrinfo(host.c_str(), nullptr, &hints, &found) != 0 || found == nullptr)
+            return false;
+        std::memcpy(&address, found->ai_addr, sizeof(address));
+        address.sin_port = htons(port);
+        freeaddrinfo(found);
+        return true;
+    }
+
+    bool sameAddress(const sockaddr_in& a, const sockaddr_in& b)
+    {
+        return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+    }
+}
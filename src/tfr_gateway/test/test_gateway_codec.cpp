@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "gateway_codec.h"
+#include "topic_scheduler.h"
+
+using namespace tfr_gateway;
+
+TEST(GatewayCodec, DeltaRoundTrip)
+{
+    std::vector<uint8_t> base(101);
+    for (size_t i = 0; i < base.size(); i++)
+        base[i] = static_cast<uint8_t>(i * 7);
+    std::vector<uint8_t> message = base;
+    message[3] ^= 0x40;
+    message[64] = 0;
+    message[100] = 1;
+
+    std::vector<uint8_t> delta;
+    deltaEncode(base, message, delta);
+    //a mask per block of eight and one byte per change
+    EXPECT_EQ(delta.size(), 13u + 3u);
+
+    std::vector<uint8_t> decoded;
+    ASSERT_TRUE(deltaDecode(base, delta.data(), delta.size(), decoded));
+    EXPECT_EQ(decoded, message);
+
+    //a delta for some other length does not decode
+    std::vector<uint8_t> shorter(base.begin(), base.begin() + 90);
+    EXPECT_FALSE(deltaDecode(shorter, delta.data(), delta.size(), decoded));
+    EXPECT_FALSE(deltaDecode(base, delta.data(), delta.size() - 1, decoded));
+}
+
+TEST(GatewayCodec, DescriptionRoundTrip)
+{
+    TopicDescription description{"/com", "tfr_msgs/StatusFrame", "0123456789abcdef",
+        "time stamp\nstring node\n", true};
+    std::vector<uint8_t> body;
+    encodeDescription(description, body);
+
+    TopicDescription decoded;
+    ASSERT_TRUE(decodeDescription(body, decoded));
+    EXPECT_EQ(decoded.name, description.name);
+    EXPECT_EQ(decoded.datatype, description.datatype);
+    EXPECT_EQ(decoded.md5sum, description.md5sum);
+    EXPECT_EQ(decoded.definition, description.definition);
+    EXPECT_TRUE(decoded.latching);
+
+    body.resize(body.size() - 2);
+    EXPECT_FALSE(decodeDescription(body, decoded));
+}
+
+namespace
+{
+    //which topic a datagram from the scheduler belongs to
+    uint16_t topicOf(const std::vector<uint8_t>& packet)
+    {
+        ByteReader reader{packet.data(), packet.size()};
+        PacketHeader header;
+        FragmentHeader fragment;
+        EXPECT_TRUE(readHeader(reader, header));
+        EXPECT_TRUE(readFragment(reader, fragment));
+        return fragment.topic;
+    }
+}
+
+TEST(TopicScheduler, HighestPriorityBetweenFragments)
+{
+    TopicScheduler scheduler{{{"/image", 10, 0, 1, false}, {"/teleop", 100, 0, 4, false}}, 200, 10, 0.3};
+    scheduler.offer(0, std::vector<uint8_t>(1000, 1));
+
+    std::vector<uint8_t> packet;
+    ASSERT_TRUE(scheduler.next(0.0, 1, packet));
+    EXPECT_EQ(topicOf(packet), 0);
+
+    //arrives part way through the image and goes next
+    scheduler.offer(1, std::vector<uint8_t>(20, 2));
+    packet.clear();
+    ASSERT_TRUE(scheduler.next(0.0, 2, packet));
+    EXPECT_EQ(topicOf(packet), 1);
+
+    //then the image picks up where it left off
+    int fragments = 1;
+    packet.clear();
+    while (scheduler.next(0.0, 3, packet))
+    {
+        EXPECT_EQ(topicOf(packet), 0);
+        fragments++;
+        packet.clear();
+    }
+    EXPECT_EQ(fragments, 6);
+}
+
+TEST(TopicScheduler, DropsOldestAndCapsRate)
+{
+    TopicScheduler scheduler{{{"/odom", 10, 10, 2, false}}, 1200, 10, 0.3};
+    EXPECT_TRUE(scheduler.offer(0, std::vector<uint8_t>(8, 1)));
+    EXPECT_TRUE(scheduler.offer(0, std::vector<uint8_t>(8, 2)));
+    EXPECT_FALSE(scheduler.offer(0, std::vector<uint8_t>(8, 3)));
+    EXPECT_EQ(scheduler.stats(0).dropped, 1u);
+
+    std::vector<uint8_t> packet;
+    ASSERT_TRUE(scheduler.next(0.0, 1, packet));
+    //the oldest left is the second one
+    EXPECT_EQ(packet.back(), 2);
+
+    //10hz cap, the next one waits a tenth of a second
+    packet.clear();
+    EXPECT_FALSE(scheduler.next(0.05, 2, packet));
+    EXPECT_TRUE(packet.empty());
+    ASSERT_TRUE(scheduler.next(0.1, 2, packet));
+    EXPECT_EQ(packet.back(), 3);
+}
+
+TEST(TopicScheduler, DeltasAgainstAcknowledgedKeyframes)
+{
+    TopicScheduler scheduler{{{"/odom", 10, 0, 1, true}}, 1200, 3, 0.3};
+    std::vector<uint8_t> message(700, 5);
+    int sent = 0;
+    //sends the next message and returns how it was encoded
+    auto send = [&]()
+    {
+        message[sent] = static_cast<uint8_t>(sent);
+        scheduler.offer(0, message);
+        std::vector<uint8_t> packet;
+        EXPECT_TRUE(scheduler.next(sent, sent, packet));
+        sent++;
+        return static_cast<Encoding>(packet.at(HEADER_SIZE + FRAGMENT_HEADER_SIZE));
+    };
+
+    EXPECT_EQ(send(), Encoding::KEYFRAME);
+    //nothing to take a delta against until the keyframe is acknowledged
+    EXPECT_EQ(send(), Encoding::PLAIN);
+    scheduler.keyframeReceived(0, 0);
+    EXPECT_EQ(send(), Encoding::DELTA);
+    EXPECT_EQ(send(), Encoding::DELTA);
+    //a fresh keyframe is due, deltas stay on the old one until it is acknowledged
+    EXPECT_EQ(send(), Encoding::KEYFRAME);
+    EXPECT_EQ(send(), Encoding::DELTA);
+    scheduler.keyframeReceived(0, 4);
+    EXPECT_EQ(send(), Encoding::DELTA);
+    EXPECT_EQ(scheduler.stats(0).keyframes, 2u);
+    EXPECT_LT(scheduler.stats(0).bytes, 4u * 750u);
+
+    //the far end lost track, start over
+    scheduler.requestKeyframe(0);
+    EXPECT_EQ(send(), Encoding::KEYFRAME);
+}
+
+TEST(TopicScheduler, ResendsReliableUntilAcknowledged)
+{
+    TopicScheduler scheduler{{{"/goal", 100, 0, 4, true, true}}, 1200, 10, 0.3};
+    EXPECT_FALSE(scheduler.config(0).delta);
+    scheduler.offer(0, std::vector<uint8_t>(8, 1));
+    scheduler.offer(0, std::vector<uint8_t>(8, 2));
+
+    std::vector<uint8_t> packet;
+    ASSERT_TRUE(scheduler.next(0.0, 1, packet));
+    ByteReader reader{packet.data(), packet.size()};
+    PacketHeader header;
+    FragmentHeader fragment;
+    ASSERT_TRUE(readHeader(reader, header) && readFragment(reader, fragment));
+    EXPECT_EQ(header.flags, MESSAGE_RELIABLE);
+
+    //the second waits on the first, which goes again once it is overdue
+    packet.clear();
+    EXPECT_FALSE(scheduler.next(0.2, 2, packet));
+    ASSERT_TRUE(scheduler.next(0.3, 2, packet));
+    EXPECT_EQ(packet.back(), 1);
+    EXPECT_EQ(scheduler.stats(0).retransmitted, 1u);
+
+    //an old id does not count
+    scheduler.messageReceived(0, fragment.message + 1);
+    packet.clear();
+    EXPECT_FALSE(scheduler.next(0.4, 3, packet));
+    scheduler.messageReceived(0, fragment.message);
+    ASSERT_TRUE(scheduler.next(0.4, 3, packet));
+    EXPECT_EQ(packet.back(), 2);
+    EXPECT_EQ(scheduler.stats(0).sent, 2u);
+}
+
+TEST(TopicScheduler, DescriptionsGoFirst)
+{
+    TopicScheduler scheduler{{{"/teleop", 100, 0, 1, false}}, 1200, 10, 0.3};
+    scheduler.offer(0, std::vector<uint8_t>(8, 1));
+    scheduler.describe(0, std::vector<uint8_t>(30, 9));
+
+    std::vector<uint8_t> packet;
+    ASSERT_TRUE(scheduler.next(0.0, 1, packet));
+    ByteReader reader{packet.data(), packet.size()};
+    PacketHeader header;
+    ASSERT_TRUE(readHeader(reader, header));
+    EXPECT_EQ(header.kind, PacketKind::DESCRIPTION);
+    EXPECT_EQ(header.sequence, 1u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,289 @@
+/*
+ * Runs a robot and a station gateway against each other through a pair of
+ * emulated links, in simulated time, a millisecond a step.
+ * */
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "gateway.h"
+#include "link_emulator.h"
+
+using namespace tfr_gateway;
+
+namespace
+{
+    GatewayOptions gatewayOptions(uint32_t session, double loss_threshold)
+    {
+        return GatewayOptions{1200, 0.1, 0.5, 0.3, 20, 0.05, session,
+            LinkOptions{64000, 4000, 4e6, 0.15, loss_threshold, 1.0}};
+    }
+
+    struct Loopback
+    {
+        Gateway robot;
+        Gateway station;
+        LinkEmulator up;
+        LinkEmulator down;
+        double now;
+        std::vector<Incoming> at_robot;
+        std::vector<Incoming> at_station;
+        //this many of the next datagrams of the kind go missing before the link
+        size_t drop_goals;
+        size_t drop_requests;
+
+        Loopback(const std::vector<TopicConfig>& robot_topics,
+                const std::vector<TopicConfig>& station_topics,
+                const EmulatorOptions& link, double loss_threshold = 0.05) :
+            robot{gatewayOptions(1, loss_threshold), robot_topics},
+            station{gatewayOptions(2, loss_threshold), station_topics},
+            up{link}, down{EmulatorOptions{link.latency, link.jitter, link.bandwidth,
+                link.loss, link.queue_bytes, link.seed + 1}},
+            now{0}, at_robot{}, at_station{}, drop_goals{0}, drop_requests{0}
+        {}
+
+        void step()
+        {
+            now += 0.001;
+            std::vector<std::vector<uint8_t>> packets;
+            robot.poll(now, packets);
+            for (std::vector<uint8_t>& packet : packets)
+                if (!drop(packet, PacketKind::REQUEST, drop_requests))
+                    down.send(std::move(packet), now);
+            packets.clear();
+            station.poll(now, packets);
+            for (std::vector<uint8_t>& packet : packets)
+                if (!drop(packet, PacketKind::MESSAGE, drop_goals))
+                    up.send(std::move(packet), now);
+
+            packets.clear();
+            down.deliver(now, packets);
+            for (const std::vector<uint8_t>& packet : packets)
+                station.receive(packet.data(), packet.size(), now, at_station);
+            packets.clear();
+            up.deliver(now, packets);
+            for (const std::vector<uint8_t>& packet : packets)
+                robot.receive(packet.data(), packet.size(), now, at_robot);
+        }
+
+        static bool drop(const std::vector<uint8_t>& packet, PacketKind kind, size_t& count)
+        {
+            ByteReader reader{packet.data(), packet.size()};
+            PacketHeader header;
+            if (count == 0 || !readHeader(reader, header) || header.kind != kind)
+                return false;
+            count--;
+            return true;
+        }
+    };
+
+    //a message of the given size stamped with when it was made
+    std::vector<uint8_t> stamped(double time, size_t size)
+    {
+        std::vector<uint8_t> message(std::max(size, sizeof(time)), 0);
+        std::memcpy(message.data(), &time, sizeof(time));
+        return message;
+    }
+
+    double stampOf(const std::vector<uint8_t>& message)
+    {
+        double time;
+        std::memcpy(&time, message.data(), sizeof(time));
+        return time;
+    }
+
+    void describe(Gateway& gateway, uint16_t topic, const std::string& name)
+    {
+        gateway.describe(topic, TopicDescription{name, "std_msgs/Empty", "d41d8cd98f00b204e9800998ecf8427e", "", false});
+    }
+}
+
+TEST(GatewayLoopback, DescribesThenDeltas)
+{
+    Loopback loopback{{{"/odom", 40, 0, 1, true}}, {}, EmulatorOptions{0.02, 0, 0, 0, 0, 1}};
+    describe(loopback.robot, 0, "/odom");
+
+    std::vector<uint8_t> message(700, 3);
+    std::vector<std::vector<uint8_t>> sent;
+    for (int i = 0; i < 2100; i++)
+    {
+        if (i % 20 == 0 && i < 2000)
+        {
+            std::memcpy(message.data() + 16, &i, sizeof(i));
+            loopback.robot.offer(0, message);
+            sent.push_back(message);
+        }
+        loopback.step();
+    }
+
+    ASSERT_FALSE(loopback.at_station.empty());
+    EXPECT_EQ(loopback.at_station[0].kind, PacketKind::DESCRIPTION);
+    std::vector<std::vector<uint8_t>> received;
+    for (const Incoming& incoming : loopback.at_station)
+        if (incoming.kind == PacketKind::MESSAGE)
+            received.push_back(incoming.body);
+    ASSERT_EQ(received.size(), sent.size());
+    EXPECT_TRUE(received == sent);
+
+    //most of them went as small deltas
+    const TopicStats& stats = loopback.robot.topics().stats(0);
+    EXPECT_EQ(stats.sent, sent.size());
+    EXPECT_LT(stats.bytes, sent.size() * 700 / 3);
+}
+
+TEST(GatewayLoopback, ResendsAGoalUntilAcknowledged)
+{
+    Loopback loopback{{}, {{"/goal", 100, 0, 4, false, true}}, EmulatorOptions{0.02, 0, 0, 0, 0, 3}};
+    describe(loopback.station, 0, "/goal");
+    for (int i = 0; i < 500; i++)
+        loopback.step();
+    ASSERT_FALSE(loopback.at_robot.empty());
+    loopback.at_robot.clear();
+
+    //the goal's only datagram is lost, then so is the robot's acknowledgement
+    const std::vector<uint8_t> goal = stamped(loopback.now, 64);
+    loopback.station.offer(0, goal);
+    loopback.drop_goals = 1;
+    loopback.drop_requests = 1;
+    for (int i = 0; i < 3000; i++)
+        loopback.step();
+    EXPECT_EQ(loopback.drop_goals, 0u);
+    EXPECT_EQ(loopback.drop_requests, 0u);
+
+    //published once, and the station stopped sending it
+    ASSERT_EQ(loopback.at_robot.size(), 1u);
+    EXPECT_EQ(loopback.at_robot[0].kind, PacketKind::MESSAGE);
+    EXPECT_TRUE(loopback.at_robot[0].body == goal);
+    const TopicStats& stats = loopback.station.topics().stats(0);
+    EXPECT_EQ(stats.sent, 1u);
+    EXPECT_EQ(stats.retransmitted, 2u);
+
+    //the next goal only needs the one try
+    loopback.station.offer(0, stamped(loopback.now, 64));
+    for (int i = 0; i < 1000; i++)
+        loopback.step();
+    EXPECT_EQ(loopback.at_robot.size(), 2u);
+    EXPECT_EQ(stats.retransmitted, 2u);
+}
+
+TEST(GatewayLoopback, MeasuresTheLink)
+{
+    Loopback loopback{{}, {}, EmulatorOptions{0.04, 0, 0, 0.1, 0, 7}};
+    for (int i = 0; i < 20000; i++)
+        loopback.step();
+
+    const LinkStats stats = loopback.station.link(loopback.now);
+    EXPECT_TRUE(stats.connected);
+    EXPECT_NEAR(stats.rtt, 0.08, 0.005);
+    EXPECT_NEAR(stats.min_rtt, 0.08, 0.005);
+    EXPECT_GT(stats.loss, 0.02);
+    EXPECT_LT(stats.loss, 0.3);
+
+    //nothing comes back once the link is gone
+    EmulatorOptions dead{0.04, 0, 0, 1.0, 0, 7};
+    Loopback cut{{}, {}, dead};
+    for (int i = 0; i < 2000; i++)
+        cut.step();
+    EXPECT_FALSE(cut.station.link(cut.now).connected);
+}
+
+TEST(GatewayLoopback, TeleopStaysResponsiveOnASaturatedLink)
+{
+    //40kB/s each way with a quarter second of buffer, far less than the camera wants
+    Loopback loopback{
+        {{"/camera", 10, 0, 1, false}, {"/teleop_feedback", 90, 0, 4, false}},
+        {{"/teleop_goal", 100, 0, 4, false}},
+        EmulatorOptions{0.03, 0.005, 40000, 0, 10000, 3}};
+    describe(loopback.robot, 0, "/camera");
+    describe(loopback.robot, 1, "/teleop_feedback");
+    describe(loopback.station, 0, "/teleop_goal");
+
+    std::vector<double> goal_latency, feedback_latency;
+    size_t frames = 0, feedback = 0;
+    for (int i = 0; i < 30000; i++)
+    {
+        //a 30kB frame at 10hz, 300kB/s offered into a 40kB/s link
+        if (i % 100 == 0)
+            loopback.robot.offer(0, stamped(loopback.now, 30000));
+        if (i % 50 == 0)
+        {
+            loopback.station.offer(0, stamped(loopback.now, 60));
+            loopback.robot.offer(1, stamped(loopback.now, 80));
+        }
+        loopback.step();
+
+        for (const Incoming& incoming : loopback.at_robot)
+            if (incoming.kind == PacketKind::MESSAGE)
+                goal_latency.push_back(loopback.now - stampOf(incoming.body));
+        for (const Incoming& incoming : loopback.at_station)
+        {
+            if (incoming.kind != PacketKind::MESSAGE)
+                continue;
+            if (incoming.topic != 1)
+            {
+                frames++;
+                continue;
+            }
+            feedback++;
+            //past the first few seconds, spent filling the link's buffer finding its limit
+            if (loopback.now > 5.0)
+                feedback_latency.push_back(loopback.now - stampOf(incoming.body));
+        }
+        loopback.at_robot.clear();
+        loopback.at_station.clear();
+    }
+
+    //every goal and bit of feedback made it, quickly, while the camera got what was left
+    EXPECT_GE(goal_latency.size(), 599u);
+    EXPECT_GE(feedback, 599u);
+    std::sort(goal_latency.begin(), goal_latency.end());
+    std::sort(feedback_latency.begin(), feedback_latency.end());
+    //the link alone takes 30ms, and up to 250ms with its buffer full
+    EXPECT_LT(goal_latency[goal_latency.size() * 99 / 100], 0.1);
+    EXPECT_LT(feedback_latency[feedback_latency.size() * 99 / 100], 0.2);
+    EXPECT_GT(frames, 10u);
+    EXPECT_GT(loopback.robot.topics().stats(0).dropped, 100u);
+
+    //the budget came down from 64kB/s to about what the link carries
+    const LinkStats stats = loopback.robot.link(loopback.now);
+    EXPECT_LT(stats.budget, 48000);
+    EXPECT_GT(stats.delivered_rate, 20000);
+}
+
+TEST(GatewayLoopback, LossyDeltasNeverCorrupt)
+{
+    //loss this heavy would normally back the budget right off, it is the codec under test here
+    Loopback loopback{{{"/odom", 40, 0, 1, true}}, {}, EmulatorOptions{0.02, 0, 0, 0.2, 0, 11}, 1.0};
+    describe(loopback.robot, 0, "/odom");
+
+    std::vector<uint8_t> message(2500, 1);
+    std::vector<std::vector<uint8_t>> sent;
+    for (int i = 0; i < 20000; i++)
+    {
+        if (i % 20 == 0)
+        {
+            std::memcpy(message.data() + (i / 20) % 2400, &i, sizeof(i));
+            loopback.robot.offer(0, message);
+            sent.push_back(message);
+        }
+        loopback.step();
+    }
+
+    size_t delivered = 0;
+    for (const Incoming& incoming : loopback.at_station)
+    {
+        if (incoming.kind != PacketKind::MESSAGE)
+            continue;
+        EXPECT_NE(std::find(sent.begin(), sent.end(), incoming.body), sent.end());
+        delivered++;
+    }
+    //a lost keyframe only costs itself, deltas keep using the last one that arrived
+    EXPECT_GT(delivered, sent.size() / 2);
+    EXPECT_GT(loopback.station.incomplete(), 0u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -7,9 +7,20 @@
  * Needs access to the image wrapper topic wrapper to fetch images, 
  * name is specified as a parameter.
  *
+ * Detection runs continuously while the robot turns. Once the board has been
+ * sighted, its bearing is predicted from the last sighting and the yaw rate
+ * reported by the imu, so the robot turns the shorter way towards the target
+ * yaw and slows down as it approaches it.
+ *
  * parameters:
  *  - ~turn_speed: how fast to turn [rad/s] (double, default: 0.0)
  *  - ~turn_duration: how long to turn [s] (double, default: 0.0)
+ *  - ~min_turn_velocity: slowest turn used while approaching [rad/s] (double, default: 0.15)
+ *  - ~approach_gain: turn speed per radian of predicted error [1/s] (double, default: 1.5)
+ *  - ~sighting_timeout: how long a sighting is trusted for prediction [s] (double, default: 3.0)
+ *
+ * subscribed topics:
+ *  - /sensors/imu the imu yaw rate used for prediction (sensor_msgs/Imu)
  *
  * published topics:
  *  - /cmd_vel publishes to the drivebase (geometry_msgs/Twist)
@@ -24,6 +35,9 @@
 #include <tfr_msgs/PoseSrv.h>
 #include <tfr_utilities/tf_manipulator.h>
 #include <geometry_msgs/Twist.h>
+#include <sensor_msgs/Imu.h>
+#include <cmath>
+#include <mutex>
 
 class Localizer
 {
@@ -33,6 +47,7 @@ class Localizer
             aruco{n, "aruco_action_server"},
             server{n, "localize", boost::bind(&Localizer::localize, this, _1) ,false},
             cmd_publisher{n.advertise<geometry_msgs::Twist>("cmd_vel", 5)},
+            imu_subscriber{n.subscribe("/sensors/imu", 20, &Localizer::integrateYaw, this)},
             turn_velocity{velocity},
             turn_duration{duration},
             threshold{thresh}
@@ -69,6 +84,7 @@ class Localizer
         actionlib::SimpleActionServer<tfr_msgs::LocalizationAction> server;
         actionlib::SimpleActionClient<tfr_msgs::ArucoAction> aruco;
         ros::Publisher cmd_publisher;
+        ros::Subscriber imu_subscriber;
         ros::ServiceClient rear_cam_client;
         ros::ServiceClient front_cam_client;
         TfManipulator tf_manipulator;
@@ -76,6 +92,19 @@ class Localizer
         double turn_duration;
         double threshold;
 
+        //yaw integrated from the imu, only meaningful relative to itself
+        std::mutex heading_mutex;
+        double heading = 0;
+        ros::Time last_imu_stamp{};
+
+        //the last time we saw the board, and where we were pointing
+        bool sighted = false;
+        double sighting_bearing = 0;
+        double sighting_heading = 0;
+        ros::Time sighting_time{};
+        //the camera which saw the board last gets asked first
+        bool rear_first = true;
+
         void localize( const tfr_msgs::LocalizationGoalConstPtr &goal)
         {
             ROS_INFO("Localization Action Server: Localize Starting");
@@ -89,6 +118,9 @@ class Localizer
             ROS_INFO("Localization Action Server: odometry %s, target yaw %f",
                     odometry ? "set": "unset", goal->target_yaw);
 
+            //a sighting from the last goal says nothing about this one
+            sighted = false;
+
             tfr_msgs::LocalizationResult output;
             //loop
             while (true) {
@@ -98,6 +130,8 @@ class Localizer
                 
                 if ( not ros::param::getCached("~turn_velocity", turn_velocity)) {turn_velocity = .5;}
                 
+                //the heading when the image was taken, not when it was processed
+                double capture_heading = getHeading();
                 tfr_msgs::ArucoResultConstPtr result = getArucoResult();
                 
                 
@@ -147,7 +181,13 @@ class Localizer
                          processed_pose.pose.orientation.z * processed_pose.pose.orientation.z );  
                     auto angle = atan2(siny, cosy);
 
-                    auto difference = std::abs(goal->target_yaw) - std::abs(angle);
+                    sighted = true;
+                    sighting_bearing = angle;
+                    sighting_heading = capture_heading;
+                    sighting_time = ros::Time::now();
+
+                    //the same error the search turns to close, signed the same way
+                    auto difference = bearingError(angle, goal->target_yaw);
                     ROS_INFO("Angle %f Difference %f", angle, difference);
                     if (std::abs(difference) < threshold)
                     {
@@ -172,7 +212,7 @@ class Localizer
                 ROS_INFO("Localization Action Server: turning");
 
                 geometry_msgs::Twist cmd;
-                cmd.angular.z = turn_velocity; 
+                cmd.angular.z = searchVelocity(goal->target_yaw);
                 cmd_publisher.publish(cmd); 
                 //Removed the below to try and continuously spin until we localize
               //  ros::Duration(turn_duration).sleep(); 
@@ -192,21 +232,86 @@ class Localizer
             ROS_INFO("Localization Action Server: Localize Finished");
         }
         
+        /*
+         * Picks the turn velocity for the next iteration. Until the board has
+         * been seen we turn blind at the configured velocity. Afterwards we
+         * predict the bearing of the board from the imu yaw swept since the
+         * sighting, turn the shorter way towards the target yaw, and slow
+         * down proportionally to the remaining error.
+         * */
+        double searchVelocity(const double target_yaw)
+        {
+            double min_velocity, gain, timeout;
+            if (not ros::param::getCached("~min_turn_velocity", min_velocity)) {min_velocity = 0.15;}
+            if (not ros::param::getCached("~approach_gain", gain)) {gain = 1.5;}
+            if (not ros::param::getCached("~sighting_timeout", timeout)) {timeout = 3.0;}
+
+            if (not sighted || (ros::Time::now() - sighting_time).toSec() > timeout)
+                return turn_velocity;
+
+            //turning counterclockwise sweeps the board clockwise in our frame
+            double predicted = normalizeAngle(sighting_bearing -
+                    (getHeading() - sighting_heading));
+            double error = bearingError(predicted, target_yaw);
+            double speed = std::max(min_velocity, gain * std::abs(error));
+            speed = std::min(speed, std::abs(turn_velocity));
+            ROS_INFO("Localization Action Server: predicted %f error %f", predicted, error);
+            return std::copysign(speed, error);
+        }
+
         tfr_msgs::ArucoResultConstPtr getArucoResult(){
             tfr_msgs::ArucoResultConstPtr result = nullptr;
             tfr_msgs::WrappedImage image_wrapper{};
-            //rear camera
-            if (rear_cam_client.call(image_wrapper))
+            ros::ServiceClient& first = rear_first ? rear_cam_client : front_cam_client;
+            ros::ServiceClient& second = rear_first ? front_cam_client : rear_cam_client;
+
+            if (first.call(image_wrapper))
                 result = sendAruco(image_wrapper);
-            ROS_INFO("Localization Action Server: rearcam %d", result->number_found);
+            if (result != nullptr && result->number_found > 0)
+                return result;
 
-            //front camera 
-            if (result != nullptr && result->number_found == 0 && front_cam_client.call(image_wrapper))
+            if (second.call(image_wrapper))
                 result = sendAruco(image_wrapper);
-            ROS_INFO("Localization Action Server: frontcam %d", result->number_found);
+            ROS_INFO("Localization Action Server: %s %d", rear_first ? "frontcam" : "rearcam",
+                    result == nullptr ? 0 : result->number_found);
+            if (result != nullptr && result->number_found > 0)
+                rear_first = not rear_first;
             return result;
         }
 
+        /*
+         * Integrates the imu yaw rate into a running heading, skipping any
+         * gaps too large to integrate across.
+         * */
+        void integrateYaw(const sensor_msgs::ImuConstPtr &imu)
+        {
+            std::lock_guard<std::mutex> lock(heading_mutex);
+            if (not last_imu_stamp.isZero())
+            {
+                double dt = (imu->header.stamp - last_imu_stamp).toSec();
+                if (dt > 0 && dt < 0.5)
+                    heading += imu->angular_velocity.z * dt;
+            }
+            last_imu_stamp = imu->header.stamp;
+        }
+
+        double getHeading()
+        {
+            std::lock_guard<std::mutex> lock(heading_mutex);
+            return heading;
+        }
+
+        static double normalizeAngle(double angle)
+        {
+            return std::atan2(std::sin(angle), std::cos(angle));
+        }
+
+        //how far the board's bearing is from where we want it, the short way round
+        static double bearingError(double bearing, double target_yaw)
+        {
+            return normalizeAngle(bearing - target_yaw);
+        }
+
         tfr_msgs::ArucoResultConstPtr sendAruco(const tfr_msgs::WrappedImage& msg) {
             tfr_msgs::ArucoGoal goal;
             goal.image = msg.response.image;
@@ -0,0 +1,103 @@
+/****************************************************************************************
+ * File:            adaptive_dig.h
+ *
+ * Purpose:         Decides when a DIG state of the digging queue is done. The
+ *                  waypoint of a DIG state is the deepest the scoop is allowed
+ *                  to go, but in packed regolith the drives stall long before
+ *                  they get there, and in loose regolith the scoop is full
+ *                  early. So while the arm digs the lower arm and scoop torque
+ *                  is watched, and once either of them stays over its limit the
+ *                  scoop counts as loaded and the queue goes straight on to the
+ *                  next state, which lifts it out.
+ *
+ *                  Torques are in per mille of the drive's rated torque, as the
+ *                  drives stream them. The first moments of a move are ignored,
+ *                  the drives need extra torque to get going.
+ *
+ *                  It is off until the limits are calibrated, see
+ *                  tfr_mining/data/adaptive_dig.yaml.
+ *
+ * Parameters:      ~adaptive_dig/enabled: watch the torque at all (bool, default false)
+ *                  ~adaptive_dig/lower_arm_max_torque: (double, default 600)
+ *                  ~adaptive_dig/scoop_max_torque: (double, default 600)
+ *                  ~adaptive_dig/samples: how many samples in a row have to be
+ *                                         over the limit (int, default 3)
+ *                  ~adaptive_dig/ignore_time: seconds ignored at the start of
+ *                                             a move (double, default 0.3)
+ ***************************************************************************************/
+#ifndef ADAPTIVE_DIG_H
+#define ADAPTIVE_DIG_H
+
+#include <ros/ros.h>
+#include <cstddef>
+
+namespace tfr_mining
+{
+    class AdaptiveDig
+    {
+    public:
+        struct Envelope
+        {
+            bool enabled;
+            double lower_arm_max_torque;
+            double scoop_max_torque;
+            int samples;
+            double ignore_time;
+        };
+
+        enum Status
+        {
+            IDLE,
+            DIGGING,
+            LOADED,
+        };
+
+        enum Joint
+        {
+            LOWER_ARM,
+            SCOOP,
+        };
+
+        explicit AdaptiveDig(const Envelope& envelope);
+        ~AdaptiveDig() = default;
+        AdaptiveDig(const AdaptiveDig&) = delete;
+        AdaptiveDig& operator=(const AdaptiveDig&) = delete;
+        AdaptiveDig(AdaptiveDig&&) = delete;
+        AdaptiveDig& operator=(AdaptiveDig&&) = delete;
+
+        /*
+         * Reads the envelope from ~adaptive_dig, nh must be a private node
+         * handle.
+         * */
+        static Envelope loadEnvelope(ros::NodeHandle& nh);
+
+        /*
+         * Starts watching a dig that begins at time (seconds).
+         * */
+        void start(double time);
+        void stop();
+
+        /*
+         * Takes one torque sample of joint, taken at time (seconds).
+         * */
+        void addTorque(Joint joint, double time, double torque);
+
+        Status getStatus() const;
+
+        /*
+         * The largest torque seen on joint since start, for the logs.
+         * */
+        double getPeakTorque(Joint joint) const;
+
+    private:
+        static const size_t JOINTS = 2;
+
+        Envelope envelope;
+        Status status;
+        double start_time;
+        int over_limit[JOINTS];
+        double peak_torque[JOINTS];
+    };
+}
+
+#endif // ADAPTIVE_DIG_H
@@ -0,0 +1,52 @@
+/****************************************************************************************
+ * File:            arm_collision_check.h
+ *
+ * Purpose:         Checks an arm position, in drive radians, against the robot
+ *                  model for self collision. Uses the urdf and srdf loaded
+ *                  for moveit (tfr_moveit), so the allowed collisions are the
+ *                  same ones the arm planner uses.
+ ***************************************************************************************/
+#ifndef ARM_COLLISION_CHECK_H
+#define ARM_COLLISION_CHECK_H
+
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <string>
+#include <vector>
+#include "joint_mapping.h"
+#include "queue_compiler.h"
+
+namespace tfr_mining
+{
+    class ArmCollisionCheck
+    {
+    public:
+        /*
+         * mappings: drive to urdf radians per joint, in ArmCommand order
+         * */
+        ArmCollisionCheck(const std::string& robot_description,
+                const std::vector<JointMapping>& mappings);
+        ~ArmCollisionCheck() = default;
+        ArmCollisionCheck(const ArmCollisionCheck&) = delete;
+        ArmCollisionCheck& operator=(const ArmCollisionCheck&) = delete;
+        ArmCollisionCheck(ArmCollisionCheck&&) = delete;
+        ArmCollisionCheck& operator=(ArmCollisionCheck&&) = delete;
+
+        /*
+         * False if the robot model couldn't be loaded.
+         * */
+        bool isValid() const;
+
+        /*
+         * True if the arm hits itself at position, contact names the links.
+         * */
+        bool inCollision(const QueueCompiler::Waypoint& position, std::string& contact);
+
+    private:
+        robot_model_loader::RobotModelLoader loader;
+        planning_scene::PlanningScenePtr scene;
+        std::vector<JointMapping> mappings;
+    };
+}
+
+#endif // ARM_COLLISION_CHECK_H
@@ -0,0 +1,128 @@
+/****************************************************************************************
+ * File:            dig_scheduler.h
+ *
+ * Purpose:         Picks which sets of the digging queue to run in the digging
+ *                  time the mission clock gives us.
+ *
+ *                  Every set digs at a hole, found from the turntable angle of
+ *                  its first dig state (or its first state). The sets of a
+ *                  hole go deeper one after the other, so a hole's sets only
+ *                  ever run in queue order, and any plan takes some number of
+ *                  them from the front of every hole. Out of those plans the
+ *                  one with the most expected regolith that fits in the time
+ *                  left is found by dynamic programming over time, and its
+ *                  sets run in queue order.
+ *
+ *                  After every set the plan is made again with what was
+ *                  measured: the sets so far ran some factor slower or faster
+ *                  than estimated, and every remaining estimate is scaled by
+ *                  it, and a hole's expected yield becomes the average of its
+ *                  configured yield and the scoops weighed there. Only sets
+ *                  that fit whole are started, so digging ends between sets
+ *                  with margin seconds still left over.
+ *
+ * Parameters:      ~scheduler/hole_turntables: turntable angles of known holes (list, default empty)
+ *                  ~scheduler/hole_yields: expected kg per set at those holes (list, default empty)
+ *                  ~scheduler/default_yield: expected kg per set anywhere else (double, default 1.0)
+ *                  ~scheduler/hole_tolerance: how close in turntable radians sets
+ *                                             have to be to share a hole (double, default 0.05)
+ *                  ~scheduler/resolution: time step of the plan in seconds (double, default 1.0)
+ *                  ~scheduler/margin: seconds of digging time never planned into (double, default 5.0)
+ ***************************************************************************************/
+#ifndef DIG_SCHEDULER_H
+#define DIG_SCHEDULER_H
+
+#include <ros/ros.h>
+#include <cstddef>
+#include <vector>
+#include "digging_queue.h"
+
+namespace tfr_mining
+{
+    class DigScheduler
+    {
+    public:
+        struct Options
+        {
+            std::vector<double> hole_turntables;
+            std::vector<double> hole_yields;
+            double default_yield;
+            double hole_tolerance;
+            double resolution;
+            double margin;
+        };
+
+        /*
+         * Reads the options from ~scheduler, nh must be a private node handle.
+         * */
+        static Options loadOptions(ros::NodeHandle& nh);
+
+        DigScheduler(const DiggingQueue& queue, const Options& options);
+
+        /*
+         * The same from one entry per set: how long it is estimated to take
+         * and the turntable angle it digs at, NaN for a set with nothing to
+         * dig.
+         * */
+        DigScheduler(const std::vector<double>& set_times,
+                const std::vector<double>& set_turntables, const Options& options);
+        ~DigScheduler() = default;
+        DigScheduler(const DigScheduler&) = delete;
+        DigScheduler& operator=(const DigScheduler&) = delete;
+        DigScheduler(DigScheduler&&) = delete;
+        DigScheduler& operator=(DigScheduler&&) = delete;
+
+        /*
+         * Plans the rest of the dig in remaining seconds, and returns false if
+         * no set fits, so a remaining time of zero or less digs nothing.
+         * */
+        bool next(double remaining, size_t& set);
+
+        /*
+         * The next set with no time limit: every set runs, in queue order.
+         * Returns false once they all have.
+         * */
+        bool nextWithoutLimit(size_t& set);
+
+        /*
+         * Tells the scheduler set has run, in measured seconds, and dug
+         * measured_yield kg, or less than zero if it wasn't weighed.
+         * */
+        void finished(size_t set, double measured_time, double measured_yield);
+
+        size_t getHoleCount() const;
+        size_t getHole(size_t set) const;
+
+        /*
+         * What the remaining sets are expected to take with the timing so far.
+         * */
+        double getTimeScale() const;
+
+    private:
+        struct Hole
+        {
+            double turntable;
+            double yield;
+            double measured_yield;
+            int measured_sets;
+            // the hole's sets in queue order, and how many of them have run
+            std::vector<size_t> sets;
+            size_t done;
+        };
+
+        std::vector<double> set_times;
+        std::vector<size_t> set_holes;
+        std::vector<Hole> holes;
+        double resolution;
+        double margin;
+        double estimated_total;
+        double measured_total;
+
+        double expectedYield(const Hole& hole) const;
+
+        static std::vector<double> getSetTimes(const DiggingQueue& queue);
+        static std::vector<double> getSetTurntables(const DiggingQueue& queue);
+    };
+}
+
+#endif // DIG_SCHEDULER_H
@@ -1,61 +1,113 @@
 /****************************************************************************************
  * File:            digging_queue.h
- * 
+ *
  * Purpose:         This class implements a queue of digging sets, used to
  *                  execute large sets of digging actions in a row. It
  *                  instantiates all of its stored states on construction, and
- *                  we then pop from it until we run out of states or we
+ *                  we then walk through it until we run out of states or we
  *                  run out of time to dig.
+ *
+ *                  Every state of every set lives in one contiguous array,
+ *                  with the sets marked by offsets into it, so walking the
+ *                  queue never allocates and stays in cache even for long
+ *                  multi hole queues. The sets handed out are read only views
+ *                  into that array.
+ *
+ *                  Every set is timed by DiggingTrajectory when it is loaded,
+ *                  so the time estimates come from the arm's limits.
+ *
+ * Parameters:      ~compiled_queue: a queue from compile_digging_queue, used
+ *                                   instead of ~positions when given (string)
+ *                  ~positions: the sets of waypoints (list of lists of rows),
+ *                              refused if any row fails QueueCompiler's checks
+ *                  ~trajectory_sample_period: trajectory point spacing in seconds (double, default 0.1)
+ *                  ~settle_time: time spent confirming the arm stopped at each
+ *                                waypoint in seconds (double, default 0.2)
  ***************************************************************************************/
 #ifndef DIGGING_QUEUE_H
 #define DIGGING_QUEUE_H
 
 #include <ros/ros.h>
-#include <queue>
+#include <cstdint>
+#include <vector>
 #include "digging_set.h"
+#include "digging_trajectory.h"
 
 namespace tfr_mining
 {
     class DiggingQueue
     {
     public:
+        /**
+         * Walks the sets of a queue in order.
+         **/
+        class const_iterator
+        {
+        public:
+            const_iterator(const DiggingQueue& queue, size_t set);
+            DiggingSet operator*() const;
+            const_iterator& operator++();
+            bool operator!=(const const_iterator& other) const;
+
+        private:
+            const DiggingQueue* queue;
+            size_t set;
+        };
+
         /**
          * Constructs the queue and instantiates all of the digging sets inside
          * it.
          **/
         DiggingQueue(ros::NodeHandle nh);
         ~DiggingQueue() = default;
+        // the sets point into the queue, so it stays put
+        DiggingQueue(const DiggingQueue&) = delete;
+        DiggingQueue& operator=(const DiggingQueue&) = delete;
+        DiggingQueue(DiggingQueue&&) = delete;
+        DiggingQueue& operator=(DiggingQueue&&) = delete;
 
         /**
          * Returns whether this queue is empty or not.
          **/
-        bool isEmpty();
+        bool isEmpty() const;
 
         /**
-         * Returns the next set in the queue and removes it.
+         * Returns the number of sets in the queue.
          **/
-        DiggingSet popDiggingSet();
-        std::queue<DiggingSet> sets;
-    private:
-        
+        size_t size() const;
 
         /**
-         * Helper method to generate a single dig, without any side dumping.
+         * Returns set i of the queue.
          **/
-        void generateSingleDig(ros::NodeHandle &nh, DiggingSet &set, double rotation, int dig_number);
+        DiggingSet operator[](size_t set) const;
+
+        const_iterator begin() const;
+        const_iterator end() const;
 
         /**
-         * Helper method which generates a set of digging positions. Generates ready pos -> dig pos (penetrating dirt)
-         * -> scoop pos (moving scoop upwards to remove dirt) -> out pos (scoop horizontal out of dirt) -> either bin
-         * dump (if dig_number > 2) or dump to side (if dig_number <= 2)
-         * 
-         * The rotation parameter is the angle of the dumping position (angle of the turntable for digs). Dig number is
-         * which dig this is in the set (aka in this hole we're digging, is this the first scoop, second scoop, etc?).
-         * This is used to determine whether we should dump to the side or into the bin.
+         * Gets the time estimate for every set in the queue.
          **/
-        void generateDigAndDump(ros::NodeHandle &nh, DiggingSet &set, double rotation, int dig_number);
+        double getTimeEstimate() const;
 
-        void loadTestingDig(ros::NodeHandle &nh, DiggingSet &set, std::string pos_name);
+    private:
+        std::vector<Waypoint> states;
+        std::vector<StateKind> state_kinds;
+        std::vector<double> state_times;
+        // set i is states[set_offsets[i]] up to states[set_offsets[i + 1]]
+        std::vector<uint32_t> set_offsets;
+        std::vector<double> set_times;
+        std::vector<trajectory_msgs::JointTrajectory> trajectories;
+        double time_estimate;
+
+        /**
+         * Loads states, state_kinds and set_offsets from ~compiled_queue or ~positions.
+         **/
+        bool load(ros::NodeHandle& nh, const std::vector<DiggingTrajectory::JointLimits>& limits);
+
+        /**
+         * Times every set, each one starting where the last one ended.
+         **/
+        void timeSets(const DiggingTrajectory& trajectory);
     };
 }
 
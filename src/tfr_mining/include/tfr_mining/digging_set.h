@@ -1,49 +1,90 @@
 /****************************************************************************************
  * File:            digging_set.h
- * 
+ *
  * Purpose:         This class implements a set of digging states with a time
- *                  estimate. It is intended to be instantiated only by
- *                  DiggingQueue, and then used by the DiggingActionServer after
- *                  being returned out.
+ *                  estimate. It is a read only view into the storage of the
+ *                  DiggingQueue that made it, so it is cheap to copy and the
+ *                  states of a set sit next to each other in memory. It is
+ *                  only valid as long as that queue is.
  ***************************************************************************************/
 #ifndef DIGGING_SET_H
 #define DIGGING_SET_H
 
-#include <queue>
-#include <vector>
+#include <trajectory_msgs/JointTrajectory.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 
 namespace tfr_mining
 {
+    // turntable, lower arm, upper arm, scoop
+    constexpr size_t ARM_JOINTS = 4;
+
+    // one target per arm joint, in the drives' own radians
+    using Waypoint = std::array<double, ARM_JOINTS>;
+
+    /*
+     * How the executor treats reaching a state.
+     * */
+    enum StateKind : uint8_t
+    {
+        // move there and wait for the arm to stop
+        MOVE,
+        // move there, but go on to the next state as soon as the lower arm or
+        // scoop hits its torque envelope (see AdaptiveDig)
+        DIG,
+    };
+
     class DiggingSet
     {
     public:
-        DiggingSet();
-        ~DiggingSet() = default;
         /**
-         * Inserts a new state into this set, and increases the time estimate
-         * accordingly.
+         * states, state_kinds and state_times all hold size entries,
+         * trajectory is the whole set as a timed joint trajectory.
          **/
-        void insertState(std::vector<double> state, double time);
+        DiggingSet(const Waypoint* states, const StateKind* state_kinds, const double* state_times,
+                size_t size, double time_estimate, const trajectory_msgs::JointTrajectory* trajectory);
+        ~DiggingSet() = default;
+        DiggingSet(const DiggingSet&) = default;
+        DiggingSet& operator=(const DiggingSet&) = default;
 
         /**
          * Returns whether this set is empty or not.
          **/
-        bool isEmpty();
+        bool isEmpty() const;
+
+        size_t size() const;
 
         /**
-         * Returns the next state in this set and removes it.
+         * Returns state i of the set.
          **/
-        std::vector<double> popState();
+        const Waypoint& operator[](size_t i) const;
+
+        StateKind getStateKind(size_t i) const;
+
+        /**
+         * Gets how long reaching state i is expected to take.
+         **/
+        double getStateTime(size_t i) const;
 
         /**
          * Gets the time estimate for the set as a whole (cumulative for all
          * states).
          **/
-        double getTimeEstimate();
-        std::queue<std::vector<double> > states;
+        double getTimeEstimate() const;
+
+        const trajectory_msgs::JointTrajectory& getTrajectory() const;
+
+        const Waypoint* begin() const;
+        const Waypoint* end() const;
+
     private:
-        
+        const Waypoint* states;
+        const StateKind* state_kinds;
+        const double* state_times;
+        size_t count;
         double time_estimate;
+        const trajectory_msgs::JointTrajectory* trajectory;
     };
 }
 
@@ -0,0 +1,130 @@
+/****************************************************************************************
+ * File:            digging_trajectory.h
+ *
+ * Purpose:         Turns the bare waypoints of a digging set into a time
+ *                  parameterised joint trajectory, and gives every waypoint a
+ *                  real time estimate instead of a constant.
+ *
+ *                  The executor stops at every waypoint, so each segment is a
+ *                  rest to rest move along a straight line in joint space
+ *                  (every joint starts and finishes together, like the drive
+ *                  profiles ArmManipulator sends). Along that line the path
+ *                  parameter follows the time optimal jerk limited S-curve:
+ *                  jerk up, constant acceleration, jerk down, cruise, and the
+ *                  mirror image to stop. The limits on the path are the
+ *                  tightest of max / distance over the moving joints, so no
+ *                  joint ever exceeds its own velocity, acceleration or jerk.
+ *
+ *                  The estimates only hold while the CAN bridge applies those
+ *                  profiles (/arm_command/profiled), otherwise the drives move
+ *                  with their own. The digging server publishes each set's
+ *                  trajectory on digging_trajectory as it starts it.
+ *
+ *                  All positions are in the drives' own radians, the units the
+ *                  digging queue is written in.
+ *
+ * Parameters:      /arm_profile/<joint_name>/
+ *                      max_velocity:     rad/s (double)
+ *                      max_acceleration: rad/s^2 (double)
+ *                      max_jerk:         rad/s^3 (double)
+ *                      min_position, max_position: optional position limits,
+ *                          used instead of the urdf ones (double)
+ *                  /robot_description: urdf joint limits, mapped into drive
+ *                      units by JointMapping
+ ***************************************************************************************/
+#ifndef DIGGING_TRAJECTORY_H
+#define DIGGING_TRAJECTORY_H
+
+#include <trajectory_msgs/JointTrajectory.h>
+#include <vector>
+#include "digging_set.h"
+
+namespace tfr_mining
+{
+    class DiggingTrajectory
+    {
+    public:
+        struct JointLimits
+        {
+            double min_position;
+            double max_position;
+            double max_velocity;
+            double max_acceleration;
+            double max_jerk;
+        };
+
+        /*
+         * One rest to rest S-curve over distance, the phase durations are
+         * enough to rebuild the whole curve.
+         * */
+        struct SCurve
+        {
+            double distance;
+            double jerk;
+            double jerk_time;     // time spent ramping acceleration up (or down)
+            double accel_time;    // whole speed up phase, including the jerk ramps
+            double cruise_time;
+            double peak_velocity;
+
+            double duration() const;
+            // position, velocity and acceleration at time t into the move
+            void sample(double t, double& position, double& velocity, double& acceleration) const;
+        };
+
+        /*
+         * limits: one per arm joint (ARM_JOINTS), in ArmCommand order
+         * sample_period: spacing of the trajectory points in seconds
+         * settle_time: time the executor spends confirming the arm stopped at
+         *              each waypoint, added to every time estimate
+         * */
+        DiggingTrajectory(const std::vector<JointLimits>& limits,
+                double sample_period, double settle_time);
+        ~DiggingTrajectory() = default;
+        DiggingTrajectory(const DiggingTrajectory&) = default;
+        DiggingTrajectory& operator=(const DiggingTrajectory&) = default;
+        DiggingTrajectory(DiggingTrajectory&&) = default;
+        DiggingTrajectory& operator=(DiggingTrajectory&&) = default;
+
+        /*
+         * Reads the limits from the parameter server, see the header comment.
+         * */
+        static std::vector<JointLimits> loadLimits();
+
+        /*
+         * Gets the limits the generator was built with.
+         * */
+        const std::vector<JointLimits>& getLimits() const;
+
+        /*
+         * The fastest rest to rest S-curve covering distance.
+         * */
+        static SCurve solve(double distance, double max_velocity,
+                double max_acceleration, double max_jerk);
+
+        /*
+         * How long the straight line move from one waypoint to the next takes.
+         * */
+        double segmentTime(const Waypoint& from, const Waypoint& to) const;
+
+        /*
+         * Times count waypoints starting from start (the arm position before
+         * them). Fills state_times with how long reaching each one takes and
+         * trajectory with the whole thing, returns the total.
+         * */
+        double parameterize(const Waypoint& start, const Waypoint* waypoints, size_t count,
+                double* state_times, trajectory_msgs::JointTrajectory& trajectory) const;
+
+        static const char* const joint_names[];
+
+    private:
+        std::vector<JointLimits> limits;
+        double sample_period;
+        double settle_time;
+
+        SCurve segment(const Waypoint& from, const Waypoint& to) const;
+        void appendPoint(const Waypoint& from, const Waypoint& to, const SCurve& curve,
+                double t, double offset, trajectory_msgs::JointTrajectory& trajectory) const;
+    };
+}
+
+#endif // DIGGING_TRAJECTORY_H
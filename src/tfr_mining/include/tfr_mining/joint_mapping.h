@@ -0,0 +1,40 @@
+/****************************************************************************************
+ * File:            joint_mapping.h
+ *
+ * Purpose:         Converts between the drives' own radians, which the digging
+ *                  queue is written in, and the urdf joint radians that the
+ *                  model's limits and collision geometry use.
+ *
+ *                  Every joint is a straight line, joint = scale * drive + offset.
+ *                  It is either given directly or taken from the same two points
+ *                  the control node calibrates the absolute encoders with.
+ *
+ * Parameters:      /arm_profile/<joint_name>/joint_scale, joint_offset: the line,
+ *                      used first if both are given (double)
+ *                  /absolute_position_encoder_limits/<joint_name>/encoder, joint:
+ *                      the calibration points, used otherwise
+ ***************************************************************************************/
+#ifndef JOINT_MAPPING_H
+#define JOINT_MAPPING_H
+
+#include <string>
+
+namespace tfr_mining
+{
+    struct JointMapping
+    {
+        double scale;
+        double offset;
+
+        double toJoint(double drive) const;
+        double toDrive(double joint) const;
+
+        /*
+         * Reads the mapping for joint from the parameter server, returns
+         * false and leaves mapping alone if neither form is there.
+         * */
+        static bool load(const std::string& joint, JointMapping& mapping);
+    };
+}
+
+#endif // JOINT_MAPPING_H
@@ -0,0 +1,93 @@
+/****************************************************************************************
+ * File:            payload_estimator.h
+ *
+ * Purpose:         Estimates how much regolith is in the scoop from the static
+ *                  torque on the lower arm, upper arm and scoop drives.
+ *
+ *                  With the arm stopped, each of those joints holds up the
+ *                  links past it plus the payload. The links' share comes from
+ *                  the masses and centres of mass in the urdf, what is left is
+ *                  the payload pulling down at a point in the scoop. The lever
+ *                  arm of that point about each joint comes from the urdf
+ *                  kinematics at the current pose, so the three joints give
+ *                  three measures of the same mass, which are combined by
+ *                  least squares.
+ *
+ *                  The drives report torque in per mille of their rated
+ *                  torque. How that maps to torque on the joint (gearing, the
+ *                  lever of the linear actuators) is a per joint calibration:
+ *                  put a known mass in the scoop at the weigh pose and adjust
+ *                  torque_scale until it reads right. A joint with no scale is
+ *                  left out.
+ *
+ * Parameters:      ~payload/link: the link the payload rides in (string, default scoop)
+ *                  ~payload/point: where the payload sits in that link, x y z in
+ *                                  m (list, default the link's centre of mass)
+ *                  ~payload/<joint_name>/torque_scale: joint torque in N m for
+ *                      one per mille of drive torque (double, default 0)
+ *                  ~payload/<joint_name>/torque_offset: added to the joint
+ *                      torque, in N m (double, default 0)
+ *                  /robot_description: the arm's kinematics and link masses
+ ***************************************************************************************/
+#ifndef PAYLOAD_ESTIMATOR_H
+#define PAYLOAD_ESTIMATOR_H
+
+#include <ros/ros.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <Eigen/Core>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include "digging_set.h"
+#include "joint_mapping.h"
+
+namespace tfr_mining
+{
+    class PayloadEstimator
+    {
+    public:
+        // lower arm, upper arm, scoop
+        static const size_t JOINTS = 3;
+        using Torques = std::array<double, JOINTS>;
+
+        static const char* const joint_names[JOINTS];
+
+        /*
+         * mappings: drive to urdf radians per joint, in ArmCommand order.
+         * nh must be a private node handle.
+         * */
+        PayloadEstimator(ros::NodeHandle& nh, const std::string& robot_description,
+                const std::vector<JointMapping>& mappings);
+        ~PayloadEstimator() = default;
+        PayloadEstimator(const PayloadEstimator&) = delete;
+        PayloadEstimator& operator=(const PayloadEstimator&) = delete;
+        PayloadEstimator(PayloadEstimator&&) = delete;
+        PayloadEstimator& operator=(PayloadEstimator&&) = delete;
+
+        /*
+         * False if the robot model couldn't be loaded or no joint is
+         * calibrated.
+         * */
+        bool isValid() const;
+
+        /*
+         * Estimates the payload in kg with the arm stopped at position, from
+         * the drive torques in per mille. Returns false if the pose gives no
+         * usable lever arm.
+         * */
+        bool estimate(const Waypoint& position, const Torques& torques, double& mass);
+
+    private:
+        robot_model_loader::RobotModelLoader loader;
+        std::unique_ptr<robot_state::RobotState> state;
+        std::vector<JointMapping> mappings;
+        std::string payload_link;
+        Eigen::Vector3d payload_point;
+        std::array<double, JOINTS> torque_scale;
+        std::array<double, JOINTS> torque_offset;
+    };
+}
+
+#endif // PAYLOAD_ESTIMATOR_H
@@ -0,0 +1,160 @@
+/****************************************************************************************
+ * File:            queue_compiler.h
+ *
+ * Purpose:         Checks a hand written digging queue and compiles it into a
+ *                  compact binary file the digging server can map straight into
+ *                  memory.
+ *
+ *                  Compiling checks that every row has a value per arm joint
+ *                  (extra values, like the fifth one in the 2018 queues, are
+ *                  dropped), that every value is inside the joint limits and,
+ *                  when a collision check is given, that neither the waypoints
+ *                  nor the straight lines between them make the arm hit itself.
+ *                  Consecutive identical waypoints in a set are merged, the arm
+ *                  wouldn't move between them anyway.
+ *
+ *                  A row can end in the word dig, e.g. [1.6, 2.0, 1.1, 0.3, dig],
+ *                  to make it a DIG state: the arm digs towards it and moves on
+ *                  once the scoop is loaded (see AdaptiveDig).
+ *
+ *                  The binary file is a QueueFileHeader, then sets + 1 uint32
+ *                  set offsets, then at data_offset the waypoints as
+ *                  joints doubles each, then one uint8 StateKind per
+ *                  waypoint, all in host byte order.
+ ***************************************************************************************/
+#ifndef QUEUE_COMPILER_H
+#define QUEUE_COMPILER_H
+
+#include <ros/ros.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "digging_trajectory.h"
+
+namespace tfr_mining
+{
+    struct QueueFileHeader
+    {
+        char magic[4];          // "TFRQ"
+        uint32_t version;
+        uint32_t joints;
+        uint32_t sets;
+        uint32_t waypoints;
+        uint32_t data_offset;   // where the waypoints start, 8 byte aligned
+    };
+
+    class QueueCompiler
+    {
+    public:
+        static const uint32_t VERSION = 2;
+        static const size_t JOINTS = ARM_JOINTS;
+
+        using Waypoint = tfr_mining::Waypoint;
+
+        struct Row
+        {
+            std::vector<double> values;
+            StateKind kind;
+        };
+        using Rows = std::vector<Row>;
+
+        /*
+         * Reads a word in a row, returns false if it isn't one.
+         * */
+        static bool parseKind(const std::string& word, StateKind& kind);
+
+        struct Diagnostic
+        {
+            bool error;
+            size_t set;
+            size_t row;     // row in the source, before merging
+            std::string message;
+        };
+
+        struct CompiledQueue
+        {
+            std::vector<Waypoint> waypoints;
+            std::vector<StateKind> kinds;
+            // set i is waypoints[set_offsets[i]] up to waypoints[set_offsets[i + 1]]
+            std::vector<uint32_t> set_offsets;
+        };
+
+        /*
+         * Takes drive positions, returns true and says what touched if the
+         * arm hits itself there.
+         * */
+        using CollisionCheck = std::function<bool(const Waypoint&, std::string&)>;
+
+        explicit QueueCompiler(const std::vector<DiggingTrajectory::JointLimits>& limits);
+        ~QueueCompiler() = default;
+        QueueCompiler(const QueueCompiler&) = delete;
+        QueueCompiler& operator=(const QueueCompiler&) = delete;
+        QueueCompiler(QueueCompiler&&) = delete;
+        QueueCompiler& operator=(QueueCompiler&&) = delete;
+
+        /*
+         * Checks every waypoint, and every step of at most step drive radians
+         * on any joint along the moves between them.
+         * */
+        void setCollisionCheck(CollisionCheck check, double step);
+
+        /*
+         * Compiles sets, returns false if there was an error. Rows with errors
+         * are left out, so queue is still usable if the caller wants to.
+         * */
+        bool compile(const std::vector<Rows>& sets, CompiledQueue& queue,
+                std::vector<Diagnostic>& diagnostics) const;
+
+        static bool write(const std::string& path, const CompiledQueue& queue,
+                std::string& message);
+
+        /*
+         * Reads the "positions" layout from the parameter server.
+         * */
+        static bool fromXmlRpc(XmlRpc::XmlRpcValue& positions, std::vector<Rows>& sets,
+                std::string& message);
+
+    private:
+        std::vector<DiggingTrajectory::JointLimits> limits;
+        CollisionCheck collision_check;
+        double collision_step;
+
+        bool collides(const Waypoint& from, const Waypoint& to, std::string& message) const;
+    };
+
+    /*
+     * A compiled queue mapped read only into memory.
+     * */
+    class MappedQueue
+    {
+    public:
+        MappedQueue() = default;
+        ~MappedQueue();
+        MappedQueue(const MappedQueue&) = delete;
+        MappedQueue& operator=(const MappedQueue&) = delete;
+        MappedQueue(MappedQueue&&) = delete;
+        MappedQueue& operator=(MappedQueue&&) = delete;
+
+        bool open(const std::string& path, std::string& message);
+
+        size_t setCount() const;
+        // the waypoints of set are setBegin(set) up to setEnd(set)
+        size_t setBegin(size_t set) const;
+        size_t setEnd(size_t set) const;
+        const Waypoint& waypoint(size_t index) const;
+        StateKind kind(size_t index) const;
+
+    private:
+        void close();
+
+        void* data = nullptr;
+        size_t size = 0;
+        const QueueFileHeader* header = nullptr;
+        const uint32_t* offsets = nullptr;
+        const Waypoint* waypoints = nullptr;
+        const uint8_t* kinds = nullptr;
+    };
+}
+
+#endif // QUEUE_COMPILER_H
@@ -0,0 +1,64 @@
+#include "adaptive_dig.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tfr_mining
+{
+    const size_t AdaptiveDig::JOINTS;
+
+    AdaptiveDig::AdaptiveDig(const Envelope& e) :
+        envelope{e}, status{IDLE}, start_time{0}, over_limit{0, 0}, peak_torque{0, 0}
+    {
+    }
+
+    AdaptiveDig::Envelope AdaptiveDig::loadEnvelope(ros::NodeHandle& nh)
+    {
+        Envelope envelope;
+        nh.param<bool>("adaptive_dig/enabled", envelope.enabled, false);
+        nh.param<double>("adaptive_dig/lower_arm_max_torque", envelope.lower_arm_max_torque, 600);
+        nh.param<double>("adaptive_dig/scoop_max_torque", envelope.scoop_max_torque, 600);
+        nh.param<int>("adaptive_dig/samples", envelope.samples, 3);
+        nh.param<double>("adaptive_dig/ignore_time", envelope.ignore_time, 0.3);
+        envelope.samples = std::max(envelope.samples, 1);
+        return envelope;
+    }
+
+    void AdaptiveDig::start(double time)
+    {
+        status = envelope.enabled ? DIGGING : IDLE;
+        start_time = time;
+        std::fill(over_limit, over_limit + JOINTS, 0);
+        std::fill(peak_torque, peak_torque + JOINTS, 0);
+    }
+
+    void AdaptiveDig::stop()
+    {
+        status = IDLE;
+    }
+
+    void AdaptiveDig::addTorque(Joint joint, double time, double torque)
+    {
+        if (status != DIGGING || time - start_time < envelope.ignore_time)
+            return;
+
+        //digging pushes the drives either way depending on the joint
+        torque = std::abs(torque);
+        peak_torque[joint] = std::max(peak_torque[joint], torque);
+        const double limit = joint == LOWER_ARM ?
+            envelope.lower_arm_max_torque : envelope.scoop_max_torque;
+        over_limit[joint] = torque > limit ? over_limit[joint] + 1 : 0;
+        if (over_limit[joint] >= envelope.samples)
+            status = LOADED;
+    }
+
+    AdaptiveDig::Status AdaptiveDig::getStatus() const
+    {
+        return status;
+    }
+
+    double AdaptiveDig::getPeakTorque(Joint joint) const
+    {
+        return peak_torque[joint];
+    }
+}
@@ -0,0 +1,43 @@
+#include "arm_collision_check.h"
+
+namespace tfr_mining
+{
+    ArmCollisionCheck::ArmCollisionCheck(const std::string& robot_description,
+            const std::vector<JointMapping>& m) :
+        loader{robot_description}, scene{}, mappings{m}
+    {
+        if (loader.getModel())
+            scene.reset(new planning_scene::PlanningScene{loader.getModel()});
+    }
+
+    bool ArmCollisionCheck::isValid() const
+    {
+        return scene != nullptr;
+    }
+
+    bool ArmCollisionCheck::inCollision(const QueueCompiler::Waypoint& position,
+            std::string& contact)
+    {
+        robot_state::RobotState& state = scene->getCurrentStateNonConst();
+        for (size_t joint = 0; joint < mappings.size() && joint < position.size(); joint++)
+        {
+            const double angle = mappings[joint].toJoint(position[joint]);
+            state.setJointPositions(DiggingTrajectory::joint_names[joint], &angle);
+        }
+        state.update();
+
+        collision_detection::CollisionRequest request;
+        request.contacts = true;
+        request.max_contacts = 1;
+        collision_detection::CollisionResult result;
+        scene->checkSelfCollision(request, result, state);
+        if (!result.collision)
+            return false;
+
+        contact = "arm is in collision";
+        if (!result.contacts.empty())
+            contact = result.contacts.begin()->first.first + " hits " +
+                result.contacts.begin()->first.second;
+        return true;
+    }
+}
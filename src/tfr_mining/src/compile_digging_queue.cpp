@@ -0,0 +1,166 @@
+/****************************************************************************************
+ * File:    compile_digging_queue.cpp
+ * Node:    compile_digging_queue
+ *
+ * Purpose: Checks a digging queue yaml and compiles it into the binary queue
+ *          the digging server maps at startup (its ~compiled_queue parameter).
+ *
+ *          usage: compile_digging_queue <queue.yaml> <queue.tfrq> [--force] [--no-collision]
+ *
+ *          Every problem is printed with its set and row. Nothing is written
+ *          if there was an error, unless --force is given, which writes the
+ *          queue without the rows in error. Warnings (extra values in a row,
+ *          merged waypoints, empty sets) never stop it.
+ *
+ *          The joint limits, the drive to urdf mapping and the robot model
+ *          come from the parameter server, compile_queue.launch loads them.
+ *          Without a robot_description the collision check is skipped.
+ ***************************************************************************************/
+#include <ros/ros.h>
+#include <yaml-cpp/yaml.h>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include "arm_collision_check.h"
+#include "digging_trajectory.h"
+#include "joint_mapping.h"
+#include "queue_compiler.h"
+
+using tfr_mining::QueueCompiler;
+
+static bool loadYaml(const std::string& path, std::vector<QueueCompiler::Rows>& sets,
+        std::string& message)
+{
+    YAML::Node positions;
+    try
+    {
+        positions = YAML::LoadFile(path)["positions"];
+    }
+    catch (const YAML::Exception& e)
+    {
+        message = e.what();
+        return false;
+    }
+    if (!positions.IsSequence())
+    {
+        message = "no positions list";
+        return false;
+    }
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        if (!positions[i].IsSequence())
+        {
+            message = "set " + std::to_string(i) + " is not a list of rows";
+            return false;
+        }
+        sets.emplace_back();
+        for (const YAML::Node& row : positions[i])
+        {
+            QueueCompiler::Row parsed{{}, tfr_mining::MOVE};
+            for (const YAML::Node& value : row)
+            {
+                try
+                {
+                    parsed.values.push_back(value.as<double>());
+                }
+                catch (const YAML::Exception&)
+                {
+                    if (!value.IsScalar() ||
+                            !QueueCompiler::parseKind(value.Scalar(), parsed.kind))
+                        parsed.values.push_back(NAN);
+                }
+            }
+            sets.back().push_back(parsed);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "compile_digging_queue");
+    ros::NodeHandle n{};
+
+    std::vector<std::string> files;
+    bool force = false, check_collisions = true;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg{argv[i]};
+        if (arg == "--force")
+            force = true;
+        else if (arg == "--no-collision")
+            check_collisions = false;
+        else
+            files.push_back(arg);
+    }
+    if (files.size() != 2)
+    {
+        ROS_ERROR("usage: compile_digging_queue <queue.yaml> <queue.tfrq> [--force] [--no-collision]");
+        return 2;
+    }
+
+    std::vector<QueueCompiler::Rows> sets;
+    std::string message;
+    if (!loadYaml(files[0], sets, message))
+    {
+        ROS_ERROR("%s: %s", files[0].c_str(), message.c_str());
+        return 1;
+    }
+
+    QueueCompiler compiler{tfr_mining::DiggingTrajectory::loadLimits()};
+
+    std::unique_ptr<tfr_mining::ArmCollisionCheck> collision;
+    if (check_collisions && ros::param::has("robot_description"))
+    {
+        std::vector<tfr_mining::JointMapping> mappings(QueueCompiler::JOINTS, {1.0, 0.0});
+        for (size_t joint = 0; joint < mappings.size(); joint++)
+            if (!tfr_mining::JointMapping::load(tfr_mining::DiggingTrajectory::joint_names[joint],
+                        mappings[joint]))
+                ROS_WARN("No drive to urdf mapping for %s, using drive radians as is",
+                        tfr_mining::DiggingTrajectory::joint_names[joint]);
+
+        double step;
+        ros::param::param<double>("~collision_step", step, 0.05);
+        collision.reset(new tfr_mining::ArmCollisionCheck{"robot_description", mappings});
+        if (collision->isValid())
+            compiler.setCollisionCheck(
+                    [&collision](const QueueCompiler::Waypoint& position, std::string& contact)
+                    { return collision->inCollision(position, contact); }, step);
+        else
+            ROS_WARN("Could not load the robot model, not checking collisions");
+    }
+    else if (check_collisions)
+        ROS_WARN("No robot_description, not checking collisions");
+
+    QueueCompiler::CompiledQueue queue;
+    std::vector<QueueCompiler::Diagnostic> diagnostics;
+    const bool ok = compiler.compile(sets, queue, diagnostics);
+    size_t errors = 0;
+    for (const QueueCompiler::Diagnostic& diagnostic : diagnostics)
+    {
+        if (diagnostic.error)
+        {
+            ROS_ERROR("%s: set %lu row %lu %s", files[0].c_str(), diagnostic.set,
+                    diagnostic.row, diagnostic.message.c_str());
+            errors++;
+        }
+        else
+            ROS_WARN("%s: set %lu row %lu %s", files[0].c_str(), diagnostic.set,
+                    diagnostic.row, diagnostic.message.c_str());
+    }
+
+    if (!ok && !force)
+    {
+        ROS_ERROR("%lu errors, not writing %s", errors, files[1].c_str());
+        return 1;
+    }
+    if (!QueueCompiler::write(files[1], queue, message))
+    {
+        ROS_ERROR("%s", message.c_str());
+        return 1;
+    }
+    ROS_INFO("Wrote %lu sets, %lu waypoints to %s", queue.set_offsets.size() - 1,
+            queue.waypoints.size(), files[1].c_str());
+    return 0;
+}
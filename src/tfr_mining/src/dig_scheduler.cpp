@@ -0,0 +1,202 @@
+#include "dig_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace tfr_mining
+{
+    DigScheduler::Options DigScheduler::loadOptions(ros::NodeHandle& nh)
+    {
+        Options options;
+        nh.getParam("scheduler/hole_turntables", options.hole_turntables);
+        nh.getParam("scheduler/hole_yields", options.hole_yields);
+        nh.param<double>("scheduler/default_yield", options.default_yield, 1.0);
+        nh.param<double>("scheduler/hole_tolerance", options.hole_tolerance, 0.05);
+        nh.param<double>("scheduler/resolution", options.resolution, 1.0);
+        nh.param<double>("scheduler/margin", options.margin, 5.0);
+        if (options.hole_yields.size() != options.hole_turntables.size())
+        {
+            ROS_WARN("Dig scheduler: %lu hole yields for %lu holes, using the default yield",
+                    options.hole_yields.size(), options.hole_turntables.size());
+            options.hole_yields.assign(options.hole_turntables.size(), options.default_yield);
+        }
+        options.resolution = std::max(options.resolution, 0.01);
+        return options;
+    }
+
+    DigScheduler::DigScheduler(const DiggingQueue& queue, const Options& options) :
+        DigScheduler(getSetTimes(queue), getSetTurntables(queue), options)
+    {
+    }
+
+    DigScheduler::DigScheduler(const std::vector<double>& times,
+            const std::vector<double>& set_turntables, const Options& options) :
+        set_times{times}, set_holes{}, holes{}, resolution{options.resolution},
+        margin{options.margin}, estimated_total{0}, measured_total{0}
+    {
+        for (size_t i = 0; i < options.hole_turntables.size(); i++)
+            holes.push_back(Hole{options.hole_turntables[i], options.hole_yields[i], 0, 0, {}, 0});
+
+        for (size_t i = 0; i < set_turntables.size(); i++)
+        {
+            const double turntable = set_turntables[i];
+            if (std::isnan(turntable))
+            {
+                //nothing to dig, but it still gets a hole of its own no
+                //other set can match
+                set_holes.push_back(holes.size());
+                holes.push_back(Hole{std::numeric_limits<double>::infinity(), 0, 0, 0, {i}, 0});
+                continue;
+            }
+
+            size_t hole = 0;
+            while (hole < holes.size() &&
+                    std::abs(holes[hole].turntable - turntable) > options.hole_tolerance)
+                hole++;
+            if (hole == holes.size())
+                holes.push_back(Hole{turntable, options.default_yield, 0, 0, {}, 0});
+            holes[hole].sets.push_back(i);
+            set_holes.push_back(hole);
+        }
+    }
+
+    bool DigScheduler::nextWithoutLimit(size_t& set)
+    {
+        bool found = false;
+        for (const Hole& hole : holes)
+            if (hole.done < hole.sets.size() && (!found || hole.sets[hole.done] < set))
+            {
+                set = hole.sets[hole.done];
+                found = true;
+            }
+        return found;
+    }
+
+    bool DigScheduler::next(double remaining, size_t& set)
+    {
+        const double scale = getTimeScale();
+        const double budget = remaining - margin;
+        if (budget <= 0)
+            return false;
+        //times round up and the budget down, so a plan never runs over
+        const size_t steps = static_cast<size_t>(budget / resolution);
+
+        //best[t] is the most regolith the holes so far can give in t steps,
+        //take[h][t] how many sets of hole h that needs
+        std::vector<double> best(steps + 1, 0);
+        std::vector<std::vector<size_t> > take(holes.size(), std::vector<size_t>(steps + 1, 0));
+        for (size_t h = 0; h < holes.size(); h++)
+        {
+            const Hole& hole = holes[h];
+            const double yield = expectedYield(hole);
+            std::vector<size_t> cost{0};
+            for (size_t k = hole.done; k < hole.sets.size(); k++)
+            {
+                const double time = set_times[hole.sets[k]] * scale;
+                cost.push_back(cost.back() + static_cast<size_t>(std::ceil(time / resolution - 1e-9)));
+            }
+
+            std::vector<double> previous = best;
+            for (size_t t = 0; t <= steps; t++)
+                for (size_t k = 1; k < cost.size() && cost[k] <= t; k++)
+                {
+                    const double value = previous[t - cost[k]] + yield * k;
+                    //ties go to more sets, a yield of zero still digs
+                    if (value > best[t] || (value == best[t] && k > take[h][t]))
+                    {
+                        best[t] = value;
+                        take[h][t] = k;
+                    }
+                }
+        }
+
+        //walk back through the holes to find how many sets each one gets
+        bool found = false;
+        size_t t = steps;
+        for (size_t h = holes.size(); h-- > 0;)
+        {
+            const size_t k = take[h][t];
+            const Hole& hole = holes[h];
+            if (k == 0)
+                continue;
+            if (!found || hole.sets[hole.done] < set)
+            {
+                set = hole.sets[hole.done];
+                found = true;
+            }
+            for (size_t i = hole.done; i < hole.done + k; i++)
+                t -= static_cast<size_t>(std::ceil(set_times[hole.sets[i]] * scale / resolution - 1e-9));
+        }
+        return found;
+    }
+
+    void DigScheduler::finished(size_t set, double measured_time, double measured_yield)
+    {
+        Hole& hole = holes[set_holes[set]];
+        if (hole.done < hole.sets.size() && hole.sets[hole.done] == set)
+            hole.done++;
+        if (set_times[set] > 0 && measured_time > 0)
+        {
+            estimated_total += set_times[set];
+            measured_total += measured_time;
+        }
+        if (measured_yield >= 0)
+        {
+            hole.measured_yield += measured_yield;
+            hole.measured_sets++;
+        }
+    }
+
+    size_t DigScheduler::getHoleCount() const
+    {
+        return holes.size();
+    }
+
+    size_t DigScheduler::getHole(size_t set) const
+    {
+        return set_holes[set];
+    }
+
+    double DigScheduler::getTimeScale() const
+    {
+        return estimated_total > 0 ? measured_total / estimated_total : 1.0;
+    }
+
+    double DigScheduler::expectedYield(const Hole& hole) const
+    {
+        //the configured yield counts as one more set
+        return (hole.yield + hole.measured_yield) / (1 + hole.measured_sets);
+    }
+
+    std::vector<double> DigScheduler::getSetTimes(const DiggingQueue& queue)
+    {
+        std::vector<double> times;
+        for (const DiggingSet set : queue)
+            times.push_back(set.getTimeEstimate());
+        return times;
+    }
+
+    std::vector<double> DigScheduler::getSetTurntables(const DiggingQueue& queue)
+    {
+        //the first dig state, or the first state if it has none
+        std::vector<double> turntables;
+        for (const DiggingSet set : queue)
+        {
+            if (set.isEmpty())
+            {
+                turntables.push_back(NAN);
+                continue;
+            }
+            double turntable = set[0][0];
+            for (size_t state = 0; state < set.size(); state++)
+                if (set.getStateKind(state) == DIG)
+                {
+                    turntable = set[state][0];
+                    break;
+                }
+            turntables.push_back(turntable);
+        }
+        return turntables;
+    }
+}
@@ -14,6 +14,31 @@
  *              devel/include/tfr_msgs/DiggingGoal.h
  *              devel/include/tfr_msgs/DiggingResult.h
  *
+ *          States marked dig in the queue end early once the scoop is loaded,
+ *          judged from the lower arm and scoop torque (see adaptive_dig.h).
+ *
+ *          Which sets run, and in what order, is up to DigScheduler (see
+ *          dig_scheduler.h), so the most regolith is dug in the digging time.
+ *
+ *          At the first state after a dig, the lift out, the arm is held still
+ *          for a moment and the scoop is weighed from the drive torques (see
+ *          payload_estimator.h). Only scoops the arm then carries round to
+ *          the bin count towards bin_fill, the rest are dumped beside the hole.
+ *
+ * Parameters:
+ *  - ~weigh_time: how long the torque is averaged for when weighing a scoop (double, default 0.5)
+ *  - ~bin_turntable: the turntable angle the scoop is released into the bin at (double, default 3.14)
+ *  - ~bin_turntable_tolerance: how close to ~bin_turntable counts as over the bin (double, default 0.1)
+ *
+ * Published topics:
+ *  - scoop_mass: the estimated mass of the last scoop in kg (std_msgs/Float64)
+ *  - bin_fill: the estimated mass released into the bin since the last reset in kg, latched (std_msgs/Float64)
+ *  - digging_trajectory: the timed trajectory of each set as it starts, stamped with its
+ *    start, what the time estimates assume the arm follows (trajectory_msgs/JointTrajectory)
+ *
+ * Services:
+ *  - reset_bin_fill: starts bin_fill over at zero, call it once the bin is dumped (std_srvs/Empty)
+ *
  ***************************************************************************************/
 
 #include <actionlib/server/simple_action_server.h>
@@ -21,11 +46,23 @@
 #include <tfr_msgs/DiggingAction.h>  // Note: "Action" is appended
 #include <tfr_msgs/ArmMoveAction.h>  // Note: "Action" is appended
 #include <tfr_utilities/arm_manipulator.h>
+#include <tfr_utilities/async_log.h>
+#include <algorithm>
+#include <cmath>
 #include <geometry_msgs/Twist.h>
 #include <tfr_utilities/teleop_code.h>
 #include <actionlib/client/simple_action_client.h>
 #include "digging_queue.h"
+#include "adaptive_dig.h"
+#include "dig_scheduler.h"
+#include "digging_trajectory.h"
+#include "joint_mapping.h"
+#include "payload_estimator.h"
 #include <std_msgs/Bool.h>
+#include <std_msgs/Float64.h>
+#include <std_msgs/Int16.h>
+#include <std_srvs/Empty.h>
+#include <mutex>
 
 typedef actionlib::SimpleActionServer<tfr_msgs::DiggingAction> Server;
 typedef actionlib::SimpleActionClient<tfr_msgs::ArmMoveAction> Client;
@@ -39,10 +76,32 @@ public:
         lowerArmSubscriber{nh.subscribe("arm_status/lowerArm", 5, &DiggingActionServer::lowerArmVelocityCallback, this)},
         upperArmSubscriber{nh.subscribe("arm_status/upperArm", 5, &DiggingActionServer::upperArmVelocityCallback, this)},
         scoopSubscriber{nh.subscribe("arm_status/scoop", 5, &DiggingActionServer::scoopVelocityCallback, this)},
+        lowerArmTorqueSubscriber{nh.subscribe("/device23/get_torque_actual_value", 5, &DiggingActionServer::lowerArmTorqueCallback, this)},
+        scoopTorqueSubscriber{nh.subscribe("/device56/get_torque_actual_value", 5, &DiggingActionServer::scoopTorqueCallback, this)},
+        upperArmTorqueSubscriber{nh.subscribe("/device45/get_torque_actual_value", 5, &DiggingActionServer::upperArmTorqueCallback, this)},
+        scoopMassPublisher{nh.advertise<std_msgs::Float64>("scoop_mass", 5)},
+        binFillPublisher{nh.advertise<std_msgs::Float64>("bin_fill", 5, true)},
+        trajectoryPublisher{nh.advertise<trajectory_msgs::JointTrajectory>("digging_trajectory", 5)},
+        resetBinFillService{nh.advertiseService("reset_bin_fill", &DiggingActionServer::resetBinFill, this)},
         server{nh, "dig", boost::bind(&DiggingActionServer::execute, this, _1), false},
-        arm_manipulator{nh}
+        arm_manipulator{nh},
+        adaptive_dig{tfr_mining::AdaptiveDig::loadEnvelope(priv_nh)},
+        torques{},
+        payload_estimator{priv_nh, "robot_description", loadMappings()},
+        bin_fill{0}
 
     {
+        priv_nh.param<double>("weigh_time", weigh_time, 0.5);
+        priv_nh.param<double>("bin_turntable", bin_turntable, 3.14);
+        priv_nh.param<double>("bin_turntable_tolerance", bin_turntable_tolerance, 0.1);
+        scheduler_options = tfr_mining::DigScheduler::loadOptions(priv_nh);
+        if (!payload_estimator.isValid()) {
+            ROS_WARN("Digging server: no robot model or torque calibration, not weighing scoops");
+        }
+        publishBinFill();
+
+        // Lets the mission clock budget for how long the queue really takes.
+        ros::param::set("/digging_queue_time", queue.getTimeEstimate());
         server.start();
     }
 
@@ -54,10 +113,12 @@ private:
      * When the digging action server receives a goal, it executes one
      * iteration of the digging queue.
      *
-	 * Currently the digging action server receives the number of seconds
-     * it is allowed to spend on digging in the goal message. This is not
-     * currently used, but in the future (TODO) it can be used to control the
-     * time spent digging autonomously.
+	 * The digging action server receives the number of seconds it is
+     * allowed to spend on digging in the goal message. The scheduler
+     * plans the sets that dig the most in that time, and plans again
+     * after every set with how long it really took. A zero or negative
+     * digging time digs nothing, a goal marked unlimited runs the whole
+     * queue.
 	 *
 	 * Pre: There must be accurate measurements of the position of the
      * arm. Digging can start while the arm is turned off-center, but
@@ -81,11 +142,33 @@ private:
     ros::Subscriber lowerArmSubscriber;
     ros::Subscriber upperArmSubscriber;
     ros::Subscriber scoopSubscriber;
+    ros::Subscriber lowerArmTorqueSubscriber;
+    ros::Subscriber scoopTorqueSubscriber;
+    ros::Subscriber upperArmTorqueSubscriber;
+
+    ros::Publisher scoopMassPublisher;
+    ros::Publisher binFillPublisher;
+    ros::Publisher trajectoryPublisher;
+    ros::ServiceServer resetBinFillService;
 
     ArmManipulator arm_manipulator;
     tfr_mining::DiggingQueue queue;
     Server server;
 
+    // fed by the torque callbacks while execute runs, so they are locked
+    tfr_mining::AdaptiveDig adaptive_dig;
+    tfr_mining::PayloadEstimator::Torques torques;
+    std::mutex torque_mutex;
+
+    tfr_mining::PayloadEstimator payload_estimator;
+    double weigh_time;
+    double bin_turntable;
+    double bin_turntable_tolerance;
+    tfr_mining::DigScheduler::Options scheduler_options;
+    // added to by execute, reset by the service
+    double bin_fill;
+    std::mutex bin_fill_mutex;
+
     bool turnTableMoving;
     bool lowerArmMoving;
     bool upperArmMoving;
@@ -97,40 +180,90 @@ private:
 
     void execute(const tfr_msgs::DiggingGoalConstPtr& goal)
     {
-        ROS_INFO("Start digging queue.");
+        if (goal->unlimited) {
+            ROS_INFO("Start digging queue, estimated %.1f seconds with no limit.", queue.getTimeEstimate());
+        } else {
+            ROS_INFO("Start digging queue, estimated %.1f seconds for %.1f allowed.",
+                    queue.getTimeEstimate(), goal->diggingTime.toSec());
+        }
 
-        std::queue<tfr_mining::DiggingSet> current_queue{queue.sets};
+        const ros::Time digging_start = ros::Time::now();
+        const double digging_time = goal->diggingTime.toSec();
+        tfr_mining::DigScheduler scheduler{queue, scheduler_options};
 
-        while (!current_queue.empty())
-        {
-            tfr_mining::DiggingSet set = current_queue.front();
-            current_queue.pop();
-            ros::Time now = ros::Time::now();
+        // an overrun budget goes negative, and the scheduler starts nothing
+        auto next = [&](size_t& set) {
+            if (goal->unlimited) {
+                return scheduler.nextWithoutLimit(set);
+            }
+            return scheduler.next(digging_time - (ros::Time::now() - digging_start).toSec(), set);
+        };
+
+        // weighed at the lift out, added to bin_fill once it is over the bin
+        double carried = 0;
 
-            ROS_INFO("Starting digging set");
+        // The queue is only read, nothing here copies or allocates it.
+        size_t set_index;
+        while (next(set_index))
+        {
+            const tfr_mining::DiggingSet set = queue[set_index];
+            const ros::Time set_start = ros::Time::now();
+            double set_yield = -1;
 
-            std::queue<std::vector<double> > current_set{set.states};
+            ROS_INFO("Starting digging set %lu at hole %lu, estimated %.1f seconds (x%.2f)", set_index,
+                    scheduler.getHole(set_index), set.getTimeEstimate(), scheduler.getTimeScale());
+            trajectory_msgs::JointTrajectory trajectory = set.getTrajectory();
+            trajectory.header.stamp = set_start;
+            trajectoryPublisher.publish(trajectory);
 
-            while (!current_set.empty())
+            for (size_t i = 0; i < set.size(); i++)
             {
-                std::vector<double> state = current_set.front();
-                current_set.pop();
+                const tfr_mining::Waypoint& state = set[i];
+                const double expected_time = set.getStateTime(i);
+                const bool digging = set.getStateKind(i) == tfr_mining::DIG;
+                const ros::Time move_start = ros::Time::now();
+                bool overdue = false;
+                bool loaded = false;
+
+                if (digging) {
+                    std::lock_guard<std::mutex> lock{torque_mutex};
+                    adaptive_dig.start(move_start.toSec());
+                }
 
                 // Use arm_manipulator, and NOT MoveIt, to send commands to the arm. The actuators will just
                 // move to each of the points in the digging queue, there is no trajectory or other points being
                 // generated. There is also no collision checking, so be careful.
-                ROS_INFO("Moving arm to position: %.2f %.2f %.2f %.2f", state[0], state[1], state[2], state[3]);
-                arm_manipulator.moveArmWithoutPlanningOrLimits(state[0], state[1], state[2], state[3]);
+                TFR_LOG_INFO("Moving arm to position: %.2f %.2f %.2f %.2f", state[0], state[1], state[2], state[3]);
+                const double expected_duration =
+                    arm_manipulator.moveArmWithoutPlanningOrLimits(state[0], state[1], state[2], state[3]);
 		
 		// since turn table takes longer than actuators to increase in velocity, if the turn table moves then sleep 0.5 seconds
-		// to allow it to start moving so the robot doesn't think it's not moving and move to the next set of positions
+		// to allow it to start moving so the robot doesn't think it's not moving and move to the next set of positions.
+		// When the joints are profiled to arrive together a short move can't need longer than the move itself.
 		if(turnTablePosition != state[0]) {
-                     ros::Duration(0.50).sleep();
+                     ros::Duration(expected_duration > 0 ? std::min(0.50, expected_duration) : 0.50).sleep();
 		}
 		turnTablePosition = state[0];
 
                 // This loop checks for the actuators and turn table to be done moving. Will keep looping until they are done moving.
                 while (true) {
+                  if (!overdue && (ros::Time::now() - move_start).toSec() > 2 * expected_time + 1.0) {
+                      TFR_LOG_WARN("Arm is taking longer than the expected %.2f seconds to reach the position", expected_time);
+                      overdue = true;
+                  }
+                  if (digging) {
+                      std::lock_guard<std::mutex> lock{torque_mutex};
+                      if (adaptive_dig.getStatus() == tfr_mining::AdaptiveDig::LOADED) {
+                          TFR_LOG_INFO("Scoop loaded after %.2f seconds (lower arm %.0f, scoop %.0f), moving on",
+                                  (ros::Time::now() - move_start).toSec(),
+                                  adaptive_dig.getPeakTorque(tfr_mining::AdaptiveDig::LOWER_ARM),
+                                  adaptive_dig.getPeakTorque(tfr_mining::AdaptiveDig::SCOOP));
+                          loaded = true;
+                      }
+                  }
+                  if (loaded) {
+                      break;
+                  }
                   if (this->turnTableMoving == false &&
                       this->lowerArmMoving == false &&
                       this->upperArmMoving == false &&
@@ -145,6 +278,24 @@ private:
                   }
                 }
 
+                if (digging) {
+                    std::lock_guard<std::mutex> lock{torque_mutex};
+                    adaptive_dig.stop();
+                    // whatever was in the scoop went somewhere else
+                    carried = 0;
+                } else if (i > 0 && set.getStateKind(i - 1) == tfr_mining::DIG) {
+                    // the scoop just came up out of the dirt
+                    const double mass = weighScoop(state);
+                    if (mass >= 0) {
+                        set_yield = std::max(set_yield, 0.0) + mass;
+                    }
+                    carried = std::max(mass, 0.0);
+                }
+                if (carried > 0 && std::abs(state[0] - bin_turntable) <= bin_turntable_tolerance) {
+                    addToBinFill(carried);
+                    carried = 0;
+                }
+
                 ros::Rate rate(10.0);
 
                 if (server.isPreemptRequested() || !ros::ok())
@@ -157,8 +308,9 @@ private:
 
                 rate.sleep();
             }
+            scheduler.finished(set_index, (ros::Time::now() - set_start).toSec(), set_yield);
         }
-        ROS_INFO("End digging queue.");
+        ROS_INFO("End digging queue after %.1f seconds.", (ros::Time::now() - digging_start).toSec());
         tfr_msgs::DiggingResult result;
         server.setSucceeded(result);
     }
@@ -181,6 +333,104 @@ private:
       this->scoopMoving = scoopStatus.data;
     }
 
+    void lowerArmTorqueCallback(const std_msgs::Int16 &torque) {
+      std::lock_guard<std::mutex> lock{torque_mutex};
+      adaptive_dig.addTorque(tfr_mining::AdaptiveDig::LOWER_ARM, ros::Time::now().toSec(), torque.data);
+      torques[0] = torque.data;
+    }
+
+    void upperArmTorqueCallback(const std_msgs::Int16 &torque) {
+      std::lock_guard<std::mutex> lock{torque_mutex};
+      torques[1] = torque.data;
+    }
+
+    void scoopTorqueCallback(const std_msgs::Int16 &torque) {
+      std::lock_guard<std::mutex> lock{torque_mutex};
+      adaptive_dig.addTorque(tfr_mining::AdaptiveDig::SCOOP, ros::Time::now().toSec(), torque.data);
+      torques[2] = torque.data;
+    }
+
+    /*
+     * Averages the lower arm, upper arm and scoop torque over weigh_time with
+     * the arm stopped at state, and publishes the scoop's estimated mass.
+     * Returns the mass, or -1 if the scoop couldn't be weighed.
+     */
+    double weighScoop(const tfr_mining::Waypoint &state) {
+      if (!payload_estimator.isValid()) {
+          return -1;
+      }
+      // the drives stream torque at 32 Hz
+      ros::Rate rate(32.0);
+      tfr_mining::PayloadEstimator::Torques average{};
+      int samples = 0;
+      const ros::Time start = ros::Time::now();
+      while ((ros::Time::now() - start).toSec() < weigh_time && ros::ok()) {
+          {
+              std::lock_guard<std::mutex> lock{torque_mutex};
+              for (size_t joint = 0; joint < average.size(); joint++) {
+                  average[joint] += torques[joint];
+              }
+          }
+          samples++;
+          rate.sleep();
+      }
+      if (samples == 0) {
+          return -1;
+      }
+      for (double &torque : average) {
+          torque /= samples;
+      }
+
+      double mass;
+      if (!payload_estimator.estimate(state, average, mass)) {
+          ROS_WARN("Digging server: can't weigh the scoop in this pose");
+          return -1;
+      }
+      std_msgs::Float64 msg;
+      msg.data = mass;
+      scoopMassPublisher.publish(msg);
+      ROS_INFO("Digging server: scoop weighed %.2f kg", mass);
+      return mass;
+    }
+
+    void addToBinFill(double mass) {
+      {
+          std::lock_guard<std::mutex> lock{bin_fill_mutex};
+          bin_fill += mass;
+      }
+      ROS_INFO("Digging server: %.2f kg released into the bin", mass);
+      publishBinFill();
+    }
+
+    void publishBinFill() {
+      std_msgs::Float64 msg;
+      {
+          std::lock_guard<std::mutex> lock{bin_fill_mutex};
+          msg.data = bin_fill;
+      }
+      binFillPublisher.publish(msg);
+    }
+
+    bool resetBinFill(std_srvs::Empty::Request &request, std_srvs::Empty::Response &response) {
+      {
+          std::lock_guard<std::mutex> lock{bin_fill_mutex};
+          bin_fill = 0;
+      }
+      publishBinFill();
+      return true;
+    }
+
+    static std::vector<tfr_mining::JointMapping> loadMappings() {
+      std::vector<tfr_mining::JointMapping> mappings(tfr_mining::ARM_JOINTS, {1.0, 0.0});
+      for (size_t joint = 0; joint < mappings.size(); joint++) {
+          if (!tfr_mining::JointMapping::load(tfr_mining::DiggingTrajectory::joint_names[joint], mappings[joint])) {
+              ROS_WARN("Digging server: no drive to urdf mapping for %s, using drive radians as is",
+                      tfr_mining::DiggingTrajectory::joint_names[joint]);
+          }
+      }
+      return mappings;
+    }
+
 };
 
 
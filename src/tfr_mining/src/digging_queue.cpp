@@ -1,40 +1,163 @@
 #include "digging_queue.h"
+#include "queue_compiler.h"
 
 namespace tfr_mining
 {
     // Must be a private node handle ("~")
-    DiggingQueue::DiggingQueue(ros::NodeHandle nh) : sets{}
+    DiggingQueue::DiggingQueue(ros::NodeHandle nh) :
+        states{}, state_kinds{}, state_times{}, set_offsets{0}, set_times{}, trajectories{}, time_estimate{0}
     {
-        XmlRpc::XmlRpcValue positions;
+        double sample_period, settle_time;
+        nh.param<double>("trajectory_sample_period", sample_period, 0.1);
+        nh.param<double>("settle_time", settle_time, 0.2);
+        const std::vector<DiggingTrajectory::JointLimits> limits = DiggingTrajectory::loadLimits();
 
-        if (!nh.getParam("positions", positions)) {
-            ROS_ERROR("Error loading positions, exiting");
+        if (!load(nh, limits)) {
+            states.clear();
+            state_kinds.clear();
+            set_offsets.assign(1, 0);
             return;
         }
+        timeSets(DiggingTrajectory{limits, sample_period, settle_time});
+        ROS_INFO("Digging queue: %lu sets, %lu states, %.1f seconds in total", size(), states.size(),
+                time_estimate);
+    }
 
-        for (int i = 0; i < positions.size(); i++) {
-            DiggingSet toAdd;
-            for (int j = 0; j < positions[i].size(); j++)
-            {
-                std::vector<double> state;
-                for (int angle = 0; angle < 5; angle++) {
-                    state.push_back(positions[i][j][angle]);
+    bool DiggingQueue::load(ros::NodeHandle& nh, const std::vector<DiggingTrajectory::JointLimits>& limits)
+    {
+        std::string compiled_path, message;
+        if (nh.getParam("compiled_queue", compiled_path)) {
+            // Already checked by compile_digging_queue, use it as is.
+            MappedQueue mapped;
+            if (!mapped.open(compiled_path, message)) {
+                ROS_ERROR("Error loading compiled queue: %s, exiting", message.c_str());
+                return false;
+            }
+            const size_t count = mapped.setCount() == 0 ? 0 : mapped.setEnd(mapped.setCount() - 1);
+            states.assign(&mapped.waypoint(0), &mapped.waypoint(0) + count);
+            for (size_t i = 0; i < count; i++) {
+                state_kinds.push_back(mapped.kind(i));
+            }
+            for (size_t i = 0; i < mapped.setCount(); i++) {
+                if (mapped.setBegin(i) != set_offsets.back()) {
+                    ROS_ERROR("Error loading compiled queue: set %lu doesn't follow the last one, exiting", i);
+                    return false;
                 }
-                toAdd.insertState(state, 4.5); // Just use a constant time for simplicity.
+                set_offsets.push_back(static_cast<uint32_t>(mapped.setEnd(i)));
+            }
+            return true;
+        }
+
+        XmlRpc::XmlRpcValue positions;
+        std::vector<QueueCompiler::Rows> rows;
+        if (!nh.getParam("positions", positions)) {
+            ROS_ERROR("Error loading positions, exiting");
+            return false;
+        }
+        if (!QueueCompiler::fromXmlRpc(positions, rows, message)) {
+            ROS_ERROR("Error loading positions: %s, exiting", message.c_str());
+            return false;
+        }
+
+        // The same checks as compile_digging_queue, minus collisions. A queue
+        // with errors is refused, the arm would be sent somewhere it can't go.
+        QueueCompiler compiler{limits};
+        QueueCompiler::CompiledQueue compiled;
+        std::vector<QueueCompiler::Diagnostic> diagnostics;
+        const bool compiled_ok = compiler.compile(rows, compiled, diagnostics);
+        for (const QueueCompiler::Diagnostic& diagnostic : diagnostics) {
+            if (diagnostic.error) {
+                ROS_ERROR("Digging set %lu row %lu %s", diagnostic.set, diagnostic.row,
+                        diagnostic.message.c_str());
+            } else {
+                ROS_WARN("Digging set %lu row %lu %s", diagnostic.set, diagnostic.row,
+                        diagnostic.message.c_str());
+            }
+        }
+        if (!compiled_ok) {
+            ROS_ERROR("Error loading positions: the queue has errors, exiting");
+            return false;
+        }
+        states.swap(compiled.waypoints);
+        state_kinds.swap(compiled.kinds);
+        set_offsets.swap(compiled.set_offsets);
+        return true;
+    }
+
+    void DiggingQueue::timeSets(const DiggingTrajectory& trajectory)
+    {
+        state_times.assign(states.size(), 0);
+        set_times.assign(size(), 0);
+        trajectories.assign(size(), trajectory_msgs::JointTrajectory{});
+
+        // Sets run back to back, so each one starts where the last one
+        // ended. Where the arm is before the first one isn't known here,
+        // so the first move isn't counted.
+        for (size_t i = 0; i < size(); i++) {
+            const size_t begin = set_offsets[i];
+            const size_t count = set_offsets[i + 1] - begin;
+            if (count == 0) {
+                continue;
             }
-            sets.push(toAdd);
+            const Waypoint& start = begin == 0 ? states[0] : states[begin - 1];
+            set_times[i] = trajectory.parameterize(start, &states[begin], count,
+                    &state_times[begin], trajectories[i]);
+            time_estimate += set_times[i];
+            ROS_INFO("Digging set %lu: %lu states, %.1f seconds", i, count, set_times[i]);
         }
     }
 
-    bool DiggingQueue::isEmpty()
+    bool DiggingQueue::isEmpty() const
+    {
+        return size() == 0;
+    }
+
+    size_t DiggingQueue::size() const
+    {
+        return set_offsets.size() - 1;
+    }
+
+    DiggingSet DiggingQueue::operator[](size_t set) const
+    {
+        const size_t begin = set_offsets[set];
+        return DiggingSet{states.data() + begin, state_kinds.data() + begin,
+            state_times.data() + begin, set_offsets[set + 1] - begin, set_times[set],
+            &trajectories[set]};
+    }
+
+    DiggingQueue::const_iterator DiggingQueue::begin() const
+    {
+        return const_iterator{*this, 0};
+    }
+
+    DiggingQueue::const_iterator DiggingQueue::end() const
+    {
+        return const_iterator{*this, size()};
+    }
+
+    double DiggingQueue::getTimeEstimate() const
+    {
+        return time_estimate;
+    }
+
+    DiggingQueue::const_iterator::const_iterator(const DiggingQueue& q, size_t s) :
+        queue{&q}, set{s}
+    {
+    }
+
+    DiggingSet DiggingQueue::const_iterator::operator*() const
+    {
+        return (*queue)[set];
+    }
+
+    DiggingQueue::const_iterator& DiggingQueue::const_iterator::operator++()
     {
-        return sets.empty();
+        ++set;
+        return *this;
     }
 
-    DiggingSet DiggingQueue::popDiggingSet()
+    bool DiggingQueue::const_iterator::operator!=(const const_iterator& other) const
     {
-        DiggingSet set = sets.front();
-        sets.pop();
-        return set;
+        return queue != other.queue || set != other.set;
     }
 }
@@ -2,31 +2,55 @@
 
 namespace tfr_mining
 {
-    DiggingSet::DiggingSet() : states{}, time_estimate{0}
+    DiggingSet::DiggingSet(const Waypoint* s, const StateKind* kinds, const double* times,
+            size_t size, double estimate, const trajectory_msgs::JointTrajectory* t) :
+        states{s}, state_kinds{kinds}, state_times{times}, count{size}, time_estimate{estimate},
+        trajectory{t}
     {
-		
     }
 
-    void DiggingSet::insertState(std::vector<double> state, double time)
+    bool DiggingSet::isEmpty() const
     {
-        states.push(state);
-        time_estimate += time;
+        return count == 0;
     }
 
-    bool DiggingSet::isEmpty()
+    size_t DiggingSet::size() const
     {
-        return states.empty();
+        return count;
     }
 
-    std::vector<double> DiggingSet::popState()
+    const Waypoint& DiggingSet::operator[](size_t i) const
     {
-        std::vector<double> state = states.front();
-        states.pop();
-        return state;
+        return states[i];
     }
 
-    double DiggingSet::getTimeEstimate()
+    StateKind DiggingSet::getStateKind(size_t i) const
+    {
+        return state_kinds[i];
+    }
+
+    double DiggingSet::getStateTime(size_t i) const
+    {
+        return state_times[i];
+    }
+
+    double DiggingSet::getTimeEstimate() const
     {
         return time_estimate;
     }
+
+    const trajectory_msgs::JointTrajectory& DiggingSet::getTrajectory() const
+    {
+        return *trajectory;
+    }
+
+    const Waypoint* DiggingSet::begin() const
+    {
+        return states;
+    }
+
+    const Waypoint* DiggingSet::end() const
+    {
+        return states + count;
+    }
 }
@@ -0,0 +1,245 @@
+#include "digging_trajectory.h"
+#include "joint_mapping.h"
+
+#include <ros/ros.h>
+#include <urdf/model.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace tfr_mining
+{
+    const char* const DiggingTrajectory::joint_names[] =
+        {"turntable_joint", "lower_arm_joint", "upper_arm_joint", "scoop_joint"};
+
+    double DiggingTrajectory::SCurve::duration() const
+    {
+        return 2 * accel_time + cruise_time;
+    }
+
+    void DiggingTrajectory::SCurve::sample(double t, double& position,
+            double& velocity, double& acceleration) const
+    {
+        const double total = duration();
+        t = std::max(0.0, std::min(t, total));
+
+        //the slow down is the speed up played backwards
+        bool mirrored = false;
+        if (t > accel_time + cruise_time)
+        {
+            t = total - t;
+            mirrored = true;
+        }
+
+        const double peak_acceleration = jerk * jerk_time;
+        const double constant_time = accel_time - 2 * jerk_time;
+        double s, v, a;
+        if (t > accel_time)
+        {
+            const double tau = t - accel_time;
+            s = peak_velocity * accel_time / 2 + peak_velocity * tau;
+            v = peak_velocity;
+            a = 0;
+        }
+        else if (t <= jerk_time)
+        {
+            s = jerk * t * t * t / 6;
+            v = jerk * t * t / 2;
+            a = jerk * t;
+        }
+        else
+        {
+            const double s1 = jerk * jerk_time * jerk_time * jerk_time / 6;
+            const double v1 = jerk * jerk_time * jerk_time / 2;
+            if (t <= jerk_time + constant_time)
+            {
+                const double tau = t - jerk_time;
+                s = s1 + v1 * tau + peak_acceleration * tau * tau / 2;
+                v = v1 + peak_acceleration * tau;
+                a = peak_acceleration;
+            }
+            else
+            {
+                const double s2 = s1 + v1 * constant_time
+                    + peak_acceleration * constant_time * constant_time / 2;
+                const double v2 = v1 + peak_acceleration * constant_time;
+                const double tau = t - jerk_time - constant_time;
+                s = s2 + v2 * tau + peak_acceleration * tau * tau / 2 - jerk * tau * tau * tau / 6;
+                v = v2 + peak_acceleration * tau - jerk * tau * tau / 2;
+                a = peak_acceleration - jerk * tau;
+            }
+        }
+
+        position = mirrored ? distance - s : s;
+        velocity = v;
+        acceleration = mirrored ? -a : a;
+    }
+
+    DiggingTrajectory::DiggingTrajectory(const std::vector<JointLimits>& l,
+            double period, double settle) :
+        limits{l}, sample_period{period}, settle_time{settle}
+    {
+    }
+
+    const std::vector<DiggingTrajectory::JointLimits>& DiggingTrajectory::getLimits() const
+    {
+        return limits;
+    }
+
+    std::vector<DiggingTrajectory::JointLimits> DiggingTrajectory::loadLimits()
+    {
+        //conservative defaults, tune them in tfr_control/config/arm_profile.yaml
+        const double default_velocity[] = {0.3, 0.4, 0.4, 0.8};
+        const double default_acceleration[] = {0.3, 0.8, 0.8, 1.6};
+        const double infinity = std::numeric_limits<double>::infinity();
+
+        urdf::Model model;
+        const bool have_urdf = model.initParam("robot_description");
+        if (!have_urdf)
+            ROS_WARN("Digging trajectory: no robot_description, only using configured position limits");
+
+        std::vector<JointLimits> limits(ARM_JOINTS);
+        for (size_t joint = 0; joint < limits.size(); joint++)
+        {
+            JointLimits& limit = limits[joint];
+            const std::string name{joint_names[joint]};
+            const std::string prefix = "/arm_profile/" + name;
+            ros::param::param<double>(prefix + "/max_velocity", limit.max_velocity,
+                    default_velocity[joint]);
+            ros::param::param<double>(prefix + "/max_acceleration", limit.max_acceleration,
+                    default_acceleration[joint]);
+            ros::param::param<double>(prefix + "/max_jerk", limit.max_jerk,
+                    10 * limit.max_acceleration);
+            limit.min_position = -infinity;
+            limit.max_position = infinity;
+
+            if (ros::param::get(prefix + "/min_position", limit.min_position) &&
+                    ros::param::get(prefix + "/max_position", limit.max_position))
+                continue;
+
+            //urdf limits are in joint radians, bring them back to drive units
+            JointMapping mapping;
+            urdf::JointConstSharedPtr urdf_joint = have_urdf ? model.getJoint(name) : nullptr;
+            if (!urdf_joint || !urdf_joint->limits || !JointMapping::load(name, mapping))
+            {
+                ROS_WARN("Digging trajectory: no position limits for %s", name.c_str());
+                limit.min_position = -infinity;
+                limit.max_position = infinity;
+                continue;
+            }
+            const double lower = mapping.toDrive(urdf_joint->limits->lower);
+            const double upper = mapping.toDrive(urdf_joint->limits->upper);
+            limit.min_position = std::min(lower, upper);
+            limit.max_position = std::max(lower, upper);
+        }
+        return limits;
+    }
+
+    DiggingTrajectory::SCurve DiggingTrajectory::solve(double distance,
+            double max_velocity, double max_acceleration, double max_jerk)
+    {
+        SCurve curve{distance, max_jerk, 0, 0, 0, 0};
+        if (distance <= 0)
+            return curve;
+
+        //the acceleration can't be reached before the velocity is
+        double acceleration = std::min(max_acceleration, std::sqrt(max_velocity * max_jerk));
+        double velocity = max_velocity;
+
+        //the distance it takes to get up to speed and back down
+        if (distance < velocity * (velocity / acceleration + acceleration / max_jerk))
+        {
+            if (distance * max_jerk * max_jerk >= 2 * acceleration * acceleration * acceleration)
+            {
+                //still reaches the acceleration limit, but not the velocity one
+                const double ramp = acceleration * acceleration / max_jerk;
+                velocity = (-ramp + std::sqrt(ramp * ramp + 4 * acceleration * distance)) / 2;
+            }
+            else
+            {
+                //all jerk, the acceleration only peaks
+                velocity = std::pow(distance * std::sqrt(max_jerk) / 2, 2.0 / 3.0);
+                acceleration = std::sqrt(velocity * max_jerk);
+            }
+        }
+
+        curve.jerk_time = acceleration / max_jerk;
+        curve.accel_time = velocity / acceleration + curve.jerk_time;
+        curve.peak_velocity = velocity;
+        curve.cruise_time = std::max(0.0, distance / velocity - curve.accel_time);
+        return curve;
+    }
+
+    DiggingTrajectory::SCurve DiggingTrajectory::segment(const Waypoint& from,
+            const Waypoint& to) const
+    {
+        //the path runs from 0 to 1, every joint moves its distance times that
+        double velocity = std::numeric_limits<double>::infinity();
+        double acceleration = velocity;
+        double jerk = velocity;
+        bool moving = false;
+        for (size_t joint = 0; joint < ARM_JOINTS; joint++)
+        {
+            const double distance = std::abs(to[joint] - from[joint]);
+            if (distance <= 0)
+                continue;
+            moving = true;
+            velocity = std::min(velocity, limits[joint].max_velocity / distance);
+            acceleration = std::min(acceleration, limits[joint].max_acceleration / distance);
+            jerk = std::min(jerk, limits[joint].max_jerk / distance);
+        }
+        if (!moving)
+            return SCurve{0, 1, 0, 0, 0, 0};
+        return solve(1.0, velocity, acceleration, jerk);
+    }
+
+    double DiggingTrajectory::segmentTime(const Waypoint& from, const Waypoint& to) const
+    {
+        return segment(from, to).duration();
+    }
+
+    void DiggingTrajectory::appendPoint(const Waypoint& from, const Waypoint& to,
+            const SCurve& curve, double t, double offset,
+            trajectory_msgs::JointTrajectory& trajectory) const
+    {
+        double s, v, a;
+        curve.sample(t, s, v, a);
+        trajectory_msgs::JointTrajectoryPoint point;
+        for (size_t joint = 0; joint < ARM_JOINTS; joint++)
+        {
+            const double distance = to[joint] - from[joint];
+            point.positions.push_back(from[joint] + distance * s);
+            point.velocities.push_back(distance * v);
+            point.accelerations.push_back(distance * a);
+        }
+        point.time_from_start = ros::Duration{offset + t};
+        trajectory.points.push_back(point);
+    }
+
+    double DiggingTrajectory::parameterize(const Waypoint& start, const Waypoint* waypoints,
+            size_t count, double* state_times, trajectory_msgs::JointTrajectory& trajectory) const
+    {
+        trajectory.joint_names.assign(joint_names, joint_names + ARM_JOINTS);
+        trajectory.points.clear();
+
+        double offset = 0;
+        const Waypoint* from = &start;
+        for (size_t i = 0; i < count; i++)
+        {
+            const Waypoint& waypoint = waypoints[i];
+            const SCurve curve = segment(*from, waypoint);
+            const double duration = curve.duration();
+            for (double t = 0; t < duration; t += sample_period)
+                appendPoint(*from, waypoint, curve, t, offset, trajectory);
+            //the executor holds still here while it confirms the arm stopped
+            appendPoint(*from, waypoint, curve, duration, offset, trajectory);
+            if (settle_time > 0)
+                appendPoint(*from, waypoint, curve, duration, offset + settle_time, trajectory);
+
+            state_times[i] = duration + settle_time;
+            offset += duration + settle_time;
+            from = &waypoint;
+        }
+        return offset;
+    }
+}
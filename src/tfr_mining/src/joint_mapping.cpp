@@ -0,0 +1,42 @@
+#include "joint_mapping.h"
+
+#include <ros/ros.h>
+#include <vector>
+
+namespace tfr_mining
+{
+    double JointMapping::toJoint(double drive) const
+    {
+        return scale * drive + offset;
+    }
+
+    double JointMapping::toDrive(double joint) const
+    {
+        return (joint - offset) / scale;
+    }
+
+    bool JointMapping::load(const std::string& joint, JointMapping& mapping)
+    {
+        const std::string profile = "/arm_profile/" + joint;
+        double scale, offset;
+        if (ros::param::get(profile + "/joint_scale", scale) &&
+                ros::param::get(profile + "/joint_offset", offset) && scale != 0)
+        {
+            mapping = JointMapping{scale, offset};
+            return true;
+        }
+
+        //the arm actuators' encoders read in drive radians, so the
+        //calibration line is the mapping
+        std::vector<double> encoder, position;
+        const std::string calibration = "/absolute_position_encoder_limits/" + joint;
+        if (!ros::param::get(calibration + "/encoder", encoder) ||
+                !ros::param::get(calibration + "/joint", position) ||
+                encoder.size() != 2 || position.size() != 2 || encoder[0] == encoder[1] ||
+                position[0] == position[1])
+            return false;
+        scale = (position[1] - position[0]) / (encoder[1] - encoder[0]);
+        mapping = JointMapping{scale, position[0] - scale * encoder[0]};
+        return true;
+    }
+}
@@ -0,0 +1,110 @@
+#include "payload_estimator.h"
+
+#include <moveit/robot_model/revolute_joint_model.h>
+#include <algorithm>
+#include "digging_trajectory.h"
+
+namespace tfr_mining
+{
+    const size_t PayloadEstimator::JOINTS;
+
+    const char* const PayloadEstimator::joint_names[JOINTS] =
+    {
+        "lower_arm_joint",
+        "upper_arm_joint",
+        "scoop_joint",
+    };
+
+    PayloadEstimator::PayloadEstimator(ros::NodeHandle& nh, const std::string& robot_description,
+            const std::vector<JointMapping>& m) :
+        loader{robot_description}, state{}, mappings{m}, payload_link{},
+        payload_point{Eigen::Vector3d::Zero()}, torque_scale{}, torque_offset{}
+    {
+        nh.param<std::string>("payload/link", payload_link, "scoop");
+        for (size_t joint = 0; joint < JOINTS; joint++)
+        {
+            const std::string prefix = std::string{"payload/"} + joint_names[joint];
+            nh.param<double>(prefix + "/torque_scale", torque_scale[joint], 0.0);
+            nh.param<double>(prefix + "/torque_offset", torque_offset[joint], 0.0);
+        }
+
+        const robot_model::RobotModelConstPtr& model = loader.getModel();
+        if (!model || !model->hasLinkModel(payload_link))
+            return;
+
+        std::vector<double> point;
+        if (nh.getParam("payload/point", point) && point.size() == 3)
+            payload_point = Eigen::Vector3d{point[0], point[1], point[2]};
+        else
+        {
+            urdf::LinkConstSharedPtr link = model->getURDF()->getLink(payload_link);
+            if (link && link->inertial)
+                payload_point = Eigen::Vector3d{link->inertial->origin.position.x,
+                    link->inertial->origin.position.y, link->inertial->origin.position.z};
+        }
+
+        state.reset(new robot_state::RobotState{model});
+        state->setToDefaultValues();
+    }
+
+    bool PayloadEstimator::isValid() const
+    {
+        if (state == nullptr)
+            return false;
+        for (size_t joint = 0; joint < JOINTS; joint++)
+            if (torque_scale[joint] != 0)
+                return true;
+        return false;
+    }
+
+    bool PayloadEstimator::estimate(const Waypoint& position, const Torques& torques, double& mass)
+    {
+        for (size_t joint = 0; joint < mappings.size() && joint < position.size(); joint++)
+        {
+            const double angle = mappings[joint].toJoint(position[joint]);
+            state->setJointPositions(DiggingTrajectory::joint_names[joint], &angle);
+        }
+        state->update();
+
+        const robot_model::RobotModelConstPtr& model = loader.getModel();
+        const Eigen::Vector3d gravity{0, 0, -9.81};
+        const Eigen::Vector3d payload = state->getGlobalLinkTransform(payload_link) * payload_point;
+
+        //least squares over the joints of measured = arm + mass * lever
+        double numerator = 0, denominator = 0;
+        for (size_t joint = 0; joint < JOINTS; joint++)
+        {
+            const auto revolute = dynamic_cast<const robot_model::RevoluteJointModel*>(
+                    model->getJointModel(joint_names[joint]));
+            if (torque_scale[joint] == 0 || revolute == nullptr)
+                continue;
+
+            //the joint frame is the child link's frame
+            const auto& frame = state->getGlobalLinkTransform(revolute->getChildLinkModel());
+            const Eigen::Vector3d axis = frame.linear() * revolute->getAxis();
+            const Eigen::Vector3d origin = frame.translation();
+
+            double arm = 0;
+            for (const robot_model::LinkModel* link : revolute->getDescendantLinkModels())
+            {
+                urdf::LinkConstSharedPtr urdf_link = model->getURDF()->getLink(link->getName());
+                if (!urdf_link || !urdf_link->inertial)
+                    continue;
+                const urdf::Vector3& com = urdf_link->inertial->origin.position;
+                const Eigen::Vector3d centre =
+                    state->getGlobalLinkTransform(link) * Eigen::Vector3d{com.x, com.y, com.z};
+                arm += axis.dot((centre - origin).cross(urdf_link->inertial->mass * gravity));
+            }
+            const double lever = axis.dot((payload - origin).cross(gravity));
+            const double measured = torque_scale[joint] * torques[joint] + torque_offset[joint];
+            numerator += (measured - arm) * lever;
+            denominator += lever * lever;
+        }
+
+        //a payload right under every joint can't be weighed
+        if (denominator < 1e-6)
+            return false;
+        mass = std::max(0.0, numerator / denominator);
+        return true;
+    }
+}
@@ -0,0 +1,348 @@
+#include "queue_compiler.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace tfr_mining
+{
+    const uint32_t QueueCompiler::VERSION;
+    const size_t QueueCompiler::JOINTS;
+
+    QueueCompiler::QueueCompiler(const std::vector<DiggingTrajectory::JointLimits>& l) :
+        limits{l}, collision_check{}, collision_step{0.05}
+    {
+    }
+
+    void QueueCompiler::setCollisionCheck(CollisionCheck check, double step)
+    {
+        collision_check = check;
+        collision_step = step;
+    }
+
+    bool QueueCompiler::compile(const std::vector<Rows>& sets, CompiledQueue& queue,
+            std::vector<Diagnostic>& diagnostics) const
+    {
+        queue.waypoints.clear();
+        queue.kinds.clear();
+        queue.set_offsets.assign(1, 0);
+        bool ok = true;
+        auto report = [&](bool error, size_t set, size_t row, const std::string& message)
+        {
+            diagnostics.push_back(Diagnostic{error, set, row, message});
+            ok = ok && !error;
+        };
+
+        for (size_t set = 0; set < sets.size(); set++)
+        {
+            const size_t set_begin = queue.waypoints.size();
+            size_t previous_row = 0;
+            for (size_t row = 0; row < sets[set].size(); row++)
+            {
+                const std::vector<double>& values = sets[set][row].values;
+                const StateKind kind = sets[set][row].kind;
+                if (values.size() < JOINTS)
+                {
+                    std::ostringstream message;
+                    message << "has " << values.size() << " values, needs " << JOINTS;
+                    report(true, set, row, message.str());
+                    continue;
+                }
+                if (values.size() > JOINTS)
+                {
+                    std::ostringstream message;
+                    message << "has " << values.size() << " values, only the first "
+                        << JOINTS << " are used";
+                    report(false, set, row, message.str());
+                }
+
+                Waypoint waypoint;
+                bool valid = true;
+                for (size_t joint = 0; joint < JOINTS; joint++)
+                {
+                    waypoint[joint] = values[joint];
+                    if (!std::isfinite(waypoint[joint]))
+                    {
+                        report(true, set, row, std::string{DiggingTrajectory::joint_names[joint]} +
+                                " is not a number");
+                        valid = false;
+                    }
+                    else if (joint < limits.size() &&
+                            (waypoint[joint] < limits[joint].min_position ||
+                             waypoint[joint] > limits[joint].max_position))
+                    {
+                        std::ostringstream message;
+                        message << DiggingTrajectory::joint_names[joint] << " at " << waypoint[joint]
+                            << " is outside [" << limits[joint].min_position << ", "
+                            << limits[joint].max_position << "]";
+                        report(true, set, row, message.str());
+                        valid = false;
+                    }
+                }
+                if (!valid)
+                    continue;
+
+                if (queue.waypoints.size() > set_begin && queue.waypoints.back() == waypoint &&
+                        queue.kinds.back() == kind)
+                {
+                    std::ostringstream message;
+                    message << "is the same as row " << previous_row << ", merged";
+                    report(false, set, row, message.str());
+                    continue;
+                }
+
+                //the arm moves here from the last waypoint, even across sets
+                std::string contact;
+                if (collision_check && !queue.waypoints.empty() &&
+                        collides(queue.waypoints.back(), waypoint, contact))
+                {
+                    report(true, set, row, "moving here, " + contact);
+                    continue;
+                }
+                if (collision_check && queue.waypoints.empty() &&
+                        collision_check(waypoint, contact))
+                {
+                    report(true, set, row, contact);
+                    continue;
+                }
+
+                queue.waypoints.push_back(waypoint);
+                queue.kinds.push_back(kind);
+                previous_row = row;
+            }
+            if (queue.waypoints.size() == set_begin)
+                report(false, set, 0, "set is empty");
+            queue.set_offsets.push_back(static_cast<uint32_t>(queue.waypoints.size()));
+        }
+        return ok;
+    }
+
+    bool QueueCompiler::collides(const Waypoint& from, const Waypoint& to,
+            std::string& message) const
+    {
+        double distance = 0;
+        for (size_t joint = 0; joint < JOINTS; joint++)
+            distance = std::max(distance, std::abs(to[joint] - from[joint]));
+        const size_t steps = std::max<size_t>(1, std::ceil(distance / collision_step));
+
+        //from itself was checked on the way in
+        for (size_t step = 1; step <= steps; step++)
+        {
+            const double fraction = static_cast<double>(step) / steps;
+            Waypoint position;
+            for (size_t joint = 0; joint < JOINTS; joint++)
+                position[joint] = from[joint] + (to[joint] - from[joint]) * fraction;
+            if (collision_check(position, message))
+            {
+                std::ostringstream at;
+                at << message << " at " << static_cast<int>(fraction * 100) << "% of the way";
+                message = at.str();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool QueueCompiler::write(const std::string& path, const CompiledQueue& queue,
+            std::string& message)
+    {
+        QueueFileHeader header{};
+        std::memcpy(header.magic, "TFRQ", 4);
+        header.version = VERSION;
+        header.joints = JOINTS;
+        header.sets = static_cast<uint32_t>(queue.set_offsets.size() - 1);
+        header.waypoints = static_cast<uint32_t>(queue.waypoints.size());
+        const size_t offsets_end = sizeof(header) + queue.set_offsets.size() * sizeof(uint32_t);
+        header.data_offset = static_cast<uint32_t>((offsets_end + 7) & ~static_cast<size_t>(7));
+
+        std::ofstream out{path, std::ios::binary | std::ios::trunc};
+        if (!out)
+        {
+            message = "could not open " + path;
+            return false;
+        }
+        const char padding[8] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(queue.set_offsets.data()),
+                queue.set_offsets.size() * sizeof(uint32_t));
+        out.write(padding, header.data_offset - offsets_end);
+        out.write(reinterpret_cast<const char*>(queue.waypoints.data()),
+                queue.waypoints.size() * sizeof(Waypoint));
+        out.write(reinterpret_cast<const char*>(queue.kinds.data()),
+                queue.kinds.size() * sizeof(StateKind));
+        if (!out)
+        {
+            message = "could not write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    bool QueueCompiler::fromXmlRpc(XmlRpc::XmlRpcValue& positions, std::vector<Rows>& sets,
+            std::string& message)
+    {
+        sets.clear();
+        if (positions.getType() != XmlRpc::XmlRpcValue::TypeArray)
+        {
+            message = "positions is not a list of sets";
+            return false;
+        }
+        for (int i = 0; i < positions.size(); i++)
+        {
+            if (positions[i].getType() != XmlRpc::XmlRpcValue::TypeArray)
+            {
+                message = "set " + std::to_string(i) + " is not a list of rows";
+                return false;
+            }
+            sets.emplace_back();
+            for (int j = 0; j < positions[i].size(); j++)
+            {
+                XmlRpc::XmlRpcValue& row = positions[i][j];
+                if (row.getType() != XmlRpc::XmlRpcValue::TypeArray)
+                {
+                    message = "set " + std::to_string(i) + " row " + std::to_string(j) +
+                        " is not a list of angles";
+                    return false;
+                }
+                Row parsed{{}, MOVE};
+                for (int angle = 0; angle < row.size(); angle++)
+                {
+                    if (row[angle].getType() == XmlRpc::XmlRpcValue::TypeInt)
+                        parsed.values.push_back(static_cast<int>(row[angle]));
+                    else if (row[angle].getType() == XmlRpc::XmlRpcValue::TypeDouble)
+                        parsed.values.push_back(static_cast<double>(row[angle]));
+                    else if (row[angle].getType() != XmlRpc::XmlRpcValue::TypeString ||
+                            !parseKind(static_cast<std::string>(row[angle]), parsed.kind))
+                        parsed.values.push_back(NAN);
+                }
+                sets.back().push_back(parsed);
+            }
+        }
+        return true;
+    }
+
+    bool QueueCompiler::parseKind(const std::string& word, StateKind& kind)
+    {
+        if (word == "dig")
+            kind = DIG;
+        else if (word == "move")
+            kind = MOVE;
+        else
+            return false;
+        return true;
+    }
+
+    MappedQueue::~MappedQueue()
+    {
+        close();
+    }
+
+    bool MappedQueue::open(const std::string& path, std::string& message)
+    {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            message = "could not open " + path;
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(QueueFileHeader))
+        {
+            ::close(fd);
+            message = path + " is too short for a compiled queue";
+            return false;
+        }
+        size = info.st_size;
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        //the mapping holds its own reference to the file
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            data = nullptr;
+            size = 0;
+            message = "could not map " + path;
+            return false;
+        }
+
+        header = static_cast<const QueueFileHeader*>(data);
+        const size_t offsets_end = sizeof(QueueFileHeader) +
+            (static_cast<size_t>(header->sets) + 1) * sizeof(uint32_t);
+        if (std::memcmp(header->magic, "TFRQ", 4) != 0 ||
+                header->version != QueueCompiler::VERSION ||
+                header->joints != QueueCompiler::JOINTS)
+            message = path + " is not a version " + std::to_string(QueueCompiler::VERSION) +
+                " compiled queue";
+        else if (header->data_offset % 8 != 0 || header->data_offset < offsets_end ||
+                header->data_offset + static_cast<size_t>(header->waypoints) *
+                (QueueCompiler::JOINTS * sizeof(double) + sizeof(uint8_t)) > size)
+            message = path + " is truncated";
+        else
+        {
+            offsets = reinterpret_cast<const uint32_t*>(header + 1);
+            waypoints = reinterpret_cast<const Waypoint*>(
+                    static_cast<const char*>(data) + header->data_offset);
+            kinds = reinterpret_cast<const uint8_t*>(waypoints + header->waypoints);
+            for (size_t set = 0; set < header->sets; set++)
+                if (offsets[set] > offsets[set + 1] || offsets[set + 1] > header->waypoints)
+                {
+                    message = path + " has bad set offsets";
+                    close();
+                    return false;
+                }
+            for (size_t i = 0; i < header->waypoints; i++)
+                if (kinds[i] > DIG)
+                {
+                    message = path + " has an unknown state kind";
+                    close();
+                    return false;
+                }
+            return true;
+        }
+        close();
+        return false;
+    }
+
+    size_t MappedQueue::setCount() const
+    {
+        return header == nullptr ? 0 : header->sets;
+    }
+
+    size_t MappedQueue::setBegin(size_t set) const
+    {
+        return offsets[set];
+    }
+
+    size_t MappedQueue::setEnd(size_t set) const
+    {
+        return offsets[set + 1];
+    }
+
+    const Waypoint& MappedQueue::waypoint(size_t index) const
+    {
+        return waypoints[index];
+    }
+
+    StateKind MappedQueue::kind(size_t index) const
+    {
+        return static_cast<StateKind>(kinds[index]);
+    }
+
+    void MappedQueue::close()
+    {
+        if (data != nullptr)
+            munmap(data, size);
+        data = nullptr;
+        size = 0;
+        header = nullptr;
+        offsets = nullptr;
+        waypoints = nullptr;
+        kinds = nullptr;
+    }
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include "adaptive_dig.h"
+
+using tfr_mining::AdaptiveDig;
+
+namespace
+{
+    AdaptiveDig::Envelope envelope(bool enabled = true)
+    {
+        return AdaptiveDig::Envelope{enabled, 500, 300, 3, 0.3};
+    }
+}
+
+TEST(AdaptiveDig, IdleUntilStarted)
+{
+    AdaptiveDig dig{envelope()};
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::IDLE);
+    for (int i = 0; i < 10; i++)
+        dig.addTorque(AdaptiveDig::LOWER_ARM, 1.0 + i * 0.01, 1000);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::IDLE);
+    EXPECT_EQ(dig.getPeakTorque(AdaptiveDig::LOWER_ARM), 0);
+}
+
+TEST(AdaptiveDig, DisabledNeverDigs)
+{
+    AdaptiveDig dig{envelope(false)};
+    dig.start(0);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::IDLE);
+    for (int i = 0; i < 10; i++)
+        dig.addTorque(AdaptiveDig::SCOOP, 1.0 + i * 0.01, 1000);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::IDLE);
+}
+
+TEST(AdaptiveDig, IgnoresTheStartOfTheMove)
+{
+    AdaptiveDig dig{envelope()};
+    dig.start(10);
+    for (int i = 0; i < 10; i++)
+        dig.addTorque(AdaptiveDig::LOWER_ARM, 10 + i * 0.02, 1000);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::DIGGING);
+    EXPECT_EQ(dig.getPeakTorque(AdaptiveDig::LOWER_ARM), 0);
+
+    dig.addTorque(AdaptiveDig::LOWER_ARM, 10.3, 1000);
+    EXPECT_EQ(dig.getPeakTorque(AdaptiveDig::LOWER_ARM), 1000);
+}
+
+TEST(AdaptiveDig, LoadedAfterEnoughSamplesInARow)
+{
+    AdaptiveDig dig{envelope()};
+    dig.start(0);
+    dig.addTorque(AdaptiveDig::LOWER_ARM, 1.0, 600);
+    dig.addTorque(AdaptiveDig::LOWER_ARM, 1.1, 600);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::DIGGING);
+    dig.addTorque(AdaptiveDig::LOWER_ARM, 1.2, 600);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::LOADED);
+}
+
+TEST(AdaptiveDig, DipUnderTheLimitStartsTheCountAgain)
+{
+    AdaptiveDig dig{envelope()};
+    dig.start(0);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.0, 400);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.1, 400);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.2, 300);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.3, 400);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.4, 400);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::DIGGING);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.5, 400);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::LOADED);
+}
+
+TEST(AdaptiveDig, JointsAreCountedApart)
+{
+    AdaptiveDig dig{envelope()};
+    dig.start(0);
+    //over the scoop limit but not the lower arm one
+    for (int i = 0; i < 5; i++)
+        dig.addTorque(AdaptiveDig::LOWER_ARM, 1.0 + i * 0.1, 400);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::DIGGING);
+
+    dig.addTorque(AdaptiveDig::LOWER_ARM, 2.0, 600);
+    dig.addTorque(AdaptiveDig::SCOOP, 2.0, 400);
+    dig.addTorque(AdaptiveDig::LOWER_ARM, 2.1, 600);
+    dig.addTorque(AdaptiveDig::SCOOP, 2.1, 400);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::DIGGING);
+    dig.addTorque(AdaptiveDig::SCOOP, 2.2, 400);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::LOADED);
+}
+
+TEST(AdaptiveDig, TorqueCountsEitherWay)
+{
+    AdaptiveDig dig{envelope()};
+    dig.start(0);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.0, -350);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.1, -450);
+    dig.addTorque(AdaptiveDig::SCOOP, 1.2, 320);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::LOADED);
+    EXPECT_EQ(dig.getPeakTorque(AdaptiveDig::SCOOP), 450);
+}
+
+TEST(AdaptiveDig, StopAndRestart)
+{
+    AdaptiveDig dig{envelope()};
+    dig.start(0);
+    for (int i = 0; i < 3; i++)
+        dig.addTorque(AdaptiveDig::LOWER_ARM, 1.0 + i * 0.1, 800);
+    ASSERT_EQ(dig.getStatus(), AdaptiveDig::LOADED);
+
+    dig.stop();
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::IDLE);
+    dig.addTorque(AdaptiveDig::LOWER_ARM, 2.0, 900);
+    EXPECT_EQ(dig.getPeakTorque(AdaptiveDig::LOWER_ARM), 800);
+
+    //a new dig forgets the samples and peaks of the last one
+    dig.start(5);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::DIGGING);
+    EXPECT_EQ(dig.getPeakTorque(AdaptiveDig::LOWER_ARM), 0);
+    dig.addTorque(AdaptiveDig::LOWER_ARM, 6.0, 800);
+    EXPECT_EQ(dig.getStatus(), AdaptiveDig::DIGGING);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "dig_scheduler.h"
+
+using tfr_mining::DigScheduler;
+
+namespace
+{
+    /*
+     * Holes at turntable 1 and 2 with the given yields, whole seconds and no
+     * margin, so the plans are easy to work out by hand.
+     * */
+    DigScheduler::Options options(double first_yield, double second_yield)
+    {
+        return DigScheduler::Options{{1.0, 2.0}, {first_yield, second_yield}, 1.0, 0.05, 1.0, 0.0};
+    }
+
+    /*
+     * Runs the scheduler to the end with every set taking its estimate and
+     * not weighed, returns the sets in the order they ran.
+     * */
+    std::vector<size_t> run(DigScheduler& scheduler, const std::vector<double>& times,
+            double budget)
+    {
+        std::vector<size_t> sets;
+        size_t set;
+        while (scheduler.next(budget, set))
+        {
+            sets.push_back(set);
+            scheduler.finished(set, times[set], -1);
+            budget -= times[set];
+        }
+        return sets;
+    }
+
+    std::vector<size_t> runWithoutLimit(DigScheduler& scheduler, const std::vector<double>& times)
+    {
+        std::vector<size_t> sets;
+        size_t set;
+        while (scheduler.nextWithoutLimit(set))
+        {
+            sets.push_back(set);
+            scheduler.finished(set, times[set], -1);
+        }
+        return sets;
+    }
+}
+
+TEST(DigScheduler, SetsShareAHoleByTurntable)
+{
+    DigScheduler scheduler{{10, 10, 10, 10}, {1.0, 2.02, 3.0, NAN}, options(1, 1)};
+    EXPECT_EQ(scheduler.getHoleCount(), 4);
+    EXPECT_EQ(scheduler.getHole(0), 0);
+    EXPECT_EQ(scheduler.getHole(1), 1);
+    EXPECT_EQ(scheduler.getHole(2), 2);
+    EXPECT_EQ(scheduler.getHole(3), 3);
+}
+
+TEST(DigScheduler, NoLimitRunsEverythingInQueueOrder)
+{
+    const std::vector<double> times{10, 10, 10, 10};
+    DigScheduler scheduler{times, {2.0, 1.0, 2.0, 1.0}, options(1, 5)};
+    EXPECT_EQ(runWithoutLimit(scheduler, times), (std::vector<size_t>{0, 1, 2, 3}));
+}
+
+TEST(DigScheduler, OnlyWholeSetsInsideTheBudget)
+{
+    const std::vector<double> times{10, 10, 10};
+    DigScheduler scheduler{times, {1.0, 1.0, 1.0}, options(1, 1)};
+    EXPECT_EQ(run(scheduler, times, 29.5), (std::vector<size_t>{0, 1}));
+
+    DigScheduler exact{times, {1.0, 1.0, 1.0}, options(1, 1)};
+    EXPECT_EQ(run(exact, times, 30), (std::vector<size_t>{0, 1, 2}));
+}
+
+TEST(DigScheduler, MarginIsNeverPlannedInto)
+{
+    const std::vector<double> times{10, 10};
+    DigScheduler::Options with_margin = options(1, 1);
+    with_margin.margin = 5;
+    DigScheduler scheduler{times, {1.0, 1.0}, with_margin};
+    EXPECT_EQ(run(scheduler, times, 24), (std::vector<size_t>{0}));
+}
+
+TEST(DigScheduler, TimeIsSpentOnTheBetterHole)
+{
+    const std::vector<double> times{10, 10, 10, 10};
+    DigScheduler scheduler{times, {1.0, 2.0, 1.0, 2.0}, options(1, 3)};
+    EXPECT_EQ(run(scheduler, times, 20), (std::vector<size_t>{1, 3}));
+}
+
+TEST(DigScheduler, OneChoicePerHole)
+{
+    //taking both sets of the second hole is worth 6 in 10s, taking one of
+    //them 3 in 5s. Counting both choices at once would fill the 15s with 9.
+    const std::vector<double> times{10, 5, 5};
+    DigScheduler scheduler{times, {1.0, 2.0, 2.0}, options(2, 3)};
+    EXPECT_EQ(run(scheduler, times, 15), (std::vector<size_t>{1, 2}));
+
+    //with a bit more time the one set of the first hole fits as well
+    DigScheduler more{times, {1.0, 2.0, 2.0}, options(2, 3)};
+    EXPECT_EQ(run(more, times, 20), (std::vector<size_t>{0, 1, 2}));
+}
+
+TEST(DigScheduler, DeeperSetsWaitForTheShallowerOnes)
+{
+    //the second set of the first hole is cheap and good, but it can only
+    //be dug after the slow first one
+    const std::vector<double> times{20, 1, 3};
+    DigScheduler scheduler{times, {1.0, 1.0, 2.0}, options(5, 1)};
+    EXPECT_EQ(run(scheduler, times, 5), (std::vector<size_t>{2}));
+}
+
+TEST(DigScheduler, NothingFits)
+{
+    const std::vector<double> times{10, 10};
+    DigScheduler scheduler{times, {1.0, 2.0}, options(1, 1)};
+    size_t set;
+    EXPECT_FALSE(scheduler.next(9, set));
+    EXPECT_FALSE(scheduler.next(1e-3, set));
+    //a used up or overrun digging time digs nothing, it is not "no limit"
+    EXPECT_FALSE(scheduler.next(0, set));
+    EXPECT_FALSE(scheduler.next(-30, set));
+
+    DigScheduler::Options with_margin = options(1, 1);
+    with_margin.margin = 5;
+    DigScheduler past_margin{times, {1.0, 2.0}, with_margin};
+    EXPECT_FALSE(past_margin.next(4, set));
+}
+
+TEST(DigScheduler, SlowSetsShrinkThePlan)
+{
+    const std::vector<double> times{10, 10, 10};
+    DigScheduler scheduler{times, {1.0, 1.0, 1.0}, options(1, 1)};
+    size_t set;
+    ASSERT_TRUE(scheduler.next(30, set));
+    EXPECT_EQ(set, 0);
+    //the first set took twice its estimate, so only one more fits in the
+    //remaining 20s
+    scheduler.finished(set, 20, -1);
+    EXPECT_DOUBLE_EQ(scheduler.getTimeScale(), 2.0);
+    EXPECT_FALSE(scheduler.next(10, set));
+    ASSERT_TRUE(scheduler.next(20, set));
+    EXPECT_EQ(set, 1);
+}
+
+TEST(DigScheduler, WeighedScoopsMoveTheYield)
+{
+    const std::vector<double> times{10, 10, 10, 10};
+    DigScheduler scheduler{times, {1.0, 2.0, 1.0, 2.0}, options(2, 1.5)};
+    size_t set;
+    ASSERT_TRUE(scheduler.next(20, set));
+    EXPECT_EQ(set, 0);
+    //the first hole came up empty, (2 + 0) / 2 is worse than the second one
+    scheduler.finished(set, 10, 0);
+    ASSERT_TRUE(scheduler.next(10, set));
+    EXPECT_EQ(set, 1);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include "digging_trajectory.h"
+
+using tfr_mining::DiggingTrajectory;
+using tfr_mining::Waypoint;
+
+namespace
+{
+    /*
+     * Samples the curve finely and checks it stays within the limits, never
+     * runs backwards and comes to rest at the end of the move.
+     * */
+    void expectWithinLimits(const DiggingTrajectory::SCurve& curve, double max_velocity,
+            double max_acceleration, double max_jerk)
+    {
+        const double dt = 1e-4;
+        double last_position = 0, last_acceleration = 0;
+        for (double t = 0; t <= curve.duration(); t += dt)
+        {
+            double position, velocity, acceleration;
+            curve.sample(t, position, velocity, acceleration);
+            EXPECT_GE(position, last_position - 1e-12);
+            EXPECT_GE(velocity, -1e-9);
+            EXPECT_LE(velocity, max_velocity + 1e-9);
+            EXPECT_LE(std::abs(acceleration), max_acceleration + 1e-9);
+            if (t > 0)
+            {
+                EXPECT_LE(std::abs(acceleration - last_acceleration) / dt, max_jerk * (1 + 1e-6));
+            }
+            last_position = position;
+            last_acceleration = acceleration;
+        }
+
+        double position, velocity, acceleration;
+        curve.sample(curve.duration(), position, velocity, acceleration);
+        EXPECT_NEAR(position, curve.distance, 1e-9);
+        EXPECT_NEAR(velocity, 0, 1e-9);
+        EXPECT_NEAR(acceleration, 0, 1e-9);
+    }
+}
+
+TEST(DiggingTrajectory, LongMoveReachesEveryLimit)
+{
+    auto curve = DiggingTrajectory::solve(10, 1, 2, 10);
+
+    EXPECT_NEAR(curve.peak_velocity, 1, 1e-9);
+    EXPECT_NEAR(curve.jerk * curve.jerk_time, 2, 1e-9);
+    EXPECT_NEAR(curve.jerk_time, 0.2, 1e-9);
+    //1/2s of constant acceleration plus one jerk ramp
+    EXPECT_NEAR(curve.accel_time, 0.7, 1e-9);
+    EXPECT_NEAR(curve.cruise_time, 9.3, 1e-9);
+    EXPECT_NEAR(curve.duration(), 10.7, 1e-9);
+    expectWithinLimits(curve, 1, 2, 10);
+}
+
+TEST(DiggingTrajectory, ShortMoveNeverCruises)
+{
+    //reaches the acceleration limit, but not the velocity one
+    auto curve = DiggingTrajectory::solve(0.5, 1, 2, 10);
+
+    EXPECT_LT(curve.peak_velocity, 1);
+    EXPECT_NEAR(curve.jerk * curve.jerk_time, 2, 1e-9);
+    EXPECT_GT(curve.accel_time, 2 * curve.jerk_time);
+    EXPECT_NEAR(curve.cruise_time, 0, 1e-9);
+    expectWithinLimits(curve, 1, 2, 10);
+}
+
+TEST(DiggingTrajectory, TinyMoveIsAllJerk)
+{
+    //too short to reach either limit, acceleration only peaks
+    auto curve = DiggingTrajectory::solve(0.001, 1, 2, 10);
+
+    EXPECT_LT(curve.jerk * curve.jerk_time, 2);
+    EXPECT_NEAR(curve.accel_time, 2 * curve.jerk_time, 1e-9);
+    EXPECT_NEAR(curve.cruise_time, 0, 1e-9);
+    expectWithinLimits(curve, 1, 2, 10);
+}
+
+TEST(DiggingTrajectory, NoMove)
+{
+    auto curve = DiggingTrajectory::solve(0, 1, 2, 10);
+    EXPECT_EQ(curve.duration(), 0.0);
+}
+
+TEST(DiggingTrajectory, SlowestJointSetsTheSegment)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    DiggingTrajectory trajectory{{{-infinity, infinity, 1, 2, 10},
+        {-infinity, infinity, 1, 2, 10},
+        {-infinity, infinity, 4, 8, 40},
+        {-infinity, infinity, 1, 2, 10}}, 0.01, 0.5};
+
+    //joint 0 moving 2 at its own limits is the slowest, the rest keep pace
+    const Waypoint start{0, 0, 0, 0};
+    const Waypoint waypoints[2] = {{2, 1, 3, 0}, {2, 1, 3, 0}};
+    const double slowest = DiggingTrajectory::solve(2, 1, 2, 10).duration();
+    EXPECT_NEAR(trajectory.segmentTime(start, waypoints[0]), slowest, 1e-9);
+    EXPECT_EQ(trajectory.segmentTime(waypoints[0], waypoints[1]), 0.0);
+
+    double state_times[2];
+    trajectory_msgs::JointTrajectory timed;
+    const double total = trajectory.parameterize(start, waypoints, 2, state_times, timed);
+    //every state includes the settle time, even one the arm is already at
+    EXPECT_NEAR(state_times[0], slowest + 0.5, 1e-9);
+    EXPECT_NEAR(state_times[1], 0.5, 1e-9);
+    EXPECT_NEAR(total, slowest + 1.0, 1e-9);
+
+    ASSERT_FALSE(timed.points.empty());
+    EXPECT_EQ(timed.joint_names.size(), tfr_mining::ARM_JOINTS);
+    for (const auto& point : timed.points)
+        for (size_t joint = 0; joint < tfr_mining::ARM_JOINTS; joint++)
+            EXPECT_LE(std::abs(point.velocities[joint]),
+                    trajectory.getLimits()[joint].max_velocity + 1e-9);
+    const auto& last = timed.points.back();
+    for (size_t joint = 0; joint < tfr_mining::ARM_JOINTS; joint++)
+        EXPECT_NEAR(last.positions[joint], waypoints[1][joint], 1e-9);
+    EXPECT_NEAR(last.time_from_start.toSec(), total, 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
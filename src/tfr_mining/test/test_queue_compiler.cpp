@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "queue_compiler.h"
+
+using tfr_mining::DiggingTrajectory;
+using tfr_mining::MappedQueue;
+using tfr_mining::QueueCompiler;
+using tfr_mining::Waypoint;
+
+namespace
+{
+    std::vector<DiggingTrajectory::JointLimits> unitLimits()
+    {
+        return std::vector<DiggingTrajectory::JointLimits>(tfr_mining::ARM_JOINTS,
+                DiggingTrajectory::JointLimits{0, 1, 1, 1, 1});
+    }
+
+    QueueCompiler::Row row(double value, tfr_mining::StateKind kind = tfr_mining::MOVE)
+    {
+        return QueueCompiler::Row{std::vector<double>(tfr_mining::ARM_JOINTS, value), kind};
+    }
+
+    size_t errorCount(const std::vector<QueueCompiler::Diagnostic>& diagnostics)
+    {
+        size_t errors = 0;
+        for (const QueueCompiler::Diagnostic& diagnostic : diagnostics)
+            if (diagnostic.error)
+                errors++;
+        return errors;
+    }
+
+    /*
+     * A fresh file name, removed again when it goes out of scope.
+     * */
+    struct TempFile
+    {
+        std::string path;
+
+        TempFile()
+        {
+            char name[] = "/tmp/test_queue_compiler_XXXXXX";
+            const int fd = mkstemp(name);
+            if (fd >= 0)
+                close(fd);
+            path = name;
+        }
+
+        ~TempFile()
+        {
+            unlink(path.c_str());
+        }
+    };
+}
+
+TEST(QueueCompiler, CompilesSets)
+{
+    QueueCompiler compiler{unitLimits()};
+    std::vector<QueueCompiler::Rows> sets{
+        {row(0.1), row(0.2, tfr_mining::DIG)},
+        {row(0.3)}};
+    QueueCompiler::CompiledQueue queue;
+    std::vector<QueueCompiler::Diagnostic> diagnostics;
+    EXPECT_TRUE(compiler.compile(sets, queue, diagnostics));
+    EXPECT_TRUE(diagnostics.empty());
+
+    ASSERT_EQ(queue.waypoints.size(), 3u);
+    EXPECT_EQ(queue.set_offsets, (std::vector<uint32_t>{0, 2, 3}));
+    EXPECT_EQ(queue.kinds[0], tfr_mining::MOVE);
+    EXPECT_EQ(queue.kinds[1], tfr_mining::DIG);
+    EXPECT_DOUBLE_EQ(queue.waypoints[2][0], 0.3);
+}
+
+TEST(QueueCompiler, DropsRowsOutsideTheLimits)
+{
+    QueueCompiler compiler{unitLimits()};
+    QueueCompiler::Rows rows{row(0.5), row(0.5), row(0.6)};
+    rows[1].values[2] = 5;
+    QueueCompiler::CompiledQueue queue;
+    std::vector<QueueCompiler::Diagnostic> diagnostics;
+    EXPECT_FALSE(compiler.compile({rows}, queue, diagnostics));
+
+    ASSERT_EQ(errorCount(diagnostics), 1u);
+    EXPECT_EQ(diagnostics[0].row, 1u);
+    ASSERT_EQ(queue.waypoints.size(), 2u);
+    EXPECT_DOUBLE_EQ(queue.waypoints[1][2], 0.6);
+}
+
+TEST(QueueCompiler, DropsShortAndNonNumericRows)
+{
+    QueueCompiler compiler{unitLimits()};
+    QueueCompiler::Rows rows{row(0.5), row(0.6), row(0.7)};
+    rows[0].values.pop_back();
+    rows[1].values[0] = NAN;
+    QueueCompiler::CompiledQueue queue;
+    std::vector<QueueCompiler::Diagnostic> diagnostics;
+    EXPECT_FALSE(compiler.compile({rows}, queue, diagnostics));
+
+    EXPECT_EQ(errorCount(diagnostics), 2u);
+    ASSERT_EQ(queue.waypoints.size(), 1u);
+    EXPECT_DOUBLE_EQ(queue.waypoints[0][0], 0.7);
+}
+
+TEST(QueueCompiler, WarnsOnExtraValuesAndMergesRepeats)
+{
+    QueueCompiler compiler{unitLimits()};
+    QueueCompiler::Rows rows{row(0.5), row(0.5), row(0.5, tfr_mining::DIG)};
+    //the fifth value of the 2018 queues
+    rows[0].values.push_back(2.0);
+    QueueCompiler::CompiledQueue queue;
+    std::vector<QueueCompiler::Diagnostic> diagnostics;
+    EXPECT_TRUE(compiler.compile({rows, {}}, queue, diagnostics));
+
+    //extra value, merged row and the empty second set
+    EXPECT_EQ(diagnostics.size(), 3u);
+    EXPECT_EQ(errorCount(diagnostics), 0u);
+    //a different kind is a different state
+    EXPECT_EQ(queue.waypoints.size(), 2u);
+    EXPECT_EQ(queue.set_offsets, (std::vector<uint32_t>{0, 2, 2}));
+}
+
+TEST(QueueCompiler, DropsRowsTheArmCollidesOnTheWayTo)
+{
+    QueueCompiler compiler{unitLimits()};
+    //a wall between 0.4 and 0.6 on the first joint
+    compiler.setCollisionCheck([](const Waypoint& waypoint, std::string& contact)
+            {
+                contact = "wall";
+                return waypoint[0] > 0.4 && waypoint[0] < 0.6;
+            }, 0.05);
+    QueueCompiler::Rows rows{row(0.2), row(0.8), row(0.3)};
+    QueueCompiler::CompiledQueue queue;
+    std::vector<QueueCompiler::Diagnostic> diagnostics;
+    EXPECT_FALSE(compiler.compile({rows}, queue, diagnostics));
+
+    ASSERT_EQ(errorCount(diagnostics), 1u);
+    EXPECT_EQ(diagnostics[0].row, 1u);
+    ASSERT_EQ(queue.waypoints.size(), 2u);
+    EXPECT_DOUBLE_EQ(queue.waypoints[1][0], 0.3);
+}
+
+TEST(QueueCompiler, ParsesKinds)
+{
+    tfr_mining::StateKind kind = tfr_mining::MOVE;
+    EXPECT_TRUE(QueueCompiler::parseKind("dig", kind));
+    EXPECT_EQ(kind, tfr_mining::DIG);
+    EXPECT_TRUE(QueueCompiler::parseKind("move", kind));
+    EXPECT_EQ(kind, tfr_mining::MOVE);
+    EXPECT_FALSE(QueueCompiler::parseKind("scoop", kind));
+}
+
+TEST(MappedQueue, RoundTripsACompiledQueue)
+{
+    QueueCompiler compiler{unitLimits()};
+    std::vector<QueueCompiler::Rows> sets{
+        {row(0.1), row(0.2, tfr_mining::DIG), row(0.3)},
+        {},
+        {row(0.4, tfr_mining::DIG)}};
+    QueueCompiler::CompiledQueue queue;
+    std::vector<QueueCompiler::Diagnostic> diagnostics;
+    ASSERT_TRUE(compiler.compile(sets, queue, diagnostics));
+
+    TempFile file;
+    std::string message;
+    ASSERT_TRUE(QueueCompiler::write(file.path, queue, message)) << message;
+
+    MappedQueue mapped;
+    ASSERT_TRUE(mapped.open(file.path, message)) << message;
+    ASSERT_EQ(mapped.setCount(), 3u);
+    for (size_t set = 0; set < mapped.setCount(); set++)
+    {
+        EXPECT_EQ(mapped.setBegin(set), queue.set_offsets[set]);
+        EXPECT_EQ(mapped.setEnd(set), queue.set_offsets[set + 1]);
+    }
+    for (size_t i = 0; i < queue.waypoints.size(); i++)
+    {
+        EXPECT_EQ(mapped.waypoint(i), queue.waypoints[i]);
+        EXPECT_EQ(mapped.kind(i), queue.kinds[i]);
+    }
+    //the waypoints are read in place, so they have to be aligned
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&mapped.waypoint(0)) % alignof(Waypoint), 0u);
+}
+
+TEST(MappedQueue, RefusesBadFiles)
+{
+    MappedQueue mapped;
+    std::string message;
+    EXPECT_FALSE(mapped.open("/nonexistent/queue.tfrq", message));
+    EXPECT_FALSE(message.empty());
+
+    TempFile file;
+    {
+        std::ofstream out{file.path, std::ios::binary | std::ios::trunc};
+        out << "not a queue, just long enough to have a header";
+    }
+    EXPECT_FALSE(mapped.open(file.path, message));
+    EXPECT_EQ(mapped.setCount(), 0u);
+
+    //a real queue cut short
+    QueueCompiler compiler{unitLimits()};
+    QueueCompiler::CompiledQueue queue;
+    std::vector<QueueCompiler::Diagnostic> diagnostics;
+    ASSERT_TRUE(compiler.compile({{row(0.1), row(0.2)}}, queue, diagnostics));
+    ASSERT_TRUE(QueueCompiler::write(file.path, queue, message)) << message;
+    ASSERT_EQ(truncate(file.path.c_str(), sizeof(tfr_mining::QueueFileHeader) + 16), 0);
+    EXPECT_FALSE(mapped.open(file.path, message));
+    EXPECT_EQ(mapped.setCount(), 0u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -12,7 +12,7 @@
 #include <std_srvs/Empty.h>
 #include <sensor_msgs/Joy.h>
 
-#include <tfr_msgs/SystemStatus.h>
+#include <tfr_msgs/StatusFrame.h>
 #include <tfr_msgs/DurationSrv.h>
 #include <tfr_msgs/EmptyAction.h>
 #include <tfr_msgs/TeleopAction.h>
@@ -21,7 +21,9 @@
 
 #include <tfr_utilities/teleop_code.h>
 #include <tfr_utilities/status_code.h>
+#include <tfr_utilities/tracer.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <mutex>
 
@@ -165,7 +167,7 @@ namespace tfr_mission_control {
 
             //triggered by incoming status message, and cascades other signals into thread
             //safe gui update
-            void updateStatus(const tfr_msgs::SystemStatusConstPtr &status);
+            void updateStatus(const tfr_msgs::StatusFrameConstPtr &frame);
 
             // Responds to joystick messages.
             void joyCallback(const sensor_msgs::Joy::ConstPtr& joy);
@@ -65,6 +65,8 @@ namespace tfr_mission_control {
 
         countdownClock = new QTimer(this); //mission clock, runs repeatedly
 
+        tfr_utilities::Tracer::configureFromParams("mission_control");
+
         // Since rqt creates a Nodelet for the ROS side of things, we can
         // use getNodeHandle() and similar functions instead of creating
         // a NodeHandle member.
@@ -416,14 +418,29 @@ namespace tfr_mission_control {
      * This triggers our custom emitStatus signal, which triggers the built in
      * text update in the text box, a seperate timer event is constantly
      * scrolling the window on a set fast interval.
+     *
+     * Each frame carries every code a node reported since its last one, the
+     * text is only rendered here.
      * */
-    void MissionControl::updateStatus(const tfr_msgs::SystemStatusConstPtr &status)
+    void MissionControl::updateStatus(const tfr_msgs::StatusFrameConstPtr &frame)
     {
-        const std::string statusStr = getStatusMessage(
-            static_cast<StatusCode>(status->status_code), status->data);
-        // The status message must be wrapped in a signal-safe "Q" object.
-        QString statusMsg = QString::fromStdString(statusStr);
-        emit emitStatus(statusMsg);
+        const size_t entries = std::min({frame->codes.size(), frame->counts.size(),
+                frame->data.size()});
+        for (size_t i = 0; i < entries; i++)
+        {
+            std::string statusStr = getStatusMessage(
+                static_cast<StatusCode>(frame->codes[i]), frame->data[i]);
+            if (frame->counts[i] > 1)
+                statusStr += " (x" + std::to_string(frame->counts[i]) + ")";
+            // The status message must be wrapped in a signal-safe "Q" object.
+            QString statusMsg = QString::fromStdString(statusStr);
+            emit emitStatus(statusMsg);
+        }
+        if (frame->dropped != 0)
+        {
+            emit emitStatus(QString::fromStdString(frame->node + ": " +
+                        std::to_string(frame->dropped) + " status reports lost"));
+        }
     }
 
     /*
@@ -483,6 +500,7 @@ namespace tfr_mission_control {
         {
             return;
         }
+        tfr_utilities::TraceSpan span{"mission_control/input_read", "teleop"};
 
         tfr_utilities::TeleopCode code;
         // Using unique_lock instead of lock_guard so we can control when
@@ -630,6 +648,10 @@ namespace tfr_mission_control {
     {
         tfr_msgs::TeleopGoal goal;
         goal.code = static_cast<uint8_t>(code);
+        //starts the joystick to can trace, see trace_report.py
+        goal.trace_flow = tfr_utilities::Tracer::enabled() ? tfr_utilities::Tracer::newFlow() : 0;
+        tfr_utilities::TraceSpan span{"mission_control/send_goal", "teleop", goal.trace_flow,
+            tfr_utilities::Tracer::FLOW_START};
         teleop.sendGoal(goal);
     }
 
@@ -6,6 +6,7 @@
 #include <tfr_msgs/NavigationAction.h>
 #include <tfr_msgs/PoseSrv.h>
 #include <tfr_utilities/location_codes.h>
+#include <tfr_utilities/async_log.h>
 #include <boost/bind.hpp>
 #include <cstdint>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
@@ -105,7 +106,7 @@ private:
         //test for completion
         while (true)
         {
-            ROS_INFO("Navigation Server Preempt Request:%d Active:%d", server.isPreemptRequested(), server.isActive());
+            TFR_LOG_INFO("Navigation Server Preempt Request:%d Active:%d", server.isPreemptRequested(), server.isActive());
 
             //Deal with preemption or error
             if (server.isPreemptRequested() || !ros::ok()) 
@@ -119,7 +120,7 @@ private:
             {
                 rate.sleep();
             }
-            ROS_INFO("Navigation Stack state %s", nav_stack.getState().toString().c_str());
+            TFR_LOG_INFO("Navigation Stack state %s", nav_stack.getState().toString());
             if (nav_stack.getState().isDone())
                 break;
         }
@@ -0,0 +1,67 @@
+/*
+ * Accumulates imu samples between ticks of the sensor fusion filter, and
+ * collapses them into a single measurement per tick.
+ *
+ * Each sample is integrated over the time since the one before it, by its
+ * header stamp: the bias corrected angular velocity into a delta angle, and
+ * the linear acceleration into a delta velocity. The gyro bias is estimated
+ * from the first samples, taken while the robot sits still at startup. A gap
+ * longer than maxGap is a dropout and is not integrated across.
+ *
+ * Every sample's own covariance is propagated into the deltas: a rate with
+ * covariance C held for dt adds C * dt^2 to the covariance of its delta, the
+ * samples being independent. A negative first element marks a field as
+ * unknown and it stays that way.
+ *
+ * robot_localization only takes rates, so toImu() hands the filter the
+ * delta divided by the window, the mean rate over the tick, with the delta
+ * covariance divided by the window squared. Orientation and the header are
+ * taken from the newest sample.
+ * */
+#ifndef IMU_PREINTEGRATOR_H
+#define IMU_PREINTEGRATOR_H
+
+#include <sensor_msgs/Imu.h>
+#include <boost/array.hpp>
+#include <cstddef>
+
+class ImuPreintegrator {
+public:
+    struct Delta {
+        double duration; // seconds integrated over
+        double angle[3]; // rad, bias corrected
+        double velocity[3]; // m/s
+        boost::array<double, 9> angleCovariance;
+        boost::array<double, 9> velocityCovariance;
+        sensor_msgs::Imu latest;
+    };
+
+    ImuPreintegrator(const size_t biasSamples, const double maxGap = 0.1);
+
+    void addSample(const sensor_msgs::Imu& imu);
+
+    // Whether anything was integrated since the last call to integrate()
+    bool hasSamples() const;
+
+    // Produces the deltas for the current window and starts a new one
+    Delta integrate();
+
+    // The mean rates over a window, as the filter wants them
+    static sensor_msgs::Imu toImu(const Delta& delta);
+
+    bool biasEstimated() const;
+
+private:
+    const size_t biasSamples; // how many samples to average the gyro bias over
+    const double maxGap;
+    size_t biasCount;
+    double gyroBias[3];
+
+    bool started; // whether there is a previous stamp to integrate from
+    ros::Time lastStamp;
+    Delta window;
+
+    void resetWindow();
+};
+
+#endif
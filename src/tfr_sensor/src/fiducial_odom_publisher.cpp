@@ -22,6 +22,7 @@
 #include <tfr_msgs/WrappedImage.h>
 #include <tfr_msgs/SetOdometry.h>
 #include <tfr_utilities/tf_manipulator.h>
+#include <tfr_utilities/tracer.h>
 #include <actionlib/client/simple_action_client.h>
 #include <robot_localization/SetPose.h>
 #include <tf2/convert.h>
@@ -81,6 +82,7 @@ class FiducialOdom
 
         void processOdometry(bool reset)
         {
+            tfr_utilities::TraceSpan span{"fiducial_odom/process", "camera"};
             tfr_msgs::ArucoResultConstPtr result = nullptr;
             tfr_msgs::WrappedImage image_wrapper{};
 
@@ -146,6 +148,9 @@ class FiducialOdom
                     0,   0,   0,   0,   0,1e-1}; 
                 //fire it off! and cleanup
                 publisher.publish(odom);
+                tfr_utilities::Tracer::instance().instant("fiducial_odom/publish", "camera",
+                        tfr_utilities::Tracer::flowFromStamp(image_wrapper.response.image.header.stamp.toNSec()),
+                        tfr_utilities::Tracer::FLOW_END);
 
                 //control error propagation in the drivebase odometry publisher removed for debugging
               /* tfr_msgs::SetOdometry odom_req{};
@@ -195,6 +200,7 @@ int main(int argc, char** argv)
 {
     ros::init(argc, argv, "fiducial_odom_publisher");
     ros::NodeHandle n{};
+    tfr_utilities::Tracer::configureFromParams("fiducial_odom_publisher");
 
     std::string footprint_frame, bin_frame, odometry_frame;
     double rate;
@@ -21,6 +21,9 @@
 #include <sensor_msgs/Image.h>
 #include <image_transport/image_transport.h>
 #include <tfr_msgs/WrappedImage.h>
+#include <tfr_utilities/async_log.h>
+#include <tfr_utilities/tracer.h>
+#include <algorithm>
 
 class ImageWrapper
 {
@@ -46,7 +49,17 @@ class ImageWrapper
         void set_current(const sensor_msgs::ImageConstPtr &i, const
                 sensor_msgs::CameraInfoConstPtr &in)
         {
-            ROS_INFO("Image subscription callback");
+            TFR_LOG_INFO("Image subscription callback");
+            if (tfr_utilities::Tracer::enabled())
+            {
+                //the stamp follows the image all the way to fiducial odom
+                const uint64_t flow = tfr_utilities::Tracer::flowFromStamp(i->header.stamp.toNSec());
+                const int64_t stamp = static_cast<int64_t>(i->header.stamp.toNSec() / 1000);
+                const int64_t now = tfr_utilities::Tracer::now();
+                tfr_utilities::Tracer::instance().span("camera/exposure", "camera", stamp,
+                        std::max<int64_t>(now - stamp, 0), flow, tfr_utilities::Tracer::FLOW_START);
+                tfr_utilities::Tracer::instance().instant("image_wrapper/receive", "camera", flow);
+            }
             //this is safe because of shared pointers and non threaded spinning
             image = i;
             info = in;
@@ -60,6 +73,8 @@ class ImageWrapper
              * so nullptr check needed*/
             if (image != nullptr && info != nullptr)
             {
+                tfr_utilities::TraceSpan span{"image_wrapper/serve", "camera",
+                    tfr_utilities::Tracer::flowFromStamp(image->header.stamp.toNSec())};
                 response.image = *image;
                 response.camera_info= *info;
                 return true;
@@ -77,6 +92,7 @@ int main(int argc, char **argv)
 {
     ros::init(argc, argv, "image_topic_wrapper");
     ros::NodeHandle n;
+    tfr_utilities::Tracer::configureFromParams("image_topic_wrapper");
     std::string camera_topic{}, service_name{};
     ros::param::param<std::string>("~camera_topic", camera_topic, "");
     ros::param::param<std::string>("~service_name", service_name, "");
@@ -0,0 +1,93 @@
+#include "imu_preintegrator.h"
+
+ImuPreintegrator::ImuPreintegrator(const size_t biasSamples, const double maxGap) :
+    biasSamples{ biasSamples }, maxGap{ maxGap }, biasCount{ 0 }, gyroBias{}, started{ false }, lastStamp{}, window{} {
+    resetWindow();
+}
+
+void ImuPreintegrator::addSample(const sensor_msgs::Imu& imu) {
+    const double angular[3] = { imu.angular_velocity.x, imu.angular_velocity.y, imu.angular_velocity.z };
+    const double acceleration[3] = { imu.linear_acceleration.x, imu.linear_acceleration.y, imu.linear_acceleration.z };
+
+    if (biasCount < biasSamples) {
+        // running mean, so a partial estimate is usable right away
+        biasCount++;
+        for (int i = 0; i < 3; i++) {
+            gyroBias[i] += (angular[i] - gyroBias[i]) / biasCount;
+        }
+    }
+
+    const double dt = started ? (imu.header.stamp - lastStamp).toSec() : 0;
+    started = true;
+    lastStamp = imu.header.stamp;
+    window.latest = imu;
+    // out of order, or a dropout we know nothing about
+    if (dt <= 0 || dt > maxGap) {
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        window.angle[i] += (angular[i] - gyroBias[i]) * dt;
+        window.velocity[i] += acceleration[i] * dt;
+    }
+    const bool angleKnown = window.angleCovariance[0] >= 0 && imu.angular_velocity_covariance[0] >= 0;
+    const bool velocityKnown = window.velocityCovariance[0] >= 0 && imu.linear_acceleration_covariance[0] >= 0;
+    for (size_t i = 0; i < 9; i++) {
+        window.angleCovariance[i] += imu.angular_velocity_covariance[i] * dt * dt;
+        window.velocityCovariance[i] += imu.linear_acceleration_covariance[i] * dt * dt;
+    }
+    if (!angleKnown) {
+        window.angleCovariance[0] = -1;
+    }
+    if (!velocityKnown) {
+        window.velocityCovariance[0] = -1;
+    }
+    window.duration += dt;
+}
+
+bool ImuPreintegrator::hasSamples() const {
+    return window.duration > 0;
+}
+
+bool ImuPreintegrator::biasEstimated() const {
+    return biasCount >= biasSamples;
+}
+
+ImuPreintegrator::Delta ImuPreintegrator::integrate() {
+    Delta out = window;
+    resetWindow();
+    window.latest = out.latest;
+    return out;
+}
+
+sensor_msgs::Imu ImuPreintegrator::toImu(const Delta& delta) {
+    sensor_msgs::Imu out = delta.latest;
+    if (delta.duration <= 0) {
+        return out;
+    }
+
+    const double duration = delta.duration;
+    out.angular_velocity.x = delta.angle[0] / duration;
+    out.angular_velocity.y = delta.angle[1] / duration;
+    out.angular_velocity.z = delta.angle[2] / duration;
+    out.linear_acceleration.x = delta.velocity[0] / duration;
+    out.linear_acceleration.y = delta.velocity[1] / duration;
+    out.linear_acceleration.z = delta.velocity[2] / duration;
+    for (size_t i = 0; i < 9; i++) {
+        out.angular_velocity_covariance[i] = delta.angleCovariance[0] < 0 ? -1 :
+            delta.angleCovariance[i] / (duration * duration);
+        out.linear_acceleration_covariance[i] = delta.velocityCovariance[0] < 0 ? -1 :
+            delta.velocityCovariance[i] / (duration * duration);
+    }
+    return out;
+}
+
+void ImuPreintegrator::resetWindow() {
+    window.duration = 0;
+    for (int i = 0; i < 3; i++) {
+        window.angle[i] = 0;
+        window.velocity[i] = 0;
+    }
+    window.angleCovariance.fill(0);
+    window.velocityCovariance.fill(0);
+}
@@ -0,0 +1,60 @@
+/*
+ * Sits in front of sensor fusion and integrates the ~200 hz imu stream into
+ * one bias corrected delta angle and delta velocity per filter tick, handed
+ * to the filter as the mean rates over the tick, so it does not have to queue
+ * and process every raw sample.
+ *
+ * Parameters:
+ *   - ~rate: how quickly to publish, should match the filter frequency hz. (double, default 16)
+ *   - ~bias_samples: how many samples at startup to estimate gyro bias from (int, default 400)
+ *   - ~max_gap: longest gap between samples to integrate across s. (double, default 0.1)
+ * Subscribed topics:
+ *   - /sensors/imu : (sensor_msgs/Imu) the raw imu stream
+ * Published topics:
+ *   - /sensors/imu_integrated : (sensor_msgs/Imu) one measurement per tick
+ * */
+#include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
+#include <boost/function.hpp>
+#include <mutex>
+#include "imu_preintegrator.h"
+
+int main(int argc, char** argv) {
+    ros::init(argc, argv, "imu_preintegrator");
+    ros::NodeHandle n;
+
+    double rate;
+    int biasSamples;
+    double maxGap;
+    ros::param::param<double>("~rate", rate, 16);
+    ros::param::param<int>("~bias_samples", biasSamples, 400);
+    ros::param::param<double>("~max_gap", maxGap, 0.1);
+
+    ImuPreintegrator preintegrator(biasSamples, maxGap);
+    std::mutex preintegratorMutex;
+
+    ros::Publisher imuPublisher = n.advertise<sensor_msgs::Imu>("/sensors/imu_integrated", 5);
+    boost::function<void(const sensor_msgs::Imu&)> imuCallback = [&preintegrator, &preintegratorMutex](const sensor_msgs::Imu& msg) {
+        std::lock_guard<std::mutex> lock(preintegratorMutex);
+        preintegrator.addSample(msg);
+    };
+    auto imuSub = n.subscribe<sensor_msgs::Imu>("/sensors/imu", 250, imuCallback);
+
+    ros::Rate loop_rate(rate);
+    bool biasReported = false;
+    while (ros::ok()) {
+        ros::spinOnce();
+        {
+            std::lock_guard<std::mutex> lock(preintegratorMutex);
+            if (preintegrator.hasSamples()) {
+                imuPublisher.publish(ImuPreintegrator::toImu(preintegrator.integrate()));
+            }
+            if (!biasReported && preintegrator.biasEstimated()) {
+                ROS_INFO("Imu Preintegrator: gyro bias estimated");
+                biasReported = true;
+            }
+        }
+        loop_rate.sleep();
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "imu_preintegrator.h"
+
+sensor_msgs::Imu makeSample(double stamp, double yawRate, double accelerationX)
+{
+    sensor_msgs::Imu imu;
+    imu.header.stamp = ros::Time(stamp);
+    imu.angular_velocity.z = yawRate;
+    imu.linear_acceleration.x = accelerationX;
+    imu.angular_velocity_covariance[8] = 0.04;
+    imu.linear_acceleration_covariance[0] = 0.1;
+    return imu;
+}
+
+TEST(ImuPreintegrator, IntegratesDeltas)
+{
+    ImuPreintegrator preintegrator(0);
+    preintegrator.addSample(makeSample(1.0, 0.0, 0.0));
+    //the first sample only gives the next one a start
+    EXPECT_FALSE(preintegrator.hasSamples());
+    preintegrator.addSample(makeSample(1.01, 1.0, 2.0));
+    preintegrator.addSample(makeSample(1.04, 3.0, 4.0));
+    EXPECT_TRUE(preintegrator.hasSamples());
+
+    ImuPreintegrator::Delta delta = preintegrator.integrate();
+    EXPECT_NEAR(delta.duration, 0.04, 1e-9);
+    EXPECT_NEAR(delta.angle[2], 1.0 * 0.01 + 3.0 * 0.03, 1e-9);
+    EXPECT_NEAR(delta.velocity[0], 2.0 * 0.01 + 4.0 * 0.03, 1e-9);
+    //each rate's covariance held for its dt
+    EXPECT_NEAR(delta.angleCovariance[8], 0.04 * (0.01 * 0.01 + 0.03 * 0.03), 1e-12);
+    EXPECT_NEAR(delta.velocityCovariance[0], 0.1 * (0.01 * 0.01 + 0.03 * 0.03), 1e-12);
+    EXPECT_FALSE(preintegrator.hasSamples());
+
+    //the next window picks up from the last sample of this one
+    preintegrator.addSample(makeSample(1.05, 2.0, 0.0));
+    delta = preintegrator.integrate();
+    EXPECT_NEAR(delta.duration, 0.01, 1e-9);
+    EXPECT_NEAR(delta.angle[2], 0.02, 1e-9);
+}
+
+TEST(ImuPreintegrator, MeanRatesForTheFilter)
+{
+    ImuPreintegrator preintegrator(0);
+    preintegrator.addSample(makeSample(0.0, 0.0, 0.0));
+    preintegrator.addSample(makeSample(0.005, 1.0, 2.0));
+    preintegrator.addSample(makeSample(0.01, 3.0, 4.0));
+
+    sensor_msgs::Imu out = ImuPreintegrator::toImu(preintegrator.integrate());
+    EXPECT_NEAR(out.angular_velocity.z, 2.0, 1e-9);
+    EXPECT_NEAR(out.linear_acceleration.x, 3.0, 1e-9);
+    //two equal, independent samples halve the variance
+    EXPECT_NEAR(out.angular_velocity_covariance[8], 0.02, 1e-9);
+    EXPECT_NEAR(out.linear_acceleration_covariance[0], 0.05, 1e-9);
+    EXPECT_DOUBLE_EQ(out.header.stamp.toSec(), 0.01);
+}
+
+TEST(ImuPreintegrator, SkipsDropouts)
+{
+    ImuPreintegrator preintegrator(0, 0.1);
+    preintegrator.addSample(makeSample(0.0, 1.0, 0.0));
+    preintegrator.addSample(makeSample(0.5, 1.0, 0.0));
+    EXPECT_FALSE(preintegrator.hasSamples());
+    preintegrator.addSample(makeSample(0.51, 1.0, 0.0));
+    EXPECT_NEAR(preintegrator.integrate().duration, 0.01, 1e-9);
+}
+
+TEST(ImuPreintegrator, KeepsUnknownCovariance)
+{
+    ImuPreintegrator preintegrator(0);
+    sensor_msgs::Imu sample = makeSample(0.0, 1.0, 0.0);
+    sample.linear_acceleration_covariance[0] = -1;
+    preintegrator.addSample(sample);
+    sample.header.stamp = ros::Time(0.01);
+    preintegrator.addSample(sample);
+
+    sensor_msgs::Imu out = ImuPreintegrator::toImu(preintegrator.integrate());
+    EXPECT_DOUBLE_EQ(out.linear_acceleration_covariance[0], -1);
+    EXPECT_NEAR(out.angular_velocity_covariance[8], 0.04, 1e-9);
+}
+
+TEST(ImuPreintegrator, RemovesGyroBias)
+{
+    ImuPreintegrator preintegrator(2);
+    preintegrator.addSample(makeSample(0.0, 0.1, 0));
+    EXPECT_FALSE(preintegrator.biasEstimated());
+    preintegrator.addSample(makeSample(0.01, 0.1, 0));
+    EXPECT_TRUE(preintegrator.biasEstimated());
+    preintegrator.integrate();
+
+    preintegrator.addSample(makeSample(0.02, 0.6, 0));
+    sensor_msgs::Imu out = ImuPreintegrator::toImu(preintegrator.integrate());
+    EXPECT_NEAR(out.angular_velocity.z, 0.5, 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -4,16 +4,35 @@
 #include <tfr_msgs/ArmMoveAction.h>
 #include <std_msgs/Float64MultiArray.h>
 #include <std_msgs/UInt16.h>
+#include <std_msgs/Bool.h>
 #include <actionlib/server/simple_action_server.h>
 #include <trajectory_msgs/JointTrajectory.h>
 #include <joints.h>
 #include <urdf/model.h>
 #include <actionlib/client/simple_action_client.h>
 #include <sensor_msgs/JointState.h>
+#include <tfr_msgs/ArmCommand.h>
+#include <profile_synchronizer.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 /**
  * Provides a simple method for moving the arm.
  * This is a regular ole' class, just instantiate it and call moveArm.
+ *
+ * PARAMETERS:
+ *  /arm_profile/<joint>/max_velocity: rad/s (double)
+ *  /arm_profile/<joint>/max_acceleration: rad/s^2 (double)
+ *      limits used to give each joint a profile so they all arrive together,
+ *      for turntable_joint, lower_arm_joint, upper_arm_joint and scoop_joint.
+ *      Like every position here they are in the drives' own radians.
+ * SUBSCRIBED TOPICS:
+ *  /device<id>/get_joint_state - where the arm starts each move from
+ *  /arm_command/enabled - whether the CAN bridge takes whole arm commands,
+ *      until it says so moves go out per drive on /device<id>/set_joint_state
+ *  /arm_command/profiled - whether it applies their profiles as well, until it
+ *      says so no move has a known duration
  * */
 class ArmManipulator
 {
@@ -27,7 +46,12 @@ class ArmManipulator
 
         void moveArm( const double& turntable, const double& lower_arm, const double& upper_arm, const double& scoop);
 
-        void moveArmWithoutPlanningOrLimits(
+        /*
+         * Returns how long the move should take in seconds, or 0 if the arm's
+         * position is unknown or whole arm commands or their profiles are
+         * unavailable, and the drives keep their own profiles.
+         * */
+        double moveArmWithoutPlanningOrLimits(
             const double& turntable, const double& lower_arm, const double& upper_arm, const double& scoop);
 
         void moveTurntablePosition(double turntable);
@@ -48,8 +72,27 @@ class ArmManipulator
         ros::Publisher scoop_publisher;
         ros::Publisher left_bin_publisher;
         ros::Publisher right_bin_publisher;
+        ros::Publisher arm_command_publisher;
         ros::Subscriber turntable_statusword_subscriber;
         void updateTurntableTargetPosition(const std_msgs::UInt16 &value);
+
+        std::atomic<bool> arm_command_enabled{false};
+        ros::Subscriber arm_command_enabled_subscriber;
+        void updateArmCommandEnabled(const std_msgs::Bool &enabled);
+
+        std::atomic<bool> arm_command_profiled{false};
+        ros::Subscriber arm_command_profiled_subscriber;
+        void updateArmCommandProfiled(const std_msgs::Bool &profiled);
+
+        ProfileSynchronizer synchronizer;
+        std::vector<ros::Subscriber> joint_state_subscribers;
+        std::mutex joint_state_mutex;
+        //turntable, lower arm, upper arm, scoop
+        std::vector<double> arm_position;
+        //bit i is set once joint i has reported
+        uint8_t arm_position_known = 0;
+        void updateArmPosition(const sensor_msgs::JointState::ConstPtr &state, size_t joint);
+        static std::vector<ProfileSynchronizer::Limits> loadProfileLimits();
  };
 
 #endif
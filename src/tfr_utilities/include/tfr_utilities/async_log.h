@@ -0,0 +1,278 @@
+/*
+ * Logging for hot paths, a drop in for ROS_INFO and friends that does not
+ * format on the calling thread.
+ *
+ *      TFR_LOG_INFO("Moving arm to position: %.2f %.2f", lower, upper);
+ *
+ * The call site is checked against rosconsole exactly like ROS_INFO is, so
+ * the levels in detailed_logging_rosconsole.config (or rqt_logger_level) turn
+ * it on and off, and nothing is done for a disabled level. An enabled call
+ * copies the wall time and its raw arguments into a fixed size AsyncLogRecord
+ * on a ring of the calling thread's own, no locks or allocation. A thread of
+ * AsyncLog's drains the rings every 10 ms, and drops the ring of a thread that
+ * has exited once it is empty. It then either formats the records and
+ * hands them to rosconsole with the call site's file, line and logger, or
+ * writes them as is to a .tfrl file for async_log_decode.py to format offline.
+ *
+ * Every site is also rate limited, to /async_log/rate messages per second by
+ * default or its own with the _RATE macros, 0 for no limit. What it drops is
+ * counted onto the next message that gets through.
+ *
+ * Arguments can be integers, floating point, bools, enums, C strings and
+ * std::string. Strings are copied, so temporaries are fine. They have to fit
+ * AsyncLogRecord::DATA_SIZE bytes together, whatever doesn't is printed as
+ * "<truncated>". Formats are printf's without '*' widths, and the argument is
+ * converted to what the conversion asks for, so %d of a size_t is fine.
+ *
+ * Rosconsole stamps a message when it is printed, which is up to 10 ms after
+ * the call. The .tfrl files keep the time of the call.
+ *
+ * PARAMETERS (read when the first message is logged):
+ *  /async_log/rate: default messages per second per site (double, default 10)
+ *  /async_log/ring_size: messages each thread can have waiting, more are
+ *      dropped and counted (int, default 1024)
+ *  /async_log/directory: when set, write <directory>/<node>_<pid>.tfrl
+ *      instead of printing (string, default "")
+ * */
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <ros/console.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tfr_utilities
+{
+    /*
+     * One call site, a function local static made by the macros below
+     * */
+    struct AsyncLogSite
+    {
+        AsyncLogSite(ros::console::LogLocation* location, const char* file, int line,
+                const char* function, const char* format, double rate);
+        AsyncLogSite(const AsyncLogSite&) = delete;
+        AsyncLogSite& operator=(const AsyncLogSite&) = delete;
+
+        /*
+         * Whether a message at now [us] gets through the rate limit, if it
+         * does suppressed is how many didn't since the last one
+         * */
+        bool admit(int64_t now, uint32_t& suppressed);
+
+        ros::console::LogLocation* const location;
+        const char* const file;
+        const int line;
+        const char* const function;
+        const char* const format;
+        const uint32_t id;
+
+    private:
+        //us between messages, 0 for no limit
+        const int64_t period;
+        std::atomic<int64_t> next;
+        std::atomic<uint32_t> suppressed;
+    };
+
+    /*
+     * A message as it waits on a ring: which site, when, and the arguments
+     * packed one after the other, each a tag and its value.
+     * */
+    struct AsyncLogRecord
+    {
+        static constexpr size_t DATA_SIZE = 96;
+
+        enum Tag : uint8_t
+        {
+            SIGNED = 'i',
+            UNSIGNED = 'u',
+            DOUBLE = 'd',
+            STRING = 's',   // a one byte length, then the bytes
+        };
+
+        const AsyncLogSite* site;
+        int64_t time;       // us since the epoch
+        uint32_t suppressed;
+        int32_t tid;
+        uint8_t arguments;
+        uint8_t size;       // bytes of data used
+        uint8_t truncated;
+        uint8_t padding[5];
+        char data[DATA_SIZE];
+
+        void clear();
+
+        template <typename... Args>
+        void pack(const Args&... args)
+        {
+            int expand[] = {0, (add(args), 0)...};
+            (void)expand;
+        }
+
+        void add(const char* value);
+        void add(const std::string& value) { add(value.c_str()); }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+        add(T value)
+        {
+            addNumber(SIGNED, static_cast<int64_t>(value));
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+        add(T value)
+        {
+            addNumber(UNSIGNED, static_cast<uint64_t>(value));
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_enum<T>::value>::type add(T value)
+        {
+            add(static_cast<typename std::underlying_type<T>::type>(value));
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_floating_point<T>::value>::type add(T value)
+        {
+            addNumber(DOUBLE, static_cast<double>(value));
+        }
+
+        /*
+         * printf the arguments into format
+         * */
+        std::string format(const char* format) const;
+
+    private:
+        template <typename T>
+        void addNumber(Tag tag, T value);
+    };
+
+    class AsyncLog
+    {
+        public:
+            static AsyncLog& instance();
+
+            /*
+             * Queues a message for site, from the macros below
+             * */
+            template <typename... Args>
+            void log(AsyncLogSite& site, const Args&... args)
+            {
+                AsyncLogRecord record;
+                record.clear();
+                record.time = now();
+                if (!site.admit(record.time, record.suppressed))
+                    return;
+                record.site = &site;
+                record.pack(args...);
+                push(record);
+            }
+
+            double defaultRate() const { return default_rate; }
+
+            /*
+             * Prints or writes everything queued so far, normally done every
+             * 10 ms
+             * */
+            void flush();
+
+            /*
+             * How many rings are kept, one for every thread that has logged
+             * and not exited, or whose last messages are still waiting
+             * */
+            size_t getRingCount();
+
+            static int64_t now();
+
+            ~AsyncLog();
+            AsyncLog(const AsyncLog&) = delete;
+            AsyncLog& operator=(const AsyncLog&) = delete;
+            AsyncLog(AsyncLog&&) = delete;
+            AsyncLog& operator=(AsyncLog&&) = delete;
+
+        private:
+            struct Ring
+            {
+                Ring(size_t capacity, int32_t tid);
+                const size_t capacity;
+                const int32_t tid;
+                std::unique_ptr<AsyncLogRecord[]> records;
+                //written by the logging thread, read by the drain thread
+                std::atomic<uint64_t> head;
+                //the other way around
+                std::atomic<uint64_t> tail;
+                std::atomic<uint64_t> dropped;
+                //set once the thread has exited, after its last message
+                std::atomic<bool> retired;
+            };
+
+            //retires the calling thread's ring when the thread exits
+            struct ThreadRing
+            {
+                ~ThreadRing();
+                std::shared_ptr<Ring> ring;
+            };
+
+            static thread_local ThreadRing thread_ring;
+
+            AsyncLog();
+
+            double default_rate;
+            size_t ring_size;
+            std::string directory;
+
+            //guards the rings, flush takes it too so two never interleave
+            std::mutex mutex;
+            std::vector<std::shared_ptr<Ring>> rings;
+            std::ofstream binary;
+            std::vector<bool> sites_written;
+            std::vector<AsyncLogRecord> pending;
+
+            std::mutex stop_mutex;
+            std::condition_variable signal;
+            bool stopping;
+            std::thread drainer;
+
+            void push(const AsyncLogRecord& record);
+            Ring& threadRing();
+            void run();
+            void print(const AsyncLogRecord& record) const;
+            void writeBinary(const AsyncLogRecord& record);
+    };
+}
+
+#define TFR_LOG_RATE(level, rate, format, ...) \
+    do \
+    { \
+        ROSCONSOLE_DEFINE_LOCATION(true, level, ROSCONSOLE_DEFAULT_NAME); \
+        if (ROS_UNLIKELY(__rosconsole_define_location__enabled)) \
+        { \
+            static ::tfr_utilities::AsyncLogSite __tfr_async_log_site{ \
+                &__rosconsole_define_location__loc, __FILE__, __LINE__, __ROSCONSOLE_FUNCTION__, \
+                format, rate}; \
+            ::tfr_utilities::AsyncLog::instance().log(__tfr_async_log_site, ##__VA_ARGS__); \
+        } \
+    } while (false)
+
+//a negative rate takes /async_log/rate
+#define TFR_LOG_DEBUG(format, ...) TFR_LOG_RATE(::ros::console::levels::Debug, -1, format, ##__VA_ARGS__)
+#define TFR_LOG_INFO(format, ...) TFR_LOG_RATE(::ros::console::levels::Info, -1, format, ##__VA_ARGS__)
+#define TFR_LOG_WARN(format, ...) TFR_LOG_RATE(::ros::console::levels::Warn, -1, format, ##__VA_ARGS__)
+#define TFR_LOG_ERROR(format, ...) TFR_LOG_RATE(::ros::console::levels::Error, -1, format, ##__VA_ARGS__)
+
+#define TFR_LOG_DEBUG_RATE(rate, format, ...) \
+    TFR_LOG_RATE(::ros::console::levels::Debug, rate, format, ##__VA_ARGS__)
+#define TFR_LOG_INFO_RATE(rate, format, ...) \
+    TFR_LOG_RATE(::ros::console::levels::Info, rate, format, ##__VA_ARGS__)
+#define TFR_LOG_WARN_RATE(rate, format, ...) \
+    TFR_LOG_RATE(::ros::console::levels::Warn, rate, format, ##__VA_ARGS__)
+
+#endif
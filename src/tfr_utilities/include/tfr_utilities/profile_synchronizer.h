@@ -0,0 +1,59 @@
+#ifndef PROFILE_SYNCHRONIZER_H
+#define PROFILE_SYNCHRONIZER_H
+
+#include <vector>
+
+/**
+ * Picks a trapezoidal velocity profile for every axis of a multi axis move,
+ * so that all of the axes start and finish at the same moment.
+ *
+ * Every axis gets the same accelerate, cruise and decelerate timing, only the
+ * peak velocity and acceleration are scaled to its distance. That makes the
+ * axes move in a straight line in joint space, and the move takes as long as
+ * the most constrained axis needs, never longer.
+ *
+ * For acceleration time ta and total time T an axis moving d needs
+ *     v = d / (T - ta),  a = v / ta
+ * so the limits give T >= ta + V and T >= ta + A / ta, where V is the largest
+ * d / max_velocity and A is the largest d / max_acceleration. The shortest T
+ * is then:
+ *     A <= V^2: ta = A / V, T = V + A / V  (trapezoid)
+ *     A >  V^2: ta = sqrt(A), T = 2 ta     (triangle)
+ * */
+class ProfileSynchronizer
+{
+    public:
+        struct Limits
+        {
+            double max_velocity;
+            double max_acceleration;
+        };
+
+        struct Profile
+        {
+            double velocity;
+            double acceleration;
+        };
+
+        /*
+         * limits: one per axis, everything must be positive
+         * */
+        explicit ProfileSynchronizer(const std::vector<Limits>& limits);
+        ProfileSynchronizer(const ProfileSynchronizer&) = default;
+        ProfileSynchronizer& operator=(const ProfileSynchronizer&) = default;
+        ProfileSynchronizer(ProfileSynchronizer&&) = default;
+        ProfileSynchronizer& operator=(ProfileSynchronizer&&) = default;
+
+        /*
+         * Fills profiles for a move from start to end, returns how long the
+         * move takes in seconds. Axes that don't move get the smallest
+         * non zero profile, since many drives reject a profile of zero.
+         * */
+        double synchronize(const std::vector<double>& start, const std::vector<double>& end,
+                std::vector<Profile>& profiles) const;
+
+    private:
+        std::vector<Limits> limits;
+};
+
+#endif
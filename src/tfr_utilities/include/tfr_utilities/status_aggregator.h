@@ -0,0 +1,66 @@
+/* Coalesces the status codes a node reports between two status frames.
+ *
+ * A code reported again before the frame goes out only bumps its count and
+ * keeps the newest data, so a node stuck in a loop reporting the same code
+ * costs one entry per frame instead of a message per report. Entries stay in
+ * the order their codes were first reported. Once max_entries different codes
+ * are waiting, reports of new codes are only counted as dropped.
+ *
+ * Not thread safe, StatusPublisher guards it.
+ * */
+#ifndef STATUS_AGGREGATOR_H
+#define STATUS_AGGREGATOR_H
+
+#include <status_code.h>
+#include <cstdint>
+#include <vector>
+
+class StatusAggregator
+{
+    public:
+        //rosgraph_msgs/Log levels, QUIET goes to mission control only
+        enum Level : uint8_t
+        {
+            QUIET = 0,
+            DEBUG = 1,
+            INFO = 2,
+            WARN = 4,
+            ERROR = 8,
+        };
+
+        struct Entry
+        {
+            StatusCode code;
+            //the highest level it was reported at
+            uint8_t level;
+            //reports since the last frame, saturates
+            uint16_t count;
+            //from the latest report
+            float data;
+            double time;
+        };
+
+        explicit StatusAggregator(size_t max_entries);
+        ~StatusAggregator() = default;
+        StatusAggregator(const StatusAggregator&) = delete;
+        StatusAggregator& operator=(const StatusAggregator&) = delete;
+        StatusAggregator(StatusAggregator&&) = delete;
+        StatusAggregator& operator=(StatusAggregator&&) = delete;
+
+        void report(StatusCode code, Level level, float data, double time);
+
+        /*
+         * Moves the waiting entries into entries and returns how many reports
+         * were dropped since the last take.
+         * */
+        uint32_t take(std::vector<Entry>& entries);
+
+        bool empty() const { return waiting.empty() && dropped == 0; }
+
+    private:
+        const size_t max_entries;
+        std::vector<Entry> waiting;
+        uint32_t dropped;
+};
+
+#endif
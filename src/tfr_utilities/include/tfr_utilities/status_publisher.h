@@ -1,7 +1,16 @@
 /* Utility class for publishing to stdout and mission control at the same time.
+ *
+ * Reports are not formatted or sent when they are made. They are coalesced by
+ * a StatusAggregator, and a timer sends everything waiting as one StatusFrame
+ * at most /status_publisher/rate times a second, logging each entry once per
+ * frame. Mission control renders the text on its side.
+ *
+ * Parameters:
+ *  -/status_publisher/rate - frames per second at most (double, default 4)
+ *  -/status_publisher/max_entries - different codes per frame (int, default 32)
  *
  * Published Topics:
- *  -/com - The diagnostics topic
+ *  -/com - The diagnostics topic (tfr_msgs/StatusFrame)
  * */
 #ifndef STATUS_PUBLISHER_H
 #define STATUS_PUBLISHER_H
@@ -9,8 +18,11 @@
 #include <ros/ros.h>
 #include <ros/console.h>
 #include <status_code.h>
-#include <tfr_msgs/SystemStatus.h>
+#include <status_aggregator.h>
+#include <tfr_msgs/StatusFrame.h>
 #include <cstdint>
+#include <mutex>
+#include <vector>
 
 class StatusPublisher
 {
@@ -34,11 +46,24 @@ class StatusPublisher
         //only publishes at mission control scope
         void missionControl(const StatusCode& code ,const float &data) const;
 
+        //sends whatever is waiting now instead of on the next tick
+        void flush() const;
+
         //frees up resources for qt framewwork
         void shutdown();
 
     private:
         ros::Publisher com;
+
+        //reports come from any thread, frames go out from the timer's
+        mutable std::mutex mutex;
+        mutable StatusAggregator aggregator;
+        mutable std::vector<StatusAggregator::Entry> entries;
+
+        //last, it can fire as soon as it exists
+        ros::WallTimer timer;
+
+        void report(const StatusCode& code, StatusAggregator::Level level, const float& data) const;
+        void tick(const ros::WallTimerEvent& event);
 };
 #endif
-
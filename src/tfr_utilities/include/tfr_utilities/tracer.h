@@ -0,0 +1,206 @@
+/*
+ * Lightweight tracing of where time goes across the nodes, exported as Chrome
+ * trace / Perfetto json (open it at ui.perfetto.dev or chrome://tracing).
+ *
+ * A TraceSpan times a scope. Spans can carry a flow id, which ties spans in
+ * different nodes together into one arrow in the viewer and one row of the
+ * latency report. A flow id has to travel with the data, so it is either
+ * made up with newFlow() and put in a message field (the teleop goal's
+ * trace_flow), or derived with flowFromStamp() from a header stamp that is
+ * already passed along unchanged (camera images).
+ *
+ * Every thread records into a ring of its own, with a sequence number per
+ * slot like the control loop's flight recorder, so recording never locks and
+ * the rings can be copied out while threads keep going. Only a thread's first
+ * event takes a lock, to register its ring. When tracing is off a span costs
+ * one relaxed atomic load.
+ *
+ * Each process writes <directory>/<process>_<pid>.trace.json when it exits,
+ * trace_report.py merges them and reports the latency of each hop.
+ *
+ * Timestamps are wall clock microseconds, so events from every node on the
+ * robot line up as long as the clocks are synced.
+ *
+ * PARAMETERS (read by configureFromParams):
+ *  /trace/enabled: (bool, default false)
+ *  /trace/directory: where traces are written (string, default the ros log directory)
+ *  /trace/events_per_thread: ring size, older events are dropped (int, default 65536)
+ * */
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tfr_utilities
+{
+    class Tracer
+    {
+        public:
+            enum Phase : char
+            {
+                SPAN = 'X',
+                INSTANT = 'i',
+                FLOW_START = 's',
+                FLOW_STEP = 't',
+                FLOW_END = 'f',
+            };
+
+            /*
+             * name and category must be string literals, only the pointers
+             * are kept. flow 0 means none.
+             * */
+            struct Event
+            {
+                const char* name;
+                const char* category;
+                int64_t start;      // us since the epoch
+                int64_t duration;   // us, SPAN only
+                uint64_t flow;
+                Phase phase;
+                //how the span's flow event continues the flow
+                Phase flow_phase;
+            };
+
+            static Tracer& instance();
+
+            /*
+             * Turns tracing on, for process, writing to directory at exit.
+             * */
+            void configure(const std::string& process, const std::string& directory,
+                    size_t events_per_thread);
+
+            /*
+             * configure() from the /trace parameters, call it after ros::init
+             * */
+            static void configureFromParams(const std::string& process);
+
+            static bool enabled()
+            {
+                return active.load(std::memory_order_relaxed);
+            }
+
+            static int64_t now();
+
+            /*
+             * A new flow id, unique across processes
+             * */
+            static uint64_t newFlow();
+
+            /*
+             * The flow id for data stamped with a ros time in nanoseconds,
+             * never 0
+             * */
+            static uint64_t flowFromStamp(uint64_t nanoseconds);
+
+            /*
+             * Records an event on the calling thread's ring
+             * */
+            void record(const Event& event);
+
+            /*
+             * Records a zero length event, optionally in a flow
+             * */
+            void instant(const char* name, const char* category, uint64_t flow = 0,
+                    Phase flow_phase = FLOW_STEP);
+
+            /*
+             * Records a span that already happened, from start for duration us
+             * */
+            void span(const char* name, const char* category, int64_t start, int64_t duration,
+                    uint64_t flow = 0, Phase flow_phase = FLOW_STEP);
+
+            /*
+             * Writes every event still in the rings as trace json
+             * */
+            void write(std::ostream& out) const;
+
+            /*
+             * write() to <directory>/<process>_<pid>.trace.json, done at exit
+             * anyway
+             * */
+            bool dump(std::string& message) const;
+
+            /*
+             * Turns tracing off and drops every event, so tests start from
+             * nothing. No other thread may be recording while it runs.
+             * */
+            void reset();
+
+            ~Tracer();
+            Tracer(const Tracer&) = delete;
+            Tracer& operator=(const Tracer&) = delete;
+            Tracer(Tracer&&) = delete;
+            Tracer& operator=(Tracer&&) = delete;
+
+        private:
+            struct Slot
+            {
+                std::atomic<uint64_t> sequence;
+                Event event;
+            };
+
+            struct Ring
+            {
+                Ring(size_t capacity, int32_t tid);
+                const size_t capacity;
+                const int32_t tid;
+                std::unique_ptr<Slot[]> slots;
+                std::atomic<uint64_t> written;
+
+                void record(const Event& event);
+                void snapshot(std::vector<Event>& events) const;
+            };
+
+            Tracer();
+
+            static std::atomic<bool> active;
+
+            //guard the rings and the configuration
+            mutable std::mutex mutex;
+            std::vector<std::shared_ptr<Ring>> rings;
+            //bumped by reset, a thread whose ring is older registers a new one
+            std::atomic<uint64_t> generation;
+            std::string process;
+            std::string directory;
+            size_t events_per_thread;
+
+            Ring& threadRing();
+            std::string path() const;
+    };
+
+    /*
+     * Times the scope it lives in.
+     * */
+    class TraceSpan
+    {
+        public:
+            explicit TraceSpan(const char* name, const char* category = "tfr", uint64_t flow = 0,
+                    Tracer::Phase flow_phase = Tracer::FLOW_STEP);
+            ~TraceSpan();
+            TraceSpan(const TraceSpan&) = delete;
+            TraceSpan& operator=(const TraceSpan&) = delete;
+            TraceSpan(TraceSpan&&) = delete;
+            TraceSpan& operator=(TraceSpan&&) = delete;
+
+            /*
+             * Puts the span in a flow, for when the flow is only known partway
+             * through the scope
+             * */
+            void setFlow(uint64_t flow, Tracer::Phase flow_phase = Tracer::FLOW_STEP);
+
+        private:
+            const char* name;
+            const char* category;
+            int64_t start;
+            uint64_t flow;
+            Tracer::Phase flow_phase;
+    };
+}
+
+#endif
@@ -1,4 +1,14 @@
 #include <arm_manipulator.h>
+#include <boost/bind.hpp>
+#include <async_log.h>
+
+namespace
+{
+    //ArmCommand order
+    const char* const arm_joints[] = {"turntable_joint", "lower_arm_joint", "upper_arm_joint", "scoop_joint"};
+    const char* const arm_devices[] = {"/device1", "/device23", "/device45", "/device56"};
+    const size_t ARM_JOINT_COUNT = 4;
+}
 
 ArmManipulator::ArmManipulator(ros::NodeHandle &n, bool init_joints):
             turntable_publisher{n.advertise<sensor_msgs::JointState>("/device1/set_joint_state", 5)},
@@ -7,8 +17,20 @@ ArmManipulator::ArmManipulator(ros::NodeHandle &n, bool init_joints):
             scoop_publisher{n.advertise<sensor_msgs::JointState>("/device56/set_joint_state", 5)},
             left_bin_publisher{n.advertise<sensor_msgs::JointState>("/device77/set_joint_state", 5)},
             right_bin_publisher{n.advertise<sensor_msgs::JointState>("/device88/set_joint_state", 5)},
-            turntable_statusword_subscriber{n.subscribe("/device1/statusword", 5, &ArmManipulator::updateTurntableTargetPosition, this)}
+            arm_command_publisher{n.advertise<tfr_msgs::ArmCommand>("/arm_command", 5)},
+            turntable_statusword_subscriber{n.subscribe("/device1/statusword", 5, &ArmManipulator::updateTurntableTargetPosition, this)},
+            arm_command_enabled_subscriber{n.subscribe("/arm_command/enabled", 1, &ArmManipulator::updateArmCommandEnabled, this)},
+            arm_command_profiled_subscriber{n.subscribe("/arm_command/profiled", 1, &ArmManipulator::updateArmCommandProfiled, this)},
+            synchronizer{loadProfileLimits()},
+            arm_position(ARM_JOINT_COUNT, 0.0)
 {
+  // the drives report in the same radians the arm is commanded in
+  for (size_t joint = 0; joint < ARM_JOINT_COUNT; joint++)
+  {
+    joint_state_subscribers.push_back(n.subscribe<sensor_msgs::JointState>(
+        std::string{arm_devices[joint]} + "/get_joint_state", 5,
+        boost::bind(&ArmManipulator::updateArmPosition, this, _1, joint)));
+  }
   ROS_INFO("Initializing Arm Manipulator");
 }
 
@@ -89,18 +111,58 @@ void ArmManipulator::moveRightBinPosition(double rightBin)
  *
  *  - The method is not blocking, so the caller needs to wait for the arm to move.
  *    See digging_action_server.cpp for example.
+ *
+ *  - All four targets go out in one message, the CAN bridge releases them on
+ *    a single SYNC so every joint starts moving at the same time. When the
+ *    bridge can't do that they go to each drive separately, as they used to.
  */
-void ArmManipulator::moveArmWithoutPlanningOrLimits(
+double ArmManipulator::moveArmWithoutPlanningOrLimits(
             const double& turntable, const double& lower_arm, const double& upper_arm, const double& scoop)
 {
-    ROS_INFO_STREAM("moveArmWithoutPlanningOrLimits() called by: " << ros::this_node::getName() << ". Parameters: " << turntable << ", " << lower_arm << ", " << upper_arm << ", " << scoop << std::endl);
+    TFR_LOG_INFO("moveArmWithoutPlanningOrLimits() called by: %s. Parameters: %g, %g, %g, %g",
+            ros::this_node::getName(), turntable, lower_arm, upper_arm, scoop);
 
-    moveTurntablePosition(turntable);
-    moveLowerArmPosition(lower_arm);
-    moveUpperArmPosition(upper_arm);
-    moveScoopPosition(scoop);
+    if (!arm_command_enabled)
+    {
+        moveTurntablePosition(turntable);
+        moveLowerArmPosition(lower_arm);
+        moveUpperArmPosition(upper_arm);
+        moveScoopPosition(scoop);
+        return 0.0;
+    }
 
-    return;
+    tfr_msgs::ArmCommand command;
+    command.header.stamp = ros::Time::now();
+    command.turntable = turntable;
+    command.lower_arm = lower_arm;
+    command.upper_arm = upper_arm;
+    command.scoop = scoop;
+
+    // give every joint the profile that makes it arrive with the slowest one
+    std::vector<double> start;
+    {
+        std::lock_guard<std::mutex> lock(joint_state_mutex);
+        if (arm_position_known == (1 << ARM_JOINT_COUNT) - 1)
+            start = arm_position;
+    }
+    double duration = 0.0;
+    if (start.size() == ARM_JOINT_COUNT)
+    {
+        std::vector<ProfileSynchronizer::Profile> profiles;
+        duration = synchronizer.synchronize(start, {turntable, lower_arm, upper_arm, scoop}, profiles);
+        for (const auto& profile : profiles)
+        {
+            command.profile_velocity.push_back(profile.velocity);
+            command.profile_acceleration.push_back(profile.acceleration);
+        }
+    }
+
+    arm_command_publisher.publish(command);
+
+    //the drives move with their own profiles, the estimate means nothing
+    if (!arm_command_profiled)
+        return 0.0;
+    return duration;
 }
 
 // return true if all the arm actuators have reached the positions they were asked to move to.
@@ -125,3 +187,45 @@ void ArmManipulator::updateTurntableTargetPosition(const std_msgs::UInt16 &value
         turntable_target_position_reached = false;
     }
 }
+
+void ArmManipulator::updateArmCommandEnabled(const std_msgs::Bool &enabled)
+{
+    if (enabled.data != arm_command_enabled)
+        ROS_INFO("Arm Manipulator: whole arm commands %s", enabled.data ? "enabled" : "disabled, moving each drive separately");
+    arm_command_enabled = enabled.data;
+}
+
+void ArmManipulator::updateArmCommandProfiled(const std_msgs::Bool &profiled)
+{
+    if (profiled.data != arm_command_profiled)
+        ROS_INFO("Arm Manipulator: arm profiles %s", profiled.data ? "applied" : "not applied, moves have no known duration");
+    arm_command_profiled = profiled.data;
+}
+
+void ArmManipulator::updateArmPosition(const sensor_msgs::JointState::ConstPtr &state, size_t joint)
+{
+    if (state->position.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(joint_state_mutex);
+    arm_position[joint] = state->position[0];
+    arm_position_known |= 1 << joint;
+}
+
+std::vector<ProfileSynchronizer::Limits> ArmManipulator::loadProfileLimits()
+{
+    //conservative defaults, tune them in tfr_control/config/arm_profile.yaml
+    const double default_velocity[] = {0.3, 0.4, 0.4, 0.8};
+    const double default_acceleration[] = {0.3, 0.8, 0.8, 1.6};
+
+    std::vector<ProfileSynchronizer::Limits> limits(ARM_JOINT_COUNT);
+    for (size_t joint = 0; joint < ARM_JOINT_COUNT; joint++)
+    {
+        const std::string prefix = std::string{"/arm_profile/"} + arm_joints[joint];
+        ros::param::param<double>(prefix + "/max_velocity", limits[joint].max_velocity,
+                default_velocity[joint]);
+        ros::param::param<double>(prefix + "/max_acceleration", limits[joint].max_acceleration,
+                default_acceleration[joint]);
+    }
+    return limits;
+}
@@ -0,0 +1,458 @@
+#include <async_log.h>
+#include <ros/ros.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace tfr_utilities
+{
+    constexpr size_t AsyncLogRecord::DATA_SIZE;
+
+    namespace
+    {
+        const uint32_t BINARY_VERSION = 1;
+        //how often the drain thread wakes up
+        const std::chrono::milliseconds DRAIN_PERIOD{10};
+
+        std::atomic<uint32_t> next_site_id{0};
+
+        template <typename T>
+        void writeValue(std::ostream& out, const T& value)
+        {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        void writeString(std::ostream& out, const char* text)
+        {
+            const uint16_t length = static_cast<uint16_t>(std::min<size_t>(std::strlen(text), 0xffff));
+            writeValue(out, length);
+            out.write(text, length);
+        }
+
+        /*
+         * One argument as read back out of a record
+         * */
+        struct Argument
+        {
+            AsyncLogRecord::Tag tag;
+            int64_t signed_value;
+            uint64_t unsigned_value;
+            double double_value;
+            std::string string_value;
+
+            long long asSigned() const
+            {
+                switch (tag)
+                {
+                    case AsyncLogRecord::UNSIGNED: return static_cast<long long>(unsigned_value);
+                    case AsyncLogRecord::DOUBLE: return static_cast<long long>(double_value);
+                    default: return signed_value;
+                }
+            }
+
+            unsigned long long asUnsigned() const
+            {
+                switch (tag)
+                {
+                    case AsyncLogRecord::SIGNED: return static_cast<unsigned long long>(signed_value);
+                    case AsyncLogRecord::DOUBLE: return static_cast<unsigned long long>(double_value);
+                    default: return unsigned_value;
+                }
+            }
+
+            double asDouble() const
+            {
+                switch (tag)
+                {
+                    case AsyncLogRecord::SIGNED: return static_cast<double>(signed_value);
+                    case AsyncLogRecord::UNSIGNED: return static_cast<double>(unsigned_value);
+                    default: return double_value;
+                }
+            }
+
+            std::string asString() const
+            {
+                switch (tag)
+                {
+                    case AsyncLogRecord::SIGNED: return std::to_string(signed_value);
+                    case AsyncLogRecord::UNSIGNED: return std::to_string(unsigned_value);
+                    case AsyncLogRecord::DOUBLE: return std::to_string(double_value);
+                    default: return string_value;
+                }
+            }
+        };
+    }
+
+    AsyncLogSite::AsyncLogSite(ros::console::LogLocation* l, const char* fi, int li,
+            const char* fu, const char* fo, double rate) :
+        location{l}, file{fi}, line{li}, function{fu}, format{fo},
+        id{next_site_id.fetch_add(1, std::memory_order_relaxed)},
+        period{[rate]
+            {
+                const double r = rate < 0 ? AsyncLog::instance().defaultRate() : rate;
+                return r > 0 ? static_cast<int64_t>(1e6 / r) : 0;
+            }()},
+        next{0}, suppressed{0}
+    {}
+
+    bool AsyncLogSite::admit(int64_t now, uint32_t& dropped)
+    {
+        if (period == 0)
+        {
+            dropped = 0;
+            return true;
+        }
+        int64_t allowed = next.load(std::memory_order_relaxed);
+        //another thread can take the same slot, only one of them wins it
+        if (now < allowed || !next.compare_exchange_strong(allowed, now + period,
+                    std::memory_order_relaxed))
+        {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        dropped = suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    void AsyncLogRecord::clear()
+    {
+        site = nullptr;
+        time = 0;
+        suppressed = 0;
+        tid = 0;
+        arguments = 0;
+        size = 0;
+        truncated = 0;
+    }
+
+    template <typename T>
+    void AsyncLogRecord::addNumber(Tag tag, T value)
+    {
+        if (truncated || size + 1 + sizeof(value) > DATA_SIZE)
+        {
+            truncated = 1;
+            return;
+        }
+        data[size] = static_cast<char>(tag);
+        std::memcpy(data + size + 1, &value, sizeof(value));
+        size += 1 + sizeof(value);
+        arguments++;
+    }
+
+    template void AsyncLogRecord::addNumber<int64_t>(Tag, int64_t);
+    template void AsyncLogRecord::addNumber<uint64_t>(Tag, uint64_t);
+    template void AsyncLogRecord::addNumber<double>(Tag, double);
+
+    void AsyncLogRecord::add(const char* value)
+    {
+        if (value == nullptr)
+            value = "(null)";
+        const size_t length = std::min<size_t>(std::strlen(value), 0xff);
+        //keep what fits of a long string, but not an empty stub of one
+        if (truncated || size + 2 + std::min<size_t>(length, 8) > DATA_SIZE)
+        {
+            truncated = 1;
+            return;
+        }
+        const size_t kept = std::min(length, DATA_SIZE - size - 2);
+        data[size] = static_cast<char>(STRING);
+        data[size + 1] = static_cast<char>(kept);
+        std::memcpy(data + size + 2, value, kept);
+        size += 2 + kept;
+        arguments++;
+    }
+
+    std::string AsyncLogRecord::format(const char* format) const
+    {
+        std::vector<Argument> values;
+        size_t at = 0;
+        for (uint8_t i = 0; i < arguments && at < size; i++)
+        {
+            Argument value{static_cast<Tag>(data[at]), 0, 0, 0.0, {}};
+            at++;
+            switch (value.tag)
+            {
+                case SIGNED:
+                    std::memcpy(&value.signed_value, data + at, sizeof(int64_t));
+                    at += sizeof(int64_t);
+                    break;
+                case UNSIGNED:
+                    std::memcpy(&value.unsigned_value, data + at, sizeof(uint64_t));
+                    at += sizeof(uint64_t);
+                    break;
+                case DOUBLE:
+                    std::memcpy(&value.double_value, data + at, sizeof(double));
+                    at += sizeof(double);
+                    break;
+                case STRING:
+                {
+                    const size_t length = static_cast<uint8_t>(data[at]);
+                    value.string_value.assign(data + at + 1, length);
+                    at += 1 + length;
+                    break;
+                }
+            }
+            values.push_back(value);
+        }
+
+        std::string out;
+        size_t next = 0;
+        char buffer[512];
+        for (const char* c = format; *c != '\0'; c++)
+        {
+            if (*c != '%')
+            {
+                out += *c;
+                continue;
+            }
+            if (c[1] == '%')
+            {
+                out += '%';
+                c++;
+                continue;
+            }
+            //flags, width and precision are kept, the length is ours to pick
+            std::string spec{"%"};
+            c++;
+            while (*c != '\0' && std::strchr("-+ #0", *c) != nullptr)
+                spec += *c++;
+            while (*c != '\0' && (std::isdigit(static_cast<unsigned char>(*c)) || *c == '.'))
+                spec += *c++;
+            while (*c != '\0' && std::strchr("hlLqjzt", *c) != nullptr)
+                c++;
+            const char conversion = *c;
+            if (conversion == '\0')
+                break;
+            if (next >= values.size())
+            {
+                out += truncated ? "<truncated>" : "<missing>";
+                continue;
+            }
+            const Argument& value = values[next++];
+            switch (conversion)
+            {
+                case 'd':
+                case 'i':
+                    std::snprintf(buffer, sizeof(buffer), (spec + "lld").c_str(), value.asSigned());
+                    break;
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o':
+                    std::snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).c_str(),
+                            value.asUnsigned());
+                    break;
+                case 'c':
+                    std::snprintf(buffer, sizeof(buffer), (spec + "c").c_str(),
+                            static_cast<int>(value.asSigned()));
+                    break;
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                case 'a':
+                case 'A':
+                    std::snprintf(buffer, sizeof(buffer), (spec + conversion).c_str(), value.asDouble());
+                    break;
+                default:
+                    std::snprintf(buffer, sizeof(buffer), (spec + "s").c_str(), value.asString().c_str());
+                    break;
+            }
+            out += buffer;
+        }
+        return out;
+    }
+
+    AsyncLog& AsyncLog::instance()
+    {
+        static AsyncLog log{};
+        return log;
+    }
+
+    AsyncLog::AsyncLog() : default_rate{10.0}, ring_size{1024}, directory{}, stopping{false}
+    {
+        if (ros::isInitialized())
+        {
+            int size;
+            ros::param::param<double>("/async_log/rate", default_rate, 10.0);
+            ros::param::param<int>("/async_log/ring_size", size, 1024);
+            ros::param::param<std::string>("/async_log/directory", directory, "");
+            ring_size = static_cast<size_t>(std::max(size, 1));
+        }
+        if (!directory.empty())
+        {
+            std::string node = ros::this_node::getName();
+            node.erase(0, node.find_first_not_of('/'));
+            std::replace(node.begin(), node.end(), '/', '_');
+            const std::string path = directory + "/" + node + "_" + std::to_string(getpid()) + ".tfrl";
+            binary.open(path, std::ios::binary | std::ios::trunc);
+            if (binary)
+            {
+                binary.write("TFRL", 4);
+                writeValue(binary, BINARY_VERSION);
+                ROS_INFO("Async Log: writing messages to %s", path.c_str());
+            }
+            else
+                ROS_WARN("Async Log: could not open %s, printing messages instead", path.c_str());
+        }
+        drainer = std::thread{&AsyncLog::run, this};
+    }
+
+    AsyncLog::~AsyncLog()
+    {
+        {
+            std::lock_guard<std::mutex> lock{stop_mutex};
+            stopping = true;
+        }
+        signal.notify_one();
+        drainer.join();
+    }
+
+    int64_t AsyncLog::now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    thread_local AsyncLog::ThreadRing AsyncLog::thread_ring;
+
+    AsyncLog::Ring::Ring(size_t c, int32_t t) :
+        capacity{c}, tid{t}, records{new AsyncLogRecord[c]}, head{0}, tail{0}, dropped{0},
+        retired{false}
+    {}
+
+    AsyncLog::ThreadRing::~ThreadRing()
+    {
+        //the drain thread drops it from the rings once it is empty, the ring
+        //is shared so that can be before or after this
+        if (ring)
+            ring->retired.store(true, std::memory_order_release);
+    }
+
+    AsyncLog::Ring& AsyncLog::threadRing()
+    {
+        if (!thread_ring.ring)
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            const int32_t tid = static_cast<int32_t>(syscall(SYS_gettid));
+            thread_ring.ring = std::make_shared<Ring>(ring_size, tid);
+            rings.push_back(thread_ring.ring);
+        }
+        return *thread_ring.ring;
+    }
+
+    void AsyncLog::push(const AsyncLogRecord& record)
+    {
+        Ring& ring = threadRing();
+        const uint64_t head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.tail.load(std::memory_order_acquire) >= ring.capacity)
+        {
+            //full, the drain thread is behind
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        AsyncLogRecord& slot = ring.records[head % ring.capacity];
+        slot = record;
+        slot.tid = ring.tid;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    void AsyncLog::flush()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        pending.clear();
+        uint64_t dropped = 0;
+        for (auto ring = rings.begin(); ring != rings.end();)
+        {
+            //read first, a retired ring's head doesn't move any more
+            const bool retired = (*ring)->retired.load(std::memory_order_acquire);
+            const uint64_t tail = (*ring)->tail.load(std::memory_order_relaxed);
+            const uint64_t head = (*ring)->head.load(std::memory_order_acquire);
+            for (uint64_t index = tail; index < head; index++)
+                pending.push_back((*ring)->records[index % (*ring)->capacity]);
+            (*ring)->tail.store(head, std::memory_order_release);
+            dropped += (*ring)->dropped.exchange(0, std::memory_order_relaxed);
+            ring = retired ? rings.erase(ring) : ring + 1;
+        }
+        //each ring is in order, put the threads together
+        std::stable_sort(pending.begin(), pending.end(),
+                [](const AsyncLogRecord& a, const AsyncLogRecord& b) { return a.time < b.time; });
+
+        for (const AsyncLogRecord& record : pending)
+        {
+            if (binary.is_open())
+                writeBinary(record);
+            else
+                print(record);
+        }
+        if (binary.is_open())
+            binary.flush();
+        if (dropped != 0)
+            ROS_WARN("Async Log: dropped %" PRIu64 " messages, the rings were full", dropped);
+    }
+
+    size_t AsyncLog::getRingCount()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return rings.size();
+    }
+
+    void AsyncLog::print(const AsyncLogRecord& record) const
+    {
+        const AsyncLogSite& site = *record.site;
+        std::string text = record.format(site.format);
+        if (record.suppressed != 0)
+            text += " (" + std::to_string(record.suppressed) + " more suppressed)";
+        ros::console::print(nullptr, site.location->logger_, site.location->level_, site.file,
+                site.line, site.function, "%s", text.c_str());
+    }
+
+    void AsyncLog::writeBinary(const AsyncLogRecord& record)
+    {
+        const AsyncLogSite& site = *record.site;
+        if (site.id >= sites_written.size())
+            sites_written.resize(site.id + 1, false);
+        if (!sites_written[site.id])
+        {
+            sites_written[site.id] = true;
+            binary.put('S');
+            writeValue(binary, site.id);
+            writeValue(binary, static_cast<uint8_t>(site.location->level_));
+            writeValue(binary, static_cast<int32_t>(site.line));
+            writeString(binary, site.format);
+            writeString(binary, site.file);
+            writeString(binary, site.function);
+        }
+        binary.put('M');
+        writeValue(binary, site.id);
+        writeValue(binary, record.time);
+        writeValue(binary, record.suppressed);
+        writeValue(binary, record.tid);
+        writeValue(binary, record.arguments);
+        writeValue(binary, record.truncated);
+        writeValue(binary, record.size);
+        binary.write(record.data, record.size);
+    }
+
+    void AsyncLog::run()
+    {
+        std::unique_lock<std::mutex> lock{stop_mutex};
+        while (true)
+        {
+            signal.wait_for(lock, DRAIN_PERIOD, [this]{ return stopping; });
+            const bool stop = stopping;
+            lock.unlock();
+            flush();
+            if (stop)
+                return;
+            lock.lock();
+        }
+    }
+}
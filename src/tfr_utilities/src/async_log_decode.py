@@ -0,0 +1,130 @@
+#! /usr/bin/env python
+"""
+Prints the messages in a .tfrl file, written by the async log when
+/async_log/directory is set (see include/tfr_utilities/async_log.h), one line
+each like rosconsole would.
+
+usage: rosrun tfr_utilities async_log_decode.py [--level INFO] <node>_<pid>.tfrl
+"""
+import argparse
+import datetime
+import re
+import struct
+import sys
+
+VERSION = 1
+LEVELS = ["DEBUG", "INFO", "WARN", "ERROR", "FATAL"]
+
+# must match AsyncLog::writeBinary
+SITE = struct.Struct("<IBi")
+MESSAGE = struct.Struct("<IqIiBBB")
+NUMBERS = {b"i": struct.Struct("<q"), b"u": struct.Struct("<Q"), b"d": struct.Struct("<d")}
+
+# a printf conversion, python's % has no use for the length
+CONVERSION = re.compile(r"%([-+ #0]*[0-9]*(?:\.[0-9]*)?)(?:hh|h|ll|l|L|q|j|z|t)?([diouxXeEfFgGaAcsp%])")
+
+
+class Reader(object):
+    def __init__(self, data):
+        self.data = data
+        self.at = 0
+
+    def done(self):
+        return self.at >= len(self.data)
+
+    def unpack(self, layout):
+        values = layout.unpack_from(self.data, self.at)
+        self.at += layout.size
+        return values
+
+    def bytes(self, length):
+        value = self.data[self.at:self.at + length]
+        self.at += length
+        return value
+
+    def string(self):
+        length, = self.unpack(struct.Struct("<H"))
+        return self.bytes(length).decode("utf-8", "replace")
+
+
+def arguments(data, count):
+    reader = Reader(data)
+    values = []
+    for _ in range(count):
+        tag = reader.bytes(1)
+        if tag in NUMBERS:
+            values.append(reader.unpack(NUMBERS[tag])[0])
+        else:
+            length = ord(reader.bytes(1))
+            values.append(reader.bytes(length).decode("utf-8", "replace"))
+    return values
+
+
+def format_message(format, values, truncated):
+    values = list(values)
+
+    def convert(match):
+        spec, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        if not values:
+            return "<truncated>" if truncated else "<missing>"
+        value = values.pop(0)
+        try:
+            if conversion in "diouxXc":
+                value = int(value)
+            elif conversion in "eEfFgGaA":
+                value = float(value)
+                conversion = "f" if conversion in "aA" else conversion
+            else:
+                conversion = "s"
+            return ("%" + spec + conversion) % value
+        except (TypeError, ValueError):
+            return str(value)
+
+    return CONVERSION.sub(convert, format)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("log")
+    parser.add_argument("--level", default="DEBUG", choices=LEVELS,
+                        help="leave out anything below this")
+    args = parser.parse_args()
+    with open(args.log, "rb") as log:
+        reader = Reader(log.read())
+
+    if reader.bytes(4) != b"TFRL" or reader.unpack(struct.Struct("<I"))[0] != VERSION:
+        sys.exit("%s is not a version %d async log" % (args.log, VERSION))
+
+    sites = {}
+    minimum = LEVELS.index(args.level)
+    try:
+        while not reader.done():
+            kind = reader.bytes(1)
+            if kind == b"S":
+                site, level, line = reader.unpack(SITE)
+                format = reader.string()
+                path = reader.string()
+                function = reader.string()
+                sites[site] = (level, line, format, path, function)
+            elif kind == b"M":
+                site, time, suppressed, tid, count, truncated, size = reader.unpack(MESSAGE)
+                values = arguments(reader.bytes(size), count)
+                level, line, format, path, function = sites[site]
+                if level < minimum:
+                    continue
+                text = format_message(format, values, truncated)
+                if suppressed:
+                    text += " (%d more suppressed)" % suppressed
+                stamp = datetime.datetime.fromtimestamp(time / 1e6).strftime("%H:%M:%S.%f")
+                print("[%5s] [%s] [%d] %s:%d: %s" % (LEVELS[min(level, len(LEVELS) - 1)], stamp,
+                                                     tid, path.split("/")[-1], line, text))
+            else:
+                sys.exit("%s is corrupt at byte %d" % (args.log, reader.at - 1))
+    except struct.error:
+        sys.stderr.write("%s is cut short\n" % args.log)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,56 @@
+#include <profile_synchronizer.h>
+#include <algorithm>
+#include <cmath>
+
+ProfileSynchronizer::ProfileSynchronizer(const std::vector<Limits>& l) : limits{l} {}
+
+double ProfileSynchronizer::synchronize(const std::vector<double>& start,
+        const std::vector<double>& end, std::vector<Profile>& profiles) const
+{
+    const size_t axes = std::min(limits.size(), std::min(start.size(), end.size()));
+    profiles.assign(axes, Profile{});
+
+    //the time each limit forces on the slowest axis
+    double cruise_time = 0.0;
+    double acceleration_area = 0.0;
+    for (size_t i = 0; i < axes; i++)
+    {
+        const double distance = std::abs(end[i] - start[i]);
+        cruise_time = std::max(cruise_time, distance / limits[i].max_velocity);
+        acceleration_area = std::max(acceleration_area, distance / limits[i].max_acceleration);
+    }
+
+    double acceleration_time = 0.0;
+    double total_time = 0.0;
+    if (acceleration_area > 0.0)
+    {
+        if (acceleration_area <= cruise_time * cruise_time)
+        {
+            acceleration_time = acceleration_area / cruise_time;
+            total_time = cruise_time + acceleration_time;
+        }
+        else
+        {
+            acceleration_time = std::sqrt(acceleration_area);
+            total_time = 2 * acceleration_time;
+        }
+    }
+
+    //a tiny fraction of the limit, so idle axes never get a zero profile
+    const double idle = 1e-3;
+    for (size_t i = 0; i < axes; i++)
+    {
+        const double distance = std::abs(end[i] - start[i]);
+        if (total_time <= 0.0 || distance <= 0.0)
+        {
+            profiles[i].velocity = idle * limits[i].max_velocity;
+            profiles[i].acceleration = idle * limits[i].max_acceleration;
+            continue;
+        }
+        const double velocity = distance / (total_time - acceleration_time);
+        profiles[i].velocity = std::max(velocity, idle * limits[i].max_velocity);
+        profiles[i].acceleration = std::max(velocity / acceleration_time,
+                idle * limits[i].max_acceleration);
+    }
+    return total_time;
+}
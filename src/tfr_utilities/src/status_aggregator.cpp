@@ -0,0 +1,41 @@
+#include <status_aggregator.h>
+#include <algorithm>
+#include <limits>
+
+StatusAggregator::StatusAggregator(size_t max) : max_entries{max}, waiting{}, dropped{0}
+{
+    waiting.reserve(max_entries);
+}
+
+void StatusAggregator::report(StatusCode code, Level level, float data, double time)
+{
+    //only a handful of codes are ever waiting, a scan beats a map
+    for (Entry& entry : waiting)
+    {
+        if (entry.code != code)
+            continue;
+        entry.level = std::max<uint8_t>(entry.level, level);
+        if (entry.count < std::numeric_limits<uint16_t>::max())
+            entry.count++;
+        entry.data = data;
+        entry.time = time;
+        return;
+    }
+    if (waiting.size() >= max_entries)
+    {
+        if (dropped < std::numeric_limits<uint32_t>::max())
+            dropped++;
+        return;
+    }
+    waiting.push_back(Entry{code, level, 1, data, time});
+}
+
+uint32_t StatusAggregator::take(std::vector<Entry>& entries)
+{
+    entries.clear();
+    entries.swap(waiting);
+    waiting.reserve(max_entries);
+    const uint32_t lost = dropped;
+    dropped = 0;
+    return lost;
+}
@@ -1,57 +1,129 @@
 #include <status_publisher.h>
+#include <algorithm>
+
+namespace
+{
+    double readRate()
+    {
+        double rate;
+        ros::param::param<double>("/status_publisher/rate", rate, 4.0);
+        return rate > 0 ? rate : 4.0;
+    }
+
+    size_t readMaxEntries()
+    {
+        int entries;
+        ros::param::param<int>("/status_publisher/max_entries", entries, 32);
+        return static_cast<size_t>(std::max(entries, 1));
+    }
+}
 
 StatusPublisher::StatusPublisher(ros::NodeHandle &n) :
-    com{n.advertise<tfr_msgs::SystemStatus>("com",5)} 
+    com{n.advertise<tfr_msgs::StatusFrame>("com",5)},
+    aggregator{readMaxEntries()},
+    timer{n.createWallTimer(ros::WallDuration(1.0 / readRate()), &StatusPublisher::tick, this)}
 {}
 
 //  mission control
 void StatusPublisher::status(const StatusCode &code, const float &data)  const
 {
-    ROS_INFO("%s" ,getStatusMessage(code,data).c_str());
-    missionControl(code,data);
+    report(code, StatusAggregator::INFO, data);
 }
 
 // ROS_INFO visibility + mission control
 void StatusPublisher::info(const StatusCode &code, const float &data)  const
 {
-    ROS_INFO("%s" ,getStatusMessage(code,data).c_str());
-    missionControl(code,data);
+    report(code, StatusAggregator::INFO, data);
 }
 
 // ROS_DEBUG visibility + mission control
 void StatusPublisher::debug(const StatusCode &code, const float &data) const
 {
-    ROS_DEBUG("%s" ,getStatusMessage(code,data).c_str());
-    missionControl(code,data);
+    report(code, StatusAggregator::DEBUG, data);
 }
 
 // ROS_WARN visibility + mission control
 void StatusPublisher::warn(const StatusCode &code, const float &data) const
 {
-    ROS_WARN("%s" ,getStatusMessage(code,data).c_str());
-    missionControl(code,data);
+    report(code, StatusAggregator::WARN, data);
 }
 
 // ROS_ERROR visibility + mission control
 void StatusPublisher::error(const StatusCode &code, const float &data) const
 {
-    ROS_ERROR("%s" ,getStatusMessage(code,data).c_str());
-    missionControl(code,data);
+    report(code, StatusAggregator::ERROR, data);
 }
 
 //Sends message to mission control
 void StatusPublisher::missionControl(const StatusCode &code, const float &data)
     const
 {
-    tfr_msgs::SystemStatus status;
-    status.time_stamp = ros::Time::now();
-    status.status_code = static_cast<uint8_t>(code);
-    status.data = data;
-    com.publish(status);
+    report(code, StatusAggregator::QUIET, data);
+}
+
+void StatusPublisher::report(const StatusCode &code, StatusAggregator::Level level,
+        const float &data) const
+{
+    const double now = ros::WallTime::now().toSec();
+    std::lock_guard<std::mutex> lock{mutex};
+    aggregator.report(code, level, data, now);
+}
+
+void StatusPublisher::flush() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    if (aggregator.empty())
+        return;
+    tfr_msgs::StatusFrame frame;
+    frame.dropped = aggregator.take(entries);
+    frame.stamp = ros::Time::now();
+    frame.node = ros::this_node::getName();
+    const double now = ros::WallTime::now().toSec();
+    for (const StatusAggregator::Entry& entry : entries)
+    {
+        frame.codes.push_back(static_cast<uint16_t>(entry.code));
+        frame.counts.push_back(entry.count);
+        frame.data.push_back(entry.data);
+        frame.levels.push_back(entry.level);
+        frame.age_ms.push_back(static_cast<uint16_t>(
+                    std::min(std::max(now - entry.time, 0.0) * 1000.0, 65535.0)));
+
+        //one line per code per frame, however often it was reported
+        if (entry.level == StatusAggregator::QUIET)
+            continue;
+        const std::string message = getStatusMessage(entry.code, entry.data);
+        const char* repeats = entry.count > 1 ? " (x" : "";
+        const std::string count = entry.count > 1 ? std::to_string(entry.count) + ")" : "";
+        switch (entry.level)
+        {
+            case StatusAggregator::DEBUG:
+                ROS_DEBUG("%s%s%s", message.c_str(), repeats, count.c_str());
+                break;
+            case StatusAggregator::INFO:
+                ROS_INFO("%s%s%s", message.c_str(), repeats, count.c_str());
+                break;
+            case StatusAggregator::WARN:
+                ROS_WARN("%s%s%s", message.c_str(), repeats, count.c_str());
+                break;
+            default:
+                ROS_ERROR("%s%s%s", message.c_str(), repeats, count.c_str());
+                break;
+        }
+    }
+    if (frame.dropped != 0)
+        ROS_WARN("Status Publisher: %u status reports did not fit in a frame", frame.dropped);
+    com.publish(frame);
+}
+
+void StatusPublisher::tick(const ros::WallTimerEvent& event)
+{
+    flush();
 }
 
 //shuts down publishers
 void StatusPublisher::shutdown()
 {
+    flush();
+    timer.stop();
     com.shutdown();
 }
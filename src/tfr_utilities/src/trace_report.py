@@ -0,0 +1,110 @@
+#! /usr/bin/env python
+"""
+Merges the traces the nodes write at exit (see include/tfr_utilities/tracer.h)
+into one file for ui.perfetto.dev, and reports the latency of each hop along
+the joystick to CAN and camera to fiducial odometry paths.
+
+Hops are joined by their flow id where both carry one. The Twist, Float64 and
+Int32 messages between teleop, the drivebase, the control loop and the CAN
+bridge have no header to carry one, so those hops are joined to the first
+event after the previous hop instead, and dropped if that is more than
+--max-gap seconds later. Latencies are from the start of one hop to the start
+of the next.
+
+usage: rosrun tfr_utilities trace_report.py [--merge merged.json] [--max-gap s] trace.json...
+"""
+import argparse
+import bisect
+import json
+import sys
+
+CHAINS = [
+    ("joystick to can", ["mission_control/send_goal", "teleop/process_command",
+                         "drivebase/cmd_vel", "control/write", "can/cmd_cango"]),
+    ("camera to fiducial odom", ["camera/exposure", "image_wrapper/receive",
+                                 "image_wrapper/serve", "aruco/execute",
+                                 "fiducial_odom/publish"]),
+]
+
+
+class Hop(object):
+    """Every event with one name, by time and by flow."""
+
+    def __init__(self, events):
+        self.events = sorted(events, key=lambda event: event["ts"])
+        self.times = [event["ts"] for event in self.events]
+        self.flows = {}
+        for event in self.events:
+            flow = event.get("args", {}).get("flow")
+            if flow is not None and flow not in self.flows:
+                self.flows[flow] = event
+
+    def after(self, event, max_gap):
+        flow = event.get("args", {}).get("flow")
+        if flow is not None and self.flows:
+            return self.flows.get(flow)
+        i = bisect.bisect_left(self.times, event["ts"])
+        if i < len(self.events) and self.times[i] - event["ts"] <= max_gap:
+            return self.events[i]
+        return None
+
+
+def percentile(values, fraction):
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def report(name, hops, events, max_gap):
+    by_name = {hop: Hop([event for event in events if event.get("name") == hop]) for hop in hops}
+    first = by_name[hops[0]].events
+    latencies = [[] for _ in hops]
+    for start in first:
+        chain = [start]
+        for hop in hops[1:]:
+            following = by_name[hop].after(chain[-1], max_gap)
+            if following is None:
+                break
+            chain.append(following)
+        if len(chain) != len(hops):
+            continue
+        for i in range(1, len(hops)):
+            latencies[i].append(chain[i]["ts"] - chain[i - 1]["ts"])
+        latencies[0].append(chain[-1]["ts"] - chain[0]["ts"])
+
+    print("%s: %d of %d complete" % (name, len(latencies[0]), len(first)))
+    if not latencies[0]:
+        return
+    print("  %-56s %9s %9s %9s %9s" % ("ms", "p50", "p90", "p99", "max"))
+    rows = [("end to end", latencies[0])]
+    rows += [("%s -> %s" % (hops[i - 1], hops[i]), latencies[i]) for i in range(1, len(hops))]
+    for label, values in rows:
+        values = sorted(values)
+        print("  %-56s %9.2f %9.2f %9.2f %9.2f" % (label, percentile(values, 0.5) / 1000.0,
+                                                  percentile(values, 0.9) / 1000.0,
+                                                  percentile(values, 0.99) / 1000.0,
+                                                  values[-1] / 1000.0))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("traces", nargs="+")
+    parser.add_argument("--merge", help="write every trace into this one file")
+    parser.add_argument("--max-gap", type=float, default=0.5,
+                        help="longest hop joined by time alone [s]")
+    args = parser.parse_args()
+
+    events = []
+    for path in args.traces:
+        with open(path) as trace:
+            events.extend(json.load(trace)["traceEvents"])
+    if args.merge:
+        with open(args.merge, "w") as merged:
+            json.dump({"displayTimeUnit": "ms", "traceEvents": events}, merged)
+        sys.stderr.write("merged %d events into %s\n" % (len(events), args.merge))
+
+    spans = [event for event in events if event.get("ph") in ("X", "i")]
+    for name, hops in CHAINS:
+        report(name, hops, spans, args.max_gap * 1e6)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,293 @@
+#include <tracer.h>
+#include <ros/ros.h>
+#include <ros/file_log.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+
+namespace tfr_utilities
+{
+    std::atomic<bool> Tracer::active{false};
+
+    namespace
+    {
+        //set in the top bit by flowFromStamp, so made up flows never collide
+        const uint64_t STAMP_FLOW = 1ull << 63;
+
+        //the calling thread's ring, owned by Tracer::rings
+        thread_local void* thread_ring = nullptr;
+        thread_local uint64_t thread_generation = 0;
+
+        void writeString(std::ostream& out, const char* text)
+        {
+            out << '"';
+            for (const char* c = text; *c != '\0'; c++)
+            {
+                if (*c == '"' || *c == '\\')
+                    out << '\\';
+                out << *c;
+            }
+            out << '"';
+        }
+
+        void writeFlow(std::ostream& out, uint64_t flow)
+        {
+            //ids are 64 bits, more than a json number holds exactly
+            char id[24];
+            std::snprintf(id, sizeof(id), "\"0x%" PRIx64 "\"", flow);
+            out << id;
+        }
+    }
+
+    Tracer& Tracer::instance()
+    {
+        static Tracer tracer{};
+        return tracer;
+    }
+
+    Tracer::Tracer() : generation{1}, process{"tfr"}, directory{"."}, events_per_thread{65536} {}
+
+    Tracer::~Tracer()
+    {
+        if (!enabled())
+            return;
+        active.store(false, std::memory_order_relaxed);
+        std::string message;
+        dump(message);
+        //the ros log may be gone by now
+        std::fprintf(stderr, "Tracer: %s\n", message.c_str());
+    }
+
+    void Tracer::configure(const std::string& p, const std::string& d, size_t events)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            process = p;
+            directory = d;
+            events_per_thread = std::max<size_t>(events, 1);
+        }
+        active.store(true, std::memory_order_relaxed);
+    }
+
+    void Tracer::configureFromParams(const std::string& process)
+    {
+        bool enabled;
+        ros::param::param<bool>("/trace/enabled", enabled, false);
+        if (!enabled)
+            return;
+        std::string directory;
+        ros::param::param<std::string>("/trace/directory", directory,
+                ros::file_log::getLogDirectory());
+        int events;
+        ros::param::param<int>("/trace/events_per_thread", events, 65536);
+        instance().configure(process, directory, static_cast<size_t>(std::max(events, 1)));
+        ROS_INFO("Tracer: tracing %s, writing to %s at exit", process.c_str(),
+                instance().path().c_str());
+    }
+
+    int64_t Tracer::now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t Tracer::newFlow()
+    {
+        static std::atomic<uint64_t> count{0};
+        //the pid keeps flows from different nodes apart
+        const uint64_t pid = static_cast<uint64_t>(getpid()) & 0x7fffff;
+        return (pid << 40) | ((count.fetch_add(1, std::memory_order_relaxed) + 1) & 0xffffffffff);
+    }
+
+    uint64_t Tracer::flowFromStamp(uint64_t nanoseconds)
+    {
+        return nanoseconds | STAMP_FLOW;
+    }
+
+    void Tracer::record(const Event& event)
+    {
+        if (!enabled())
+            return;
+        threadRing().record(event);
+    }
+
+    void Tracer::instant(const char* name, const char* category, uint64_t flow, Phase flow_phase)
+    {
+        if (!enabled())
+            return;
+        record(Event{name, category, now(), 0, flow, INSTANT, flow_phase});
+    }
+
+    void Tracer::span(const char* name, const char* category, int64_t start, int64_t duration,
+            uint64_t flow, Phase flow_phase)
+    {
+        record(Event{name, category, start, duration, flow, SPAN, flow_phase});
+    }
+
+    Tracer::Ring& Tracer::threadRing()
+    {
+        if (thread_ring == nullptr ||
+                thread_generation != generation.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            const int32_t tid = static_cast<int32_t>(syscall(SYS_gettid));
+            rings.push_back(std::make_shared<Ring>(events_per_thread, tid));
+            thread_ring = rings.back().get();
+            thread_generation = generation.load(std::memory_order_relaxed);
+        }
+        return *static_cast<Ring*>(thread_ring);
+    }
+
+    Tracer::Ring::Ring(size_t c, int32_t t) :
+        capacity{c}, tid{t}, slots{new Slot[c]}, written{0}
+    {
+        for (size_t i = 0; i < capacity; i++)
+            slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+
+    void Tracer::Ring::record(const Event& event)
+    {
+        const uint64_t index = written.load(std::memory_order_relaxed);
+        Slot& slot = slots[index % capacity];
+        //odd while the event is half written
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.event = event;
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        written.store(index + 1, std::memory_order_release);
+    }
+
+    void Tracer::Ring::snapshot(std::vector<Event>& events) const
+    {
+        const uint64_t end = written.load(std::memory_order_acquire);
+        const uint64_t begin = end > capacity ? end - capacity : 0;
+        events.clear();
+        events.reserve(end - begin);
+        for (uint64_t index = begin; index < end; index++)
+        {
+            const Slot& slot = slots[index % capacity];
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            //being written, or already lapped by a newer event
+            if (sequence != 2 * index + 2)
+                continue;
+            Event event = slot.event;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+                continue;
+            events.push_back(event);
+        }
+    }
+
+    void Tracer::write(std::ostream& out) const
+    {
+        std::vector<std::shared_ptr<Ring>> copied;
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            copied = rings;
+            name = process;
+        }
+        const int pid = static_cast<int>(getpid());
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"tid\":0,\"args\":{\"name\":";
+        writeString(out, name.c_str());
+        out << "}}";
+
+        std::vector<Event> events;
+        for (const std::shared_ptr<Ring>& ring : copied)
+        {
+            ring->snapshot(events);
+            for (const Event& event : events)
+            {
+                out << ",\n{\"name\":";
+                writeString(out, event.name);
+                out << ",\"cat\":";
+                writeString(out, event.category);
+                out << ",\"ph\":\"" << static_cast<char>(event.phase) << "\",\"ts\":" << event.start
+                    << ",\"pid\":" << pid << ",\"tid\":" << ring->tid;
+                if (event.phase == SPAN)
+                    out << ",\"dur\":" << event.duration;
+                else
+                    out << ",\"s\":\"t\"";
+                if (event.flow != 0)
+                {
+                    out << ",\"args\":{\"flow\":";
+                    writeFlow(out, event.flow);
+                    out << "}";
+                }
+                out << "}";
+
+                if (event.flow == 0)
+                    continue;
+                //the arrow between nodes, bound to the event above
+                out << ",\n{\"name\":";
+                writeString(out, event.name);
+                out << ",\"cat\":\"flow\",\"ph\":\"" << static_cast<char>(event.flow_phase)
+                    << "\",\"id\":";
+                writeFlow(out, event.flow);
+                out << ",\"ts\":" << event.start << ",\"pid\":" << pid << ",\"tid\":" << ring->tid;
+                if (event.flow_phase != FLOW_START)
+                    out << ",\"bp\":\"e\"";
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+    }
+
+    bool Tracer::dump(std::string& message) const
+    {
+        const std::string file = path();
+        std::ofstream out{file, std::ios::trunc};
+        if (!out)
+        {
+            message = "could not open " + file;
+            return false;
+        }
+        write(out);
+        if (!out)
+        {
+            message = "could not write " + file;
+            return false;
+        }
+        message = "wrote " + file;
+        return true;
+    }
+
+    void Tracer::reset()
+    {
+        active.store(false, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock{mutex};
+        rings.clear();
+        generation.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string Tracer::path() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return directory + "/" + process + "_" + std::to_string(getpid()) + ".trace.json";
+    }
+
+    TraceSpan::TraceSpan(const char* n, const char* c, uint64_t f, Tracer::Phase p) :
+        name{n}, category{c}, start{Tracer::enabled() ? Tracer::now() : 0}, flow{f},
+        flow_phase{p}
+    {}
+
+    TraceSpan::~TraceSpan()
+    {
+        if (start == 0 || !Tracer::enabled())
+            return;
+        Tracer::instance().span(name, category, start, Tracer::now() - start, flow, flow_phase);
+    }
+
+    void TraceSpan::setFlow(uint64_t f, Tracer::Phase p)
+    {
+        flow = f;
+        flow_phase = p;
+    }
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <thread>
+#include "async_log.h"
+
+using tfr_utilities::AsyncLog;
+using tfr_utilities::AsyncLogRecord;
+using tfr_utilities::AsyncLogSite;
+
+template <typename... Args>
+static std::string format(const char* format, const Args&... args)
+{
+    AsyncLogRecord record;
+    record.clear();
+    record.pack(args...);
+    return record.format(format);
+}
+
+TEST(AsyncLog, FormatsLikePrintf)
+{
+    EXPECT_EQ(format("Moving arm to position: %.2f %.2f", 1.0, -0.125),
+            "Moving arm to position: 1.00 -0.12");
+    EXPECT_EQ(format("set %lu at hole %d, %s", size_t{3}, -2, std::string{"done"}),
+            "set 3 at hole -2, done");
+    EXPECT_EQ(format("%5.1f%% of %-4s|%03x", 99.5f, "max", 255u), " 99.5% of max |0ff");
+    EXPECT_EQ(format("no arguments"), "no arguments");
+}
+
+TEST(AsyncLog, ConvertsToTheConversion)
+{
+    //whatever the argument, the conversion decides how it prints
+    EXPECT_EQ(format("%d %u %.1f %s", 2.7, -1, 3, 4), "2 18446744073709551615 3.0 4");
+    EXPECT_EQ(format("%d %d", true, 'a'), "1 97");
+}
+
+TEST(AsyncLog, CopiesStrings)
+{
+    std::string name{"/digging_action_server"};
+    AsyncLogRecord record;
+    record.clear();
+    record.pack(name.c_str());
+    name = "overwritten";
+    EXPECT_EQ(record.format("called by %s"), "called by /digging_action_server");
+}
+
+TEST(AsyncLog, MarksWhatDoesNotFit)
+{
+    const std::string text(200, 'x');
+    AsyncLogRecord record;
+    record.clear();
+    record.pack(1, text, 2);
+    EXPECT_TRUE(record.truncated);
+    EXPECT_LE(record.size, AsyncLogRecord::DATA_SIZE);
+    const std::string out = record.format("%d %s %d");
+    EXPECT_EQ(out.substr(0, 4), "1 xx");
+    EXPECT_EQ(out.substr(out.size() - 12), " <truncated>");
+}
+
+TEST(AsyncLog, RateLimitsEachSite)
+{
+    AsyncLogSite site{nullptr, __FILE__, __LINE__, "test", "%d", 10.0};
+    uint32_t suppressed;
+    EXPECT_TRUE(site.admit(0, suppressed));
+    EXPECT_EQ(suppressed, 0u);
+    EXPECT_FALSE(site.admit(50000, suppressed));
+    EXPECT_FALSE(site.admit(99999, suppressed));
+    EXPECT_TRUE(site.admit(100000, suppressed));
+    EXPECT_EQ(suppressed, 2u);
+
+    AsyncLogSite unlimited{nullptr, __FILE__, __LINE__, "test", "%d", 0.0};
+    for (int i = 0; i < 100; i++)
+        EXPECT_TRUE(unlimited.admit(0, suppressed));
+}
+
+TEST(AsyncLog, DropsTheRingsOfExitedThreads)
+{
+    AsyncLog& log = AsyncLog::instance();
+    log.flush();
+    const size_t before = log.getRingCount();
+
+    std::promise<void> logged, exit;
+    std::thread thread{[&]
+        {
+            TFR_LOG_RATE(::ros::console::levels::Info, 0, "from a short lived thread");
+            logged.set_value();
+            exit.get_future().wait();
+        }};
+    logged.get_future().wait();
+    log.flush();
+    EXPECT_EQ(log.getRingCount(), before + 1);
+
+    exit.set_value();
+    thread.join();
+    log.flush();
+    EXPECT_EQ(log.getRingCount(), before);
+
+    for (int i = 0; i < 16; i++)
+        std::thread{[] { TFR_LOG_RATE(::ros::console::levels::Info, 0, "from thread"); }}.join();
+    log.flush();
+    EXPECT_EQ(log.getRingCount(), before);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "profile_synchronizer.h"
+
+/*
+ * Time for a symmetric trapezoid (or triangle) with the given peak velocity
+ * and acceleration to cover distance
+ * */
+static double moveTime(double distance, double velocity, double acceleration)
+{
+    if (distance <= velocity * velocity / acceleration)
+        return 2 * std::sqrt(distance / acceleration);
+    return distance / velocity + velocity / acceleration;
+}
+
+TEST(ProfileSynchronizer, AllAxesFinishTogether)
+{
+    ProfileSynchronizer synchronizer{{{1.0, 2.0}, {0.5, 1.0}, {2.0, 0.5}}};
+    std::vector<ProfileSynchronizer::Profile> profiles;
+    double time = synchronizer.synchronize({0, 0, 0}, {1.0, -0.8, 0.3}, profiles);
+
+    ASSERT_EQ(profiles.size(), 3u);
+    EXPECT_NEAR(moveTime(1.0, profiles[0].velocity, profiles[0].acceleration), time, 1e-9);
+    EXPECT_NEAR(moveTime(0.8, profiles[1].velocity, profiles[1].acceleration), time, 1e-9);
+    EXPECT_NEAR(moveTime(0.3, profiles[2].velocity, profiles[2].acceleration), time, 1e-9);
+}
+
+TEST(ProfileSynchronizer, StaysWithinLimits)
+{
+    std::vector<ProfileSynchronizer::Limits> limits{{1.0, 2.0}, {0.5, 1.0}, {2.0, 0.5}};
+    ProfileSynchronizer synchronizer{limits};
+    std::vector<ProfileSynchronizer::Profile> profiles;
+    synchronizer.synchronize({0, 0, 0}, {3.0, 0.1, 0.2}, profiles);
+
+    for (size_t i = 0; i < profiles.size(); i++)
+    {
+        EXPECT_LE(profiles[i].velocity, limits[i].max_velocity + 1e-9);
+        EXPECT_LE(profiles[i].acceleration, limits[i].max_acceleration + 1e-9);
+    }
+}
+
+TEST(ProfileSynchronizer, SlowestAxisRunsAtItsLimit)
+{
+    //a single axis should just get the time optimal trapezoid
+    ProfileSynchronizer synchronizer{{{1.0, 2.0}}};
+    std::vector<ProfileSynchronizer::Profile> profiles;
+    double time = synchronizer.synchronize({0}, {2.0}, profiles);
+
+    EXPECT_NEAR(profiles[0].velocity, 1.0, 1e-9);
+    EXPECT_NEAR(profiles[0].acceleration, 2.0, 1e-9);
+    EXPECT_NEAR(time, 2.5, 1e-9);
+}
+
+TEST(ProfileSynchronizer, NoMotion)
+{
+    ProfileSynchronizer synchronizer{{{1.0, 2.0}, {0.5, 1.0}}};
+    std::vector<ProfileSynchronizer::Profile> profiles;
+    double time = synchronizer.synchronize({0.5, 0.2}, {0.5, 0.2}, profiles);
+
+    EXPECT_EQ(time, 0.0);
+    EXPECT_GT(profiles[0].velocity, 0.0);
+    EXPECT_GT(profiles[1].acceleration, 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "status_aggregator.h"
+
+TEST(StatusAggregator, CoalescesRepeatedCodes)
+{
+    StatusAggregator aggregator{8};
+    aggregator.report(StatusCode::EXC_CONNECT_LOCALIZATION, StatusAggregator::INFO, 1.0f, 1.0);
+    aggregator.report(StatusCode::NAV_OK, StatusAggregator::QUIET, 0.0f, 1.1);
+    aggregator.report(StatusCode::EXC_CONNECT_LOCALIZATION, StatusAggregator::WARN, 2.0f, 1.2);
+    aggregator.report(StatusCode::EXC_CONNECT_LOCALIZATION, StatusAggregator::DEBUG, 3.0f, 1.3);
+
+    std::vector<StatusAggregator::Entry> entries;
+    EXPECT_EQ(aggregator.take(entries), 0u);
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].code, StatusCode::EXC_CONNECT_LOCALIZATION);
+    EXPECT_EQ(entries[0].count, 3);
+    EXPECT_EQ(entries[0].level, StatusAggregator::WARN);
+    EXPECT_FLOAT_EQ(entries[0].data, 3.0f);
+    EXPECT_DOUBLE_EQ(entries[0].time, 1.3);
+    EXPECT_EQ(entries[1].code, StatusCode::NAV_OK);
+    EXPECT_EQ(entries[1].count, 1);
+
+    //taking empties it
+    EXPECT_TRUE(aggregator.empty());
+    aggregator.take(entries);
+    EXPECT_TRUE(entries.empty());
+}
+
+TEST(StatusAggregator, CountsWhatDoesNotFit)
+{
+    StatusAggregator aggregator{2};
+    aggregator.report(StatusCode::SYS_OK, StatusAggregator::INFO, 0.0f, 0.0);
+    aggregator.report(StatusCode::LOC_OK, StatusAggregator::INFO, 0.0f, 0.0);
+    aggregator.report(StatusCode::MIN_OK, StatusAggregator::INFO, 0.0f, 0.0);
+    aggregator.report(StatusCode::DMP_OK, StatusAggregator::INFO, 0.0f, 0.0);
+    //codes already waiting still coalesce
+    aggregator.report(StatusCode::SYS_OK, StatusAggregator::INFO, 0.0f, 0.0);
+
+    std::vector<StatusAggregator::Entry> entries;
+    EXPECT_EQ(aggregator.take(entries), 2u);
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].count, 2);
+    EXPECT_EQ(aggregator.take(entries), 0u);
+}
+
+TEST(StatusAggregator, CountSaturates)
+{
+    StatusAggregator aggregator{1};
+    for (int i = 0; i < 70000; i++)
+        aggregator.report(StatusCode::SYS_MOTOR_TOGGLE, StatusAggregator::INFO, 0.0f, 0.0);
+    std::vector<StatusAggregator::Entry> entries;
+    aggregator.take(entries);
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].count, 65535);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
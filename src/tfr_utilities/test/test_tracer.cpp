@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tracer.h"
+
+using tfr_utilities::Tracer;
+using tfr_utilities::TraceSpan;
+
+static size_t count(const std::string& text, const std::string& pattern)
+{
+    size_t found = 0;
+    for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+        found++;
+    return found;
+}
+
+static std::string trace()
+{
+    std::ostringstream out;
+    Tracer::instance().write(out);
+    return out.str();
+}
+
+/*
+ * Every test starts with the tracer reset and configured for 64 events per
+ * thread, writing to a directory of its own that is removed afterwards.
+ * */
+class TracerTest : public testing::Test
+{
+    protected:
+        std::string directory;
+
+        void SetUp() override
+        {
+            char name[] = "/tmp/tracer_test_XXXXXX";
+            ASSERT_NE(mkdtemp(name), nullptr);
+            directory = name;
+            Tracer::instance().reset();
+            Tracer::instance().configure("tracer_test", directory, 64);
+        }
+
+        void TearDown() override
+        {
+            //off, so nothing is written at exit either
+            Tracer::instance().reset();
+            std::remove(file().c_str());
+            rmdir(directory.c_str());
+        }
+
+        std::string file() const
+        {
+            return directory + "/tracer_test_" + std::to_string(getpid()) + ".trace.json";
+        }
+};
+
+TEST_F(TracerTest, RecordsNothingUntilConfigured)
+{
+    Tracer::instance().reset();
+    ASSERT_FALSE(Tracer::enabled());
+    {
+        TraceSpan span{"before_configure"};
+    }
+    Tracer::instance().configure("tracer_test", directory, 64);
+    EXPECT_TRUE(Tracer::enabled());
+    EXPECT_EQ(count(trace(), "before_configure"), 0u);
+}
+
+TEST_F(TracerTest, ResetDropsEverything)
+{
+    Tracer::instance().instant("before_reset", "test");
+    ASSERT_EQ(count(trace(), "\"before_reset\""), 1u);
+    Tracer::instance().reset();
+    EXPECT_FALSE(Tracer::enabled());
+    EXPECT_EQ(count(trace(), "\"before_reset\""), 0u);
+
+    //the thread's next event goes in a new ring
+    Tracer::instance().configure("tracer_test", directory, 64);
+    Tracer::instance().instant("after_reset", "test");
+    EXPECT_EQ(count(trace(), "\"after_reset\""), 1u);
+}
+
+TEST_F(TracerTest, DumpsToTheDirectory)
+{
+    Tracer::instance().instant("dumped", "test");
+    std::string message;
+    ASSERT_TRUE(Tracer::instance().dump(message)) << message;
+    std::ifstream in{file()};
+    ASSERT_TRUE(in.good());
+    std::stringstream json;
+    json << in.rdbuf();
+    EXPECT_EQ(count(json.str(), "\"dumped\""), 1u);
+}
+
+TEST_F(TracerTest, SpansCarryTheirFlow)
+{
+    const uint64_t flow = Tracer::newFlow();
+    {
+        TraceSpan span{"flow_start", "test", flow, Tracer::FLOW_START};
+    }
+    {
+        TraceSpan span{"flow_end", "test"};
+        span.setFlow(flow, Tracer::FLOW_END);
+    }
+    const std::string json = trace();
+    EXPECT_EQ(count(json, "\"name\":\"flow_start\",\"cat\":\"test\",\"ph\":\"X\""), 1u);
+    EXPECT_EQ(count(json, "\"name\":\"flow_start\",\"cat\":\"flow\",\"ph\":\"s\""), 1u);
+    EXPECT_EQ(count(json, "\"name\":\"flow_end\",\"cat\":\"flow\",\"ph\":\"f\""), 1u);
+    //both spans and both flow events name the same id
+    std::ostringstream id;
+    id << "0x" << std::hex << flow;
+    EXPECT_EQ(count(json, "\"" + id.str() + "\""), 4u);
+}
+
+TEST_F(TracerTest, FlowsAreUniqueAndNeverZero)
+{
+    const uint64_t first = Tracer::newFlow();
+    const uint64_t second = Tracer::newFlow();
+    EXPECT_NE(first, 0u);
+    EXPECT_NE(first, second);
+    EXPECT_NE(Tracer::flowFromStamp(0), 0u);
+    EXPECT_EQ(Tracer::flowFromStamp(12345), Tracer::flowFromStamp(12345));
+    EXPECT_NE(Tracer::flowFromStamp(first), first);
+}
+
+TEST_F(TracerTest, RingKeepsTheNewestEvents)
+{
+    std::thread writer{[]
+        {
+            for (int i = 0; i < 50 + 64; i++)
+                Tracer::instance().instant(i < 50 ? "ring_old" : "ring_new", "test");
+        }};
+    writer.join();
+    const std::string json = trace();
+    EXPECT_EQ(count(json, "\"ring_old\""), 0u);
+    EXPECT_EQ(count(json, "\"ring_new\""), 64u);
+}
+
+TEST_F(TracerTest, ThreadsWriteWhileBeingRead)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([]
+            {
+                for (int i = 0; i < 20000; i++)
+                {
+                    TraceSpan span{"concurrent", "test"};
+                }
+            });
+    //every event read out while the threads run is whole
+    for (int i = 0; i < 50; i++)
+    {
+        const std::string json = trace();
+        EXPECT_EQ(count(json, "\"name\":\"concurrent\""),
+                count(json, "\"name\":\"concurrent\",\"cat\":\"test\",\"ph\":\"X\""));
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    EXPECT_EQ(count(trace(), "\"concurrent\""), 4u * 64u);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}